@@ -1,4 +1,41 @@
+import atexit as _atexit
+import contextlib as _contextlib
+import os as _os
+
+from minarray import TRACEMALLOC_DOMAIN
+from minarray import Graph
+from minarray import arange as _arange
 from minarray import array as _array
+from minarray import capture_begin as _capture_begin
+from minarray import capture_end as _capture_end
+from minarray import csr_matrix as _csr_matrix
+from minarray import empty as _empty
+from minarray import enable_stats as _enable_stats
+from minarray import eye as _eye
+from minarray import full as _full
+from minarray import get_autotune as _get_autotune
+from minarray import get_backend as _get_backend
+from minarray import get_gemm_blocking as _get_gemm_blocking
+from minarray import get_memory_policy as _get_memory_policy
+from minarray import get_num_threads as _get_num_threads
+from minarray import get_printoptions as _get_printoptions
+from minarray import linspace as _linspace
+from minarray import list_backends as _list_backends
+from minarray import memory_stats as _memory_stats
+from minarray import reset_peak_memory as _reset_peak_memory
+from minarray import reset_stats as _reset_stats
+from minarray import set_async_executor as _set_async_executor
+from minarray import set_autotune as _set_autotune
+from minarray import set_backend as _set_backend
+from minarray import set_memory_policy as _set_memory_policy
+from minarray import set_num_threads as _set_num_threads
+from minarray import set_printoptions as _set_printoptions
+from minarray import stats as _stats
+from minarray import trace_start as _trace_start
+from minarray import trace_stop as _trace_stop
+from minarray import tune as _tune
+from minarray import tune_save as _tune_save
+from minarray import zeros as _zeros
 
 _dtypes = {"int32": 0, "int64": 1, "float": 2, "double": 3}
 
@@ -7,7 +44,22 @@ int64 = _dtypes["int64"]
 float = _dtypes["float"]
 double = _dtypes["double"]
 
-__all__ = ["array", "ones", "randint", "ravel", "transpose", "sum", "dot"]
+__all__ = ["array", "empty", "zeros", "ones", "full", "arange", "linspace",
+           "eye", "randint", "ravel", "transpose", "sum", "dot",
+           "copy", "ascontiguousarray", "prod", "max", "min", "mean",
+           "argmax", "argmin", "nansum", "nanmax", "nanmin", "nanmean",
+           "cumsum", "cumprod", "exp", "log", "sqrt", "tanh", "sigmoid",
+           "axpy", "scal", "asum", "nrm2", "iamax", "take", "put", "extract",
+           "putmask", "sort", "argsort", "partition", "topk", "dot_async",
+           "sum_async", "set_async_executor",
+           "set_num_threads", "get_num_threads", "capture", "Graph",
+           "csr_matrix",
+           "set_printoptions", "get_printoptions", "stats", "reset_stats",
+           "enable_stats", "trace_start", "trace_stop", "memory_stats",
+           "reset_peak_memory", "set_memory_policy", "get_memory_policy",
+           "memory_policy", "set_backend", "get_backend", "list_backends",
+           "backend", "tune", "set_autotune", "get_autotune", "get_gemm_blocking",
+           "GEMM_SHAPES", "TRACEMALLOC_DOMAIN"]
 __all__.extend(_dtypes.keys())
 
 
@@ -28,14 +80,75 @@ def array(vals=None, shape=None, dtype=None):
     return _array(vals, **kwargs)
 
 
+def csr_matrix(arg, shape=None, dtype=None):
+    """Compressed sparse row matrix.
+
+    arg is either a dense array, or a (values, (rows, cols)) tuple of
+    triplets, which also needs shape; duplicate triplets are summed.
+    m.dot(b) with a dense b returns a dense array.
+    """
+    if isinstance(arg, tuple):
+        values, (rows, cols) = arg
+        if shape is None:
+            raise ValueError("shape is required for triplet input")
+        if not isinstance(values, _array):
+            values = array(list(values), dtype=dtype)
+        return _csr_matrix(values, list(rows), list(cols), shape)
+    return _csr_matrix(arg)
+
+
+def empty(shape, dtype=double):
+    """Returns an array of the given shape whose contents are uninitialised."""
+    _check_dtype(dtype)
+    return _empty(shape, dtype)
+
+
+def zeros(shape, dtype=double):
+    """Zero-filled; big buffers come as untouched zero pages."""
+    _check_dtype(dtype)
+    return _zeros(shape, dtype)
+
+
 def ones(shape=None, dtype=None):
     _check_dtype(dtype)
-    return array(shape=shape, dtype=dtype).ones()
+    return _full(shape, 1, double if dtype is None else dtype)
+
+
+def full(shape, fill_value, dtype=double):
+    _check_dtype(dtype)
+    return _full(shape, fill_value, dtype)
+
+
+def arange(start, stop=None, step=1, dtype=None):
+    """Values start, start + step, ... up to but excluding stop, as (n, 1).
+
+    arange(stop) starts from 0. Without a dtype, all-int arguments give
+    int64 and anything else double.
+    """
+    if stop is None:
+        start, stop = 0, start
+    if dtype is None:
+        ints = all(isinstance(v, int) for v in (start, stop, step))
+        dtype = int64 if ints else double
+    _check_dtype(dtype)
+    return _arange(start, stop, step, dtype)
+
+
+def linspace(start, stop, num=50, endpoint=True, dtype=double):
+    """num evenly spaced values from start to stop, as (num, 1)."""
+    _check_dtype(dtype)
+    return _linspace(start, stop, num, endpoint, dtype)
+
+
+def eye(N, M=None, k=0, dtype=double):
+    """N x M (M defaults to N) with ones on diagonal k, zeros elsewhere."""
+    _check_dtype(dtype)
+    return _eye(N, M, k, dtype)
 
 
 def randint(low=0, high=1, shape=None, dtype=None):
     _check_dtype(dtype)
-    return array(shape=shape, dtype=dtype).randint(low, high)
+    return _empty(shape, double if dtype is None else dtype).randint(low, high)
 
 
 def ravel(a):
@@ -46,9 +159,416 @@ def transpose(a, perm=None):
     return a.transpose(perm)
 
 
-def sum(a, axis=0):
-    return a.sum(axis)
+def sum(a, axis=0, keepdims=False):
+    if isinstance(axis, int) and not keepdims:
+        return a.sum(axis)
+    return a.reduce("sum", axis, keepdims)
+
+
+def prod(a, axis=None, keepdims=False):
+    return a.reduce("prod", axis, keepdims)
+
+
+def max(a, axis=None, keepdims=False):
+    return a.reduce("max", axis, keepdims)
+
+
+def min(a, axis=None, keepdims=False):
+    return a.reduce("min", axis, keepdims)
+
+
+def mean(a, axis=None, keepdims=False):
+    return a.reduce("mean", axis, keepdims)
+
+
+def argmax(a, axis=None, keepdims=False):
+    return a.reduce("argmax", axis, keepdims)
+
+
+def argmin(a, axis=None, keepdims=False):
+    return a.reduce("argmin", axis, keepdims)
+
+
+def nansum(a, axis=None, keepdims=False):
+    return a.reduce("nansum", axis, keepdims)
+
+
+def nanmax(a, axis=None, keepdims=False):
+    return a.reduce("nanmax", axis, keepdims)
+
+
+def nanmin(a, axis=None, keepdims=False):
+    return a.reduce("nanmin", axis, keepdims)
+
+
+def nanmean(a, axis=None, keepdims=False):
+    return a.reduce("nanmean", axis, keepdims)
+
+
+def cumsum(a, axis=None):
+    return a.scan("cumsum", axis)
+
+
+def cumprod(a, axis=None):
+    return a.scan("cumprod", axis)
+
+
+def exp(a, out=None):
+    """Elementwise exp of a float or double array, into out if given.
+
+    out may be a itself. Error bounds are listed in core/array_math.h.
+    """
+    return a.unary("exp", out)
+
+
+def log(a, out=None):
+    return a.unary("log", out)
+
+
+def sqrt(a, out=None):
+    return a.unary("sqrt", out)
+
+
+def tanh(a, out=None):
+    return a.unary("tanh", out)
+
+
+def sigmoid(a, out=None):
+    """1 / (1 + exp(-a)), elementwise."""
+    return a.unary("sigmoid", out)
+
+
+def axpy(alpha, x, y):
+    """y += alpha * x in place, returning y.
+
+    alpha is converted to y's dtype first, so it truncates for int arrays.
+    """
+    return y.axpy(alpha, x)
+
+
+def scal(alpha, x):
+    """x *= alpha in place, returning x."""
+    return x.scal(alpha)
+
+
+def asum(x):
+    """Sum of absolute values of x, as a float."""
+    return x.asum()
+
+
+def nrm2(x):
+    """Euclidean norm of x, as a float, without overflow or underflow."""
+    return x.nrm2()
+
+
+def iamax(x):
+    """Row-major index of the first element of largest magnitude."""
+    return x.iamax()
+
+
+def take(a, indices, axis=None):
+    """Gathers a[indices] along axis, or from the flattened a if None.
+
+    indices is an int32 or int64 array; negative indices count from the end.
+    a[indices] is take(a, indices, axis=0).
+    """
+    return a.take(indices, axis)
+
+
+def put(a, indices, values, axis=None):
+    """Scatters values into a[indices] in place; the last duplicate wins.
+
+    values is shaped like take(a, indices, axis), or a scalar to repeat.
+    Nothing is written if any index is out of range.
+    """
+    a.put(indices, values, axis)
+
+
+def extract(condition, a):
+    """The elements of a where condition is nonzero, as an (n, 1) array."""
+    return a.extract(condition)
+
+
+def putmask(a, mask, values):
+    """Sets a to values wherever mask is nonzero, in place.
+
+    values has the dims of a, or is a scalar.
+    """
+    a.putmask(mask, values)
+
+
+def sort(a, axis=-1):
+    """A sorted copy of a along axis, or of the flattened a if None.
+
+    Ints are radix sorted directly and floats after mapping them to
+    integers that order the same way, so -0.0 sorts before 0.0 and NaNs
+    last. a.sort(axis) sorts in place.
+    """
+    return a.sorted(axis)
+
+
+def argsort(a, axis=-1):
+    """int64 positions along axis, or into the flattened a if None, that
+    would sort a. Equal elements keep their order."""
+    return a.argsort(axis)
+
+
+def partition(a, kth, axis=-1):
+    """A copy of a with the kth element of each lane where a sort would put
+    it, smaller ones before and larger ones after, in no set order.
+    a.partition(kth, axis) works in place."""
+    return a.partitioned(kth, axis)
+
+
+def topk(a, k, axis=-1, largest=True):
+    """(values, indices) of the k largest, or smallest, elements along
+    axis, or of the flattened a if None.
+
+    Both come in sorted order, largest first when largest is set, and
+    equal values come in order of position. indices is int64.
+    """
+    return a.topk(k, axis, largest)
 
 
 def dot(a, b):
     return a.dot(b)
+
+
+def dot_async(a, b):
+    """Runs a.dot(b) on the async executor and returns its Future.
+
+    The GIL is released while the kernel runs; inside a coroutine use
+    ``await asyncio.wrap_future(dot_async(a, b))``. a and b cannot be
+    transposed until the future completes.
+    """
+    return a.dot_async(b)
+
+
+def sum_async(a, axis=0):
+    """Runs a.sum(axis) on the async executor and returns its Future."""
+    return a.sum_async(axis)
+
+
+def set_async_executor(executor=None):
+    """Sets the executor async operations are submitted to.
+
+    Any object with a concurrent.futures-style submit() works. None restores
+    the default, a ThreadPoolExecutor created on first use.
+    """
+    _set_async_executor(executor)
+
+
+@_contextlib.contextmanager
+def capture():
+    """Records the dot and sum calls made in the block into a Graph.
+
+    Calls still run and return arrays as usual. g.replay(inputs) then
+    recomputes the whole sequence in one call, without allocating, writing
+    into the same output arrays and returning the last one. inputs bind,
+    in order, the arrays in g.inputs (operands not produced inside the
+    block) and must match their dtype, dims and strides. Outputs cannot be
+    transposed while the graph is alive, nor inputs during capture. Other
+    ops, async ones included, are not recorded.
+    """
+    g = _capture_begin()
+    try:
+        yield g
+    finally:
+        _capture_end(g)
+
+
+def copy(a, order="C"):
+    return a.copy(order)
+
+
+def ascontiguousarray(a):
+    """Returns a itself if it is already row-major contiguous, else a copy."""
+    return a if a.c_contiguous else a.copy("C")
+
+
+def set_num_threads(n=None, pin=None):
+    """Sets how many threads parallel kernels use, the caller included.
+
+    The pool is shared by all ops. None restores MINUMPY_NUM_THREADS or the
+    core count. pin=True binds each worker to its own core and pin=False
+    releases them; None leaves the setting (MINUMPY_PIN_THREADS) alone.
+    """
+    _set_num_threads(0 if n is None else n, pin)
+
+
+def get_num_threads():
+    """Returns the thread count used by parallel kernels."""
+    return _get_num_threads()
+
+
+def set_printoptions(threshold=None, edgeitems=None, precision=None):
+    kwargs = {}
+    if threshold is not None:
+        kwargs["threshold"] = threshold
+    if edgeitems is not None:
+        kwargs["edgeitems"] = edgeitems
+    if precision is not None:
+        kwargs["precision"] = precision
+    _set_printoptions(**kwargs)
+
+
+def get_printoptions():
+    return _get_printoptions()
+
+
+def enable_stats(enabled=True):
+    _enable_stats(enabled)
+
+
+def stats():
+    return _stats()
+
+
+def reset_stats():
+    _reset_stats()
+
+
+def trace_start(path):
+    _trace_start(path)
+
+
+def trace_stop():
+    _trace_stop()
+
+
+if _os.environ.get("MINUMPY_TRACE"):
+    trace_start(_os.environ["MINUMPY_TRACE"])
+    _atexit.register(trace_stop)
+
+
+def memory_stats():
+    """Live, peak and cumulative data-buffer bytes per dtype and in total.
+
+    Buffers are also reported to tracemalloc under TRACEMALLOC_DOMAIN.
+    """
+    per_dtype, total = _memory_stats()
+    ret = {name: per_dtype[code] for name, code in _dtypes.items()}
+    ret["total"] = total
+    return ret
+
+
+def reset_peak_memory():
+    _reset_peak_memory()
+
+
+def set_memory_policy(mmap_threshold=None, hugepages=None, numa=None,
+                      node=None, first_touch=None):
+    """Sets how data buffers of at least mmap_threshold bytes are placed.
+
+    Such buffers are mapped directly, 2 MB aligned and advised for
+    transparent huge pages when hugepages is set. numa is "local" (pages
+    land on the node that first touches them), "interleave" (round-robin
+    over all allowed nodes) or "bind" (only on node). With first_touch,
+    new zeroed buffers are faulted in by the parallel pool up front, except
+    those of zeros(), which stay untouched until written. None leaves a
+    setting unchanged.
+    """
+    kwargs = {}
+    if mmap_threshold is not None:
+        kwargs["mmap_threshold"] = mmap_threshold
+    if hugepages is not None:
+        kwargs["hugepages"] = hugepages
+    if numa is not None:
+        kwargs["numa"] = numa
+    if node is not None:
+        kwargs["node"] = node
+    if first_touch is not None:
+        kwargs["first_touch"] = first_touch
+    _set_memory_policy(**kwargs)
+
+
+def get_memory_policy():
+    return _get_memory_policy()
+
+
+@_contextlib.contextmanager
+def memory_policy(**kwargs):
+    """Applies set_memory_policy(**kwargs) to arrays created in the block.
+
+    The policy is process-wide, so arrays other threads create meanwhile
+    follow it too. The previous policy is restored on exit.
+    """
+    old = _get_memory_policy()
+    _set_memory_policy(**kwargs)
+    try:
+        yield
+    finally:
+        _set_memory_policy(**old)
+
+
+def set_backend(spec):
+    """Selects the kernel backends serving gemm, dot and the level-1 ops.
+
+    spec lists backend names in order of preference, comma-separated; an
+    "op=name" entry prefers a backend for that op only, as in
+    "blas,nrm2=reference". Each op and dtype goes to the first listed
+    backend implementing it, else to "simd". The initial selection comes
+    from MINUMPY_BACKEND, defaulting to "threaded,simd".
+    """
+    _set_backend(spec)
+
+
+def get_backend(op=None, dtype=double):
+    """The selection in effect, or the backend serving op for dtype."""
+    if op is None:
+        return _get_backend()
+    _check_dtype(dtype)
+    return _get_backend(op, dtype)
+
+
+def list_backends():
+    """Names of the registered backends; "blas" only if a library loaded."""
+    return _list_backends()
+
+
+@_contextlib.contextmanager
+def backend(spec):
+    """Applies set_backend(spec) within the block, process-wide."""
+    old = _get_backend()
+    _set_backend(spec)
+    try:
+        yield
+    finally:
+        _set_backend(old)
+
+
+GEMM_SHAPES = ("small", "skinny", "large")
+
+
+def tune(dtypes=None, shapes=None, path=None):
+    """Benchmarks gemm block sizes and thread panels and caches the winners.
+
+    Each dtype and shape class ("small", "skinny" or "large" products) is
+    timed on a representative product and its fastest blocking installed,
+    then merged into the tuning cache under this CPU model and thread
+    count, so later imports on a like machine start tuned. path overrides
+    MINUMPY_TUNE_CACHE and the default ~/.cache/minumpy/gemm_tune. Returns
+    {(dtype, shape): blocking}.
+    """
+    results = {}
+    for dtype in (_dtypes.values() if dtypes is None else dtypes):
+        _check_dtype(dtype)
+        for shape in (GEMM_SHAPES if shapes is None else shapes):
+            results[(dtype, shape)] = _tune(dtype, shape)
+    _tune_save(path)
+    return results
+
+
+def set_autotune(enabled):
+    """Tunes each untuned dtype and shape class on its first product."""
+    _set_autotune(enabled)
+
+
+def get_autotune():
+    return _get_autotune()
+
+
+def get_gemm_blocking(dtype, shape="large"):
+    """The blocking gemm uses for dtype and shape class, as a dict."""
+    _check_dtype(dtype)
+    return _get_gemm_blocking(dtype, shape)
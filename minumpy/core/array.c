@@ -1,3 +1,5 @@
+#include <inttypes.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -5,25 +7,173 @@
 
 #include "array.h"
 #include "array_dtypes.h"
+#include "array_mem.h"
+#include "array_stats.h"
+#include "array_trace.h"
 #include "array_utils.h"
 
-arrayObject*
-array_alloc(int *dims, int nd, ARRAY_DTYPE dtype)
+static arrayObject*
+alloc_array(int64_t *dims, int nd, ARRAY_DTYPE dtype, int zero, const arrayMemPolicy *policy)
 {
     if (validate_nd(nd)) return NULL;
+    int64_t n;
+    if (prod_checked(dims, nd, &n)) {
+        printf("Invalid dims for allocation\n");
+        return NULL;
+    }
 
+    ARRAY_STATS_BEGIN(t0);
     arrayObject *a = malloc(sizeof(arrayObject));
 
     int ret_nd = ARRAY_NUM_DIMS;
-    int *ret_dims = promote_dims(dims, nd, ARRAY_NUM_DIMS);
-    int *ret_strides = cumprod_reverse(ret_dims, ret_nd);
+    int64_t *ret_dims = promote_dims(dims, nd, ARRAY_NUM_DIMS);
+    int64_t *ret_strides = cumprod_reverse(ret_dims, ret_nd);
+    ARRAY_TRACE_BEGIN("array_alloc", dtype, ret_dims, NULL);
 
-    a->data = calloc(prod(ret_dims, ret_nd), array_dtype_size(dtype));
+    a->data = array_data_alloc_policy(n, dtype, zero, policy);
+    if (a->data == NULL) {
+        printf("Cannot allocate %" PRId64 " elements\n", n);
+        free(ret_dims);
+        free(ret_strides);
+        free(a);
+        ARRAY_TRACE_END("array_alloc");
+        return NULL;
+    }
     a->dtype = dtype;
     a->nd = ret_nd;
     a->dims = ret_dims;
     a->strides = ret_strides;
 
+    ARRAY_TRACE_END("array_alloc");
+    ARRAY_STATS_END(t0, STATS_ALLOC, n, n * array_dtype_size(dtype));
+    return a;
+}
+
+arrayObject*
+array_alloc(int64_t *dims, int nd, ARRAY_DTYPE dtype)
+{
+    arrayMemPolicy policy;
+    array_mem_get_policy(&policy);
+    return alloc_array(dims, nd, dtype, 1, &policy);
+}
+
+arrayObject*
+array_alloc_policy(int64_t *dims, int nd, ARRAY_DTYPE dtype, const arrayMemPolicy *policy)
+{
+    return alloc_array(dims, nd, dtype, 1, policy);
+}
+
+arrayObject*
+array_zeros(int64_t *dims, int nd, ARRAY_DTYPE dtype)
+{
+    arrayMemPolicy policy;
+    array_mem_get_policy(&policy);
+    policy.first_touch = 0;
+    return alloc_array(dims, nd, dtype, 1, &policy);
+}
+
+arrayObject*
+array_empty(int64_t *dims, int nd, ARRAY_DTYPE dtype)
+{
+    arrayMemPolicy policy;
+    array_mem_get_policy(&policy);
+    return alloc_array(dims, nd, dtype, 0, &policy);
+}
+
+arrayObject*
+array_full(int64_t *dims, int nd, double val, ARRAY_DTYPE dtype)
+{
+    arrayObject *a = array_empty(dims, nd, dtype);
+    if (a == NULL) return NULL;
+    buf_fill_val(a->data, val, NUM_ARRAY_ELEMS(a), dtype);
+    return a;
+}
+
+arrayObject*
+array_arange(double start, double stop, double step, ARRAY_DTYPE dtype)
+{
+    if (step == 0 || !isfinite(start) || !isfinite(stop) || !isfinite(step)) {
+        printf("Expected finite start, stop and a non-zero step\n");
+        return NULL;
+    }
+    double len = (stop - start) / step;
+    if (!(len < (double)INT64_MAX)) {
+        printf("Range too long\n");
+        return NULL;
+    }
+    int64_t dims[] = {0};
+    if (len > 0) {
+        dims[0] = (int64_t)len;
+        dims[0] += dims[0] < len;  // ceil without libm
+    }
+    arrayObject *a = array_empty(dims, 1, dtype);
+    if (a == NULL) return NULL;
+    buf_fill_linear(a->data, start, step, dims[0], dtype);
+    return a;
+}
+
+arrayObject*
+array_full_int(int64_t *dims, int nd, int64_t val, ARRAY_DTYPE dtype)
+{
+    arrayObject *a = array_empty(dims, nd, dtype);
+    if (a == NULL) return NULL;
+    buf_fill_int(a->data, val, NUM_ARRAY_ELEMS(a), dtype);
+    return a;
+}
+
+arrayObject*
+array_arange_int(int64_t start, int64_t stop, int64_t step, ARRAY_DTYPE dtype)
+{
+    if (step == 0) {
+        printf("Expected a non-zero step\n");
+        return NULL;
+    }
+    // Spans and steps as unsigned magnitudes, which cannot overflow.
+    int64_t dims[] = {0};
+    if (step > 0 && stop > start) {
+        dims[0] = ((uint64_t)stop - (uint64_t)start - 1) / (uint64_t)step + 1;
+    } else if (step < 0 && stop < start) {
+        dims[0] = ((uint64_t)start - (uint64_t)stop - 1) / (0 - (uint64_t)step) + 1;
+    }
+    arrayObject *a = array_empty(dims, 1, dtype);
+    if (a == NULL) return NULL;
+    buf_fill_linear_int(a->data, start, step, dims[0], dtype);
+    return a;
+}
+
+arrayObject*
+array_linspace(double start, double stop, int64_t num, int endpoint, ARRAY_DTYPE dtype)
+{
+    if (num < 0 || !isfinite(start) || !isfinite(stop)) {
+        printf("Expected finite start and stop, and num >= 0\n");
+        return NULL;
+    }
+    int64_t dims[] = {num};
+    arrayObject *a = array_empty(dims, 1, dtype);
+    if (a == NULL) return NULL;
+    int64_t div = endpoint ? num - 1 : num;
+    double step = div > 0 ? (stop - start) / div : 0;
+    buf_fill_linear(a->data, start, step, num, dtype);
+    if (endpoint && num > 1) {
+        // Land exactly on stop rather than start + (num - 1) * step.
+        buf_fill_val(a->data + (num - 1) * array_dtype_size(dtype), stop, 1, dtype);
+    }
+    return a;
+}
+
+arrayObject*
+array_eye(int64_t n, int64_t m, int64_t k, ARRAY_DTYPE dtype)
+{
+    int64_t dims[] = {n, m};
+    arrayObject *a = array_alloc(dims, 2, dtype);
+    if (a == NULL) return NULL;
+    int64_t row = k < 0 ? -k : 0;
+    int64_t col = k > 0 ? k : 0;
+    if (row < n && col < m) {
+        int64_t len = n - row < m - col ? n - row : m - col;
+        buf_fill_val_strided(a->data + (row * m + col) * array_dtype_size(dtype), 1, len,
+                             m + 1, dtype);
+    }
     return a;
 }
 
@@ -31,7 +181,7 @@ void
 array_free(arrayObject *a)
 {
     if (!a) return;
-    free(a->data);
+    array_data_free(a->data);
     free(a->dims);
     free(a->strides);
     free(a);
@@ -40,8 +190,52 @@ array_free(arrayObject *a)
 arrayObject*
 array_copy(const arrayObject *a)
 {
+    return array_copy_order(a, 'C');
+}
+
+int
+array_is_contiguous(const arrayObject *a, char order)
+{
+    int64_t expected = 1;
+    for (int k = 0; k < a->nd; k++) {
+        int i = order == 'F' ? k : a->nd - 1 - k;
+        if (a->dims[i] != 1 && a->strides[i] != expected) return 0;
+        expected *= a->dims[i];
+    }
+    return 1;
+}
+
+arrayObject*
+array_copy_order(const arrayObject *a, char order)
+{
+    if (order == 'K') {
+        order = a->strides[0] < a->strides[1] ? 'F' : 'C';
+    }
+    if (order != 'C' && order != 'F') {
+        printf("Unknown order %c\n", order);
+        return NULL;
+    }
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_copy", a->dtype, a->dims, NULL);
     arrayObject *ret = array_alloc(a->dims, a->nd, a->dtype);
-    memcpy(ret->data, a->data, NUM_ARRAY_ELEMS(a) * array_dtype_size(a->dtype));
+    if (ret == NULL) {
+        ARRAY_TRACE_END("array_copy");
+        return NULL;
+    }
+    if (order == 'C') {
+        buf_copy_strided(ret->data, a->data, a->dims[0], a->dims[1],
+                         a->strides[0], a->strides[1], a->dtype);
+    } else {
+        // A column-major copy is the row-major copy of the transposed view.
+        buf_copy_strided(ret->data, a->data, a->dims[1], a->dims[0],
+                         a->strides[1], a->strides[0], a->dtype);
+        ret->strides[0] = 1;
+        ret->strides[1] = a->dims[0];
+    }
+    ARRAY_TRACE_END("array_copy");
+    ARRAY_STATS_END(t0, STATS_COPY, NUM_ARRAY_ELEMS(a),
+                    NUM_ARRAY_ELEMS(a) * array_dtype_size(a->dtype));
     return ret;
 }
 
@@ -63,26 +257,34 @@ array_fill_uniform_int(arrayObject *a, int low, int high, ARRAY_DTYPE dtype) {
 void
 *array_ravel(const arrayObject *a)
 {
-    size_t dtype_size = array_dtype_size(a->dtype);
-    void *ret = malloc(NUM_ARRAY_ELEMS(a) * dtype_size);
-    for (int i = 0; i < a->dims[0]; i++) {
-        int row_offset = i * a->strides[0];
-        for (int j = 0; j < a->dims[1]; j++) {
-            buf_set_val(
-                ret + (i * a->dims[1] + j) * dtype_size,
-                a->data + (row_offset + j * a->strides[1]) * dtype_size,
-                a->dtype
-            );
-        }
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_ravel", a->dtype, a->dims, NULL);
+    int64_t n = NUM_ARRAY_ELEMS(a);
+    void *ret = array_data_alloc(n, a->dtype, 0);
+    if (ret == NULL) {
+        ARRAY_TRACE_END("array_ravel");
+        return NULL;
     }
+    buf_copy_strided(
+        ret,
+        a->data,
+        a->dims[0],
+        a->dims[1],
+        a->strides[0],
+        a->strides[1],
+        a->dtype
+    );
+    ARRAY_TRACE_END("array_ravel");
+    ARRAY_STATS_END(t0, STATS_RAVEL, n, n * array_dtype_size(a->dtype));
     return ret;
 }
 
 void
 array_transpose(arrayObject *a, int *perm)
 {
-    int *permuted_dims = malloc(a->nd * sizeof(int));
-    int *permuted_strides = malloc(a->nd * sizeof(int));
+    ARRAY_STATS_BEGIN(t0);
+    int64_t *permuted_dims = malloc(a->nd * sizeof(int64_t));
+    int64_t *permuted_strides = malloc(a->nd * sizeof(int64_t));
     for (int i = 0; i < a->nd; i++) {
         permuted_dims[i] = a->dims[perm[i]];
         permuted_strides[i] = a->strides[perm[i]];
@@ -91,41 +293,293 @@ array_transpose(arrayObject *a, int *perm)
     a->dims = permuted_dims;
     free(a->strides);
     a->strides = permuted_strides;
+    ARRAY_STATS_END(t0, STATS_TRANSPOSE, 0, 0);
 }
 
 arrayObject*
 array_sum(arrayObject *a, int axis)
 {
-    int ret_nd = a->nd > 1 ? a->nd - 1 : 1;
-    int *ret_dims = filter_idx(a->dims, a->nd, axis);
-    arrayObject *ret = array_alloc(ret_dims, ret_nd, a->dtype);
+    ARRAY_TRACE_BEGIN("array_sum", a->dtype, a->dims, NULL);
+    arrayObject *ret = array_reduce(a, REDUCE_SUM, 1 << axis, 0);
+    ARRAY_TRACE_END("array_sum");
+    return ret;
+}
 
-    int *perm = range(a->nd);
-    swap_idx(perm, axis, a->nd - 1);
-    array_transpose(a, perm);
+int
+array_reduce_needs_scratch(const arrayObject *a, REDUCE_OP op, int axes)
+{
+    if (axes == (1 << a->nd) - 1) {
+        // Order-independent reductions can run over a column-major buffer
+        // as is; arg reductions need row-major order for their flat index.
+        return !(array_is_contiguous(a, 'C') ||
+                 (!reduce_is_arg(op) && array_is_contiguous(a, 'F')));
+    }
+    return a->strides[1] != 1 && a->strides[0] != 1;
+}
 
-    size_t dtype_size = array_dtype_size(a->dtype);
-    void *a_ravel = array_ravel(a);
-    for (int i = 0; i < a->dims[0]; i++) {
-        reduce_sum(
-            ret->data + i * dtype_size,
-            a_ravel + i * a->dims[1] * dtype_size,
-            a->dims[1],
-            a->dtype
-        );
+int
+array_reduce_into(char *out, const arrayObject *a, REDUCE_OP op, int axes, char *scratch)
+{
+    const char *src = a->data;
+    int64_t n = NUM_ARRAY_ELEMS(a);
+    int64_t rows = a->dims[0];
+    int64_t cols = a->dims[1];
+    int64_t row_stride = a->strides[0];
+    int axis = axes == 1 ? 0 : 1;
+
+    if (scratch) {
+        buf_copy_strided(scratch, a->data, rows, cols, a->strides[0], a->strides[1],
+                         a->dtype);
+        src = scratch;
+        row_stride = cols;
+    } else if (axes != (1 << a->nd) - 1 && a->strides[1] != 1) {
+        // A transposed view: reduce the other axis of the underlying rows.
+        rows = a->dims[1];
+        cols = a->dims[0];
+        row_stride = a->strides[1];
+        axis = 1 - axis;
+    }
+
+    if (axes == (1 << a->nd) - 1) {
+        return reduce(out, src, 1, n, n, 1, op, a->dtype);
+    }
+    return reduce(out, src, rows, cols, row_stride, axis, op, a->dtype);
+}
+
+arrayObject*
+array_reduce(const arrayObject *a, REDUCE_OP op, int axes, int keepdims)
+{
+    int all_axes = (1 << a->nd) - 1;
+    if (axes <= 0 || axes > all_axes) {
+        printf("Invalid reduction axes %d\n", axes);
+        return NULL;
+    }
+    int64_t n = NUM_ARRAY_ELEMS(a);
+    if (n == 0 && op != REDUCE_SUM && op != REDUCE_NANSUM && op != REDUCE_PROD) {
+        printf("Zero-size reduction (%s)\n", REDUCE_OP_NAMES[op]);
+        return NULL;
+    }
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_reduce", a->dtype, a->dims, NULL);
+    int ret_nd = 0;
+    int64_t ret_dims[ARRAY_NUM_DIMS];
+    for (int i = 0; i < a->nd; i++) {
+        int reduced = axes & (1 << i);
+        if (keepdims) {
+            ret_dims[ret_nd++] = reduced ? 1 : a->dims[i];
+        } else if (!reduced) {
+            ret_dims[ret_nd++] = a->dims[i];
+        }
+    }
+    if (ret_nd == 0) {
+        ret_dims[ret_nd++] = 1;
+    }
+    arrayObject *ret = array_alloc(ret_dims, ret_nd, reduce_out_dtype(op, a->dtype));
+    char *tmp = NULL;
+    if (ret != NULL && array_reduce_needs_scratch(a, op, axes)) {
+        tmp = array_data_alloc(n, a->dtype, 0);
+        if (tmp == NULL) {
+            array_free(ret);
+            ret = NULL;
+        }
+    }
+    if (ret == NULL) {
+        ARRAY_TRACE_END("array_reduce");
+        return NULL;
+    }
+    if (array_reduce_into(ret->data, a, op, axes, tmp)) {
+        array_free(ret);
+        ret = NULL;
+    }
+    array_data_free(tmp);
+
+    ARRAY_TRACE_END("array_reduce");
+    ARRAY_STATS_END(t0, op == REDUCE_SUM ? STATS_SUM : STATS_REDUCE, n, 0);
+    return ret;
+}
+
+arrayObject*
+array_scan(const arrayObject *a, SCAN_OP op, int axis)
+{
+    if (axis >= a->nd) {
+        printf("Invalid scan axis %d\n", axis);
+        return NULL;
+    }
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_scan", a->dtype, a->dims, NULL);
+    int64_t n = NUM_ARRAY_ELEMS(a);
+    arrayObject *ret = NULL;
+    const char *src = a->data;
+    char *tmp = NULL;
+    int64_t rows = a->dims[0];
+    int64_t cols = a->dims[1];
+    int64_t row_stride = a->strides[0];
+
+    if (axis < 0 || (axis == 0 && cols == 1 && row_stride == 1)) {
+        // A flattened scan, or one down a contiguous column, is a single run.
+        int64_t ret_dims[] = {n};
+        ret = axis < 0 ? array_alloc(ret_dims, 1, a->dtype)
+                       : array_alloc(a->dims, a->nd, a->dtype);
+        if (ret == NULL) goto done;
+        if (!array_is_contiguous(a, 'C')) {
+            tmp = array_data_alloc(n, a->dtype, 0);
+            if (tmp == NULL) goto fail;
+            buf_copy_strided(tmp, a->data, rows, cols, a->strides[0], a->strides[1],
+                             a->dtype);
+            src = tmp;
+        }
+        scan(ret->data, src, 1, n, n, 1, op, a->dtype);
+    } else {
+        ret = array_alloc(a->dims, a->nd, a->dtype);
+        if (ret == NULL) goto done;
+        if (a->strides[1] != 1 && a->strides[0] == 1) {
+            // Scan a transposed view in its own layout and return it
+            // column-major, rather than copying the input to row-major.
+            rows = a->dims[1];
+            cols = a->dims[0];
+            row_stride = a->strides[1];
+            axis = 1 - axis;
+            ret->strides[0] = 1;
+            ret->strides[1] = a->dims[0];
+        } else if (a->strides[1] != 1) {
+            tmp = array_data_alloc(n, a->dtype, 0);
+            if (tmp == NULL) goto fail;
+            buf_copy_strided(tmp, a->data, rows, cols, a->strides[0], a->strides[1],
+                             a->dtype);
+            src = tmp;
+            row_stride = cols;
+        }
+        scan(ret->data, src, rows, cols, row_stride, axis, op, a->dtype);
+    }
+    array_data_free(tmp);
+    ARRAY_STATS_END(t0, STATS_SCAN, n, n * array_dtype_size(a->dtype));
+    goto done;
+
+fail:
+    array_free(ret);
+    ret = NULL;
+done:
+    ARRAY_TRACE_END("array_scan");
+    return ret;
+}
+
+/*
+ * The rows x cols view the level-1 kernels walk: a single contiguous row
+ * when a is C-contiguous, or F-contiguous and flat_f is set, since then
+ * the order elements are visited in does not matter.
+ */
+static void
+blas1_view(const arrayObject *a, int flat_f, int64_t view[4])
+{
+    if (array_is_contiguous(a, 'C') || (flat_f && array_is_contiguous(a, 'F'))) {
+        view[0] = 1;
+        view[1] = NUM_ARRAY_ELEMS(a);
+        view[2] = 0;
+        view[3] = 1;
+    } else {
+        view[0] = a->dims[0];
+        view[1] = a->dims[1];
+        view[2] = a->strides[0];
+        view[3] = a->strides[1];
+    }
+}
+
+int
+array_axpy(arrayObject *y, double alpha, const arrayObject *x)
+{
+    if (x->dtype != y->dtype || x->dims[0] != y->dims[0] || x->dims[1] != y->dims[1]) {
+        printf("axpy operands must have the same dtype and dims\n");
+        return 1;
+    }
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_axpy", y->dtype, y->dims, NULL);
+    int64_t rows = y->dims[0], cols = y->dims[1];
+    int64_t y_rs = y->strides[0], y_cs = y->strides[1];
+    int64_t x_rs = x->strides[0], x_cs = x->strides[1];
+    if ((array_is_contiguous(y, 'C') && array_is_contiguous(x, 'C')) ||
+        (array_is_contiguous(y, 'F') && array_is_contiguous(x, 'F'))) {
+        // Same contiguous layout: pair the elements up as one flat run.
+        rows = 1;
+        cols = NUM_ARRAY_ELEMS(y);
+        y_cs = x_cs = 1;
     }
-    free(a_ravel);
+    axpy(y->data, y_rs, y_cs, alpha, x->data, x_rs, x_cs, rows, cols, y->dtype);
+    ARRAY_TRACE_END("array_axpy");
+    ARRAY_STATS_END(t0, STATS_BLAS, NUM_ARRAY_ELEMS(y), 0);
+    return 0;
+}
+
+void
+array_scal(arrayObject *a, double alpha)
+{
+    ARRAY_STATS_BEGIN(t0);
+    int64_t v[4];
+    blas1_view(a, 1, v);
+    scal(a->data, alpha, v[0], v[1], v[2], v[3], a->dtype);
+    ARRAY_STATS_END(t0, STATS_BLAS, NUM_ARRAY_ELEMS(a), 0);
+}
 
-    array_transpose(a, perm);
+double
+array_asum(const arrayObject *a)
+{
+    ARRAY_STATS_BEGIN(t0);
+    int64_t v[4];
+    blas1_view(a, 1, v);
+    double ret = asum(a->data, v[0], v[1], v[2], v[3], a->dtype);
+    ARRAY_STATS_END(t0, STATS_BLAS, NUM_ARRAY_ELEMS(a), 0);
+    return ret;
+}
 
+double
+array_nrm2(const arrayObject *a)
+{
+    ARRAY_STATS_BEGIN(t0);
+    int64_t v[4];
+    blas1_view(a, 1, v);
+    double ret = nrm2(a->data, v[0], v[1], v[2], v[3], a->dtype);
+    ARRAY_STATS_END(t0, STATS_BLAS, NUM_ARRAY_ELEMS(a), 0);
     return ret;
 }
 
+int64_t
+array_iamax(const arrayObject *a)
+{
+    ARRAY_STATS_BEGIN(t0);
+    int64_t v[4];
+    blas1_view(a, 0, v);
+    int64_t ret = iamax(a->data, v[0], v[1], v[2], v[3], a->dtype);
+    ARRAY_STATS_END(t0, STATS_BLAS, NUM_ARRAY_ELEMS(a), 0);
+    return ret;
+}
+
+int
+array_dot_into(char *out, const arrayObject *a, const arrayObject *b)
+{
+    // Operands are packed block by block straight from their strides, so a
+    // transposed view is read in place rather than copied up front.
+    return gemm(
+        out,
+        a->data,
+        a->strides[0],
+        a->strides[1],
+        b->data,
+        b->strides[0],
+        b->strides[1],
+        a->dims[0],
+        b->dims[1],
+        a->dims[1],
+        a->dtype
+    );
+}
+
 arrayObject
 *array_dot(arrayObject *a, arrayObject *b)
 {
     if (a->dims[a->nd - 1] != b->dims[0]) {
-        printf("Dims mismatch (%d %d)\n", a->dims[a->nd - 1], b->dims[0]);
+        printf("Dims mismatch (%" PRId64 " %" PRId64 ")\n", a->dims[a->nd - 1], b->dims[0]);
         return NULL;
     }
     if (a->dtype != b->dtype) {
@@ -133,89 +587,115 @@ arrayObject
         return NULL;
     }
 
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_dot", a->dtype, a->dims, b->dims);
     int ret_nd = ARRAY_NUM_DIMS;
-    int ret_dims[] = {a->dims[0], b->dims[1]};
+    int64_t ret_dims[] = {a->dims[0], b->dims[1]};
     arrayObject *ret = array_alloc(ret_dims, ret_nd, a->dtype);
+    if (ret == NULL) {
+        ARRAY_TRACE_END("array_dot");
+        return NULL;
+    }
 
-    int *perm = range(b->nd);
-    swap_idx(perm, 0, b->nd - 1);
-    array_transpose(b, perm);
+    if (array_dot_into(ret->data, a, b)) {
+        array_free(ret);
+        ret = NULL;
+    }
 
-    // TODO: avoid this memory overhead
-    void *a_ravel = array_ravel(a);
-    void *b_ravel = array_ravel(b);
+    ARRAY_TRACE_END("array_dot");
+    ARRAY_STATS_END(t0, STATS_DOT, NUM_ARRAY_ELEMS(a) + NUM_ARRAY_ELEMS(b), 0);
+    return ret;
+}
 
-    size_t dtype_size = array_dtype_size(a->dtype);
-    char buf[sizeof(double)];
-    for (int i = 0; i < a->dims[0]; i++) {
-        int a_offset = i * a->dims[1];
-        int ret_offset = i * b->dims[0];
-        for (int j = 0; j < b->dims[0]; j++) {
-            int b_offset = j * b->dims[1];
-            buf_set_zero(buf, DOUBLE);
-            reduce_mul_add(
-                buf,
-                a_ravel + a_offset * dtype_size,
-                b_ravel + b_offset * dtype_size,
-                a->dims[1],
-                a->dtype
-            );
-            buf_add_val(
-                ret->data + (ret_offset + j) * dtype_size,
-                buf,
-                a->dtype
-            );
-        }
-    }
-    free(a_ravel);
-    free(b_ravel);
+static arrayPrintOptions print_options = {1000, 3, 2};
 
-    array_transpose(b, perm);
+void
+array_get_print_options(arrayPrintOptions *opts)
+{
+    *opts = print_options;
+}
 
-    return ret;
+int
+array_set_print_options(const arrayPrintOptions *opts)
+{
+    if (opts->threshold < 0 || opts->edgeitems < 1) return 1;
+    if (opts->precision < 0 || opts->precision > PRINT_VAL_MAX_PRECISION) return 1;
+    print_options = *opts;
+    return 0;
 }
 
-char*
-array_str(arrayObject *a)
+static void
+emit(char *out, size_t *offset, const char *s, size_t len)
 {
-    int perm[2] = {1, 0};
-    int permuted = a->dims[1] == 1 ? 1 : 0;
-    if (permuted) {
-        array_transpose(a, perm);
-    }
+    if (out) memcpy(out + *offset, s, len);
+    *offset += len;
+}
 
+/*
+ * Writes the rows of a into out, or only measures them when out is NULL so
+ * that the caller can size its buffer exactly. Once the array holds more
+ * than threshold elements, any axis longer than 2 * edgeitems is elided.
+ */
+static size_t
+format_rows(const arrayObject *a, char *out, const arrayPrintOptions *opts)
+{
     size_t dtype_size = array_dtype_size(a->dtype);
-    int entry_size = print_val(NULL, 0, a->data, a->dtype);
-    int row_size = (entry_size + 1)  *a->dims[1] - 1;
-    int buf_size = 0;
-    buf_size += row_size * a->dims[0];
-    buf_size += 2 * a->dims[0];  // brackets
-    buf_size += a->dims[0];  // newlines
-    buf_size += 1;  // termination
-    char *buf = malloc(buf_size);
-
-    int offset = 0;
-    for (int i = 0; i < a->dims[0]; i++) {
-        buf[offset++] = '[';
-        for (int j = 0; j < a->dims[1]; j++) {
-            offset += print_val(
-                buf + offset,
-                buf_size - offset,
+    int summarise = NUM_ARRAY_ELEMS(a) > opts->threshold;
+    int64_t edge = opts->edgeitems;
+    int elide_rows = summarise && a->dims[0] > 2 * edge;
+    int elide_cols = summarise && a->dims[1] > 2 * edge;
+    char val[PRINT_VAL_MAX_LEN];
+    size_t offset = 0;
+
+    for (int64_t i = 0; i < a->dims[0]; i++) {
+        if (elide_rows && i == edge) {
+            emit(out, &offset, "...\n", 4);
+            i = a->dims[0] - edge - 1;
+            continue;
+        }
+        emit(out, &offset, "[", 1);
+        for (int64_t j = 0; j < a->dims[1]; j++) {
+            if (elide_cols && j == edge) {
+                emit(out, &offset, "... ", 4);
+                j = a->dims[1] - edge - 1;
+                continue;
+            }
+            int len = print_val(
+                val,
                 a->data + (i * a->strides[0] + j * a->strides[1]) * dtype_size,
+                opts->precision,
                 a->dtype
             );
+            emit(out, &offset, val, len);
             if (j < a->dims[1] - 1) {
-                buf[offset++] = ' ';
+                emit(out, &offset, " ", 1);
             }
         }
-        buf[offset++] = ']';
-        buf[offset++] = '\n';
+        emit(out, &offset, "]\n", 2);
     }
-    buf[offset] = '\0';
+    return offset;
+}
 
-    if (permuted) {
-        array_transpose(a, perm);
+char*
+array_str(arrayObject *a)
+{
+    ARRAY_STATS_BEGIN(t0);
+    // Column vectors print as a single row. Format a swapped view rather
+    // than transposing a, which may be read concurrently by another thread.
+    arrayObject view = *a;
+    int64_t dims[2] = {a->dims[1], a->dims[0]};
+    int64_t strides[2] = {a->strides[1], a->strides[0]};
+    if (a->dims[1] == 1) {
+        view.dims = dims;
+        view.strides = strides;
     }
 
+    size_t len = format_rows(&view, NULL, &print_options);
+    char *buf = malloc(len + 1);
+    if (buf == NULL) return NULL;
+    format_rows(&view, buf, &print_options);
+    buf[len] = '\0';
+
+    ARRAY_STATS_END(t0, STATS_STR, NUM_ARRAY_ELEMS(a), len + 1);
     return buf;
 }
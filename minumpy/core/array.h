@@ -5,21 +5,67 @@
 #include <stdio.h>
 
 #include "array_dtypes.h"
+#include "array_mem.h"
 #include "array_utils.h"
 
 typedef struct arrayObject {
     char *data;
     ARRAY_DTYPE dtype;
     int nd;
-    int *dims;
-    int *strides;
+    int64_t *dims;
+    int64_t *strides;  // in elements
 } arrayObject;
 
 #define NUM_ARRAY_ELEMS(a) prod(a->dims, a->nd)
 
-arrayObject *array_alloc(int *dims, int n, ARRAY_DTYPE dtype);
+typedef struct arrayPrintOptions {
+    int threshold;  // total elements above which output is summarised
+    int edgeitems;  // leading/trailing entries kept per axis when summarised
+    int precision;  // digits after the decimal point for float dtypes
+} arrayPrintOptions;
+
+/*
+ * Returns NULL if nd is out of range, a dim is negative, the element count
+ * overflows, or the zeroed buffer cannot be allocated.
+ */
+arrayObject *array_alloc(int64_t *dims, int nd, ARRAY_DTYPE dtype);
+/* As array_alloc, with the buffer placed by policy instead of the global one. */
+arrayObject *array_alloc_policy(int64_t *dims, int nd, ARRAY_DTYPE dtype,
+                                const arrayMemPolicy *policy);
+/*
+ * Like array_alloc, but a mapped buffer is never first touched: its pages
+ * stay untouched zero pages until written.
+ */
+arrayObject *array_zeros(int64_t *dims, int nd, ARRAY_DTYPE dtype);
+/* Like array_alloc, but the buffer is left uninitialised. */
+arrayObject *array_empty(int64_t *dims, int nd, ARRAY_DTYPE dtype);
+arrayObject *array_full(int64_t *dims, int nd, double val, ARRAY_DTYPE dtype);
+/*
+ * (n, 1) arrays of start + i * step for start + i * step < stop (> stop
+ * when step is negative), and of num evenly spaced values from start to
+ * stop, including stop if endpoint is set. Return NULL for a zero step or
+ * a non-finite bound.
+ */
+arrayObject *array_arange(double start, double stop, double step, ARRAY_DTYPE dtype);
+arrayObject *array_linspace(double start, double stop, int64_t num, int endpoint,
+                            ARRAY_DTYPE dtype);
+/*
+ * Integer forms of array_full and array_arange, exact where doubles would
+ * round (beyond 2^53). array_arange_int returns NULL for a zero step.
+ */
+arrayObject *array_full_int(int64_t *dims, int nd, int64_t val, ARRAY_DTYPE dtype);
+arrayObject *array_arange_int(int64_t start, int64_t stop, int64_t step, ARRAY_DTYPE dtype);
+/* An n x m array of zeros with ones on diagonal k (> 0 above the main one). */
+arrayObject *array_eye(int64_t n, int64_t m, int64_t k, ARRAY_DTYPE dtype);
 void array_free(arrayObject *a);
 arrayObject *array_copy(const arrayObject *a);
+/*
+ * Copies a into a new contiguous array laid out in row-major ('C') or
+ * column-major ('F') order; 'K' keeps whichever of the two the strides of a
+ * are closer to. Returns NULL for any other order.
+ */
+arrayObject *array_copy_order(const arrayObject *a, char order);
+int array_is_contiguous(const arrayObject *a, char order);
 
 void array_fill_val(arrayObject *a, double val, ARRAY_DTYPE dtype);
 void array_fill_vals(arrayObject *a, const void *vals, ARRAY_DTYPE dtype);
@@ -29,8 +75,48 @@ void *array_ravel(const arrayObject *a);
 void array_transpose(arrayObject *a, int *perm);
 
 arrayObject *array_sum(arrayObject *a, int axis);
+/*
+ * Reduces a over the axes set in the bitmask axes (bit i for axis i).
+ * Reduced axes are dropped from the result, or kept with length 1 when
+ * keepdims is set; reducing every axis without keepdims gives a 1-element
+ * array.
+ */
+arrayObject *array_reduce(const arrayObject *a, REDUCE_OP op, int axes, int keepdims);
+/*
+ * The kernel of array_reduce writing into a caller-owned out buffer.
+ * Strided inputs are first copied to scratch, which must hold the
+ * elements of a whenever array_reduce_needs_scratch says so and is
+ * otherwise ignored (pass NULL). Returns nonzero when out of memory.
+ */
+int array_reduce_needs_scratch(const arrayObject *a, REDUCE_OP op, int axes);
+int array_reduce_into(char *out, const arrayObject *a, REDUCE_OP op, int axes, char *scratch);
+/*
+ * Inclusive cumulative sum or product along axis, keeping the shape of a.
+ * A negative axis scans the row-major flattening into an (n, 1) array.
+ */
+arrayObject *array_scan(const arrayObject *a, SCAN_OP op, int axis);
+/*
+ * Accumulates a @ b into the zeroed, row-major out (no shape checks).
+ * Returns 1 if out of memory.
+ */
+int array_dot_into(char *out, const arrayObject *a, const arrayObject *b);
+/* Returns NULL on mismatched dims or dtypes, or if out of memory. */
 arrayObject *array_dot(arrayObject *a, arrayObject *b);
+/*
+ * Level-1 BLAS treating arrays as flat vectors: y += alpha * x (returning 1
+ * if x and y differ in dtype or dims), a *= alpha, the sum of |a|, the
+ * overflow-safe Euclidean norm and the row-major index of the first entry
+ * of largest magnitude (-1 if a is empty). Any strides are walked in place.
+ */
+int array_axpy(arrayObject *y, double alpha, const arrayObject *x);
+void array_scal(arrayObject *a, double alpha);
+double array_asum(const arrayObject *a);
+double array_nrm2(const arrayObject *a);
+int64_t array_iamax(const arrayObject *a);
 
+void array_get_print_options(arrayPrintOptions *opts);
+int array_set_print_options(const arrayPrintOptions *opts);
+/* A malloc'd string the caller frees, or NULL if out of memory. */
 char *array_str(arrayObject *);
 
 #endif
@@ -0,0 +1,195 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_backend.h"
+#include "array_blas.h"
+
+const char *KERNEL_OP_NAMES[NUM_KERNEL_OPS] = {
+    "gemm", "dot", "axpy", "scal", "asum", "nrm2", "iamax",
+};
+
+#define DEFAULT_BACKEND_SPEC "threaded,simd"
+
+static const arrayBackend *backends[ARRAY_MAX_BACKENDS];
+static int num_backends = 0;
+
+/*
+ * The resolved selection. Dispatch reads the slots without the lock, so
+ * they are only ever written whole, with atomic stores.
+ */
+static kernelFunc active_kernels[NUM_KERNEL_OPS][NUM_ARRAY_DTYPES];
+static const char *active_names[NUM_KERNEL_OPS][NUM_ARRAY_DTYPES];
+static char active_spec[ARRAY_BACKEND_SPEC_LEN];
+
+static pthread_mutex_t backend_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t backend_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Loading a BLAS library can start its own threads, so it is only looked
+ * for once a selection names "blas" or the backends are listed.
+ */
+static void
+load_blas(void)
+{
+    static int tried = 0;
+    if (tried) return;
+    tried = 1;
+    const arrayBackend *blas = array_blas_backend();
+    if (blas && num_backends < ARRAY_MAX_BACKENDS) backends[num_backends++] = blas;
+}
+
+static int
+find_backend(const char *name, size_t len)
+{
+    if (len == 4 && !strncmp(name, "blas", 4)) load_blas();
+    for (int i = 0; i < num_backends; i++) {
+        if (strlen(backends[i]->name) == len && !strncmp(backends[i]->name, name, len)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int
+find_op(const char *name, size_t len)
+{
+    for (int op = 0; op < NUM_KERNEL_OPS; op++) {
+        if (strlen(KERNEL_OP_NAMES[op]) == len && !strncmp(KERNEL_OP_NAMES[op], name, len)) {
+            return op;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Resolves spec against the registry and installs it, returning 1 and
+ * leaving the current selection alone if spec is invalid. Called with
+ * backend_lock held.
+ */
+static int
+apply_spec(const char *spec)
+{
+    int order[ARRAY_MAX_BACKENDS];
+    int num_order = 0;
+    int first[NUM_KERNEL_OPS];
+
+    if (strlen(spec) >= ARRAY_BACKEND_SPEC_LEN) return 1;
+    for (int op = 0; op < NUM_KERNEL_OPS; op++) {
+        first[op] = -1;
+    }
+    for (const char *tok = spec; *tok; ) {
+        size_t len = strcspn(tok, ",");
+        const char *eq = memchr(tok, '=', len);
+        if (eq) {
+            int op = find_op(tok, eq - tok);
+            int b = find_backend(eq + 1, len - (eq + 1 - tok));
+            if (op < 0 || b < 0) return 1;
+            first[op] = b;
+        } else if (len > 0) {
+            int b = find_backend(tok, len);
+            if (b < 0) return 1;
+            if (num_order < ARRAY_MAX_BACKENDS) order[num_order++] = b;
+        }
+        tok += len;
+        if (*tok == ',') tok++;
+    }
+
+    for (int op = 0; op < NUM_KERNEL_OPS; op++) {
+        for (int dtype = 0; dtype < NUM_ARRAY_DTYPES; dtype++) {
+            const arrayBackend *chosen = NULL;
+            if (first[op] >= 0 && backends[first[op]]->kernels[op][dtype]) {
+                chosen = backends[first[op]];
+            }
+            for (int i = 0; !chosen && i < num_order; i++) {
+                if (backends[order[i]]->kernels[op][dtype]) chosen = backends[order[i]];
+            }
+            if (!chosen) chosen = &array_backend_simd;
+            __atomic_store_n(&active_kernels[op][dtype], chosen->kernels[op][dtype],
+                             __ATOMIC_RELEASE);
+            __atomic_store_n(&active_names[op][dtype], chosen->name, __ATOMIC_RELEASE);
+        }
+    }
+    // Registering a backend re-applies active_spec itself.
+    if (spec != active_spec) strcpy(active_spec, spec);
+    return 0;
+}
+
+static void
+backend_init(void)
+{
+    backends[num_backends++] = &array_backend_simd;
+    backends[num_backends++] = &array_backend_threaded;
+    backends[num_backends++] = &array_backend_reference;
+
+    const char *env = getenv("MINUMPY_BACKEND");
+    if (env && apply_spec(env)) {
+        printf("Ignoring invalid MINUMPY_BACKEND=%s\n", env);
+        env = NULL;
+    }
+    if (!env) apply_spec(DEFAULT_BACKEND_SPEC);
+}
+
+int
+array_backend_register(const arrayBackend *backend)
+{
+    pthread_once(&backend_once, backend_init);
+    pthread_mutex_lock(&backend_lock);
+    int ret = 1;
+    if (num_backends < ARRAY_MAX_BACKENDS &&
+        find_backend(backend->name, strlen(backend->name)) < 0) {
+        backends[num_backends++] = backend;
+        apply_spec(active_spec);
+        ret = 0;
+    }
+    pthread_mutex_unlock(&backend_lock);
+    return ret;
+}
+
+int
+array_backend_set(const char *spec)
+{
+    pthread_once(&backend_once, backend_init);
+    pthread_mutex_lock(&backend_lock);
+    int ret = apply_spec(spec);
+    pthread_mutex_unlock(&backend_lock);
+    return ret;
+}
+
+void
+array_backend_get(char *spec)
+{
+    pthread_once(&backend_once, backend_init);
+    pthread_mutex_lock(&backend_lock);
+    strcpy(spec, active_spec);
+    pthread_mutex_unlock(&backend_lock);
+}
+
+int
+array_backend_list(const char *names[ARRAY_MAX_BACKENDS])
+{
+    pthread_once(&backend_once, backend_init);
+    pthread_mutex_lock(&backend_lock);
+    load_blas();
+    int n = num_backends;
+    for (int i = 0; i < n; i++) {
+        names[i] = backends[i]->name;
+    }
+    pthread_mutex_unlock(&backend_lock);
+    return n;
+}
+
+const char *
+array_backend_serving(KERNEL_OP op, ARRAY_DTYPE dtype)
+{
+    pthread_once(&backend_once, backend_init);
+    return __atomic_load_n(&active_names[op][dtype], __ATOMIC_ACQUIRE);
+}
+
+kernelFunc
+array_backend_kernel(KERNEL_OP op, ARRAY_DTYPE dtype)
+{
+    pthread_once(&backend_once, backend_init);
+    return __atomic_load_n(&active_kernels[op][dtype], __ATOMIC_ACQUIRE);
+}
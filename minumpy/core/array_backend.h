@@ -0,0 +1,94 @@
+#ifndef ARRAY_BACKEND_H
+#define ARRAY_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "array_dtypes.h"
+#include "array_utils.h"
+
+/*
+ * Registry of kernel backends. Every pluggable op/dtype slot is served by
+ * one registered backend, chosen by a selection string: a comma-separated
+ * list of backend names tried in order, where an "op=name" entry tries
+ * that backend first for the one op, e.g. "blas,nrm2=reference". Slots no
+ * listed backend implements fall back to "simd". The selection starts out
+ * from MINUMPY_BACKEND, or "threaded,simd" when that is unset or invalid.
+ *
+ * Built in are:
+ *   simd       the default kernels, vectorised; serves every slot
+ *   threaded   gemm split into row panels over the parallel pool
+ *   reference  plain scalar loops; serves every slot
+ *   blas       CBLAS from a shared library, float and double only (see
+ *              array_blas.h); loaded once a selection names it or the
+ *              backends are listed
+ */
+
+typedef enum {
+    KERNEL_GEMM,
+    KERNEL_DOT,
+    KERNEL_AXPY,
+    KERNEL_SCAL,
+    KERNEL_ASUM,
+    KERNEL_NRM2,
+    KERNEL_IAMAX,
+    NUM_KERNEL_OPS,
+} KERNEL_OP;
+
+extern const char *KERNEL_OP_NAMES[NUM_KERNEL_OPS];
+
+/*
+ * Kernel signatures of each op, with the semantics of the entry point of
+ * the same name in array_utils.h; dot is reduce_mul_add. Level-1 kernels
+ * take the block as rows, cols, row stride, col stride.
+ */
+typedef int (*gemm_func)(char *c, const char *a, int64_t a_rs, int64_t a_cs,
+                         const char *b, int64_t b_rs, int64_t b_cs,
+                         int64_t m, int64_t n, int64_t k, const gemmBlocking *blk);
+typedef void (*reduce_mul_add_func)(char *buf, const void *a, const void *b, int64_t n);
+typedef void (*axpy_func)(char *y, int64_t y_rs, int64_t y_cs, double alpha,
+                          const char *x, int64_t x_rs, int64_t x_cs,
+                          int64_t rows, int64_t cols);
+typedef void (*scal_func)(char *x, double alpha, int64_t rows, int64_t cols,
+                          int64_t rs, int64_t cs);
+typedef double (*asum_func)(const char *x, int64_t rows, int64_t cols, int64_t rs, int64_t cs);
+typedef double (*nrm2_func)(const char *x, int64_t rows, int64_t cols, int64_t rs, int64_t cs);
+typedef int64_t (*iamax_func)(const char *x, int64_t rows, int64_t cols, int64_t rs, int64_t cs);
+
+typedef void (*kernelFunc)(void);
+
+typedef struct arrayBackend {
+    const char *name;
+    // Each cast from its op's signature above; NULL where not implemented.
+    kernelFunc kernels[NUM_KERNEL_OPS][NUM_ARRAY_DTYPES];
+} arrayBackend;
+
+#define ARRAY_MAX_BACKENDS 16
+#define ARRAY_BACKEND_SPEC_LEN 256
+
+/* The built-in backends, defined next to their kernels in array_utils.c. */
+extern const arrayBackend array_backend_simd;
+extern const arrayBackend array_backend_threaded;
+extern const arrayBackend array_backend_reference;
+
+/*
+ * Adds backend, which must stay valid from then on, and re-applies the
+ * selection so that it takes effect if already named there. Returns 1 if
+ * the name is taken or the registry is full.
+ */
+int array_backend_register(const arrayBackend *backend);
+/*
+ * Selects backends by spec as described above. Returns 1, keeping the
+ * current selection, if spec names an unknown backend or op or is too long.
+ */
+int array_backend_set(const char *spec);
+/* Copies the selection in effect into spec (ARRAY_BACKEND_SPEC_LEN bytes). */
+void array_backend_get(char *spec);
+/* Registered backend names in registration order; returns their count. */
+int array_backend_list(const char *names[ARRAY_MAX_BACKENDS]);
+/* Name of the backend serving op for dtype. */
+const char *array_backend_serving(KERNEL_OP op, ARRAY_DTYPE dtype);
+/* The kernel serving op for dtype; always non-NULL. */
+kernelFunc array_backend_kernel(KERNEL_OP op, ARRAY_DTYPE dtype);
+
+#endif
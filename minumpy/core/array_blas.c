@@ -0,0 +1,226 @@
+#include <dlfcn.h>
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "array_backend.h"
+#include "array_blas.h"
+
+/* CBLAS enum values, so that building does not need cblas.h. */
+#define CBLAS_ROW_MAJOR 101
+#define CBLAS_NO_TRANS 111
+#define CBLAS_TRANS 112
+
+/* Vectors longer than this are passed to CBLAS in pieces. */
+#define BLAS_MAX_N (1 << 30)
+
+static const char *BLAS_LIBS[] = {
+    "libopenblas.so.0", "libopenblas.so", "libmkl_rt.so", "libblis.so.4",
+    "libcblas.so.3", "libblas.so.3", "libblas.so",
+};
+
+#define NUM_BLAS_LIBS (int)(sizeof(BLAS_LIBS) / sizeof(BLAS_LIBS[0]))
+
+static arrayBackend blas_backend = {"blas", {{NULL}}};
+
+/*
+ * The CBLAS transpose flag and leading dimension for a rows x cols operand
+ * with the given strides, or 1 if CBLAS cannot address it. Unit dims let
+ * either stride be anything.
+ */
+static int
+blas_layout(int64_t rs, int64_t cs, int64_t rows, int64_t cols, int *trans, int *ld)
+{
+    int64_t lead;
+    if ((cols == 1 || cs == 1) && (rows == 1 || rs >= cols)) {
+        *trans = CBLAS_NO_TRANS;
+        lead = rows == 1 ? cols : rs;
+    } else if ((rows == 1 || rs == 1) && (cols == 1 || cs >= rows)) {
+        *trans = CBLAS_TRANS;
+        lead = cols == 1 ? rows : cs;
+    } else {
+        return 1;
+    }
+    if (lead < 1 || lead > INT_MAX) return 1;
+    *ld = (int)lead;
+    return 0;
+}
+
+static int
+blas_inc_ok(int64_t inc)
+{
+    return inc >= 1 && inc <= INT_MAX;
+}
+
+#define SIMD_KERNEL(op, dtype) array_backend_simd.kernels[op][dtype]
+
+/*
+ * Kernels over a rows x cols block call CBLAS once per row, in pieces of
+ * at most BLAS_MAX_N elements; nrm2 combines the pieces with hypot, iamax
+ * keeps the first of equal maxima.
+ */
+#define DEFINE_BLAS_KERNELS(T, name, P, DTYPE) \
+    static void (*cblas_##P##gemm)(int, int, int, int, int, int, T, const T *, int, \
+                                   const T *, int, T, T *, int); \
+    static T (*cblas_##P##dot)(int, const T *, int, const T *, int); \
+    static void (*cblas_##P##axpy)(int, T, const T *, int, T *, int); \
+    static void (*cblas_##P##scal)(int, T, T *, int); \
+    static T (*cblas_##P##asum)(int, const T *, int); \
+    static T (*cblas_##P##nrm2)(int, const T *, int); \
+    static size_t (*cblas_i##P##amax)(int, const T *, int); \
+    static int gemm_blas_##name(char *c, const char *a, int64_t a_rs, int64_t a_cs, \
+                                const char *b, int64_t b_rs, int64_t b_cs, \
+                                int64_t m, int64_t n, int64_t k, const gemmBlocking *blk) { \
+        int ta, tb, lda, ldb; \
+        if (m == 0 || n == 0 || k == 0) return 0; \
+        if (m > INT_MAX || n > INT_MAX || k > INT_MAX || \
+            blas_layout(a_rs, a_cs, m, k, &ta, &lda) || \
+            blas_layout(b_rs, b_cs, k, n, &tb, &ldb)) { \
+            return ((gemm_func)SIMD_KERNEL(KERNEL_GEMM, DTYPE))(c, a, a_rs, a_cs, b, b_rs, \
+                                                                b_cs, m, n, k, blk); \
+        } \
+        cblas_##P##gemm(CBLAS_ROW_MAJOR, ta, tb, (int)m, (int)n, (int)k, 1, (const T *)a, lda, \
+                        (const T *)b, ldb, 1, (T *)c, (int)n); \
+        return 0; \
+    } \
+    static void dot_blas_##name(char *buf, const void *a, const void *b, int64_t n) { \
+        T acc = 0; \
+        for (int64_t i = 0; i < n; i += BLAS_MAX_N) { \
+            int len = (int)(n - i < BLAS_MAX_N ? n - i : BLAS_MAX_N); \
+            acc += cblas_##P##dot(len, (const T *)a + i, 1, (const T *)b + i, 1); \
+        } \
+        *(T *)buf += acc; \
+    } \
+    static void axpy_blas_##name(char *ybuf, int64_t y_rs, int64_t y_cs, double alpha, \
+                                 const char *xbuf, int64_t x_rs, int64_t x_cs, \
+                                 int64_t rows, int64_t cols) { \
+        if (!blas_inc_ok(x_cs) || !blas_inc_ok(y_cs)) { \
+            ((axpy_func)SIMD_KERNEL(KERNEL_AXPY, DTYPE))(ybuf, y_rs, y_cs, alpha, xbuf, \
+                                                         x_rs, x_cs, rows, cols); \
+            return; \
+        } \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j += BLAS_MAX_N) { \
+                int len = (int)(cols - j < BLAS_MAX_N ? cols - j : BLAS_MAX_N); \
+                cblas_##P##axpy(len, (T)alpha, (const T *)xbuf + i * x_rs + j * x_cs, \
+                                (int)x_cs, (T *)ybuf + i * y_rs + j * y_cs, (int)y_cs); \
+            } \
+        } \
+    } \
+    static void scal_blas_##name(char *buf, double alpha, int64_t rows, int64_t cols, \
+                                 int64_t rs, int64_t cs) { \
+        if (!blas_inc_ok(cs)) { \
+            ((scal_func)SIMD_KERNEL(KERNEL_SCAL, DTYPE))(buf, alpha, rows, cols, rs, cs); \
+            return; \
+        } \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j += BLAS_MAX_N) { \
+                int len = (int)(cols - j < BLAS_MAX_N ? cols - j : BLAS_MAX_N); \
+                cblas_##P##scal(len, (T)alpha, (T *)buf + i * rs + j * cs, (int)cs); \
+            } \
+        } \
+    } \
+    static double asum_blas_##name(const char *buf, int64_t rows, int64_t cols, \
+                                   int64_t rs, int64_t cs) { \
+        if (!blas_inc_ok(cs)) { \
+            return ((asum_func)SIMD_KERNEL(KERNEL_ASUM, DTYPE))(buf, rows, cols, rs, cs); \
+        } \
+        double acc = 0; \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j += BLAS_MAX_N) { \
+                int len = (int)(cols - j < BLAS_MAX_N ? cols - j : BLAS_MAX_N); \
+                acc += cblas_##P##asum(len, (const T *)buf + i * rs + j * cs, (int)cs); \
+            } \
+        } \
+        return acc; \
+    } \
+    static double nrm2_blas_##name(const char *buf, int64_t rows, int64_t cols, \
+                                   int64_t rs, int64_t cs) { \
+        if (!blas_inc_ok(cs)) { \
+            return ((nrm2_func)SIMD_KERNEL(KERNEL_NRM2, DTYPE))(buf, rows, cols, rs, cs); \
+        } \
+        double acc = 0; \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j += BLAS_MAX_N) { \
+                int len = (int)(cols - j < BLAS_MAX_N ? cols - j : BLAS_MAX_N); \
+                acc = hypot(acc, cblas_##P##nrm2(len, (const T *)buf + i * rs + j * cs, \
+                                                 (int)cs)); \
+            } \
+        } \
+        return acc; \
+    } \
+    static int64_t iamax_blas_##name(const char *buf, int64_t rows, int64_t cols, \
+                                     int64_t rs, int64_t cs) { \
+        if (rows == 0 || cols == 0) return -1; \
+        if (!blas_inc_ok(cs)) { \
+            return ((iamax_func)SIMD_KERNEL(KERNEL_IAMAX, DTYPE))(buf, rows, cols, rs, cs); \
+        } \
+        double best = -1; \
+        int64_t best_idx = 0; \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j += BLAS_MAX_N) { \
+                int len = (int)(cols - j < BLAS_MAX_N ? cols - j : BLAS_MAX_N); \
+                const T *x = (const T *)buf + i * rs + j * cs; \
+                int64_t idx = (int64_t)cblas_i##P##amax(len, x, (int)cs); \
+                double v = fabs((double)x[idx * cs]); \
+                if (v > best) { \
+                    best = v; \
+                    best_idx = i * cols + j + idx; \
+                } \
+            } \
+        } \
+        return best_idx; \
+    } \
+    static void bind_blas_##name(void *lib) { \
+        if ((*(void **)&cblas_##P##gemm = dlsym(lib, "cblas_" #P "gemm"))) { \
+            blas_backend.kernels[KERNEL_GEMM][DTYPE] = (kernelFunc)gemm_blas_##name; \
+        } \
+        if ((*(void **)&cblas_##P##dot = dlsym(lib, "cblas_" #P "dot"))) { \
+            blas_backend.kernels[KERNEL_DOT][DTYPE] = (kernelFunc)dot_blas_##name; \
+        } \
+        if ((*(void **)&cblas_##P##axpy = dlsym(lib, "cblas_" #P "axpy"))) { \
+            blas_backend.kernels[KERNEL_AXPY][DTYPE] = (kernelFunc)axpy_blas_##name; \
+        } \
+        if ((*(void **)&cblas_##P##scal = dlsym(lib, "cblas_" #P "scal"))) { \
+            blas_backend.kernels[KERNEL_SCAL][DTYPE] = (kernelFunc)scal_blas_##name; \
+        } \
+        if ((*(void **)&cblas_##P##asum = dlsym(lib, "cblas_" #P "asum"))) { \
+            blas_backend.kernels[KERNEL_ASUM][DTYPE] = (kernelFunc)asum_blas_##name; \
+        } \
+        if ((*(void **)&cblas_##P##nrm2 = dlsym(lib, "cblas_" #P "nrm2"))) { \
+            blas_backend.kernels[KERNEL_NRM2][DTYPE] = (kernelFunc)nrm2_blas_##name; \
+        } \
+        if ((*(void **)&cblas_i##P##amax = dlsym(lib, "cblas_i" #P "amax"))) { \
+            blas_backend.kernels[KERNEL_IAMAX][DTYPE] = (kernelFunc)iamax_blas_##name; \
+        } \
+    }
+
+DEFINE_BLAS_KERNELS(float, float, s, FLOAT)
+DEFINE_BLAS_KERNELS(double, double, d, DOUBLE)
+
+static void *
+blas_open(const char *name)
+{
+    void *lib = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+    if (lib && !dlsym(lib, "cblas_dgemm")) {
+        dlclose(lib);
+        lib = NULL;
+    }
+    return lib;
+}
+
+const arrayBackend *
+array_blas_backend(void)
+{
+    const char *env = getenv("MINUMPY_BLAS_LIB");
+    void *lib = env ? blas_open(env) : NULL;
+    for (int i = 0; !lib && i < NUM_BLAS_LIBS; i++) {
+        lib = blas_open(BLAS_LIBS[i]);
+    }
+    if (!lib) return NULL;
+    bind_blas_float(lib);
+    bind_blas_double(lib);
+    return &blas_backend;
+}
@@ -0,0 +1,21 @@
+#ifndef ARRAY_BLAS_H
+#define ARRAY_BLAS_H
+
+#include "array_backend.h"
+
+/*
+ * The "blas" backend: float and double gemm, dot and level-1 kernels that
+ * call CBLAS in the first shared library, of MINUMPY_BLAS_LIB and then a
+ * list of common names, that dlopen finds and that exports cblas_dgemm.
+ * Symbols missing from that library leave their slots to other backends,
+ * as do operands CBLAS cannot describe (general strides, or sizes beyond
+ * 32-bit BLAS integers), which go to the simd kernels. Results may differ
+ * from the simd backend in rounding: sasum, snrm2 and sdot accumulate in
+ * float, and NaN handling in i?amax is up to the library.
+ *
+ * Returns NULL when no library is found. Called at most once, by the
+ * registry.
+ */
+const arrayBackend *array_blas_backend(void);
+
+#endif
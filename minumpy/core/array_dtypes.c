@@ -1,3 +1,5 @@
+#include <stdint.h>
+
 #include "array_dtypes.h"
 
 ARRAY_DTYPE ARRAY_DTYPES[NUM_ARRAY_DTYPES] = {INT32, INT64, FLOAT, DOUBLE};
@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "array_dtypes.h"
+#include "array_graph.h"
+#include "array_mem.h"
+#include "array_stats.h"
+#include "array_trace.h"
+#include "array_utils.h"
+
+typedef struct graphInput {
+    const arrayObject *captured;
+    ARRAY_DTYPE dtype;
+    int64_t dims[ARRAY_NUM_DIMS];
+    int64_t strides[ARRAY_NUM_DIMS];
+} graphInput;
+
+/* Operands >= 0 name an earlier node's output, < 0 input -(ref + 1). */
+typedef struct graphNode {
+    GRAPH_OP op;
+    int operands[2];
+    int axis;
+    arrayObject *out;
+    char *scratch;  // planned copy buffer for strided sum operands
+} graphNode;
+
+struct arrayGraph {
+    graphInput *inputs;
+    int num_inputs;
+    int cap_inputs;
+    graphNode *nodes;
+    int num_nodes;
+    int cap_nodes;
+};
+
+arrayGraph*
+array_graph_alloc(void)
+{
+    return calloc(1, sizeof(arrayGraph));
+}
+
+void
+array_graph_free(arrayGraph *g)
+{
+    if (!g) return;
+    for (int i = 0; i < g->num_nodes; i++) {
+        array_data_free(g->nodes[i].scratch);
+    }
+    free(g->inputs);
+    free(g->nodes);
+    free(g);
+}
+
+int
+array_graph_num_inputs(const arrayGraph *g)
+{
+    return g->num_inputs;
+}
+
+int
+array_graph_num_ops(const arrayGraph *g)
+{
+    return g->num_nodes;
+}
+
+int
+array_graph_find_input(const arrayGraph *g, const arrayObject *a)
+{
+    for (int i = 0; i < g->num_inputs; i++) {
+        if (g->inputs[i].captured == a) return i;
+    }
+    return -1;
+}
+
+static int
+grow(void **items, int *cap, int len, size_t item_size)
+{
+    if (len < *cap) return 0;
+    int new_cap = *cap ? 2 * *cap : 8;
+    void *p = realloc(*items, new_cap * item_size);
+    if (p == NULL) return 1;
+    *items = p;
+    *cap = new_cap;
+    return 0;
+}
+
+/* Resolves a to an operand ref, adding it as a new input if unseen. */
+static int
+operand_ref(arrayGraph *g, const arrayObject *a, int *ref)
+{
+    // Newest first: ops usually consume the output just recorded.
+    for (int i = g->num_nodes - 1; i >= 0; i--) {
+        if (g->nodes[i].out == a) {
+            *ref = i;
+            return 0;
+        }
+    }
+    int i = array_graph_find_input(g, a);
+    if (i < 0) {
+        if (grow((void **)&g->inputs, &g->cap_inputs, g->num_inputs, sizeof(graphInput))) {
+            return 1;
+        }
+        i = g->num_inputs++;
+        graphInput *in = &g->inputs[i];
+        in->captured = a;
+        in->dtype = a->dtype;
+        memcpy(in->dims, a->dims, sizeof(in->dims));
+        memcpy(in->strides, a->strides, sizeof(in->strides));
+    }
+    *ref = -(i + 1);
+    return 0;
+}
+
+static int
+record(arrayGraph *g, GRAPH_OP op, const arrayObject *a, const arrayObject *b, int axis,
+       arrayObject *out)
+{
+    if (grow((void **)&g->nodes, &g->cap_nodes, g->num_nodes, sizeof(graphNode))) {
+        return 1;
+    }
+    graphNode node = {op, {0, 0}, axis, out, NULL};
+    int num_inputs = g->num_inputs;
+    if (operand_ref(g, a, &node.operands[0]) || (b && operand_ref(g, b, &node.operands[1]))) {
+        g->num_inputs = num_inputs;
+        return 1;
+    }
+    if (op == GRAPH_SUM && array_reduce_needs_scratch(a, REDUCE_SUM, 1 << axis)) {
+        node.scratch = array_data_alloc(NUM_ARRAY_ELEMS(a), a->dtype, 0);
+        if (node.scratch == NULL) {
+            g->num_inputs = num_inputs;
+            return 1;
+        }
+    }
+    g->nodes[g->num_nodes++] = node;
+    return 0;
+}
+
+int
+array_graph_record_dot(arrayGraph *g, const arrayObject *a, const arrayObject *b,
+                       arrayObject *out)
+{
+    return record(g, GRAPH_DOT, a, b, 0, out);
+}
+
+int
+array_graph_record_sum(arrayGraph *g, const arrayObject *a, int axis, arrayObject *out)
+{
+    return record(g, GRAPH_SUM, a, NULL, axis, out);
+}
+
+int
+array_graph_check_inputs(const arrayGraph *g, arrayObject *const *inputs)
+{
+    for (int i = 0; i < g->num_inputs; i++) {
+        const graphInput *in = &g->inputs[i];
+        const arrayObject *a = inputs[i];
+        if (a->dtype != in->dtype ||
+            memcmp(a->dims, in->dims, sizeof(in->dims)) ||
+            memcmp(a->strides, in->strides, sizeof(in->strides))) {
+            return 1;
+        }
+        // Replay overwrites outputs in place, so they cannot feed it.
+        for (int j = 0; j < g->num_nodes; j++) {
+            if (g->nodes[j].out->data == a->data) return 1;
+        }
+    }
+    return 0;
+}
+
+static const arrayObject*
+resolve(const arrayGraph *g, arrayObject *const *inputs, int ref)
+{
+    return ref >= 0 ? g->nodes[ref].out : inputs[-ref - 1];
+}
+
+int
+array_graph_replay(const arrayGraph *g, arrayObject *const *inputs)
+{
+    int failed = 0;
+    ARRAY_TRACE_BEGIN("array_graph_replay", UNKNOWN, NULL, NULL);
+    for (int i = 0; i < g->num_nodes && !failed; i++) {
+        const graphNode *node = &g->nodes[i];
+        const arrayObject *a = resolve(g, inputs, node->operands[0]);
+        ARRAY_STATS_BEGIN(t0);
+        switch (node->op) {
+            case GRAPH_DOT: {
+                const arrayObject *b = resolve(g, inputs, node->operands[1]);
+                memset(node->out->data, 0,
+                       NUM_ARRAY_ELEMS(node->out) * array_dtype_size(node->out->dtype));
+                failed = array_dot_into(node->out->data, a, b);
+                ARRAY_STATS_END(t0, STATS_DOT, NUM_ARRAY_ELEMS(a) + NUM_ARRAY_ELEMS(b), 0);
+                break;
+            }
+            case GRAPH_SUM:
+                failed = array_reduce_into(node->out->data, a, REDUCE_SUM, 1 << node->axis,
+                                           node->scratch);
+                ARRAY_STATS_END(t0, STATS_SUM, NUM_ARRAY_ELEMS(a), 0);
+                break;
+            default:
+                break;
+        }
+    }
+    ARRAY_TRACE_END("array_graph_replay");
+    return failed;
+}
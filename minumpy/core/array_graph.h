@@ -0,0 +1,49 @@
+#ifndef ARRAY_GRAPH_H
+#define ARRAY_GRAPH_H
+
+#include "array.h"
+
+/*
+ * Recorded sequences of dot/sum calls that can be re-run without
+ * validation or allocation. Each recorded op keeps the output array it
+ * produced when captured; replay recomputes every op into those same
+ * buffers, in order. An operand that is an earlier op's output is read
+ * from that output; any other operand becomes a graph input, bound by
+ * position on replay and required to have the dtype, dims and strides it
+ * was captured with. Outputs are not owned by the graph, and their layout
+ * must not change while it lives.
+ */
+
+typedef enum {
+    GRAPH_DOT,
+    GRAPH_SUM,
+    NUM_GRAPH_OPS,
+} GRAPH_OP;
+
+typedef struct arrayGraph arrayGraph;
+
+arrayGraph *array_graph_alloc(void);
+void array_graph_free(arrayGraph *g);
+
+/* Both return 1 (recording nothing) if an allocation fails. */
+int array_graph_record_dot(arrayGraph *g, const arrayObject *a, const arrayObject *b,
+                           arrayObject *out);
+int array_graph_record_sum(arrayGraph *g, const arrayObject *a, int axis, arrayObject *out);
+
+int array_graph_num_inputs(const arrayGraph *g);
+int array_graph_num_ops(const arrayGraph *g);
+/* Index of the input a was captured as, or -1. */
+int array_graph_find_input(const arrayGraph *g, const arrayObject *a);
+
+/*
+ * Returns 1 if an input does not match its captured layout or shares its
+ * data with one of the outputs.
+ */
+int array_graph_check_inputs(const arrayGraph *g, arrayObject *const *inputs);
+/*
+ * Runs every recorded op against inputs, which must have passed the check.
+ * Returns 1 if an op runs out of memory, leaving later ops unrun.
+ */
+int array_graph_replay(const arrayGraph *g, arrayObject *const *inputs);
+
+#endif
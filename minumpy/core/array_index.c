@@ -0,0 +1,288 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "array_dtypes.h"
+#include "array_index.h"
+#include "array_stats.h"
+#include "array_trace.h"
+#include "array_utils.h"
+
+int
+array_index(const arrayObject *a, int64_t i, int64_t j, int64_t *offset)
+{
+    if (i < 0) i += a->dims[0];
+    if (j < 0) j += a->dims[1];
+    if (i < 0 || i >= a->dims[0] || j < 0 || j >= a->dims[1]) return 1;
+    *offset = i * a->strides[0] + j * a->strides[1];
+    return 0;
+}
+
+/*
+ * Reads indices in row-major order into element offsets of a, along axis
+ * or into its flattening. Returns NULL for a non-integer index array or,
+ * after printing it, the first index out of range.
+ */
+static int64_t *
+index_offsets(const arrayObject *a, const arrayObject *indices, int axis, int64_t *n)
+{
+    if (indices->dtype != INT32 && indices->dtype != INT64) {
+        printf("Indices must be INT32 or INT64\n");
+        return NULL;
+    }
+    int64_t len = axis < 0 ? NUM_ARRAY_ELEMS(a) : a->dims[axis];
+    int64_t cols = a->dims[1];
+    int flat = array_is_contiguous(a, 'C');
+    size_t size = array_dtype_size(indices->dtype);
+    *n = NUM_ARRAY_ELEMS(indices);
+    int64_t *offsets = malloc((*n ? *n : 1) * sizeof(int64_t));
+    if (offsets == NULL) return NULL;
+
+    int64_t k = 0;
+    for (int64_t i = 0; i < indices->dims[0]; i++) {
+        for (int64_t j = 0; j < indices->dims[1]; j++) {
+            const char *p = indices->data + (i * indices->strides[0] +
+                                             j * indices->strides[1]) * size;
+            int64_t idx = indices->dtype == INT32 ? *(const int32_t *)p : *(const int64_t *)p;
+            int64_t v = idx < 0 ? idx + len : idx;
+            if (v < 0 || v >= len) {
+                printf("Index %" PRId64 " out of range for length %" PRId64 "\n", idx, len);
+                free(offsets);
+                return NULL;
+            }
+            if (axis >= 0) {
+                offsets[k++] = v * a->strides[axis];
+            } else {
+                offsets[k++] = flat ? v : (v / cols) * a->strides[0] + (v % cols) * a->strides[1];
+            }
+        }
+    }
+    return offsets;
+}
+
+int
+array_check_indices(const arrayObject *a, const arrayObject *indices, int axis)
+{
+    if (axis >= a->nd || (indices->dtype != INT32 && indices->dtype != INT64)) return 1;
+    int64_t len = axis < 0 ? NUM_ARRAY_ELEMS(a) : a->dims[axis];
+    size_t size = array_dtype_size(indices->dtype);
+    for (int64_t i = 0; i < indices->dims[0]; i++) {
+        for (int64_t j = 0; j < indices->dims[1]; j++) {
+            const char *p = indices->data + (i * indices->strides[0] +
+                                             j * indices->strides[1]) * size;
+            int64_t idx = indices->dtype == INT32 ? *(const int32_t *)p : *(const int64_t *)p;
+            int64_t v = idx < 0 ? idx + len : idx;
+            if (v < 0 || v >= len) return 1;
+        }
+    }
+    return 0;
+}
+
+/* The dims of a[indices] along axis. */
+static void
+take_dims(const arrayObject *a, const arrayObject *indices, int axis, int64_t dims[2])
+{
+    int64_t n = NUM_ARRAY_ELEMS(indices);
+    if (axis < 0) {
+        dims[0] = indices->dims[0];
+        dims[1] = indices->dims[1];
+    } else {
+        dims[axis] = n;
+        dims[1 - axis] = a->dims[1 - axis];
+    }
+}
+
+arrayObject*
+array_take(const arrayObject *a, const arrayObject *indices, int axis)
+{
+    int64_t n;
+    int64_t dims[ARRAY_NUM_DIMS];
+    if (axis >= a->nd) {
+        printf("Axis %d out of range\n", axis);
+        return NULL;
+    }
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_take", a->dtype, a->dims, indices->dims);
+    arrayObject *out = NULL;
+    int64_t *offsets = index_offsets(a, indices, axis, &n);
+    if (offsets == NULL) goto done;
+    take_dims(a, indices, axis, dims);
+    out = array_empty(dims, ARRAY_NUM_DIMS, a->dtype);
+    if (out == NULL) goto done;
+
+    size_t size = array_dtype_size(a->dtype);
+    if (axis < 0) {
+        gather(out->data, a->data, offsets, n, 1, 1, a->dtype);
+    } else if (axis == 0) {
+        gather(out->data, a->data, offsets, n, a->dims[1], a->strides[1], a->dtype);
+    } else {
+        for (int64_t r = 0; r < a->dims[0]; r++) {
+            gather(out->data + r * n * size, a->data + r * a->strides[0] * size, offsets, n,
+                   1, 1, a->dtype);
+        }
+    }
+
+done:
+    free(offsets);
+    ARRAY_TRACE_END("array_take");
+    ARRAY_STATS_END(t0, STATS_INDEX, out ? NUM_ARRAY_ELEMS(out) : 0,
+                    out ? NUM_ARRAY_ELEMS(out) * array_dtype_size(a->dtype) : 0);
+    return out;
+}
+
+int
+array_put(arrayObject *a, const arrayObject *indices, const arrayObject *vals, int axis)
+{
+    int64_t n;
+    int64_t dims[ARRAY_NUM_DIMS];
+    if (axis >= a->nd) {
+        printf("Axis %d out of range\n", axis);
+        return 1;
+    }
+    take_dims(a, indices, axis, dims);
+    int single = NUM_ARRAY_ELEMS(vals) == 1;
+    if (vals->dtype != a->dtype || (!single && (vals->dims[0] != dims[0] ||
+                                                vals->dims[1] != dims[1]))) {
+        printf("put values must have the dtype of the array and the dims of the indexed "
+               "elements, or be a single element\n");
+        return 1;
+    }
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_put", a->dtype, a->dims, indices->dims);
+    int ret = 1;
+    size_t size = array_dtype_size(a->dtype);
+    arrayObject *packed = NULL;
+    const char *v = vals->data;
+    int64_t *offsets = index_offsets(a, indices, axis, &n);
+    if (offsets == NULL) {
+        ret = array_check_indices(a, indices, axis) ? 1 : -1;
+        goto done;
+    }
+    ret = -1;
+
+    if (single && axis == 0) {
+        // A single value fills whole rows, so repeat it into one.
+        int64_t row[] = {1, a->dims[1]};
+        packed = array_empty(row, ARRAY_NUM_DIMS, a->dtype);
+        if (packed == NULL) goto done;
+        for (int64_t j = 0; j < a->dims[1]; j++) {
+            memcpy(packed->data + j * size, vals->data, size);
+        }
+        v = packed->data;
+    } else if (!single && (vals->data == a->data || !array_is_contiguous(vals, 'C'))) {
+        // Copy first: vals may alias a.
+        packed = array_copy_order(vals, 'C');
+        if (packed == NULL) goto done;
+        v = packed->data;
+    }
+
+    if (axis < 0) {
+        scatter(a->data, offsets, n, 1, 1, v, !single, a->dtype);
+    } else if (axis == 0) {
+        scatter(a->data, offsets, n, a->dims[1], a->strides[1], v, single ? 0 : a->dims[1],
+                a->dtype);
+    } else {
+        for (int64_t r = 0; r < a->dims[0]; r++) {
+            scatter(a->data + r * a->strides[0] * size, offsets, n, 1, 1,
+                    single ? v : v + r * n * size, !single, a->dtype);
+        }
+    }
+    ret = 0;
+
+done:
+    free(offsets);
+    array_free(packed);
+    ARRAY_TRACE_END("array_put");
+    ARRAY_STATS_END(t0, STATS_INDEX, ret ? 0 : dims[0] * dims[1], 0);
+    return ret;
+}
+
+static int
+check_mask(const arrayObject *a, const arrayObject *mask)
+{
+    if (mask->dims[0] != a->dims[0] || mask->dims[1] != a->dims[1]) {
+        printf("Mask dims (%" PRId64 ", %" PRId64 ") do not match array dims (%" PRId64
+               ", %" PRId64 ")\n", mask->dims[0], mask->dims[1], a->dims[0], a->dims[1]);
+        return 1;
+    }
+    return 0;
+}
+
+/* Offsets into a of the nonzeros of mask, or NULL if out of memory. */
+static int64_t *
+mask_offsets(const arrayObject *mask, const int64_t *strides, int64_t *n)
+{
+    *n = nonzero_offsets(NULL, mask->data, mask->dims[0], mask->dims[1], mask->strides[0],
+                         mask->strides[1], 0, 0, mask->dtype);
+    int64_t *offsets = malloc((*n ? *n : 1) * sizeof(int64_t));
+    if (offsets == NULL) return NULL;
+    nonzero_offsets(offsets, mask->data, mask->dims[0], mask->dims[1], mask->strides[0],
+                    mask->strides[1], strides[0], strides[1], mask->dtype);
+    return offsets;
+}
+
+arrayObject*
+array_extract(const arrayObject *a, const arrayObject *mask)
+{
+    int64_t n;
+    if (check_mask(a, mask)) return NULL;
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_extract", a->dtype, a->dims, NULL);
+    arrayObject *out = NULL;
+    int64_t *offsets = mask_offsets(mask, a->strides, &n);
+    if (offsets != NULL) {
+        int64_t dims[] = {n, 1};
+        out = array_empty(dims, ARRAY_NUM_DIMS, a->dtype);
+        if (out != NULL) gather(out->data, a->data, offsets, n, 1, 1, a->dtype);
+    }
+    free(offsets);
+    ARRAY_TRACE_END("array_extract");
+    ARRAY_STATS_END(t0, STATS_INDEX, NUM_ARRAY_ELEMS(a),
+                    out ? n * array_dtype_size(a->dtype) : 0);
+    return out;
+}
+
+int
+array_putmask(arrayObject *a, const arrayObject *mask, const arrayObject *vals)
+{
+    int64_t n;
+    int single = NUM_ARRAY_ELEMS(vals) == 1;
+    if (check_mask(a, mask)) return 1;
+    if (vals->dtype != a->dtype || (!single && check_mask(a, vals))) {
+        printf("putmask values must have the dtype of the array and its dims, or be a "
+               "single element\n");
+        return 1;
+    }
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_putmask", a->dtype, a->dims, NULL);
+    int ret = 1;
+    int64_t *val_offsets = NULL;
+    char *picked = NULL;
+    int64_t *offsets = mask_offsets(mask, a->strides, &n);
+    if (offsets == NULL) goto done;
+    if (single) {
+        scatter(a->data, offsets, n, 1, 1, vals->data, 0, a->dtype);
+    } else {
+        // Gather first: vals may alias a.
+        val_offsets = mask_offsets(mask, vals->strides, &n);
+        picked = malloc((n ? n : 1) * array_dtype_size(a->dtype));
+        if (val_offsets == NULL || picked == NULL) goto done;
+        gather(picked, vals->data, val_offsets, n, 1, 1, a->dtype);
+        scatter(a->data, offsets, n, 1, 1, picked, 1, a->dtype);
+    }
+    ret = 0;
+
+done:
+    free(offsets);
+    free(val_offsets);
+    free(picked);
+    ARRAY_TRACE_END("array_putmask");
+    ARRAY_STATS_END(t0, STATS_INDEX, NUM_ARRAY_ELEMS(a), 0);
+    return ret;
+}
@@ -0,0 +1,41 @@
+#ifndef ARRAY_INDEX_H
+#define ARRAY_INDEX_H
+
+#include "array.h"
+
+/*
+ * Element and fancy indexing. Index arrays are INT32 or INT64 and are read
+ * in row-major order; negative indices count from the end. Every index is
+ * checked before any element moves, so a failed put leaves a untouched.
+ * axis selects rows (0) or columns (1) of a; a negative axis indexes the
+ * row-major flattening of a instead. Masks may have any dtype, with
+ * nonzero meaning selected, and must match the dims of a.
+ */
+
+/* Element offset of a[i, j] into a->data; returns 1 if out of range. */
+int array_index(const arrayObject *a, int64_t i, int64_t j, int64_t *offset);
+
+/* Returns 1 for a bad axis or index array, or an index out of range. */
+int array_check_indices(const arrayObject *a, const arrayObject *indices, int axis);
+/*
+ * Gathers a[indices] along axis: rows or columns into a (n, cols) or
+ * (rows, n) array for n indices, or flat elements into an array with the
+ * dims of indices. Returns NULL for a bad index array or index.
+ */
+arrayObject *array_take(const arrayObject *a, const arrayObject *indices, int axis);
+/*
+ * Scatters vals, shaped as array_take would return, or a single element
+ * to repeat, into a[indices] along axis; the last of duplicate indices
+ * wins. Returns 1 for a bad index, or vals of another dtype or shape, and
+ * -1 if memory runs out.
+ */
+int array_put(arrayObject *a, const arrayObject *indices, const arrayObject *vals, int axis);
+/* The elements of a where mask is nonzero, in row-major order, as (n, 1). */
+arrayObject *array_extract(const arrayObject *a, const arrayObject *mask);
+/*
+ * a[k] = vals[k] wherever mask[k] is nonzero, for vals with the dims of a
+ * or a single element. Returns 1 on mismatched dims or dtype.
+ */
+int array_putmask(arrayObject *a, const arrayObject *mask, const arrayObject *vals);
+
+#endif
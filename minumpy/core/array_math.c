@@ -0,0 +1,481 @@
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "array.h"
+#include "array_dtypes.h"
+#include "array_math.h"
+#include "array_parallel.h"
+#include "array_stats.h"
+#include "array_trace.h"
+
+/* Elements gathered per block from strided rows. */
+#define UNARY_BLOCK 256
+#define UNARY_PARALLEL_MIN_ELEMS (1 << 15)
+#define UNARY_GRAIN_ELEMS (1 << 13)
+
+const char *UNARY_OP_NAMES[NUM_UNARY_OPS] = {"exp", "log", "sqrt", "tanh", "sigmoid"};
+
+typedef void (*unary_func)(char *, const char *, int64_t);
+
+#ifdef __SSE2__
+static inline __m128
+select_ps(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128d
+select_pd(__m128d mask, __m128d a, __m128d b)
+{
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+/* 2^k for int32 lanes k in [-126, 127]. */
+static inline __m128
+pow2_ps(__m128i k)
+{
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(k, _mm_set1_epi32(127)), 23));
+}
+
+/* 2^k for the two int32 lanes k in [-1022, 1023] at the bottom of k. */
+static inline __m128d
+pow2_pd(__m128i k)
+{
+    __m128i biased = _mm_add_epi32(k, _mm_set1_epi32(1023));
+    return _mm_castsi128_pd(_mm_slli_epi64(_mm_unpacklo_epi32(biased, _mm_setzero_si128()), 52));
+}
+
+/*
+ * exp(x) = 2^k * exp(r) with r = x - k ln2 split Cody-Waite style, and
+ * Cephes' degree 7 polynomial for exp(r) on |r| <= ln2 / 2. 2^k is
+ * applied as two normal factors, so overflow and gradual underflow come
+ * out of the multiplies.
+ */
+static inline __m128
+exp_ps(__m128 x)
+{
+    __m128 nan = _mm_cmpunord_ps(x, x);
+    __m128 xc = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-104.0f)), _mm_set1_ps(89.0f));
+    __m128i k = _mm_cvtps_epi32(_mm_mul_ps(xc, _mm_set1_ps(1.44269504088896341f)));
+    __m128 kf = _mm_cvtepi32_ps(k);
+    __m128 r = _mm_sub_ps(xc, _mm_mul_ps(kf, _mm_set1_ps(0.693359375f)));
+    r = _mm_sub_ps(r, _mm_mul_ps(kf, _mm_set1_ps(-2.12194440e-4f)));
+
+    __m128 p = _mm_set1_ps(1.9875691500e-4f);
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.3981999507e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(8.3334519073e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(4.1665795894e-2f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.6666665459e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(5.0000001201e-1f));
+    p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, r), r), r), _mm_set1_ps(1.0f));
+
+    __m128i k1 = _mm_srai_epi32(k, 1);
+    p = _mm_mul_ps(_mm_mul_ps(p, pow2_ps(k1)), pow2_ps(_mm_sub_epi32(k, k1)));
+    return select_ps(nan, x, p);
+}
+
+/* fdlibm's exp: r = hi - lo as above, exp(r) = 1 + 2r / (2 - c) with c a degree 10 even fit. */
+static inline __m128d
+exp_pd(__m128d x)
+{
+    __m128d nan = _mm_cmpunord_pd(x, x);
+    __m128d xc = _mm_min_pd(_mm_max_pd(x, _mm_set1_pd(-746.0)), _mm_set1_pd(710.0));
+    __m128i k = _mm_cvtpd_epi32(_mm_mul_pd(xc, _mm_set1_pd(1.44269504088896338700e+00)));
+    __m128d kf = _mm_cvtepi32_pd(k);
+    __m128d hi = _mm_sub_pd(xc, _mm_mul_pd(kf, _mm_set1_pd(6.93147180369123816490e-01)));
+    __m128d lo = _mm_mul_pd(kf, _mm_set1_pd(1.90821492927058770002e-10));
+    __m128d r = _mm_sub_pd(hi, lo);
+    __m128d t = _mm_mul_pd(r, r);
+
+    __m128d c = _mm_set1_pd(4.13813679705723846039e-08);
+    c = _mm_add_pd(_mm_mul_pd(c, t), _mm_set1_pd(-1.65339022054652515390e-06));
+    c = _mm_add_pd(_mm_mul_pd(c, t), _mm_set1_pd(6.61375632143793436117e-05));
+    c = _mm_add_pd(_mm_mul_pd(c, t), _mm_set1_pd(-2.77777777770155933842e-03));
+    c = _mm_add_pd(_mm_mul_pd(c, t), _mm_set1_pd(1.66666666666666019037e-01));
+    c = _mm_sub_pd(r, _mm_mul_pd(t, c));
+    __m128d q = _mm_div_pd(_mm_mul_pd(r, c), _mm_sub_pd(_mm_set1_pd(2.0), c));
+    __m128d y = _mm_sub_pd(_mm_set1_pd(1.0), _mm_sub_pd(_mm_sub_pd(lo, q), hi));
+
+    __m128i k1 = _mm_srai_epi32(k, 1);
+    y = _mm_mul_pd(_mm_mul_pd(y, pow2_pd(k1)), pow2_pd(_mm_sub_epi32(k, k1)));
+    return select_pd(nan, x, y);
+}
+
+/*
+ * Cephes' logf: x = m 2^e with m in [sqrt(1/2), sqrt(2)), then
+ * log(m) = f - f^2 / 2 + f^3 P(f) for f = m - 1, and e ln2 added in two
+ * parts. Subnormals are scaled into the normal range first.
+ */
+static inline __m128
+log_ps(__m128 x)
+{
+    __m128 zero = _mm_setzero_ps();
+    __m128 invalid = _mm_or_ps(_mm_cmplt_ps(x, zero), _mm_cmpunord_ps(x, x));
+    __m128 is_zero = _mm_cmpeq_ps(x, zero);
+    __m128 is_inf = _mm_cmpeq_ps(x, _mm_set1_ps(INFINITY));
+
+    __m128 tiny = _mm_cmplt_ps(x, _mm_set1_ps(FLT_MIN));
+    x = select_ps(tiny, _mm_mul_ps(x, _mm_set1_ps(33554432.0f)), x);  // 2^25
+    __m128i bias = _mm_add_epi32(_mm_set1_epi32(126),
+                                 _mm_and_si128(_mm_castps_si128(tiny), _mm_set1_epi32(25)));
+    __m128i xi = _mm_castps_si128(x);
+    __m128i e = _mm_sub_epi32(_mm_srli_epi32(xi, 23), bias);
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(xi, _mm_set1_epi32(0x007fffff)),
+                                             _mm_set1_epi32(0x3f000000)));
+    // m in [0.5, 1): below sqrt(1/2), use 2m and e - 1
+    __m128 low = _mm_cmplt_ps(m, _mm_set1_ps(0.707106781186547524f));
+    e = _mm_add_epi32(e, _mm_castps_si128(low));
+    m = _mm_add_ps(_mm_sub_ps(m, _mm_set1_ps(1.0f)), _mm_and_ps(low, m));
+    __m128 fe = _mm_cvtepi32_ps(e);
+
+    __m128 z = _mm_mul_ps(m, m);
+    __m128 p = _mm_set1_ps(7.0376836292e-2f);
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-1.1514610310e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(1.1676998740e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-1.2420140846e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(1.4249322787e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-1.6668057665e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(2.0000714765e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-2.4999993993e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(3.3333331174e-1f));
+    __m128 y = _mm_mul_ps(_mm_mul_ps(p, m), z);
+    y = _mm_add_ps(y, _mm_mul_ps(fe, _mm_set1_ps(-2.12194440e-4f)));
+    y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    __m128 ret = _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(fe, _mm_set1_ps(0.693359375f)));
+
+    ret = select_ps(is_inf, x, ret);
+    ret = select_ps(is_zero, _mm_set1_ps(-INFINITY), ret);
+    return select_ps(invalid, _mm_set1_ps(NAN), ret);
+}
+
+/*
+ * fdlibm's log: m in [sqrt(1/2), sqrt(2)), s = f / (2 + f) and
+ * log(1 + f) = f - (f^2 / 2 - s (f^2 / 2 + R(s^2))), R a degree 14 even fit.
+ */
+static inline __m128d
+log_pd(__m128d x)
+{
+    __m128d zero = _mm_setzero_pd();
+    __m128d invalid = _mm_or_pd(_mm_cmplt_pd(x, zero), _mm_cmpunord_pd(x, x));
+    __m128d is_zero = _mm_cmpeq_pd(x, zero);
+    __m128d is_inf = _mm_cmpeq_pd(x, _mm_set1_pd(INFINITY));
+
+    __m128d tiny = _mm_cmplt_pd(x, _mm_set1_pd(DBL_MIN));
+    x = select_pd(tiny, _mm_mul_pd(x, _mm_set1_pd(18014398509481984.0)), x);  // 2^54
+    __m128i xi = _mm_castpd_si128(x);
+    // The exponent fields moved to the two bottom int32 lanes.
+    __m128i ebits = _mm_shuffle_epi32(_mm_srli_epi64(xi, 52), _MM_SHUFFLE(2, 0, 2, 0));
+    __m128d e = _mm_sub_pd(_mm_cvtepi32_pd(ebits), _mm_set1_pd(1023.0));
+    e = _mm_sub_pd(e, _mm_and_pd(tiny, _mm_set1_pd(54.0)));
+    __m128d m = _mm_castsi128_pd(_mm_or_si128(
+        _mm_and_si128(xi, _mm_set1_epi64x(0x000fffffffffffffLL)),
+        _mm_set1_epi64x(0x3ff0000000000000LL)));
+    // m in [1, 2): above sqrt(2), use m / 2 and e + 1
+    __m128d high = _mm_cmpgt_pd(m, _mm_set1_pd(1.41421356237309504880));
+    m = select_pd(high, _mm_mul_pd(m, _mm_set1_pd(0.5)), m);
+    e = _mm_add_pd(e, _mm_and_pd(high, _mm_set1_pd(1.0)));
+
+    __m128d f = _mm_sub_pd(m, _mm_set1_pd(1.0));
+    __m128d s = _mm_div_pd(f, _mm_add_pd(_mm_set1_pd(2.0), f));
+    __m128d z = _mm_mul_pd(s, s);
+    __m128d w = _mm_mul_pd(z, z);
+    __m128d t1 = _mm_set1_pd(1.531383769920937332e-01);
+    t1 = _mm_add_pd(_mm_mul_pd(t1, w), _mm_set1_pd(2.222219843214978396e-01));
+    t1 = _mm_add_pd(_mm_mul_pd(t1, w), _mm_set1_pd(3.999999999940941908e-01));
+    t1 = _mm_mul_pd(t1, w);
+    __m128d t2 = _mm_set1_pd(1.479819860511658591e-01);
+    t2 = _mm_add_pd(_mm_mul_pd(t2, w), _mm_set1_pd(1.818357216161805012e-01));
+    t2 = _mm_add_pd(_mm_mul_pd(t2, w), _mm_set1_pd(2.857142874366239149e-01));
+    t2 = _mm_add_pd(_mm_mul_pd(t2, w), _mm_set1_pd(6.666666666666735130e-01));
+    t2 = _mm_mul_pd(t2, z);
+    __m128d R = _mm_add_pd(t2, t1);
+    __m128d hfsq = _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(0.5), f), f);
+    __m128d inner = _mm_add_pd(_mm_mul_pd(s, _mm_add_pd(hfsq, R)),
+                               _mm_mul_pd(e, _mm_set1_pd(1.90821492927058770002e-10)));
+    __m128d ret = _mm_sub_pd(_mm_mul_pd(e, _mm_set1_pd(6.93147180369123816490e-01)),
+                             _mm_sub_pd(_mm_sub_pd(hfsq, inner), f));
+
+    ret = select_pd(is_inf, x, ret);
+    ret = select_pd(is_zero, _mm_set1_pd(-INFINITY), ret);
+    return select_pd(invalid, _mm_set1_pd(NAN), ret);
+}
+
+static inline __m128
+sqrt_ps(__m128 x)
+{
+    return _mm_sqrt_ps(x);
+}
+
+static inline __m128d
+sqrt_pd(__m128d x)
+{
+    return _mm_sqrt_pd(x);
+}
+
+/*
+ * Cephes' tanh: an odd polynomial (float) or rational (double) fit below
+ * |x| = 0.625, where 1 - 2 / (exp(2|x|) + 1) would cancel, and that
+ * formula above it, both on |x| with the sign of x put back.
+ */
+static inline __m128
+tanh_ps(__m128 x)
+{
+    __m128 sign = _mm_and_ps(x, _mm_set1_ps(-0.0f));
+    __m128 ax = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+    __m128 small = _mm_cmplt_ps(ax, _mm_set1_ps(0.625f));
+
+    __m128 s = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps(-5.70498872745e-3f);
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(2.06390887954e-2f));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(-5.37397155531e-2f));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(1.33314422036e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(-3.33332819422e-1f));
+    __m128 near = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, s), ax), ax);
+
+    __m128 e = exp_ps(_mm_add_ps(ax, ax));
+    __m128 far = _mm_sub_ps(_mm_set1_ps(1.0f),
+                            _mm_div_ps(_mm_set1_ps(2.0f), _mm_add_ps(e, _mm_set1_ps(1.0f))));
+    return _mm_or_ps(select_ps(small, near, far), sign);
+}
+
+static inline __m128d
+tanh_pd(__m128d x)
+{
+    __m128d sign = _mm_and_pd(x, _mm_set1_pd(-0.0));
+    __m128d ax = _mm_andnot_pd(_mm_set1_pd(-0.0), x);
+    __m128d small = _mm_cmplt_pd(ax, _mm_set1_pd(0.625));
+
+    __m128d s = _mm_mul_pd(x, x);
+    __m128d p = _mm_set1_pd(-9.64399179425052238628e-1);
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(-9.92877231001918586564e1));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(-1.61468768441708447952e3));
+    __m128d q = _mm_add_pd(s, _mm_set1_pd(1.12811678491632931402e2));
+    q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(2.23548839060100448583e3));
+    q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(4.84406305325125486048e3));
+    __m128d near = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(ax, s), _mm_div_pd(p, q)), ax);
+
+    __m128d e = exp_pd(_mm_add_pd(ax, ax));
+    __m128d far = _mm_sub_pd(_mm_set1_pd(1.0),
+                             _mm_div_pd(_mm_set1_pd(2.0), _mm_add_pd(e, _mm_set1_pd(1.0))));
+    return _mm_or_pd(select_pd(small, near, far), sign);
+}
+
+/*
+ * With t = exp(-|x|), 1 / (1 + t) for x >= 0 and t / (1 + t) below, so
+ * that neither side overflows and tiny results keep their precision.
+ */
+static inline __m128
+sigmoid_ps(__m128 x)
+{
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 t = exp_ps(_mm_or_ps(x, _mm_set1_ps(-0.0f)));
+    __m128 num = select_ps(_mm_cmplt_ps(x, _mm_setzero_ps()), t, one);
+    return _mm_div_ps(num, _mm_add_ps(one, t));
+}
+
+static inline __m128d
+sigmoid_pd(__m128d x)
+{
+    __m128d one = _mm_set1_pd(1.0);
+    __m128d t = exp_pd(_mm_or_pd(x, _mm_set1_pd(-0.0)));
+    __m128d num = select_pd(_mm_cmplt_pd(x, _mm_setzero_pd()), t, one);
+    return _mm_div_pd(num, _mm_add_pd(one, t));
+}
+
+/* A partial last vector goes through a zero-padded lane buffer. */
+#define DEFINE_UNARY_KERNEL(fn, T, V, W, SFX) \
+    static void unary_##fn(char *out_buf, const char *x_buf, int64_t n) { \
+        T *out = (T *)out_buf; \
+        const T *x = (const T *)x_buf; \
+        int64_t i = 0; \
+        for (; i + W <= n; i += W) { \
+            _mm_storeu_##SFX(out + i, fn(_mm_loadu_##SFX(x + i))); \
+        } \
+        if (i < n) { \
+            T lanes[W] = {0}; \
+            memcpy(lanes, x + i, (n - i) * sizeof(T)); \
+            _mm_storeu_##SFX(lanes, fn(_mm_loadu_##SFX(lanes))); \
+            memcpy(out + i, lanes, (n - i) * sizeof(T)); \
+        } \
+    }
+
+DEFINE_UNARY_KERNEL(exp_ps, float, __m128, 4, ps)
+DEFINE_UNARY_KERNEL(log_ps, float, __m128, 4, ps)
+DEFINE_UNARY_KERNEL(sqrt_ps, float, __m128, 4, ps)
+DEFINE_UNARY_KERNEL(tanh_ps, float, __m128, 4, ps)
+DEFINE_UNARY_KERNEL(sigmoid_ps, float, __m128, 4, ps)
+DEFINE_UNARY_KERNEL(exp_pd, double, __m128d, 2, pd)
+DEFINE_UNARY_KERNEL(log_pd, double, __m128d, 2, pd)
+DEFINE_UNARY_KERNEL(sqrt_pd, double, __m128d, 2, pd)
+DEFINE_UNARY_KERNEL(tanh_pd, double, __m128d, 2, pd)
+DEFINE_UNARY_KERNEL(sigmoid_pd, double, __m128d, 2, pd)
+#else
+static inline float sigmoidf(float x) { return 1.0f / (1.0f + expf(-x)); }
+static inline double sigmoid(double x) { return 1.0 / (1.0 + exp(-x)); }
+
+#define DEFINE_UNARY_KERNEL(fn, name, T) \
+    static void unary_##name(char *out_buf, const char *x_buf, int64_t n) { \
+        T *out = (T *)out_buf; \
+        const T *x = (const T *)x_buf; \
+        for (int64_t i = 0; i < n; i++) { \
+            out[i] = fn(x[i]); \
+        } \
+    }
+
+DEFINE_UNARY_KERNEL(expf, exp_ps, float)
+DEFINE_UNARY_KERNEL(logf, log_ps, float)
+DEFINE_UNARY_KERNEL(sqrtf, sqrt_ps, float)
+DEFINE_UNARY_KERNEL(tanhf, tanh_ps, float)
+DEFINE_UNARY_KERNEL(sigmoidf, sigmoid_ps, float)
+DEFINE_UNARY_KERNEL(exp, exp_pd, double)
+DEFINE_UNARY_KERNEL(log, log_pd, double)
+DEFINE_UNARY_KERNEL(sqrt, sqrt_pd, double)
+DEFINE_UNARY_KERNEL(tanh, tanh_pd, double)
+DEFINE_UNARY_KERNEL(sigmoid, sigmoid_pd, double)
+#endif
+
+static unary_func unary_float_funcs[NUM_UNARY_OPS] = {
+    unary_exp_ps, unary_log_ps, unary_sqrt_ps, unary_tanh_ps, unary_sigmoid_ps,
+};
+static unary_func unary_double_funcs[NUM_UNARY_OPS] = {
+    unary_exp_pd, unary_log_pd, unary_sqrt_pd, unary_tanh_pd, unary_sigmoid_pd,
+};
+
+void
+unary_contiguous(char *out, const char *x, int64_t n, UNARY_OP op, ARRAY_DTYPE dtype)
+{
+    (dtype == FLOAT ? unary_float_funcs : unary_double_funcs)[op](out, x, n);
+}
+
+typedef struct unaryCtx {
+    char *out;
+    const char *vals;
+    int64_t cols;
+    int64_t row_stride;
+    int64_t col_stride;
+    int64_t out_row_stride;
+    int64_t out_col_stride;
+    size_t dtype_size;
+    unary_func func;
+} unaryCtx;
+
+static void
+unary_flat(void *arg, int64_t begin, int64_t end)
+{
+    unaryCtx *ctx = arg;
+    ctx->func(ctx->out + begin * ctx->dtype_size, ctx->vals + begin * ctx->dtype_size,
+              end - begin);
+}
+
+/* Copies n elements of size bytes between strided (in elements) buffers. */
+static void
+copy_elems(char *dst, int64_t dst_stride, const char *src, int64_t src_stride, int64_t n,
+           size_t size)
+{
+    if (size == sizeof(float)) {
+        for (int64_t i = 0; i < n; i++) {
+            ((uint32_t *)dst)[i * dst_stride] = ((const uint32_t *)src)[i * src_stride];
+        }
+    } else {
+        for (int64_t i = 0; i < n; i++) {
+            ((uint64_t *)dst)[i * dst_stride] = ((const uint64_t *)src)[i * src_stride];
+        }
+    }
+}
+
+/* Rows of strided operands, gathered and scattered a block at a time. */
+static void
+unary_rows(void *arg, int64_t begin, int64_t end)
+{
+    unaryCtx *ctx = arg;
+    size_t size = ctx->dtype_size;
+    double block[2][UNARY_BLOCK];
+    for (int64_t i = begin; i < end; i++) {
+        const char *src = ctx->vals + i * ctx->row_stride * size;
+        char *dst = ctx->out + i * ctx->out_row_stride * size;
+        for (int64_t j = 0; j < ctx->cols; j += UNARY_BLOCK) {
+            int64_t n = ctx->cols - j < UNARY_BLOCK ? ctx->cols - j : UNARY_BLOCK;
+            const char *x = src + j * ctx->col_stride * size;
+            char *y = dst + j * ctx->out_col_stride * size;
+            if (ctx->col_stride != 1) {
+                copy_elems((char *)block[0], 1, x, ctx->col_stride, n, size);
+                x = (const char *)block[0];
+            }
+            if (ctx->out_col_stride == 1) {
+                ctx->func(y, x, n);
+            } else {
+                ctx->func((char *)block[1], x, n);
+                copy_elems(y, ctx->out_col_stride, (const char *)block[1], 1, n, size);
+            }
+        }
+    }
+}
+
+static void
+unary_into(arrayObject *out, const arrayObject *a, UNARY_OP op)
+{
+    int64_t n = NUM_ARRAY_ELEMS(a);
+    unaryCtx ctx = {
+        out->data, a->data, a->dims[1], a->strides[0], a->strides[1],
+        out->strides[0], out->strides[1], array_dtype_size(a->dtype),
+        (a->dtype == FLOAT ? unary_float_funcs : unary_double_funcs)[op],
+    };
+    // Matching contiguous layouts map element for element, whatever the order.
+    int flat = (array_is_contiguous(a, 'C') && array_is_contiguous(out, 'C')) ||
+               (array_is_contiguous(a, 'F') && array_is_contiguous(out, 'F'));
+    if (flat) {
+        if (n < UNARY_PARALLEL_MIN_ELEMS) {
+            unary_flat(&ctx, 0, n);
+        } else {
+            parallel_for(n, UNARY_GRAIN_ELEMS, unary_flat, &ctx);
+        }
+        return;
+    }
+    if (n < UNARY_PARALLEL_MIN_ELEMS) {
+        unary_rows(&ctx, 0, a->dims[0]);
+    } else {
+        int64_t grain = a->dims[1] < UNARY_GRAIN_ELEMS ? UNARY_GRAIN_ELEMS / a->dims[1] : 1;
+        parallel_for(a->dims[0], grain, unary_rows, &ctx);
+    }
+}
+
+arrayObject*
+array_unary(const arrayObject *a, UNARY_OP op, arrayObject *out)
+{
+    if (a->dtype != FLOAT && a->dtype != DOUBLE) {
+        printf("%s expects a float or double array\n", UNARY_OP_NAMES[op]);
+        return NULL;
+    }
+    if (out && (out->dtype != a->dtype || out->dims[0] != a->dims[0] ||
+                out->dims[1] != a->dims[1])) {
+        printf("Output dtype and dims must match the input\n");
+        return NULL;
+    }
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_unary", a->dtype, a->dims, NULL);
+    arrayObject *ret = out;
+    if (ret == NULL) {
+        ret = array_empty(a->dims, a->nd, a->dtype);
+        if (ret == NULL) {
+            ARRAY_TRACE_END("array_unary");
+            return NULL;
+        }
+        // Keep a column-major input's layout so that it maps flat.
+        if (!array_is_contiguous(a, 'C') && array_is_contiguous(a, 'F')) {
+            ret->strides[0] = 1;
+            ret->strides[1] = a->dims[0];
+        }
+    }
+    unary_into(ret, a, op);
+    ARRAY_TRACE_END("array_unary");
+    ARRAY_STATS_END(t0, STATS_UNARY, NUM_ARRAY_ELEMS(a), 0);
+    return ret;
+}
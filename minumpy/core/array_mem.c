@@ -0,0 +1,273 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "array_dtypes.h"
+#include "array_mem.h"
+#include "array_parallel.h"
+
+#define MEM_HEADER_SIZE 64
+#define MEM_HUGE_PAGE_SIZE ((size_t)2 << 20)
+#define MEM_TOUCH_GRAIN_BYTES ((size_t)2 << 20)
+#define MEM_MAX_NODES 1024
+#define MEM_NODE_WORD_BITS (8 * sizeof(unsigned long))
+#define MEM_NODE_MASK_WORDS (MEM_MAX_NODES / MEM_NODE_WORD_BITS)
+
+// <linux/mempolicy.h> values, for libc without the libnuma wrappers
+#define MEM_MPOL_BIND 2
+#define MEM_MPOL_INTERLEAVE 3
+#define MEM_MPOL_F_MEMS_ALLOWED (1 << 2)
+
+typedef struct memHeader {
+    size_t size;
+    ARRAY_DTYPE dtype;
+    size_t map_len;  // 0 for heap buffers, else the mapping starting at the header
+} memHeader;
+
+typedef struct memTouch {
+    volatile char *base;
+    size_t page;
+} memTouch;
+
+const char *MEM_NUMA_MODE_NAMES[NUM_MEM_NUMA_MODES] = {"local", "interleave", "bind"};
+
+static arrayMemPolicy policy = {(size_t)4 << 20, 1, MEM_NUMA_LOCAL, 0, 1};
+
+static arrayMemStats dtype_stats[NUM_ARRAY_DTYPES];
+static arrayMemStats total_stats;
+static array_mem_track_func track_hook = NULL;
+static array_mem_untrack_func untrack_hook = NULL;
+
+static void
+stats_add(arrayMemStats *s, size_t size)
+{
+    uint64_t live = __atomic_add_fetch(&s->live_bytes, size, __ATOMIC_RELAXED);
+    uint64_t peak = __atomic_load_n(&s->peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak &&
+           !__atomic_compare_exchange_n(&s->peak_bytes, &peak, live, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    __atomic_add_fetch(&s->allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s->alloc_bytes, size, __ATOMIC_RELAXED);
+}
+
+static void
+stats_sub(arrayMemStats *s, size_t size)
+{
+    __atomic_sub_fetch(&s->live_bytes, size, __ATOMIC_RELAXED);
+}
+
+/* Fills mask with the nodes this process may allocate on. */
+static int
+allowed_nodes(unsigned long mask[MEM_NODE_MASK_WORDS])
+{
+#ifdef SYS_get_mempolicy
+    return syscall(SYS_get_mempolicy, NULL, mask, MEM_MAX_NODES, NULL,
+                   MEM_MPOL_F_MEMS_ALLOWED) != 0;
+#else
+    (void)mask;
+    return 1;
+#endif
+}
+
+/* Best effort: a kernel without NUMA leaves the default placement. */
+static void
+apply_numa(char *ptr, size_t len, const arrayMemPolicy *p)
+{
+#ifdef SYS_mbind
+    unsigned long mask[MEM_NODE_MASK_WORDS] = {0};
+    int mode;
+    if (p->numa == MEM_NUMA_INTERLEAVE) {
+        if (allowed_nodes(mask)) return;
+        mode = MEM_MPOL_INTERLEAVE;
+    } else if (p->numa == MEM_NUMA_BIND) {
+        mask[p->node / MEM_NODE_WORD_BITS] |= 1UL << (p->node % MEM_NODE_WORD_BITS);
+        mode = MEM_MPOL_BIND;
+    } else {
+        return;
+    }
+    // The kernel reads one bit fewer than maxnode.
+    syscall(SYS_mbind, ptr, len, mode, mask, MEM_MAX_NODES + 1, 0);
+#else
+    (void)ptr;
+    (void)len;
+    (void)p;
+#endif
+}
+
+static void
+touch_pages(void *ctx, int64_t begin, int64_t end)
+{
+    const memTouch *t = ctx;
+    for (int64_t i = begin; i < end; i++) {
+        t->base[i * t->page] = 0;
+    }
+}
+
+/*
+ * Maps *len bytes rounded up to the page size, huge-page aligned when
+ * asked for by trimming an oversized mapping. Anonymous mappings come back
+ * zeroed, so first touch only has to fault the pages in. parallel_for does
+ * that in MEM_TOUCH_GRAIN_BYTES grains on the work-stealing pool, so pages
+ * end up spread over the pool's threads, but not necessarily on the ones
+ * whose kernel grains later cover them.
+ */
+static char *
+map_buffer(size_t *map_len, int zero, const arrayMemPolicy *p)
+{
+    size_t len = *map_len;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t align = p->hugepages ? MEM_HUGE_PAGE_SIZE : page;
+    if (len > SIZE_MAX - 2 * align) return NULL;
+    len = (len + align - 1) & ~(align - 1);
+    size_t over = len + align - page;
+    char *raw = mmap(NULL, over, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    char *start = (char *)(((uintptr_t)raw + align - 1) & ~(uintptr_t)(align - 1));
+    if (start > raw) munmap(raw, start - raw);
+    if (raw + over > start + len) munmap(start + len, raw + over - (start + len));
+
+#ifdef MADV_HUGEPAGE
+    if (p->hugepages) madvise(start, len, MADV_HUGEPAGE);
+#endif
+    apply_numa(start, len, p);
+    if (zero && p->first_touch) {
+        memTouch t = {start, p->hugepages ? MEM_HUGE_PAGE_SIZE : page};
+        int64_t grain = t.page < MEM_TOUCH_GRAIN_BYTES ? MEM_TOUCH_GRAIN_BYTES / t.page : 1;
+        parallel_for(len / t.page, grain, touch_pages, &t);
+    }
+    *map_len = len;
+    return start;
+}
+
+void *
+array_data_alloc(size_t n, ARRAY_DTYPE dtype, int zero)
+{
+    arrayMemPolicy p;
+    array_mem_get_policy(&p);
+    return array_data_alloc_policy(n, dtype, zero, &p);
+}
+
+void *
+array_data_alloc_policy(size_t n, ARRAY_DTYPE dtype, int zero, const arrayMemPolicy *p)
+{
+    size_t size;
+    if (__builtin_mul_overflow(n, array_dtype_size(dtype), &size) ||
+        size > SIZE_MAX - MEM_HEADER_SIZE) {
+        return NULL;
+    }
+    size_t map_len = 0;
+    char *raw;
+    if (size >= p->mmap_threshold) {
+        map_len = MEM_HEADER_SIZE + size;
+        raw = map_buffer(&map_len, zero, p);
+        if (raw == NULL) return NULL;
+    } else {
+        raw = zero
+            ? calloc(1, MEM_HEADER_SIZE + size)
+            : malloc(MEM_HEADER_SIZE + size);
+        if (raw == NULL) return NULL;
+    }
+
+    memHeader *h = (memHeader *)raw;
+    h->size = size;
+    h->dtype = dtype;
+    h->map_len = map_len;
+    void *ptr = raw + MEM_HEADER_SIZE;
+
+    stats_add(&dtype_stats[dtype], size);
+    stats_add(&total_stats, size);
+    if (track_hook) track_hook(ptr, size);
+    return ptr;
+}
+
+void
+array_data_free(void *ptr)
+{
+    if (ptr == NULL) return;
+    char *raw = (char *)ptr - MEM_HEADER_SIZE;
+    memHeader *h = (memHeader *)raw;
+
+    if (untrack_hook) untrack_hook(ptr);
+    stats_sub(&dtype_stats[h->dtype], h->size);
+    stats_sub(&total_stats, h->size);
+    if (h->map_len) {
+        munmap(raw, h->map_len);
+    } else {
+        free(raw);
+    }
+}
+
+int
+array_data_is_mapped(const void *ptr)
+{
+    const memHeader *h = (const memHeader *)((const char *)ptr - MEM_HEADER_SIZE);
+    return h->map_len != 0;
+}
+
+/* Fields are loaded one by one: a racing set may mix two policies, never tear one. */
+void
+array_mem_get_policy(arrayMemPolicy *p)
+{
+    p->mmap_threshold = __atomic_load_n(&policy.mmap_threshold, __ATOMIC_RELAXED);
+    p->hugepages = __atomic_load_n(&policy.hugepages, __ATOMIC_RELAXED);
+    p->numa = __atomic_load_n(&policy.numa, __ATOMIC_RELAXED);
+    p->node = __atomic_load_n(&policy.node, __ATOMIC_RELAXED);
+    p->first_touch = __atomic_load_n(&policy.first_touch, __ATOMIC_RELAXED);
+}
+
+int
+array_mem_set_policy(const arrayMemPolicy *p)
+{
+    if (p->numa < 0 || p->numa >= NUM_MEM_NUMA_MODES) return 1;
+    if (p->numa == MEM_NUMA_BIND) {
+        unsigned long mask[MEM_NODE_MASK_WORDS] = {0};
+        if (p->node < 0 || p->node >= MEM_MAX_NODES || allowed_nodes(mask) ||
+            !(mask[p->node / MEM_NODE_WORD_BITS] >> (p->node % MEM_NODE_WORD_BITS) & 1)) {
+            return 1;
+        }
+    }
+    __atomic_store_n(&policy.mmap_threshold, p->mmap_threshold, __ATOMIC_RELAXED);
+    __atomic_store_n(&policy.hugepages, p->hugepages != 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&policy.numa, p->numa, __ATOMIC_RELAXED);
+    __atomic_store_n(&policy.node, p->node, __ATOMIC_RELAXED);
+    __atomic_store_n(&policy.first_touch, p->first_touch != 0, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void
+array_mem_set_hooks(array_mem_track_func track, array_mem_untrack_func untrack)
+{
+    track_hook = track;
+    untrack_hook = untrack;
+}
+
+static void
+stats_load(const arrayMemStats *s, arrayMemStats *out)
+{
+    out->live_bytes = __atomic_load_n(&s->live_bytes, __ATOMIC_RELAXED);
+    out->peak_bytes = __atomic_load_n(&s->peak_bytes, __ATOMIC_RELAXED);
+    out->allocs = __atomic_load_n(&s->allocs, __ATOMIC_RELAXED);
+    out->alloc_bytes = __atomic_load_n(&s->alloc_bytes, __ATOMIC_RELAXED);
+}
+
+void
+array_mem_stats(arrayMemStats dtypes[NUM_ARRAY_DTYPES], arrayMemStats *total)
+{
+    for (int i = 0; i < NUM_ARRAY_DTYPES; i++) {
+        stats_load(&dtype_stats[i], &dtypes[i]);
+    }
+    stats_load(&total_stats, total);
+}
+
+void
+array_mem_reset_peak(void)
+{
+    for (int i = 0; i < NUM_ARRAY_DTYPES; i++) {
+        uint64_t live = __atomic_load_n(&dtype_stats[i].live_bytes, __ATOMIC_RELAXED);
+        __atomic_store_n(&dtype_stats[i].peak_bytes, live, __ATOMIC_RELAXED);
+    }
+    uint64_t live = __atomic_load_n(&total_stats.live_bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&total_stats.peak_bytes, live, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,68 @@
+#ifndef ARRAY_MEM_H
+#define ARRAY_MEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "array_dtypes.h"
+
+/*
+ * Tracked allocation layer for array data buffers. Every buffer carries a
+ * small header recording its size and dtype so that array_data_free can
+ * keep the live/peak counters and the registered hooks (tracemalloc, when
+ * running under Python) in step without the caller passing the size back.
+ */
+
+typedef struct arrayMemStats {
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+    uint64_t allocs;
+    uint64_t alloc_bytes;  // cumulative
+} arrayMemStats;
+
+typedef void (*array_mem_track_func)(void *ptr, size_t size);
+typedef void (*array_mem_untrack_func)(void *ptr);
+
+typedef enum {
+    MEM_NUMA_LOCAL,       // pages go to the node of the thread first touching them
+    MEM_NUMA_INTERLEAVE,  // pages round-robin over every allowed node
+    MEM_NUMA_BIND,        // pages on policy.node only
+    NUM_MEM_NUMA_MODES,
+} MEM_NUMA_MODE;
+
+extern const char *MEM_NUMA_MODE_NAMES[NUM_MEM_NUMA_MODES];
+
+/*
+ * Placement of big buffers. Buffers of at least mmap_threshold bytes are
+ * mapped directly rather than taken from the heap, so that they can be
+ * huge-page aligned and given a NUMA policy. Zeroed mappings are faulted
+ * in by parallel_for when first_touch is set, spreading their pages over
+ * the nodes of the pool's threads; which thread later works on a page
+ * depends on each loop's own grain, so placement only loosely matches.
+ */
+typedef struct arrayMemPolicy {
+    size_t mmap_threshold;
+    int hugepages;  // madvise(MADV_HUGEPAGE), with 2 MB aligned mappings
+    MEM_NUMA_MODE numa;
+    int node;
+    int first_touch;
+} arrayMemPolicy;
+
+/* Returns NULL if n elements of dtype overflow size_t or cannot be allocated. */
+void *array_data_alloc(size_t n, ARRAY_DTYPE dtype, int zero);
+/* As array_data_alloc, placed by policy rather than the global policy. */
+void *array_data_alloc_policy(size_t n, ARRAY_DTYPE dtype, int zero,
+                              const arrayMemPolicy *policy);
+void array_data_free(void *ptr);
+/* Whether ptr was mapped under a policy rather than taken from the heap. */
+int array_data_is_mapped(const void *ptr);
+
+void array_mem_get_policy(arrayMemPolicy *policy);
+/* Returns 1 if the mode is unknown or a bound node is not allowed. */
+int array_mem_set_policy(const arrayMemPolicy *policy);
+
+void array_mem_set_hooks(array_mem_track_func track, array_mem_untrack_func untrack);
+void array_mem_stats(arrayMemStats dtypes[NUM_ARRAY_DTYPES], arrayMemStats *total);
+void array_mem_reset_peak(void);
+
+#endif
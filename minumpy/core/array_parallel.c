@@ -0,0 +1,351 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "array_parallel.h"
+
+#define PARALLEL_MAX_THREADS 64
+#define PARALLEL_MAX_WORKERS (PARALLEL_MAX_THREADS - 1)
+// Ranges are halved until at most 1 / (threads * this) of the loop.
+#define PARALLEL_SPLIT_FACTOR 4
+#define PARALLEL_DEQUE_INIT_CAP 64
+
+typedef struct parallelJob {
+    parallel_body body;
+    void *ctx;
+    int64_t n;
+    int64_t grain;
+    int64_t split;      // ranges longer than this many grains are halved
+    int64_t remaining;  // grains not yet processed; the caller returns at 0
+} parallelJob;
+
+typedef struct parallelTask {
+    parallelJob *job;
+    int64_t begin;  // in grains
+    int64_t end;
+} parallelTask;
+
+/*
+ * The owner pushes and pops at tail, thieves take the oldest (largest)
+ * ranges from head. A mutex per deque keeps this simple; contention is
+ * limited to one lock per steal.
+ */
+typedef struct parallelDeque {
+    pthread_mutex_t lock;
+    parallelTask *tasks;
+    int head;
+    int tail;
+    int cap;
+} parallelDeque;
+
+typedef struct parallelWorker {
+    pthread_t thread;
+    parallelDeque deque;
+} parallelWorker;
+
+static int num_threads = 0;
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static parallelWorker workers[PARALLEL_MAX_WORKERS];
+// Tasks split by threads outside the pool.
+static parallelDeque shared_deque;
+static int pool_started = 0;   // workers[0, pool_started) are running
+static int pool_active = 0;    // workers[0, pool_active) may take tasks
+static int pool_pending = 0;   // tasks queued across all deques
+static int pool_sleepers = 0;
+static int pool_pin = 0;
+static cpu_set_t pool_cpus;    // process affinity mask at startup
+static int pool_num_cpus = 0;
+
+static __thread int worker_index = -1;
+static __thread unsigned int steal_seed = 0;
+
+int
+parallel_num_threads(void)
+{
+    int n = __atomic_load_n(&num_threads, __ATOMIC_RELAXED);
+    if (n > 0) return n;
+
+    const char *env = getenv("MINUMPY_NUM_THREADS");
+    n = env ? atoi(env) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > PARALLEL_MAX_THREADS) n = PARALLEL_MAX_THREADS;
+    __atomic_store_n(&num_threads, n, __ATOMIC_RELAXED);
+    return n;
+}
+
+void
+parallel_set_num_threads(int n)
+{
+    if (n > PARALLEL_MAX_THREADS) n = PARALLEL_MAX_THREADS;
+    __atomic_store_n(&num_threads, n < 1 ? 0 : n, __ATOMIC_RELAXED);
+}
+
+static void
+deque_init(parallelDeque *d)
+{
+    pthread_mutex_init(&d->lock, NULL);
+    d->tasks = NULL;
+    d->head = d->tail = d->cap = 0;
+}
+
+/* Called under d->lock; the atomic stores let deque_take peek without it. */
+static void
+deque_set_bounds(parallelDeque *d, int head, int tail)
+{
+    __atomic_store_n(&d->head, head, __ATOMIC_RELAXED);
+    __atomic_store_n(&d->tail, tail, __ATOMIC_RELAXED);
+}
+
+/* Returns 0 if the deque could not grow; the caller runs the task itself. */
+static int
+deque_push(parallelDeque *d, parallelTask task)
+{
+    pthread_mutex_lock(&d->lock);
+    int head = d->head;
+    int tail = d->tail;
+    if (tail == d->cap) {
+        if (head > 0) {
+            memmove(d->tasks, d->tasks + head, (tail - head) * sizeof(parallelTask));
+            tail -= head;
+            head = 0;
+        } else {
+            int cap = d->cap ? 2 * d->cap : PARALLEL_DEQUE_INIT_CAP;
+            parallelTask *tasks = realloc(d->tasks, cap * sizeof(parallelTask));
+            if (tasks == NULL) {
+                pthread_mutex_unlock(&d->lock);
+                return 0;
+            }
+            d->tasks = tasks;
+            d->cap = cap;
+        }
+    }
+    d->tasks[tail++] = task;
+    deque_set_bounds(d, head, tail);
+    pthread_mutex_unlock(&d->lock);
+
+    // Pairs with the sleeper check in worker_main: either the worker sees
+    // the new task or we see it waiting and wake it.
+    __atomic_add_fetch(&pool_pending, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool_sleepers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool_lock);
+        pthread_cond_broadcast(&pool_cond);
+        pthread_mutex_unlock(&pool_lock);
+    }
+    return 1;
+}
+
+static int
+deque_take(parallelDeque *d, parallelTask *task, int from_tail)
+{
+    if (__atomic_load_n(&d->tail, __ATOMIC_RELAXED) == __atomic_load_n(&d->head, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    pthread_mutex_lock(&d->lock);
+    int head = d->head;
+    int tail = d->tail;
+    int found = head < tail;
+    if (found) {
+        *task = from_tail ? d->tasks[--tail] : d->tasks[head++];
+        if (head == tail) head = tail = 0;
+        deque_set_bounds(d, head, tail);
+    }
+    pthread_mutex_unlock(&d->lock);
+    if (found) __atomic_sub_fetch(&pool_pending, 1, __ATOMIC_SEQ_CST);
+    return found;
+}
+
+/* Pops own newest task, else steals the oldest task of a random victim. */
+static int
+find_task(parallelDeque *own, parallelTask *task)
+{
+    if (deque_take(own, task, 1)) return 1;
+    if (__atomic_load_n(&pool_pending, __ATOMIC_SEQ_CST) == 0) return 0;
+
+    int nvictims = __atomic_load_n(&pool_started, __ATOMIC_ACQUIRE) + 1;
+    steal_seed = steal_seed * 1103515245u + 12345u;
+    int start = (int)((steal_seed >> 16) % (unsigned int)nvictims);
+    for (int i = 0; i < nvictims; i++) {
+        int v = (start + i) % nvictims;
+        parallelDeque *d = v < nvictims - 1 ? &workers[v].deque : &shared_deque;
+        if (d != own && deque_take(d, task, 0)) return 1;
+    }
+    return 0;
+}
+
+static void
+run_task(parallelDeque *own, parallelTask task)
+{
+    parallelJob *job = task.job;
+    while (task.end - task.begin > job->split) {
+        int64_t mid = task.begin + (task.end - task.begin) / 2;
+        if (!deque_push(own, (parallelTask){job, mid, task.end})) break;
+        task.end = mid;
+    }
+
+    int64_t begin = task.begin * job->grain;
+    int64_t end = task.end * job->grain;
+    job->body(job->ctx, begin, end < job->n ? end : job->n);
+    // Last access to job: the caller may return as soon as this hits 0.
+    __atomic_sub_fetch(&job->remaining, task.end - task.begin, __ATOMIC_RELEASE);
+}
+
+static void
+pin_worker(int i, int pin)
+{
+    if (pool_num_cpus == 0) return;
+    cpu_set_t set;
+    if (pin) {
+        // The caller usually runs on the first CPU, so worker i takes the next.
+        int target = (i + 1) % pool_num_cpus;
+        CPU_ZERO(&set);
+        for (int cpu = 0, seen = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &pool_cpus) && seen++ == target) {
+                CPU_SET(cpu, &set);
+                break;
+            }
+        }
+    } else {
+        set = pool_cpus;
+    }
+    pthread_setaffinity_np(workers[i].thread, sizeof(set), &set);
+}
+
+static void *
+worker_main(void *arg)
+{
+    worker_index = (int)(intptr_t)arg;
+    steal_seed = (unsigned int)worker_index * 2654435761u + 1;
+    parallelDeque *own = &workers[worker_index].deque;
+    parallelTask task;
+
+    for (;;) {
+        if (worker_index < __atomic_load_n(&pool_active, __ATOMIC_ACQUIRE)
+                && find_task(own, &task)) {
+            run_task(own, task);
+            continue;
+        }
+        pthread_mutex_lock(&pool_lock);
+        __atomic_add_fetch(&pool_sleepers, 1, __ATOMIC_SEQ_CST);
+        while (worker_index >= pool_active
+                || __atomic_load_n(&pool_pending, __ATOMIC_SEQ_CST) == 0) {
+            pthread_cond_wait(&pool_cond, &pool_lock);
+        }
+        __atomic_sub_fetch(&pool_sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pool_lock);
+    }
+    return NULL;
+}
+
+static void
+pool_reset_after_fork(void)
+{
+    // Only the forking thread survives in the child; start from scratch.
+    pthread_mutex_init(&pool_lock, NULL);
+    pthread_cond_init(&pool_cond, NULL);
+    for (int i = 0; i < PARALLEL_MAX_WORKERS; i++) {
+        deque_init(&workers[i].deque);
+    }
+    deque_init(&shared_deque);
+    pool_started = pool_active = pool_pending = pool_sleepers = 0;
+    worker_index = -1;
+}
+
+static void
+pool_init(void)
+{
+    for (int i = 0; i < PARALLEL_MAX_WORKERS; i++) {
+        deque_init(&workers[i].deque);
+    }
+    deque_init(&shared_deque);
+    if (sched_getaffinity(0, sizeof(pool_cpus), &pool_cpus) == 0) {
+        pool_num_cpus = CPU_COUNT(&pool_cpus);
+    }
+    const char *env = getenv("MINUMPY_PIN_THREADS");
+    pool_pin = env && atoi(env) > 0;
+    pthread_atfork(NULL, NULL, pool_reset_after_fork);
+}
+
+/* Starts workers up to nworkers and parks any above it. */
+static void
+pool_resize(int nworkers)
+{
+    pthread_once(&pool_once, pool_init);
+    if (__atomic_load_n(&pool_active, __ATOMIC_ACQUIRE) == nworkers) return;
+
+    pthread_mutex_lock(&pool_lock);
+    while (pool_started < nworkers) {
+        int i = pool_started;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        int err = pthread_create(&workers[i].thread, &attr, worker_main, (void *)(intptr_t)i);
+        pthread_attr_destroy(&attr);
+        if (err) {
+            // Run with the workers we have; callers always help.
+            nworkers = i;
+            break;
+        }
+        if (pool_pin) pin_worker(i, 1);
+        __atomic_store_n(&pool_started, i + 1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&pool_active, nworkers, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool_cond);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+int
+parallel_get_affinity(void)
+{
+    pthread_once(&pool_once, pool_init);
+    return pool_pin;
+}
+
+void
+parallel_set_affinity(int pin)
+{
+    pthread_once(&pool_once, pool_init);
+    pthread_mutex_lock(&pool_lock);
+    pool_pin = pin ? 1 : 0;
+    for (int i = 0; i < pool_started; i++) {
+        pin_worker(i, pool_pin);
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void
+parallel_for(int64_t n, int64_t grain, parallel_body body, void *ctx)
+{
+    if (grain < 1) grain = 1;
+    int64_t chunks = (n + grain - 1) / grain;
+    int nthreads = parallel_num_threads();
+    if (nthreads > chunks) nthreads = chunks;
+    if (nthreads <= 1) {
+        if (n > 0) body(ctx, 0, n);
+        return;
+    }
+    pool_resize(parallel_num_threads() - 1);
+
+    int64_t split = chunks / (nthreads * PARALLEL_SPLIT_FACTOR);
+    parallelJob job = {body, ctx, n, grain, split > 0 ? split : 1, chunks};
+    parallelDeque *own = worker_index >= 0 ? &workers[worker_index].deque : &shared_deque;
+    if (steal_seed == 0) steal_seed = (unsigned int)(uintptr_t)&job | 1;
+    run_task(own, (parallelTask){&job, 0, chunks});
+
+    // Keep running queued ranges, of this job or any other, until ours are
+    // all done. This is what makes nested calls from inside a body safe.
+    parallelTask task;
+    while (__atomic_load_n(&job.remaining, __ATOMIC_ACQUIRE) > 0) {
+        if (find_task(own, &task)) {
+            run_task(own, task);
+        } else {
+            sched_yield();
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef ARRAY_PARALLEL_H
+#define ARRAY_PARALLEL_H
+
+#include <stdint.h>
+
+/*
+ * Shared parallel runtime: a persistent work-stealing pool that every
+ * kernel splits its loops over, so concurrent ops share one set of
+ * threads instead of each spawning their own.
+ *
+ * parallel_for calls body with disjoint [begin, end) ranges covering
+ * [0, n) whose length is a multiple of grain (except the last), and
+ * returns once every range has been processed. Ranges are split in halves
+ * onto per-worker deques that idle workers steal from; the caller works
+ * too. Bodies may call parallel_for themselves: a nested caller keeps
+ * running queued ranges while it waits, so nesting never deadlocks. Loops
+ * shorter than two grains or a pool of one thread run inline.
+ */
+
+typedef void (*parallel_body)(void *ctx, int64_t begin, int64_t end);
+
+/* Threads taking part in a parallel_for, the caller included. */
+int parallel_num_threads(void);
+/* Overrides MINUMPY_NUM_THREADS and the core count; n < 1 re-reads them. */
+void parallel_set_num_threads(int n);
+/*
+ * Binds each worker to its own CPU of the process affinity mask, or
+ * releases them. Starts from MINUMPY_PIN_THREADS (default off).
+ */
+int parallel_get_affinity(void);
+void parallel_set_affinity(int pin);
+void parallel_for(int64_t n, int64_t grain, parallel_body body, void *ctx);
+
+#endif
@@ -3,9 +3,20 @@
 #include "structmember.h"
 
 #include "array.h"
+#include "array_backend.h"
 #include "array_dtypes.h"
+#include "array_graph.h"
+#include "array_index.h"
+#include "array_sort.h"
+#include "array_math.h"
+#include "array_mem.h"
+#include "array_parallel.h"
 #include "array_py.h"
 #include "array_py_utils.h"
+#include "array_sparse.h"
+#include "array_stats.h"
+#include "array_trace.h"
+#include "array_tune.h"
 #include "array_utils.h"
 
 static void
@@ -36,9 +47,16 @@ py_array_alloc(PyTypeObject *type, PyObject *args, PyObject *kwds)
         goto fail;
     }
 
+    ARRAY_TRACE_BEGIN("py.array", dtype, NULL, NULL);
     a = array_alloc(dims.ptr, dims.len, dtype);
     if (a == NULL) {
-        PyErr_SetString(PyExc_ValueError, "Array allocation failed");
+        ARRAY_TRACE_END("py.array");
+        int64_t n;
+        if (validate_nd(dims.len) || prod_checked(dims.ptr, dims.len, &n)) {
+            PyErr_SetString(PyExc_ValueError, "Array allocation failed");
+        } else {
+            PyErr_NoMemory();
+        }
         goto fail;
     }
 
@@ -47,6 +65,7 @@ py_array_alloc(PyTypeObject *type, PyObject *args, PyObject *kwds)
 
     pa = (pyArrayObject *)type->tp_alloc(type, 0);
     pa->arr = a;
+    ARRAY_TRACE_END("py.array");
     return (PyObject *)pa;
 
 fail:
@@ -57,19 +76,167 @@ fail:
 static PyObject *
 py_array_str(pyArrayObject *pa)
 {
-    return PyUnicode_FromString(array_str(pa->arr));
+    ARRAY_TRACE_BEGIN("py.str", pa->arr->dtype, pa->arr->dims, NULL);
+    char *buf = array_str(pa->arr);
+    if (buf == NULL) {
+        ARRAY_TRACE_END("py.str");
+        return PyErr_NoMemory();
+    }
+    PyObject *ret = PyUnicode_FromString(buf);
+    free(buf);
+    ARRAY_TRACE_END("py.str");
+    return ret;
+}
+
+/*
+ * Pins mark arrays read by a kernel running without the GIL, either
+ * synchronously or on the async executor. They are only touched with the
+ * GIL held.
+ */
+static int
+py_array_check_unpinned(pyArrayObject *pa)
+{
+    if (pa->pins > 0) {
+        PyErr_SetString(PyExc_RuntimeError,
+            "Cannot modify an array in use by an asynchronous operation");
+        return 1;
+    }
+    return 0;
+}
+
+static PyObject *
+py_array_wrap(PyTypeObject *type, arrayObject *arr)
+{
+    pyArrayObject *ret = (pyArrayObject *)type->tp_alloc(type, 0);
+    if (ret == NULL) {
+        array_free(arr);
+        return NULL;
+    }
+    ret->arr = arr;
+    return (PyObject *)ret;
+}
+
+static arrayObject *
+py_array_run_sum(pyArrayObject *pa, int axis)
+{
+    arrayObject *ret;
+    pa->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret = array_sum(pa->arr, axis);
+    Py_END_ALLOW_THREADS
+    pa->pins--;
+    return ret;
+}
+
+static arrayObject *
+py_array_run_dot(pyArrayObject *pa, pyArrayObject *pb)
+{
+    arrayObject *ret;
+    pa->pins++;
+    pb->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret = array_dot(pa->arr, pb->arr);
+    Py_END_ALLOW_THREADS
+    pb->pins--;
+    pa->pins--;
+    return ret;
+}
+
+/* Raises the error behind a failed array_dot of pa and pb. */
+static PyObject *
+py_dot_error(pyArrayObject *pa, pyArrayObject *pb)
+{
+    if (pa->arr->dims[1] != pb->arr->dims[0] || pa->arr->dtype != pb->arr->dtype) {
+        PyErr_SetString(PyExc_ValueError, "Dot product failed");
+        return NULL;
+    }
+    return PyErr_NoMemory();
+}
+
+/*
+ * Graph capture: while a Graph is capturing, dot and sum calls made on the
+ * capturing thread are recorded into it after running eagerly. Arrays the
+ * ops produce are kept and pinned for the graph's lifetime, since replay
+ * writes into them; external operands are pinned until capture ends so
+ * their layout stays the one recorded.
+ */
+typedef struct pyGraphObject {
+    PyObject_HEAD
+    arrayGraph *graph;
+    PyObject *inputs;      // list of captured input arrays, in input order
+    PyObject *outputs;     // list of arrays written by the recorded ops
+    arrayObject **bound;   // replay bindings, one per input
+    int capturing;
+    int replaying;
+} pyGraphObject;
+
+static pyGraphObject *capture_graph = NULL;
+static unsigned long capture_thread = 0;
+
+static void
+py_pin_list(PyObject *list, int delta)
+{
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(list); i++) {
+        ((pyArrayObject *)PyList_GET_ITEM(list, i))->pins += delta;
+    }
+}
+
+static int
+py_graph_add_input(pyGraphObject *g, pyArrayObject *pa)
+{
+    int i = array_graph_find_input(g->graph, pa->arr);
+    if (i < 0 || i < PyList_GET_SIZE(g->inputs)) {
+        return 0;
+    }
+    if (PyList_Append(g->inputs, (PyObject *)pa)) {
+        return 1;
+    }
+    pa->pins++;
+    return 0;
+}
+
+/* Records op if a capture is running on this thread; out is the result. */
+static int
+py_graph_record(GRAPH_OP op, pyArrayObject *pa, pyArrayObject *pb, int axis, PyObject *out)
+{
+    pyGraphObject *g = capture_graph;
+    if (g == NULL || PyThread_get_thread_ident() != capture_thread) {
+        return 0;
+    }
+
+    arrayObject *ret_arr = ((pyArrayObject *)out)->arr;
+    int err = op == GRAPH_DOT
+        ? array_graph_record_dot(g->graph, pa->arr, pb->arr, ret_arr)
+        : array_graph_record_sum(g->graph, pa->arr, axis, ret_arr);
+    if (err) {
+        PyErr_NoMemory();
+        return 1;
+    }
+    if (py_graph_add_input(g, pa) || (pb && py_graph_add_input(g, pb)) ||
+        PyList_Append(g->outputs, out)) {
+        return 1;
+    }
+    ((pyArrayObject *)out)->pins++;
+    return 0;
 }
 
 static PyObject *
 py_array_ravel(pyArrayObject *pa, PyObject *Py_UNUSED(ignored))
 {
     arrayObject *a = pa->arr;
-    int n = NUM_ARRAY_ELEMS(a);
+    ARRAY_TRACE_BEGIN("py.ravel", a->dtype, a->dims, NULL);
+    int64_t n = NUM_ARRAY_ELEMS(a);
     PyObject *ret = PyList_New(n);
     // TODO: avoid double allocation
-    void *ra = array_ravel(a);
+    void *ra = ret ? array_ravel(a) : NULL;
+    if (ra == NULL) {
+        ARRAY_TRACE_END("py.ravel");
+        Py_XDECREF(ret);
+        return PyErr_NoMemory();
+    }
     fill_py_list_from_buf(ret, ra, n, a->dtype);
-    free(ra);
+    array_data_free(ra);
+    ARRAY_TRACE_END("py.ravel");
     return ret;
 }
 
@@ -79,6 +246,9 @@ py_array_transpose(pyArrayObject *pa, PyObject *perm)
     arrayObject *a = pa->arr;
     arrayDims dims = {NULL, 0};
 
+    if (py_array_check_unpinned(pa)) {
+        return NULL;
+    }
     if (!py_seq_to_intp(perm, &dims)) {
         return NULL;
     }
@@ -89,15 +259,17 @@ py_array_transpose(pyArrayObject *pa, PyObject *perm)
         goto fail;
     }
 
+    int perm_axes[ARRAY_NUM_DIMS];
     for (int i = 0; i < dims.len; i++) {
         if (dims.ptr[i] < 0 || dims.ptr[i] >= a->nd) {
             PyErr_SetString(PyExc_ValueError,
                 "Permutation values must be in [0, a->nd)");
             goto fail;
         }
+        perm_axes[i] = (int)dims.ptr[i];
     }
 
-    array_transpose(a, dims.ptr);
+    array_transpose(a, perm_axes);
     free(dims.ptr);
     Py_RETURN_NONE;
 
@@ -106,200 +278,2424 @@ fail:
     return NULL;
 }
 
-static PyObject *
-py_array_sum(pyArrayObject *pa, PyObject *pyAxis)
+static int
+py_parse_sum_axis(pyArrayObject *pa, PyObject *pyAxis, int *axis)
 {
-
-    arrayObject *a = pa->arr;
-    arrayObject *ret_arr = NULL;
-    pyArrayObject *ret = NULL;
-    PyTypeObject *type = NULL;
-
     if (!PyLong_Check(pyAxis)) {
         PyErr_SetString(PyExc_TypeError,
             "Axis argument must be an integer");
-        return NULL;
+        return 1;
     }
 
-    int axis = PyLong_AsLong(pyAxis);
-    if (axis < 0 || axis >= a->nd) {
+    *axis = PyLong_AsLong(pyAxis);
+    if (*axis < 0 || *axis >= pa->arr->nd) {
         PyErr_SetString(PyExc_ValueError,
             "Axis argument must be in [0, a->nd)");
+        return 1;
+    }
+    return 0;
+}
+
+static PyObject *
+py_array_sum(pyArrayObject *pa, PyObject *pyAxis)
+{
+    arrayObject *ret_arr = NULL;
+    int axis;
+
+    if (py_parse_sum_axis(pa, pyAxis, &axis)) {
         return NULL;
     }
 
-    ret_arr = array_sum(a, axis);
+    ARRAY_TRACE_BEGIN("py.sum", pa->arr->dtype, pa->arr->dims, NULL);
+    ret_arr = py_array_run_sum(pa, axis);
+    ARRAY_TRACE_END("py.sum");
     if (ret_arr == NULL) {
         PyErr_SetString(PyExc_ValueError, "Sum failed");
         return NULL;
     }
+    PyObject *ret = py_array_wrap(Py_TYPE(pa), ret_arr);
+    if (ret && py_graph_record(GRAPH_SUM, pa, NULL, axis, ret)) {
+        Py_CLEAR(ret);
+    }
+    return ret;
+}
 
-    type = Py_TYPE(pa);
-    ret = (pyArrayObject *)type->tp_alloc(type, 0);
-    ret->arr = ret_arr;
-    return (PyObject *)ret;
+static int
+py_axis_to_mask(PyObject *obj, int nd, int *mask)
+{
+    if (!PyLong_Check(obj)) {
+        PyErr_SetString(PyExc_TypeError, "Axes must be integers");
+        return 1;
+    }
+    long ax = PyLong_AsLong(obj);
+    if (ax < 0) ax += nd;
+    if (ax < 0 || ax >= nd || (*mask & (1 << ax))) {
+        if (!PyErr_Occurred()) {
+            PyErr_SetString(PyExc_ValueError, "Axis out of range or repeated");
+        }
+        return 1;
+    }
+    *mask |= 1 << ax;
+    return 0;
+}
+
+/* Converts None, an int or a sequence of ints into a bitmask of axes. */
+static int
+py_axes_to_mask(PyObject *axis, int nd, int *mask)
+{
+    *mask = 0;
+    if (axis == Py_None) {
+        *mask = (1 << nd) - 1;
+        return 0;
+    }
+    if (PyLong_Check(axis)) {
+        return py_axis_to_mask(axis, nd, mask);
+    }
+
+    PyObject *seq = PySequence_Fast(axis, "axis must be None, an int or a sequence");
+    if (seq == NULL) {
+        return 1;
+    }
+    int ret = 0;
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq) && !ret; i++) {
+        ret = py_axis_to_mask(PySequence_Fast_GET_ITEM(seq, i), nd, mask);
+    }
+    Py_DECREF(seq);
+    if (!ret && *mask == 0) {
+        PyErr_SetString(PyExc_ValueError, "At least one axis must be reduced");
+        ret = 1;
+    }
+    return ret;
 }
 
 static PyObject *
-py_array_dot(pyArrayObject *pa, PyObject *b)
+py_array_reduce(pyArrayObject *pa, PyObject *args, PyObject *kwds)
 {
+    static char *kwlist[] = {"op", "axis", "keepdims", NULL};
     arrayObject *a = pa->arr;
     arrayObject *ret_arr = NULL;
-    pyArrayObject *ret = NULL;
-    PyTypeObject *type = NULL;
+    const char *op_name;
+    PyObject *axis = Py_None;
+    int keepdims = 0;
+    int mask;
+    int op;
 
-    if (Py_TYPE(b) != Py_TYPE(pa)) {
-        PyErr_SetString(PyExc_TypeError, "Expected array argument");
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|Op", kwlist,
+                                     &op_name, &axis, &keepdims)) {
+        return NULL;
+    }
+    for (op = 0; op < NUM_REDUCE_OPS; op++) {
+        if (!strcmp(op_name, REDUCE_OP_NAMES[op])) break;
+    }
+    if (op == NUM_REDUCE_OPS) {
+        PyErr_Format(PyExc_ValueError, "Unknown reduction %s", op_name);
+        return NULL;
+    }
+    if (py_axes_to_mask(axis, a->nd, &mask)) {
         return NULL;
     }
 
-    ret_arr = array_dot(a, ((pyArrayObject *)b)->arr);
+    ARRAY_TRACE_BEGIN("py.reduce", a->dtype, a->dims, NULL);
+    ret_arr = array_reduce(a, op, mask, keepdims);
+    ARRAY_TRACE_END("py.reduce");
     if (ret_arr == NULL) {
-        PyErr_SetString(PyExc_ValueError, "Dot product failed");
-        return NULL;
+        // Axes were validated above, so only a zero-size min/max/mean or
+        // running out of memory fails.
+        if (NUM_ARRAY_ELEMS(a) == 0 && op != REDUCE_SUM && op != REDUCE_NANSUM &&
+            op != REDUCE_PROD) {
+            PyErr_Format(PyExc_ValueError, "Reduction %s failed", op_name);
+            return NULL;
+        }
+        return PyErr_NoMemory();
     }
 
-    type = Py_TYPE(pa);
-    ret = (pyArrayObject *)type->tp_alloc(type, 0);
-    ret->arr = ret_arr;
-    return (PyObject *)ret;
+    // Reducing every axis without keepdims gives a scalar, as in NumPy.
+    if (axis == Py_None && !keepdims) {
+        PyObject *list = PyList_New(1);
+        PyObject *val = NULL;
+        if (list) {
+            fill_py_list_from_buf(list, ret_arr->data, 1, ret_arr->dtype);
+            val = PyList_GET_ITEM(list, 0);
+            Py_XINCREF(val);
+            Py_DECREF(list);
+        }
+        array_free(ret_arr);
+        return val;
+    }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
 }
 
 static PyObject *
-py_array_ones(pyArrayObject *pa, PyObject *Py_UNUSED(ignored))
+py_array_scan(pyArrayObject *pa, PyObject *args, PyObject *kwds)
 {
+    static char *kwlist[] = {"op", "axis", NULL};
     arrayObject *a = pa->arr;
     arrayObject *ret_arr = NULL;
-    PyTypeObject *type = NULL;
-    pyArrayObject *ret = NULL;
+    const char *op_name;
+    PyObject *axis_obj = Py_None;
+    int axis = -1;
+    int op;
 
-    ret_arr = array_copy(a);
-    if (ret_arr == NULL) {
-        PyErr_SetString(PyExc_ValueError, "Array copy failed");
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O", kwlist, &op_name, &axis_obj)) {
         return NULL;
     }
+    for (op = 0; op < NUM_SCAN_OPS; op++) {
+        if (!strcmp(op_name, SCAN_OP_NAMES[op])) break;
+    }
+    if (op == NUM_SCAN_OPS) {
+        PyErr_Format(PyExc_ValueError, "Unknown scan %s", op_name);
+        return NULL;
+    }
+    if (axis_obj != Py_None) {
+        int mask = 0;
+        if (py_axis_to_mask(axis_obj, a->nd, &mask)) {
+            return NULL;
+        }
+        axis = mask == 1 ? 0 : 1;
+    }
 
-    double one = 1;
-    buf_fill_val(ret_arr->data, one, NUM_ARRAY_ELEMS(a), a->dtype);
-
-    type = Py_TYPE(pa);
-    ret = (pyArrayObject *)type->tp_alloc(type, 0);
-    ret->arr = ret_arr;
-    return (PyObject *)ret;
+    ARRAY_TRACE_BEGIN("py.scan", a->dtype, a->dims, NULL);
+    ret_arr = array_scan(a, op, axis);
+    ARRAY_TRACE_END("py.scan");
+    if (ret_arr == NULL) {
+        PyErr_Format(PyExc_ValueError, "Scan %s failed", op_name);
+        return NULL;
+    }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
 }
 
 static PyObject *
-py_array_randint(pyArrayObject *pa, PyObject *args)
+py_array_unary(pyArrayObject *pa, PyObject *args, PyObject *kwds)
 {
+    static char *kwlist[] = {"op", "out", NULL};
     arrayObject *a = pa->arr;
     arrayObject *ret_arr = NULL;
-    PyTypeObject *type = NULL;
-    pyArrayObject *ret = NULL;
+    const char *op_name;
+    PyObject *out_obj = Py_None;
+    pyArrayObject *out = NULL;
+    int op;
 
-    int low;
-    int high;
-    if (!PyArg_ParseTuple(args, "ii", &low, &high)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O", kwlist, &op_name, &out_obj)) {
         return NULL;
     }
-
-    if (high <= low) {
-        PyErr_SetString(PyExc_ValueError, "High must be greater than low");
+    for (op = 0; op < NUM_UNARY_OPS; op++) {
+        if (!strcmp(op_name, UNARY_OP_NAMES[op])) break;
+    }
+    if (op == NUM_UNARY_OPS) {
+        PyErr_Format(PyExc_ValueError, "Unknown function %s", op_name);
+        return NULL;
+    }
+    if (a->dtype != FLOAT && a->dtype != DOUBLE) {
+        PyErr_Format(PyExc_TypeError, "%s expects a float or double array", op_name);
         return NULL;
     }
+    if (out_obj != Py_None) {
+        if (Py_TYPE(out_obj) != Py_TYPE(pa)) {
+            PyErr_SetString(PyExc_TypeError, "Expected array out");
+            return NULL;
+        }
+        out = (pyArrayObject *)out_obj;
+        if (out->arr->dtype != a->dtype || out->arr->dims[0] != a->dims[0] ||
+            out->arr->dims[1] != a->dims[1]) {
+            PyErr_SetString(PyExc_ValueError, "out must match the input dtype and dims");
+            return NULL;
+        }
+        if (py_array_check_unpinned(out)) {
+            return NULL;
+        }
+    }
 
-    ret_arr = array_copy(a);
+    ARRAY_TRACE_BEGIN("py.unary", a->dtype, a->dims, NULL);
+    pa->pins++;
+    if (out) out->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret_arr = array_unary(a, op, out ? out->arr : NULL);
+    Py_END_ALLOW_THREADS
+    if (out) out->pins--;
+    pa->pins--;
+    ARRAY_TRACE_END("py.unary");
     if (ret_arr == NULL) {
-        PyErr_SetString(PyExc_ValueError, "Array copy failed");
+        return PyErr_NoMemory();
+    }
+    if (out) {
+        Py_INCREF(out);
+        return (PyObject *)out;
+    }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
+}
+
+/* self += alpha * x, in place; returns self. */
+static PyObject *
+py_array_axpy(pyArrayObject *pa, PyObject *args)
+{
+    double alpha;
+    PyObject *x_obj;
+
+    if (!PyArg_ParseTuple(args, "dO", &alpha, &x_obj)) {
+        return NULL;
+    }
+    if (Py_TYPE(x_obj) != Py_TYPE(pa)) {
+        PyErr_SetString(PyExc_TypeError, "Expected array argument");
+        return NULL;
+    }
+    pyArrayObject *x = (pyArrayObject *)x_obj;
+    if (x->arr->dtype != pa->arr->dtype || x->arr->dims[0] != pa->arr->dims[0] ||
+        x->arr->dims[1] != pa->arr->dims[1]) {
+        PyErr_SetString(PyExc_ValueError, "axpy operands must have the same dtype and dims");
+        return NULL;
+    }
+    if (py_array_check_unpinned(pa)) {
         return NULL;
     }
 
-    buf_fill_uniform_int(ret_arr->data, low, high, NUM_ARRAY_ELEMS(a), a->dtype);
+    ARRAY_TRACE_BEGIN("py.axpy", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    x->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    array_axpy(pa->arr, alpha, x->arr);
+    Py_END_ALLOW_THREADS
+    x->pins--;
+    pa->pins--;
+    ARRAY_TRACE_END("py.axpy");
+    Py_INCREF(pa);
+    return (PyObject *)pa;
+}
 
-    type = Py_TYPE(pa);
-    ret = (pyArrayObject *)type->tp_alloc(type, 0);
-    ret->arr = ret_arr;
-    return (PyObject *)ret;
+/* self *= alpha, in place; returns self. */
+static PyObject *
+py_array_scal(pyArrayObject *pa, PyObject *args)
+{
+    double alpha;
+
+    if (!PyArg_ParseTuple(args, "d", &alpha)) {
+        return NULL;
+    }
+    if (py_array_check_unpinned(pa)) {
+        return NULL;
+    }
+
+    ARRAY_TRACE_BEGIN("py.scal", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    array_scal(pa->arr, alpha);
+    Py_END_ALLOW_THREADS
+    pa->pins--;
+    ARRAY_TRACE_END("py.scal");
+    Py_INCREF(pa);
+    return (PyObject *)pa;
 }
 
 static PyObject *
-py_array_get_dtype(pyArrayObject *a)
+py_array_asum(pyArrayObject *pa, PyObject *Py_UNUSED(ignored))
 {
-    return PyLong_FromLong(a->arr->dtype);
+    double ret;
+
+    ARRAY_TRACE_BEGIN("py.asum", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret = array_asum(pa->arr);
+    Py_END_ALLOW_THREADS
+    pa->pins--;
+    ARRAY_TRACE_END("py.asum");
+    return PyFloat_FromDouble(ret);
 }
 
 static PyObject *
-py_array_get_nd(pyArrayObject *a)
+py_array_nrm2(pyArrayObject *pa, PyObject *Py_UNUSED(ignored))
 {
-    return PyLong_FromLong(a->arr->nd);
+    double ret;
+
+    ARRAY_TRACE_BEGIN("py.nrm2", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret = array_nrm2(pa->arr);
+    Py_END_ALLOW_THREADS
+    pa->pins--;
+    ARRAY_TRACE_END("py.nrm2");
+    return PyFloat_FromDouble(ret);
 }
 
 static PyObject *
-py_array_get_dims(pyArrayObject *a)
+py_array_iamax(pyArrayObject *pa, PyObject *Py_UNUSED(ignored))
 {
-    return py_tup_from_intp(a->arr->dims, a->arr->nd);
+    int64_t ret;
+
+    ARRAY_TRACE_BEGIN("py.iamax", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret = array_iamax(pa->arr);
+    Py_END_ALLOW_THREADS
+    pa->pins--;
+    ARRAY_TRACE_END("py.iamax");
+    return PyLong_FromLongLong(ret);
 }
 
 static PyObject *
-py_array_get_strides(pyArrayObject *a)
+py_array_dot(pyArrayObject *pa, PyObject *b)
 {
-    return py_tup_from_intp(a->arr->strides, a->arr->nd);
+    arrayObject *ret_arr = NULL;
+
+    if (Py_TYPE(b) != Py_TYPE(pa)) {
+        PyErr_SetString(PyExc_TypeError, "Expected array argument");
+        return NULL;
+    }
+
+    ARRAY_TRACE_BEGIN("py.dot", pa->arr->dtype, pa->arr->dims,
+                      ((pyArrayObject *)b)->arr->dims);
+    ret_arr = py_array_run_dot(pa, (pyArrayObject *)b);
+    ARRAY_TRACE_END("py.dot");
+    if (ret_arr == NULL) {
+        return py_dot_error(pa, (pyArrayObject *)b);
+    }
+    PyObject *ret = py_array_wrap(Py_TYPE(pa), ret_arr);
+    if (ret && py_graph_record(GRAPH_DOT, pa, (pyArrayObject *)b, 0, ret)) {
+        Py_CLEAR(ret);
+    }
+    return ret;
 }
 
-static PyGetSetDef py_array_getsetters[] = {
-    {"dtype", (getter)py_array_get_dtype, NULL, NULL, NULL},
-    {"nd", (getter)py_array_get_nd, NULL, NULL, NULL},
-    {"dims", (getter)py_array_get_dims, NULL, NULL, NULL},
-    {"strides", (getter)py_array_get_strides, NULL, NULL, NULL},
-    {NULL},
-};
+/*
+ * dot_async/sum_async hand a worker to an executor's submit() and return
+ * the concurrent.futures.Future it gives back. The executor is a lazily
+ * created ThreadPoolExecutor unless set_async_executor() installed another.
+ * Operands are pinned from submission until the worker finishes, or until
+ * the future is cancelled before the worker starts.
+ */
+static PyObject *async_executor = NULL;
+static PyObject *async_dot_worker = NULL;
+static PyObject *async_sum_worker = NULL;
 
-static PyMethodDef py_array_methods[] = {
-    {"ravel", (PyCFunction)py_array_ravel, METH_NOARGS, NULL},
-    {"transpose", (PyCFunction)py_array_transpose, METH_O, NULL},
-    {"sum", (PyCFunction)py_array_sum, METH_O, NULL},
-    {"dot", (PyCFunction)py_array_dot, METH_O, NULL},
-    {"ones", (PyCFunction)py_array_ones, METH_NOARGS, NULL},
-    {"randint", (PyCFunction)py_array_randint, METH_VARARGS, NULL},
-    {NULL, NULL, 0, NULL},
-};
+static void
+py_pin_operands(PyObject *operands, int delta)
+{
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(operands); i++) {
+        ((pyArrayObject *)PyTuple_GET_ITEM(operands, i))->pins += delta;
+    }
+}
 
-static PyTypeObject ArrayType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    .tp_name = "minumpy.array",
-    .tp_doc = "Minumpy ndarray",
-    .tp_basicsize = sizeof(pyArrayObject),
-    .tp_itemsize = 0,
-    .tp_flags = Py_TPFLAGS_DEFAULT,
-    .tp_new = py_array_alloc,
-    .tp_dealloc = (destructor) py_array_dealloc,
-    .tp_getset = py_array_getsetters,
-    .tp_methods = py_array_methods,
-    .tp_str = (reprfunc) py_array_str
-};
+static PyObject *
+py_async_dot(PyObject *self, PyObject *args)
+{
+    pyArrayObject *pa, *pb;
+    if (!PyArg_ParseTuple(args, "OO", &pa, &pb)) {
+        return NULL;
+    }
 
-static struct PyModuleDef minarraydef = {
-    PyModuleDef_HEAD_INIT,
-    .m_name = "minarray",
-    .m_doc = "",
-    .m_size = -1,
-};
+    ARRAY_TRACE_BEGIN("py.dot_async", pa->arr->dtype, pa->arr->dims, pb->arr->dims);
+    arrayObject *ret_arr = py_array_run_dot(pa, pb);
+    ARRAY_TRACE_END("py.dot_async");
+    pb->pins--;
+    pa->pins--;
+    if (ret_arr == NULL) {
+        return py_dot_error(pa, pb);
+    }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
+}
 
-PyMODINIT_FUNC
-PyInit_minarray(void)
+static PyObject *
+py_async_sum(PyObject *self, PyObject *args)
 {
-    PyObject *ret;
-    if (PyType_Ready(&ArrayType) < 0) {
+    pyArrayObject *pa;
+    int axis;
+    if (!PyArg_ParseTuple(args, "Oi", &pa, &axis)) {
         return NULL;
     }
 
-    ret = PyModule_Create(&minarraydef);
-    if (ret == NULL) {
+    ARRAY_TRACE_BEGIN("py.sum_async", pa->arr->dtype, pa->arr->dims, NULL);
+    arrayObject *ret_arr = py_array_run_sum(pa, axis);
+    ARRAY_TRACE_END("py.sum_async");
+    pa->pins--;
+    if (ret_arr == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Sum failed");
         return NULL;
     }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
+}
 
-    Py_INCREF(&ArrayType);
-    if (PyModule_AddObject(ret, "array", (PyObject *)&ArrayType) < 0) {
-        Py_DECREF(&ArrayType);
+// Done callback bound to the operand tuple; a worker that never ran unpins here.
+static PyObject *
+py_async_release(PyObject *operands, PyObject *future)
+{
+    PyObject *cancelled = PyObject_CallMethod(future, "cancelled", NULL);
+    if (cancelled == NULL) {
+        return NULL;
+    }
+    if (cancelled == Py_True) {
+        py_pin_operands(operands, -1);
+    }
+    Py_DECREF(cancelled);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef async_dot_def = {"_async_dot", py_async_dot, METH_VARARGS, NULL};
+static PyMethodDef async_sum_def = {"_async_sum", py_async_sum, METH_VARARGS, NULL};
+static PyMethodDef async_release_def = {"_async_release", py_async_release, METH_O, NULL};
+
+static PyObject *
+py_async_get_executor(void)
+{
+    if (async_executor == NULL) {
+        PyObject *mod = PyImport_ImportModule("concurrent.futures");
+        if (mod == NULL) {
+            return NULL;
+        }
+        async_executor = PyObject_CallMethod(mod, "ThreadPoolExecutor", NULL);
+        Py_DECREF(mod);
+    }
+    return async_executor;
+}
+
+/*
+ * Submits worker(*args) with the arrays in operands pinned. Returns a new
+ * reference to the future.
+ */
+static PyObject *
+py_async_submit(PyObject *worker, PyObject *args, PyObject *operands)
+{
+    PyObject *executor = py_async_get_executor();
+    if (executor == NULL) {
+        return NULL;
+    }
+
+    PyObject *submit_args = PyTuple_New(PyTuple_GET_SIZE(args) + 1);
+    if (submit_args == NULL) {
+        return NULL;
+    }
+    Py_INCREF(worker);
+    PyTuple_SET_ITEM(submit_args, 0, worker);
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(args); i++) {
+        PyObject *v = PyTuple_GET_ITEM(args, i);
+        Py_INCREF(v);
+        PyTuple_SET_ITEM(submit_args, i + 1, v);
+    }
+
+    // Pin before submitting: a worker thread may start and unpin right away.
+    py_pin_operands(operands, 1);
+    PyObject *submit = PyObject_GetAttrString(executor, "submit");
+    PyObject *future = submit ? PyObject_Call(submit, submit_args, NULL) : NULL;
+    Py_XDECREF(submit);
+    Py_DECREF(submit_args);
+    if (future == NULL) {
+        py_pin_operands(operands, -1);
+        return NULL;
+    }
+
+    PyObject *release = PyCFunction_New(&async_release_def, operands);
+    PyObject *r = release
+        ? PyObject_CallMethod(future, "add_done_callback", "O", release)
+        : NULL;
+    Py_XDECREF(release);
+    if (r == NULL) {
+        Py_DECREF(future);
+        return NULL;
+    }
+    Py_DECREF(r);
+    return future;
+}
+
+static PyObject *
+py_array_dot_async(pyArrayObject *pa, PyObject *b)
+{
+    if (Py_TYPE(b) != Py_TYPE(pa)) {
+        PyErr_SetString(PyExc_TypeError, "Expected array argument");
+        return NULL;
+    }
+
+    PyObject *args = PyTuple_Pack(2, (PyObject *)pa, b);
+    if (args == NULL) {
+        return NULL;
+    }
+    PyObject *ret = py_async_submit(async_dot_worker, args, args);
+    Py_DECREF(args);
+    return ret;
+}
+
+static PyObject *
+py_array_sum_async(pyArrayObject *pa, PyObject *pyAxis)
+{
+    int axis;
+    if (py_parse_sum_axis(pa, pyAxis, &axis)) {
+        return NULL;
+    }
+
+    PyObject *args = Py_BuildValue("(Oi)", (PyObject *)pa, axis);
+    PyObject *operands = PyTuple_Pack(1, (PyObject *)pa);
+    PyObject *ret = NULL;
+    if (args != NULL && operands != NULL) {
+        ret = py_async_submit(async_sum_worker, args, operands);
+    }
+    Py_XDECREF(args);
+    Py_XDECREF(operands);
+    return ret;
+}
+
+static PyObject *
+py_array_copy(pyArrayObject *pa, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"order", NULL};
+    arrayObject *a = pa->arr;
+    arrayObject *ret_arr = NULL;
+    int order = 'C';
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|C", kwlist, &order)) {
+        return NULL;
+    }
+    if (order != 'C' && order != 'F' && order != 'K') {
+        PyErr_SetString(PyExc_ValueError, "order must be one of 'C', 'F' or 'K'");
+        return NULL;
+    }
+
+    ret_arr = array_copy_order(a, (char)order);
+    if (ret_arr == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Array copy failed");
+        return NULL;
+    }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
+}
+
+static PyObject *
+py_array_ones(pyArrayObject *pa, PyObject *Py_UNUSED(ignored))
+{
+    arrayObject *a = pa->arr;
+    arrayObject *ret_arr = NULL;
+
+    ret_arr = array_full(a->dims, a->nd, 1, a->dtype);
+    if (ret_arr == NULL) {
+        return PyErr_NoMemory();
+    }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
+}
+
+static PyObject *
+py_array_randint(pyArrayObject *pa, PyObject *args)
+{
+    arrayObject *a = pa->arr;
+    arrayObject *ret_arr = NULL;
+
+    int low;
+    int high;
+    if (!PyArg_ParseTuple(args, "ii", &low, &high)) {
+        return NULL;
+    }
+
+    if (high <= low) {
+        PyErr_SetString(PyExc_ValueError, "High must be greater than low");
+        return NULL;
+    }
+
+    ret_arr = array_empty(a->dims, a->nd, a->dtype);
+    if (ret_arr == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    buf_fill_uniform_int(ret_arr->data, low, high, NUM_ARRAY_ELEMS(a), a->dtype);
+
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
+}
+
+/* The element at ptr as a Python int or float. */
+static PyObject *
+py_scalar_from_buf(const char *ptr, ARRAY_DTYPE dtype)
+{
+    switch (dtype) {
+    case INT32: return PyLong_FromLong(*(const int32_t *)ptr);
+    case INT64: return PyLong_FromLongLong(*(const int64_t *)ptr);
+    case FLOAT: return PyFloat_FromDouble(*(const float *)ptr);
+    case DOUBLE: return PyFloat_FromDouble(*(const double *)ptr);
+    default: break;
+    }
+    PyErr_SetString(PyExc_ValueError, "Unknown dtype");
+    return NULL;
+}
+
+/* Stores the int or float v at ptr, converted as by array(). */
+static int
+py_scalar_to_buf(char *ptr, PyObject *v, ARRAY_DTYPE dtype)
+{
+    if (PyLong_Check(v) && (dtype == INT32 || dtype == INT64)) {
+        long long x = PyLong_AsLongLong(v);
+        if (x == -1 && PyErr_Occurred()) {
+            return 1;
+        }
+        if (dtype == INT32) {
+            *(int32_t *)ptr = (int32_t)x;
+        } else {
+            *(int64_t *)ptr = (int64_t)x;
+        }
+        return 0;
+    }
+    if (!PyLong_Check(v) && !PyFloat_Check(v)) {
+        PyErr_SetString(PyExc_TypeError, "Expected an int or float value");
+        return 1;
+    }
+    double x = PyFloat_AsDouble(v);
+    if (x == -1 && PyErr_Occurred()) {
+        return 1;
+    }
+    buf_fill_val(ptr, x, 1, dtype);
+    return 0;
+}
+
+/*
+ * Parses an (i, j) key into the element offset of a, returning 1 with
+ * IndexError set when out of range, or -1 when key is not a pair of ints.
+ */
+static int
+py_parse_elem_key(const arrayObject *a, PyObject *key, int64_t *offset)
+{
+    if (!PyTuple_Check(key) || PyTuple_GET_SIZE(key) != 2 ||
+        !PyLong_Check(PyTuple_GET_ITEM(key, 0)) || !PyLong_Check(PyTuple_GET_ITEM(key, 1))) {
+        return -1;
+    }
+    long long i = PyLong_AsLongLong(PyTuple_GET_ITEM(key, 0));
+    long long j = PyLong_AsLongLong(PyTuple_GET_ITEM(key, 1));
+    if (PyErr_Occurred() || array_index(a, i, j, offset)) {
+        PyErr_Clear();
+        PyErr_Format(PyExc_IndexError, "Index (%lld, %lld) out of range for dims "
+                     "(%lld, %lld)", i, j, (long long)a->dims[0], (long long)a->dims[1]);
+        return 1;
+    }
+    return 0;
+}
+
+static int
+py_check_index_array(PyObject *obj, PyTypeObject *type)
+{
+    if (Py_TYPE(obj) != type) {
+        PyErr_SetString(PyExc_TypeError, "Expected an array of indices");
+        return 1;
+    }
+    ARRAY_DTYPE dtype = ((pyArrayObject *)obj)->arr->dtype;
+    if (dtype != INT32 && dtype != INT64) {
+        PyErr_SetString(PyExc_IndexError, "Index arrays must be INT32 or INT64");
+        return 1;
+    }
+    return 0;
+}
+
+/* None indexes the flattening (-1); 0, 1 and -2, -1 pick an axis. */
+static int
+py_parse_index_axis(PyObject *obj, int *axis)
+{
+    if (obj == Py_None) {
+        *axis = -1;
+        return 0;
+    }
+    long ax = PyLong_Check(obj) ? PyLong_AsLong(obj) : 3;
+    if (ax < 0) ax += ARRAY_NUM_DIMS;
+    if (ax < 0 || ax >= ARRAY_NUM_DIMS) {
+        if (!PyErr_Occurred()) {
+            PyErr_SetString(PyExc_ValueError, "axis must be None, 0 or 1");
+        }
+        return 1;
+    }
+    *axis = (int)ax;
+    return 0;
+}
+
+/*
+ * The values operand of put and putmask: an array of a's dtype, or an int
+ * or float held in the one-element *tmp, which the caller frees.
+ */
+static arrayObject *
+py_values_array(pyArrayObject *pa, PyObject *values, arrayObject **tmp)
+{
+    *tmp = NULL;
+    if (Py_TYPE(values) == Py_TYPE(pa)) {
+        return ((pyArrayObject *)values)->arr;
+    }
+    int64_t one[] = {1, 1};
+    *tmp = array_empty(one, ARRAY_NUM_DIMS, pa->arr->dtype);
+    if (*tmp == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    if (py_scalar_to_buf((*tmp)->data, values, pa->arr->dtype)) {
+        array_free(*tmp);
+        *tmp = NULL;
+        return NULL;
+    }
+    return *tmp;
+}
+
+static PyObject *
+py_array_run_take(pyArrayObject *pa, pyArrayObject *idx, int axis)
+{
+    arrayObject *ret_arr = NULL;
+    int bad;
+    ARRAY_TRACE_BEGIN("py.take", pa->arr->dtype, pa->arr->dims, idx->arr->dims);
+    pa->pins++;
+    idx->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    bad = array_check_indices(pa->arr, idx->arr, axis);
+    if (!bad) ret_arr = array_take(pa->arr, idx->arr, axis);
+    Py_END_ALLOW_THREADS
+    idx->pins--;
+    pa->pins--;
+    ARRAY_TRACE_END("py.take");
+    if (bad) {
+        PyErr_SetString(PyExc_IndexError, "Index out of range");
+        return NULL;
+    }
+    if (ret_arr == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
+}
+
+static int
+py_array_run_put(pyArrayObject *pa, pyArrayObject *idx, PyObject *values, int axis)
+{
+    arrayObject *tmp;
+    int failed;
+
+    if (py_array_check_unpinned(pa)) {
+        return 1;
+    }
+    arrayObject *vals = py_values_array(pa, values, &tmp);
+    if (vals == NULL) {
+        return 1;
+    }
+    if (vals->dtype != pa->arr->dtype) {
+        PyErr_SetString(PyExc_ValueError, "put values must have the dtype of the array");
+        array_free(tmp);
+        return 1;
+    }
+
+    // An array operand is read with the GIL released, so pin it too.
+    pyArrayObject *pv = tmp ? NULL : (pyArrayObject *)values;
+
+    ARRAY_TRACE_BEGIN("py.put", pa->arr->dtype, pa->arr->dims, idx->arr->dims);
+    pa->pins++;
+    idx->pins++;
+    if (pv) pv->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    failed = array_put(pa->arr, idx->arr, vals, axis);
+    Py_END_ALLOW_THREADS
+    if (pv) pv->pins--;
+    idx->pins--;
+    pa->pins--;
+    ARRAY_TRACE_END("py.put");
+    array_free(tmp);
+    if (failed < 0) {
+        PyErr_NoMemory();
+        return 1;
+    }
+    if (failed) {
+        PyErr_SetString(PyExc_IndexError,
+            "Index out of range, or values not shaped like the indexed elements");
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * a[i, j] reads one element without allocating; a[indices] gathers rows,
+ * as a.take(indices, 0).
+ */
+static PyObject *
+py_array_subscript(pyArrayObject *pa, PyObject *key)
+{
+    int64_t offset;
+    int err = py_parse_elem_key(pa->arr, key, &offset);
+    if (err == 0) {
+        return py_scalar_from_buf(pa->arr->data + offset * array_dtype_size(pa->arr->dtype),
+                                  pa->arr->dtype);
+    }
+    if (err > 0) {
+        return NULL;
+    }
+    if (Py_TYPE(key) != Py_TYPE(pa)) {
+        PyErr_SetString(PyExc_TypeError,
+            "Arrays are indexed by an (i, j) pair of ints or an array of row indices");
+        return NULL;
+    }
+    if (py_check_index_array(key, Py_TYPE(pa))) {
+        return NULL;
+    }
+    return py_array_run_take(pa, (pyArrayObject *)key, 0);
+}
+
+static int
+py_array_ass_subscript(pyArrayObject *pa, PyObject *key, PyObject *value)
+{
+    int64_t offset;
+    if (value == NULL) {
+        PyErr_SetString(PyExc_TypeError, "Array elements cannot be deleted");
+        return -1;
+    }
+    if (py_array_check_unpinned(pa)) {
+        return -1;
+    }
+    int err = py_parse_elem_key(pa->arr, key, &offset);
+    if (err == 0) {
+        char *ptr = pa->arr->data + offset * array_dtype_size(pa->arr->dtype);
+        return py_scalar_to_buf(ptr, value, pa->arr->dtype) ? -1 : 0;
+    }
+    if (err > 0) {
+        return -1;
+    }
+    if (Py_TYPE(key) != Py_TYPE(pa)) {
+        PyErr_SetString(PyExc_TypeError,
+            "Arrays are indexed by an (i, j) pair of ints or an array of row indices");
+        return -1;
+    }
+    if (py_check_index_array(key, Py_TYPE(pa))) {
+        return -1;
+    }
+    return py_array_run_put(pa, (pyArrayObject *)key, value, 0) ? -1 : 0;
+}
+
+static PyMappingMethods py_array_as_mapping = {
+    .mp_subscript = (binaryfunc)py_array_subscript,
+    .mp_ass_subscript = (objobjargproc)py_array_ass_subscript,
+};
+
+static PyObject *
+py_array_take(pyArrayObject *pa, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"indices", "axis", NULL};
+    PyObject *indices;
+    PyObject *axis_obj = Py_None;
+    int axis;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &indices, &axis_obj)) {
+        return NULL;
+    }
+    if (py_check_index_array(indices, Py_TYPE(pa)) || py_parse_index_axis(axis_obj, &axis)) {
+        return NULL;
+    }
+    return py_array_run_take(pa, (pyArrayObject *)indices, axis);
+}
+
+static PyObject *
+py_array_put(pyArrayObject *pa, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"indices", "values", "axis", NULL};
+    PyObject *indices;
+    PyObject *values;
+    PyObject *axis_obj = Py_None;
+    int axis;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|O", kwlist,
+                                     &indices, &values, &axis_obj)) {
+        return NULL;
+    }
+    if (py_check_index_array(indices, Py_TYPE(pa)) || py_parse_index_axis(axis_obj, &axis)) {
+        return NULL;
+    }
+    if (py_array_run_put(pa, (pyArrayObject *)indices, values, axis)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static int
+py_check_mask(pyArrayObject *pa, PyObject *mask)
+{
+    if (Py_TYPE(mask) != Py_TYPE(pa)) {
+        PyErr_SetString(PyExc_TypeError, "Expected a mask array");
+        return 1;
+    }
+    const arrayObject *m = ((pyArrayObject *)mask)->arr;
+    if (m->dims[0] != pa->arr->dims[0] || m->dims[1] != pa->arr->dims[1]) {
+        PyErr_SetString(PyExc_ValueError, "Mask must have the dims of the array");
+        return 1;
+    }
+    return 0;
+}
+
+static PyObject *
+py_array_extract(pyArrayObject *pa, PyObject *mask)
+{
+    arrayObject *ret_arr;
+    if (py_check_mask(pa, mask)) {
+        return NULL;
+    }
+    pyArrayObject *pm = (pyArrayObject *)mask;
+
+    ARRAY_TRACE_BEGIN("py.extract", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    pm->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret_arr = array_extract(pa->arr, pm->arr);
+    Py_END_ALLOW_THREADS
+    pm->pins--;
+    pa->pins--;
+    ARRAY_TRACE_END("py.extract");
+    if (ret_arr == NULL) {
+        return PyErr_NoMemory();
+    }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
+}
+
+static PyObject *
+py_array_putmask(pyArrayObject *pa, PyObject *args)
+{
+    PyObject *mask;
+    PyObject *values;
+    arrayObject *tmp;
+    int failed;
+
+    if (!PyArg_ParseTuple(args, "OO", &mask, &values)) {
+        return NULL;
+    }
+    if (py_check_mask(pa, mask) || py_array_check_unpinned(pa)) {
+        return NULL;
+    }
+    arrayObject *vals = py_values_array(pa, values, &tmp);
+    if (vals == NULL) {
+        return NULL;
+    }
+    if (vals->dtype != pa->arr->dtype ||
+        (NUM_ARRAY_ELEMS(vals) != 1 &&
+         (vals->dims[0] != pa->arr->dims[0] || vals->dims[1] != pa->arr->dims[1]))) {
+        PyErr_SetString(PyExc_ValueError,
+            "putmask values must have the dtype and dims of the array, or be a scalar");
+        array_free(tmp);
+        return NULL;
+    }
+    pyArrayObject *pm = (pyArrayObject *)mask;
+    pyArrayObject *pv = tmp ? NULL : (pyArrayObject *)values;
+
+    ARRAY_TRACE_BEGIN("py.putmask", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    pm->pins++;
+    if (pv) pv->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    failed = array_putmask(pa->arr, pm->arr, vals);
+    Py_END_ALLOW_THREADS
+    if (pv) pv->pins--;
+    pm->pins--;
+    pa->pins--;
+    ARRAY_TRACE_END("py.putmask");
+    array_free(tmp);
+    if (failed) {
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
+
+/* Parses the axis of an in-place sort, which has no flattened form. */
+static int
+py_parse_sort_axis(PyObject *obj, int *axis)
+{
+    if (obj == Py_None) {
+        PyErr_SetString(PyExc_ValueError, "In-place sorts need an axis of 0 or 1");
+        return 1;
+    }
+    return py_parse_index_axis(obj, axis);
+}
+
+static int64_t
+py_lane_length(const arrayObject *a, int axis)
+{
+    return axis < 0 ? NUM_ARRAY_ELEMS(a) : a->dims[axis];
+}
+
+/* Sorts self along axis in place. */
+static PyObject *
+py_array_sort(pyArrayObject *pa, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"axis", NULL};
+    PyObject *axis_obj = NULL;
+    arrayObject *ret_arr;
+    int axis = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &axis_obj)) {
+        return NULL;
+    }
+    if ((axis_obj && py_parse_sort_axis(axis_obj, &axis)) || py_array_check_unpinned(pa)) {
+        return NULL;
+    }
+
+    ARRAY_TRACE_BEGIN("py.sort", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret_arr = array_sort(pa->arr, axis, pa->arr);
+    Py_END_ALLOW_THREADS
+    pa->pins--;
+    ARRAY_TRACE_END("py.sort");
+    if (ret_arr == NULL) {
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
+
+/* A sorted copy of self along axis, or of its flattening for None. */
+static PyObject *
+py_array_sorted(pyArrayObject *pa, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"axis", NULL};
+    PyObject *axis_obj = NULL;
+    arrayObject *ret_arr;
+    int axis = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &axis_obj)) {
+        return NULL;
+    }
+    if (axis_obj && py_parse_index_axis(axis_obj, &axis)) {
+        return NULL;
+    }
+
+    ARRAY_TRACE_BEGIN("py.sorted", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret_arr = array_sort(pa->arr, axis, NULL);
+    Py_END_ALLOW_THREADS
+    pa->pins--;
+    ARRAY_TRACE_END("py.sorted");
+    if (ret_arr == NULL) {
+        return PyErr_NoMemory();
+    }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
+}
+
+static PyObject *
+py_array_argsort(pyArrayObject *pa, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"axis", NULL};
+    PyObject *axis_obj = NULL;
+    arrayObject *ret_arr;
+    int axis = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &axis_obj)) {
+        return NULL;
+    }
+    if (axis_obj && py_parse_index_axis(axis_obj, &axis)) {
+        return NULL;
+    }
+
+    ARRAY_TRACE_BEGIN("py.argsort", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret_arr = array_argsort(pa->arr, axis);
+    Py_END_ALLOW_THREADS
+    pa->pins--;
+    ARRAY_TRACE_END("py.argsort");
+    if (ret_arr == NULL) {
+        return PyErr_NoMemory();
+    }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
+}
+
+/* Partitions self along axis in place around its kth element. */
+static PyObject *
+py_array_partition(pyArrayObject *pa, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"kth", "axis", NULL};
+    PyObject *axis_obj = NULL;
+    long long kth;
+    arrayObject *ret_arr;
+    int axis = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "L|O", kwlist, &kth, &axis_obj)) {
+        return NULL;
+    }
+    if ((axis_obj && py_parse_sort_axis(axis_obj, &axis)) || py_array_check_unpinned(pa)) {
+        return NULL;
+    }
+    int64_t n = py_lane_length(pa->arr, axis);
+    if (kth < -n || kth >= n) {
+        PyErr_Format(PyExc_ValueError, "kth %lld out of range for length %lld", kth,
+                     (long long)n);
+        return NULL;
+    }
+
+    ARRAY_TRACE_BEGIN("py.partition", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret_arr = array_partition(pa->arr, kth, axis, pa->arr);
+    Py_END_ALLOW_THREADS
+    pa->pins--;
+    ARRAY_TRACE_END("py.partition");
+    if (ret_arr == NULL) {
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
+
+/* A partitioned copy of self along axis, or of its flattening for None. */
+static PyObject *
+py_array_partitioned(pyArrayObject *pa, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"kth", "axis", NULL};
+    PyObject *axis_obj = NULL;
+    long long kth;
+    arrayObject *ret_arr;
+    int axis = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "L|O", kwlist, &kth, &axis_obj)) {
+        return NULL;
+    }
+    if (axis_obj && py_parse_index_axis(axis_obj, &axis)) {
+        return NULL;
+    }
+    int64_t n = py_lane_length(pa->arr, axis);
+    if (kth < -n || kth >= n) {
+        PyErr_Format(PyExc_ValueError, "kth %lld out of range for length %lld", kth,
+                     (long long)n);
+        return NULL;
+    }
+
+    ARRAY_TRACE_BEGIN("py.partitioned", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret_arr = array_partition(pa->arr, kth, axis, NULL);
+    Py_END_ALLOW_THREADS
+    pa->pins--;
+    ARRAY_TRACE_END("py.partitioned");
+    if (ret_arr == NULL) {
+        return PyErr_NoMemory();
+    }
+    return py_array_wrap(Py_TYPE(pa), ret_arr);
+}
+
+/* The k smallest or largest elements along axis and their positions. */
+static PyObject *
+py_array_topk(pyArrayObject *pa, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"k", "axis", "largest", NULL};
+    PyObject *axis_obj = NULL;
+    long long k;
+    int largest = 1;
+    int axis = 1;
+    int failed;
+    arrayObject *vals;
+    arrayObject *idx;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "L|Op", kwlist, &k, &axis_obj, &largest)) {
+        return NULL;
+    }
+    if (axis_obj && py_parse_index_axis(axis_obj, &axis)) {
+        return NULL;
+    }
+    int64_t n = py_lane_length(pa->arr, axis);
+    if (k < 1 || k > n) {
+        PyErr_Format(PyExc_ValueError, "k must be between 1 and %lld", (long long)n);
+        return NULL;
+    }
+
+    ARRAY_TRACE_BEGIN("py.topk", pa->arr->dtype, pa->arr->dims, NULL);
+    pa->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    failed = array_topk(pa->arr, k, axis, largest, &vals, &idx);
+    Py_END_ALLOW_THREADS
+    pa->pins--;
+    ARRAY_TRACE_END("py.topk");
+    if (failed) {
+        return PyErr_NoMemory();
+    }
+    PyObject *v = py_array_wrap(Py_TYPE(pa), vals);
+    PyObject *i = py_array_wrap(Py_TYPE(pa), idx);
+    if (v == NULL || i == NULL) {
+        Py_XDECREF(v);
+        Py_XDECREF(i);
+        return NULL;
+    }
+    return Py_BuildValue("(NN)", v, i);
+}
+
+static PyObject *
+py_array_get_dtype(pyArrayObject *a)
+{
+    return PyLong_FromLong(a->arr->dtype);
+}
+
+static PyObject *
+py_array_get_nd(pyArrayObject *a)
+{
+    return PyLong_FromLong(a->arr->nd);
+}
+
+static PyObject *
+py_array_get_dims(pyArrayObject *a)
+{
+    return py_tup_from_intp(a->arr->dims, a->arr->nd);
+}
+
+static PyObject *
+py_array_get_strides(pyArrayObject *a)
+{
+    return py_tup_from_intp(a->arr->strides, a->arr->nd);
+}
+
+static PyObject *
+py_array_get_c_contiguous(pyArrayObject *a)
+{
+    return PyBool_FromLong(array_is_contiguous(a->arr, 'C'));
+}
+
+static PyObject *
+py_array_get_f_contiguous(pyArrayObject *a)
+{
+    return PyBool_FromLong(array_is_contiguous(a->arr, 'F'));
+}
+
+static PyGetSetDef py_array_getsetters[] = {
+    {"dtype", (getter)py_array_get_dtype, NULL, NULL, NULL},
+    {"nd", (getter)py_array_get_nd, NULL, NULL, NULL},
+    {"dims", (getter)py_array_get_dims, NULL, NULL, NULL},
+    {"strides", (getter)py_array_get_strides, NULL, NULL, NULL},
+    {"c_contiguous", (getter)py_array_get_c_contiguous, NULL, NULL, NULL},
+    {"f_contiguous", (getter)py_array_get_f_contiguous, NULL, NULL, NULL},
+    {NULL},
+};
+
+static PyMethodDef py_array_methods[] = {
+    {"ravel", (PyCFunction)py_array_ravel, METH_NOARGS, NULL},
+    {"transpose", (PyCFunction)py_array_transpose, METH_O, NULL},
+    {"sum", (PyCFunction)py_array_sum, METH_O, NULL},
+    {"sum_async", (PyCFunction)py_array_sum_async, METH_O, NULL},
+    {"reduce", (PyCFunction)py_array_reduce, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"scan", (PyCFunction)py_array_scan, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"unary", (PyCFunction)py_array_unary, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"axpy", (PyCFunction)py_array_axpy, METH_VARARGS, NULL},
+    {"scal", (PyCFunction)py_array_scal, METH_VARARGS, NULL},
+    {"asum", (PyCFunction)py_array_asum, METH_NOARGS, NULL},
+    {"nrm2", (PyCFunction)py_array_nrm2, METH_NOARGS, NULL},
+    {"iamax", (PyCFunction)py_array_iamax, METH_NOARGS, NULL},
+    {"take", (PyCFunction)py_array_take, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"put", (PyCFunction)py_array_put, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"extract", (PyCFunction)py_array_extract, METH_O, NULL},
+    {"putmask", (PyCFunction)py_array_putmask, METH_VARARGS, NULL},
+    {"sort", (PyCFunction)py_array_sort, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"sorted", (PyCFunction)py_array_sorted, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"argsort", (PyCFunction)py_array_argsort, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"partition", (PyCFunction)py_array_partition, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"partitioned", (PyCFunction)py_array_partitioned, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"topk", (PyCFunction)py_array_topk, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"dot", (PyCFunction)py_array_dot, METH_O, NULL},
+    {"dot_async", (PyCFunction)py_array_dot_async, METH_O, NULL},
+    {"copy", (PyCFunction)py_array_copy, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"ones", (PyCFunction)py_array_ones, METH_NOARGS, NULL},
+    {"randint", (PyCFunction)py_array_randint, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL},
+};
+
+static PyTypeObject ArrayType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "minumpy.ndarray",
+    .tp_doc = "Minumpy ndarray",
+    .tp_basicsize = sizeof(pyArrayObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = py_array_alloc,
+    .tp_dealloc = (destructor) py_array_dealloc,
+    .tp_getset = py_array_getsetters,
+    .tp_methods = py_array_methods,
+    .tp_as_mapping = &py_array_as_mapping,
+    .tp_str = (reprfunc) py_array_str
+};
+
+typedef struct pyCsrObject {
+    PyObject_HEAD
+    csrObject *csr;
+} pyCsrObject;
+
+static void
+py_csr_dealloc(pyCsrObject *ps)
+{
+    csr_free(ps->csr);
+    Py_TYPE(ps)->tp_free((PyObject *)ps);
+}
+
+/*
+ * csr_matrix(dense) compresses an array; csr_matrix(values, rows, cols,
+ * shape) builds one from triplets, with values an array of the nonzeros.
+ */
+static PyObject *
+py_csr_alloc(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"values", "rows", "cols", "shape", NULL};
+    pyArrayObject *values = NULL;
+    arrayDims rows = {NULL, 0};
+    arrayDims cols = {NULL, 0};
+    arrayDims shape = {NULL, 0};
+    csrObject *csr = NULL;
+    pyCsrObject *ps = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O&O&O&", kwlist,
+                                     &ArrayType, &values,
+                                     py_seq_to_int_list, &rows,
+                                     py_seq_to_int_list, &cols,
+                                     py_seq_to_intp, &shape)) {
+        goto done;
+    }
+
+    arrayObject *a = values->arr;
+    if (rows.ptr == NULL && cols.ptr == NULL && shape.ptr == NULL) {
+        csr = csr_from_dense(a);
+    } else {
+        int64_t nnz = NUM_ARRAY_ELEMS(a);
+        if (rows.ptr == NULL || cols.ptr == NULL || shape.len != 2) {
+            PyErr_SetString(PyExc_ValueError,
+                "Triplet construction needs rows, cols and a 2-d shape");
+            goto done;
+        }
+        if (rows.len != nnz || cols.len != nnz) {
+            PyErr_SetString(PyExc_ValueError,
+                "values, rows and cols must have the same length");
+            goto done;
+        }
+        void *flat = NULL;
+        if (!array_is_contiguous(a, 'C') && (flat = array_ravel(a)) == NULL) {
+            PyErr_NoMemory();
+            goto done;
+        }
+        csr = csr_from_triplets(rows.ptr, cols.ptr, flat ? flat : a->data, nnz,
+                                shape.ptr[0], shape.ptr[1], a->dtype);
+        array_data_free(flat);
+        if (csr == NULL) {
+            PyErr_SetString(PyExc_ValueError, "Triplet index out of range");
+            goto done;
+        }
+    }
+    if (csr == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    ps = (pyCsrObject *)type->tp_alloc(type, 0);
+    if (ps == NULL) {
+        csr_free(csr);
+        goto done;
+    }
+    ps->csr = csr;
+
+done:
+    free(rows.ptr);
+    free(cols.ptr);
+    free(shape.ptr);
+    return (PyObject *)ps;
+}
+
+static PyObject *
+py_csr_dot(pyCsrObject *ps, PyObject *b)
+{
+    if (Py_TYPE(b) != &ArrayType) {
+        PyErr_SetString(PyExc_TypeError, "Expected array argument");
+        return NULL;
+    }
+
+    pyArrayObject *pb = (pyArrayObject *)b;
+    arrayObject *ret_arr;
+    ARRAY_TRACE_BEGIN("py.csr_dot", ps->csr->dtype, ps->csr->dims, pb->arr->dims);
+    pb->pins++;
+    Py_BEGIN_ALLOW_THREADS
+    ret_arr = csr_dot(ps->csr, pb->arr);
+    Py_END_ALLOW_THREADS
+    pb->pins--;
+    ARRAY_TRACE_END("py.csr_dot");
+    if (ret_arr == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Sparse dot product failed");
+        return NULL;
+    }
+    return py_array_wrap(&ArrayType, ret_arr);
+}
+
+static PyObject *
+py_csr_todense(pyCsrObject *ps, PyObject *Py_UNUSED(ignored))
+{
+    arrayObject *ret_arr = csr_to_dense(ps->csr);
+    if (ret_arr == NULL) {
+        return PyErr_NoMemory();
+    }
+    return py_array_wrap(&ArrayType, ret_arr);
+}
+
+static PyObject *
+py_csr_get_dtype(pyCsrObject *ps)
+{
+    return PyLong_FromLong(ps->csr->dtype);
+}
+
+static PyObject *
+py_csr_get_dims(pyCsrObject *ps)
+{
+    return py_tup_from_intp(ps->csr->dims, ARRAY_NUM_DIMS);
+}
+
+static PyObject *
+py_csr_get_nnz(pyCsrObject *ps)
+{
+    return PyLong_FromLongLong(ps->csr->nnz);
+}
+
+static PyGetSetDef py_csr_getsetters[] = {
+    {"dtype", (getter)py_csr_get_dtype, NULL, NULL, NULL},
+    {"dims", (getter)py_csr_get_dims, NULL, NULL, NULL},
+    {"nnz", (getter)py_csr_get_nnz, NULL, NULL, NULL},
+    {NULL},
+};
+
+static PyMethodDef py_csr_methods[] = {
+    {"dot", (PyCFunction)py_csr_dot, METH_O, NULL},
+    {"todense", (PyCFunction)py_csr_todense, METH_NOARGS, NULL},
+    {NULL, NULL, 0, NULL},
+};
+
+static PyTypeObject CsrType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "minumpy.csr_matrix",
+    .tp_doc = "Compressed sparse row matrix",
+    .tp_basicsize = sizeof(pyCsrObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = py_csr_alloc,
+    .tp_dealloc = (destructor) py_csr_dealloc,
+    .tp_getset = py_csr_getsetters,
+    .tp_methods = py_csr_methods,
+};
+
+static void
+py_graph_dealloc(pyGraphObject *g)
+{
+    if (g->capturing) py_pin_list(g->inputs, -1);
+    if (g->outputs) py_pin_list(g->outputs, -1);
+    Py_XDECREF(g->inputs);
+    Py_XDECREF(g->outputs);
+    array_graph_free(g->graph);
+    free(g->bound);
+    Py_TYPE(g)->tp_free((PyObject *)g);
+}
+
+static PyObject *
+py_graph_replay(pyGraphObject *g, PyObject *inputs)
+{
+    if (g->capturing || g->replaying) {
+        PyErr_SetString(PyExc_RuntimeError,
+            "Graph is being captured or replayed by another thread");
+        return NULL;
+    }
+    PyObject *seq = PySequence_Fast(inputs, "Expected a sequence of arrays");
+    if (seq == NULL) {
+        return NULL;
+    }
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    int failed;
+    if (n != PyList_GET_SIZE(g->inputs)) {
+        PyErr_Format(PyExc_ValueError, "Expected %zd inputs, got %zd",
+                     PyList_GET_SIZE(g->inputs), n);
+        goto fail;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *v = PySequence_Fast_GET_ITEM(seq, i);
+        if (Py_TYPE(v) != &ArrayType) {
+            PyErr_SetString(PyExc_TypeError, "Expected array inputs");
+            goto fail;
+        }
+        g->bound[i] = ((pyArrayObject *)v)->arr;
+    }
+    if (array_graph_check_inputs(g->graph, g->bound)) {
+        PyErr_SetString(PyExc_ValueError,
+            "Replay inputs must keep their captured dtype, dims and strides "
+            "and must not be graph outputs");
+        goto fail;
+    }
+
+    ARRAY_TRACE_BEGIN("py.graph_replay", UNKNOWN, NULL, NULL);
+    g->replaying = 1;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        ((pyArrayObject *)PySequence_Fast_GET_ITEM(seq, i))->pins++;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    failed = array_graph_replay(g->graph, g->bound);
+    Py_END_ALLOW_THREADS
+    for (Py_ssize_t i = 0; i < n; i++) {
+        ((pyArrayObject *)PySequence_Fast_GET_ITEM(seq, i))->pins--;
+    }
+    g->replaying = 0;
+    ARRAY_TRACE_END("py.graph_replay");
+    Py_DECREF(seq);
+    if (failed) {
+        return PyErr_NoMemory();
+    }
+
+    n = PyList_GET_SIZE(g->outputs);
+    if (n == 0) {
+        Py_RETURN_NONE;
+    }
+    PyObject *ret = PyList_GET_ITEM(g->outputs, n - 1);
+    Py_INCREF(ret);
+    return ret;
+
+fail:
+    Py_DECREF(seq);
+    return NULL;
+}
+
+static PyObject *
+py_graph_get_inputs(pyGraphObject *g)
+{
+    return PyList_AsTuple(g->inputs);
+}
+
+static PyObject *
+py_graph_get_outputs(pyGraphObject *g)
+{
+    return PyList_AsTuple(g->outputs);
+}
+
+static PyGetSetDef py_graph_getsetters[] = {
+    {"inputs", (getter)py_graph_get_inputs, NULL, NULL, NULL},
+    {"outputs", (getter)py_graph_get_outputs, NULL, NULL, NULL},
+    {NULL},
+};
+
+static PyMethodDef py_graph_methods[] = {
+    {"replay", (PyCFunction)py_graph_replay, METH_O, NULL},
+    {NULL, NULL, 0, NULL},
+};
+
+static PyTypeObject GraphType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "minumpy.Graph",
+    .tp_doc = "Captured dot/sum sequence",
+    .tp_basicsize = sizeof(pyGraphObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor) py_graph_dealloc,
+    .tp_getset = py_graph_getsetters,
+    .tp_methods = py_graph_methods,
+};
+
+static PyObject *
+py_capture_begin(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (capture_graph != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "A capture is already in progress");
+        return NULL;
+    }
+    pyGraphObject *g = (pyGraphObject *)GraphType.tp_alloc(&GraphType, 0);
+    if (g == NULL) {
+        return NULL;
+    }
+    g->graph = array_graph_alloc();
+    g->inputs = PyList_New(0);
+    g->outputs = PyList_New(0);
+    if (g->graph == NULL || g->inputs == NULL || g->outputs == NULL) {
+        Py_DECREF(g);
+        return PyErr_NoMemory();
+    }
+    g->capturing = 1;
+    Py_INCREF(g);
+    capture_graph = g;
+    capture_thread = PyThread_get_thread_ident();
+    return (PyObject *)g;
+}
+
+static PyObject *
+py_capture_end(PyObject *self, PyObject *graph)
+{
+    pyGraphObject *g = (pyGraphObject *)graph;
+    if (Py_TYPE(graph) != &GraphType || g != capture_graph) {
+        PyErr_SetString(PyExc_RuntimeError, "Graph is not being captured");
+        return NULL;
+    }
+    capture_graph = NULL;
+    g->capturing = 0;
+    py_pin_list(g->inputs, -1);
+    Py_ssize_t n = PyList_GET_SIZE(g->inputs);
+    g->bound = malloc((n ? n : 1) * sizeof(arrayObject *));
+    int failed = g->bound == NULL;
+    // Drop the reference capture_begin kept; the caller still holds one.
+    Py_DECREF(g);
+    if (failed) {
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
+
+static int
+py_check_dtype(int dtype)
+{
+    if (dtype < 0 || dtype >= NUM_ARRAY_DTYPES) {
+        PyErr_Format(PyExc_ValueError, "Unsupported dtype %d", dtype);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Fails with OverflowError unless v converts to an integer dtype without
+ * leaving its range, which would be undefined behaviour.
+ */
+static int
+py_check_int_value(double v, int dtype)
+{
+    int ok = dtype == INT32 ? v > INT32_MIN - 1.0 && v < INT32_MAX + 1.0 :
+             dtype == INT64 ? v >= -0x1p63 && v < 0x1p63 : 1;
+    if (!ok) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%g out of range for an integer dtype", v);
+        PyErr_SetString(PyExc_OverflowError, buf);
+        return 1;
+    }
+    return 0;
+}
+
+/* As py_check_int_value for ints, which only INT32 can overflow. */
+static int
+py_check_int32_value(long long v, int dtype)
+{
+    if (dtype == INT32 && (v < INT32_MIN || v > INT32_MAX)) {
+        PyErr_Format(PyExc_OverflowError, "%lld out of range for int32", v);
+        return 1;
+    }
+    return 0;
+}
+
+/* Wraps a freshly constructed array; arguments were validated beforehand. */
+static PyObject *
+py_wrap_constructed(arrayObject *a)
+{
+    if (a == NULL) {
+        return PyErr_NoMemory();
+    }
+    return py_array_wrap(&ArrayType, a);
+}
+
+static int
+py_check_alloc_dims(const arrayDims *dims)
+{
+    int64_t n;
+    if (validate_nd(dims->len) || prod_checked(dims->ptr, dims->len, &n)) {
+        PyErr_SetString(PyExc_ValueError, "Array allocation failed");
+        return 1;
+    }
+    return 0;
+}
+
+static PyObject *
+py_empty(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"shape", "dtype", NULL};
+    arrayDims dims = {NULL, 0};
+    int dtype = DOUBLE;
+    arrayObject *a;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|i", kwlist,
+                                     py_seq_to_intp, &dims, &dtype)) {
+        free(dims.ptr);
+        return NULL;
+    }
+    if (py_check_dtype(dtype) || py_check_alloc_dims(&dims)) {
+        free(dims.ptr);
+        return NULL;
+    }
+    a = array_empty(dims.ptr, dims.len, dtype);
+    free(dims.ptr);
+    return py_wrap_constructed(a);
+}
+
+static PyObject *
+py_full(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"shape", "fill_value", "dtype", NULL};
+    arrayDims dims = {NULL, 0};
+    PyObject *val_obj;
+    double val = 0;
+    long long ival = 0;
+    int dtype = DOUBLE;
+    arrayObject *a;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O|i", kwlist,
+                                     py_seq_to_intp, &dims, &val_obj, &dtype)) {
+        free(dims.ptr);
+        return NULL;
+    }
+    if (py_check_dtype(dtype) || py_check_alloc_dims(&dims)) {
+        free(dims.ptr);
+        return NULL;
+    }
+    // Ints fill integer dtypes exactly, rather than rounded through a double.
+    int exact = PyLong_Check(val_obj) && (dtype == INT32 || dtype == INT64);
+    if (exact) {
+        ival = PyLong_AsLongLong(val_obj);
+    } else {
+        val = PyFloat_AsDouble(val_obj);
+    }
+    if (PyErr_Occurred() || (exact ? py_check_int32_value(ival, dtype) :
+                                     py_check_int_value(val, dtype))) {
+        free(dims.ptr);
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    if (exact) {
+        a = array_full_int(dims.ptr, dims.len, ival, dtype);
+    } else {
+        a = array_full(dims.ptr, dims.len, val, dtype);
+    }
+    Py_END_ALLOW_THREADS
+    free(dims.ptr);
+    return py_wrap_constructed(a);
+}
+
+static PyObject *
+py_zeros(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"shape", "dtype", NULL};
+    arrayDims dims = {NULL, 0};
+    int dtype = DOUBLE;
+    arrayObject *a;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|i", kwlist,
+                                     py_seq_to_intp, &dims, &dtype)) {
+        free(dims.ptr);
+        return NULL;
+    }
+    if (py_check_dtype(dtype) || py_check_alloc_dims(&dims)) {
+        free(dims.ptr);
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    a = array_zeros(dims.ptr, dims.len, dtype);
+    Py_END_ALLOW_THREADS
+    free(dims.ptr);
+    return py_wrap_constructed(a);
+}
+
+static PyObject *
+py_arange(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"start", "stop", "step", "dtype", NULL};
+    PyObject *start_obj, *stop_obj, *step_obj = NULL;
+    int dtype = DOUBLE;
+    arrayObject *a;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|Oi", kwlist,
+                                     &start_obj, &stop_obj, &step_obj, &dtype)) {
+        return NULL;
+    }
+    if (py_check_dtype(dtype)) {
+        return NULL;
+    }
+
+    if ((dtype == INT32 || dtype == INT64) && PyLong_Check(start_obj) &&
+        PyLong_Check(stop_obj) && (step_obj == NULL || PyLong_Check(step_obj))) {
+        long long start = PyLong_AsLongLong(start_obj);
+        long long stop = PyLong_AsLongLong(stop_obj);
+        long long step = step_obj ? PyLong_AsLongLong(step_obj) : 1;
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+        if (step == 0) {
+            PyErr_SetString(PyExc_ValueError, "Expected a non-zero step");
+            return NULL;
+        }
+        // Values lie between start and the exclusive stop.
+        if (py_check_int32_value(start, dtype) ||
+            py_check_int32_value(stop - (step > 0) + (step < 0), dtype)) {
+            return NULL;
+        }
+        Py_BEGIN_ALLOW_THREADS
+        a = array_arange_int(start, stop, step, dtype);
+        Py_END_ALLOW_THREADS
+        return py_wrap_constructed(a);
+    }
+
+    double start = PyFloat_AsDouble(start_obj);
+    double stop = PyFloat_AsDouble(stop_obj);
+    double step = step_obj ? PyFloat_AsDouble(step_obj) : 1;
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    if (step == 0 || !isfinite(start) || !isfinite(stop) || !isfinite(step)) {
+        PyErr_SetString(PyExc_ValueError,
+            "Expected finite start and stop, and a finite non-zero step");
+        return NULL;
+    }
+    double len = (stop - start) / step;
+    if (!(len < (double)INT64_MAX)) {
+        PyErr_SetString(PyExc_ValueError, "Range too long");
+        return NULL;
+    }
+    // The first and last values, computed as the fill does.
+    int64_t n = len > 0 ? (int64_t)len + ((int64_t)len < len) : 0;
+    if (n > 0 && (py_check_int_value(start, dtype) ||
+                  py_check_int_value(start + (double)(n - 1) * step, dtype))) {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    a = array_arange(start, stop, step, dtype);
+    Py_END_ALLOW_THREADS
+    return py_wrap_constructed(a);
+}
+
+static PyObject *
+py_linspace(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"start", "stop", "num", "endpoint", "dtype", NULL};
+    double start, stop;
+    long long num = 50;
+    int endpoint = 1;
+    int dtype = DOUBLE;
+    arrayObject *a;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "dd|Lpi", kwlist,
+                                     &start, &stop, &num, &endpoint, &dtype)) {
+        return NULL;
+    }
+    if (py_check_dtype(dtype)) {
+        return NULL;
+    }
+    if (num < 0 || !isfinite(start) || !isfinite(stop)) {
+        PyErr_SetString(PyExc_ValueError,
+            "Expected finite start and stop, and num >= 0");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    a = array_linspace(start, stop, num, endpoint, dtype);
+    Py_END_ALLOW_THREADS
+    return py_wrap_constructed(a);
+}
+
+static PyObject *
+py_eye(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"N", "M", "k", "dtype", NULL};
+    long long n;
+    PyObject *m_obj = Py_None;
+    long long k = 0;
+    int dtype = DOUBLE;
+    arrayObject *a;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "L|OLi", kwlist,
+                                     &n, &m_obj, &k, &dtype)) {
+        return NULL;
+    }
+    long long m = n;
+    if (m_obj != Py_None) {
+        m = PyLong_AsLongLong(m_obj);
+        if (m == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+    if (py_check_dtype(dtype)) {
+        return NULL;
+    }
+    int64_t dims[] = {n, m};
+    arrayDims d = {dims, 2};
+    if (py_check_alloc_dims(&d)) {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    a = array_eye(n, m, k, dtype);
+    Py_END_ALLOW_THREADS
+    return py_wrap_constructed(a);
+}
+
+static PyObject *
+py_set_print_options(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"threshold", "edgeitems", "precision", NULL};
+    arrayPrintOptions opts;
+    array_get_print_options(&opts);
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iii", kwlist,
+                                     &opts.threshold,
+                                     &opts.edgeitems,
+                                     &opts.precision)) {
+        return NULL;
+    }
+
+    if (array_set_print_options(&opts)) {
+        PyErr_Format(PyExc_ValueError,
+            "Expected threshold >= 0, edgeitems >= 1 and precision in [0, %d]",
+            PRINT_VAL_MAX_PRECISION);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+py_get_print_options(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    arrayPrintOptions opts;
+    array_get_print_options(&opts);
+    return Py_BuildValue("{s:i,s:i,s:i}",
+                         "threshold", opts.threshold,
+                         "edgeitems", opts.edgeitems,
+                         "precision", opts.precision);
+}
+
+static PyObject *
+py_stats(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    arrayOpStats stats[NUM_STATS_OPS];
+    array_stats_get(stats);
+
+    PyObject *ret = PyDict_New();
+    if (ret == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < NUM_STATS_OPS; i++) {
+        PyObject *op = Py_BuildValue("{s:K,s:K,s:K,s:K}",
+                                     "calls", stats[i].calls,
+                                     "elems", stats[i].elems,
+                                     "bytes", stats[i].bytes,
+                                     "ns", stats[i].ns);
+        if (op == NULL || PyDict_SetItemString(ret, ARRAY_STATS_OP_NAMES[i], op)) {
+            Py_XDECREF(op);
+            Py_DECREF(ret);
+            return NULL;
+        }
+        Py_DECREF(op);
+    }
+    return ret;
+}
+
+static PyObject *
+py_reset_stats(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    array_stats_reset();
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+py_enable_stats(PyObject *self, PyObject *enabled)
+{
+    int flag = PyObject_IsTrue(enabled);
+    if (flag < 0) {
+        return NULL;
+    }
+    if (flag && !array_stats_compiled()) {
+        PyErr_SetString(PyExc_RuntimeError,
+            "minarray was built without ARRAY_STATS");
+        return NULL;
+    }
+    array_stats_enable(flag);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+py_trace_start(PyObject *self, PyObject *args)
+{
+    const char *path;
+    if (!PyArg_ParseTuple(args, "s", &path)) {
+        return NULL;
+    }
+    if (!array_trace_compiled()) {
+        PyErr_SetString(PyExc_RuntimeError,
+            "minarray was built without ARRAY_TRACE");
+        return NULL;
+    }
+    if (array_trace_start(path)) {
+        PyErr_Format(PyExc_RuntimeError,
+            "Could not start trace to %s, is a trace already running?", path);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+py_trace_stop(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = array_trace_stop();
+    Py_END_ALLOW_THREADS
+    if (ret) {
+        PyErr_SetString(PyExc_RuntimeError, "No trace running or write failed");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static void
+py_mem_track(void *ptr, size_t size)
+{
+    PyTraceMalloc_Track(MINUMPY_TRACEMALLOC_DOMAIN, (uintptr_t)ptr, size);
+}
+
+static void
+py_mem_untrack(void *ptr)
+{
+    PyTraceMalloc_Untrack(MINUMPY_TRACEMALLOC_DOMAIN, (uintptr_t)ptr);
+}
+
+static PyObject *
+py_mem_stats_dict(const arrayMemStats *s)
+{
+    return Py_BuildValue("{s:K,s:K,s:K,s:K}",
+                         "live", s->live_bytes,
+                         "peak", s->peak_bytes,
+                         "allocs", s->allocs,
+                         "alloc_bytes", s->alloc_bytes);
+}
+
+static PyObject *
+py_set_memory_policy(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"mmap_threshold", "hugepages", "numa", "node", "first_touch", NULL};
+    arrayMemPolicy policy;
+    array_mem_get_policy(&policy);
+    Py_ssize_t threshold = policy.mmap_threshold > PY_SSIZE_T_MAX
+        ? PY_SSIZE_T_MAX : (Py_ssize_t)policy.mmap_threshold;
+    const char *numa_name = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|npsip", kwlist,
+                                     &threshold,
+                                     &policy.hugepages,
+                                     &numa_name,
+                                     &policy.node,
+                                     &policy.first_touch)) {
+        return NULL;
+    }
+    if (threshold < 0) {
+        PyErr_SetString(PyExc_ValueError, "Expected mmap_threshold >= 0");
+        return NULL;
+    }
+    policy.mmap_threshold = threshold;
+    if (numa_name) {
+        int mode;
+        for (mode = 0; mode < NUM_MEM_NUMA_MODES; mode++) {
+            if (!strcmp(numa_name, MEM_NUMA_MODE_NAMES[mode])) break;
+        }
+        if (mode == NUM_MEM_NUMA_MODES) {
+            PyErr_Format(PyExc_ValueError, "Unknown NUMA mode %s", numa_name);
+            return NULL;
+        }
+        policy.numa = mode;
+    }
+    if (array_mem_set_policy(&policy)) {
+        PyErr_Format(PyExc_ValueError, "Cannot bind to NUMA node %d", policy.node);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+py_get_memory_policy(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    arrayMemPolicy policy;
+    array_mem_get_policy(&policy);
+    return Py_BuildValue("{s:n,s:O,s:s,s:i,s:O}",
+                         "mmap_threshold", policy.mmap_threshold > PY_SSIZE_T_MAX
+                             ? PY_SSIZE_T_MAX : (Py_ssize_t)policy.mmap_threshold,
+                         "hugepages", policy.hugepages ? Py_True : Py_False,
+                         "numa", MEM_NUMA_MODE_NAMES[policy.numa],
+                         "node", policy.node,
+                         "first_touch", policy.first_touch ? Py_True : Py_False);
+}
+
+static PyObject *
+py_memory_stats(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    arrayMemStats dtypes[NUM_ARRAY_DTYPES];
+    arrayMemStats total;
+    array_mem_stats(dtypes, &total);
+
+    PyObject *per_dtype = PyList_New(NUM_ARRAY_DTYPES);
+    if (per_dtype == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < NUM_ARRAY_DTYPES; i++) {
+        PyObject *v = py_mem_stats_dict(&dtypes[i]);
+        if (v == NULL) {
+            Py_DECREF(per_dtype);
+            return NULL;
+        }
+        PyList_SET_ITEM(per_dtype, i, v);
+    }
+    PyObject *v = py_mem_stats_dict(&total);
+    if (v == NULL) {
+        Py_DECREF(per_dtype);
+        return NULL;
+    }
+    return Py_BuildValue("(NN)", per_dtype, v);
+}
+
+static PyObject *
+py_set_async_executor(PyObject *self, PyObject *executor)
+{
+    if (executor != Py_None && !PyObject_HasAttrString(executor, "submit")) {
+        PyErr_SetString(PyExc_TypeError, "Executor must provide submit()");
+        return NULL;
+    }
+    Py_CLEAR(async_executor);
+    if (executor != Py_None) {
+        Py_INCREF(executor);
+        async_executor = executor;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+py_set_num_threads(PyObject *self, PyObject *args)
+{
+    int n;
+    PyObject *pin = Py_None;
+    if (!PyArg_ParseTuple(args, "i|O", &n, &pin)) {
+        return NULL;
+    }
+    parallel_set_num_threads(n);
+    if (pin != Py_None) {
+        int enabled = PyObject_IsTrue(pin);
+        if (enabled < 0) {
+            return NULL;
+        }
+        parallel_set_affinity(enabled);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+py_get_num_threads(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return PyLong_FromLong(parallel_num_threads());
+}
+
+static PyObject *
+py_reset_peak_memory(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    array_mem_reset_peak();
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+py_set_backend(PyObject *self, PyObject *args)
+{
+    const char *spec;
+    if (!PyArg_ParseTuple(args, "s", &spec)) {
+        return NULL;
+    }
+    if (array_backend_set(spec)) {
+        PyErr_Format(PyExc_ValueError, "Invalid backend selection %s", spec);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/*
+ * get_backend() returns the selection in effect; get_backend(op, dtype)
+ * the backend serving that op and dtype under it.
+ */
+static PyObject *
+py_get_backend(PyObject *self, PyObject *args)
+{
+    const char *op_name = NULL;
+    int dtype = DOUBLE;
+    int op;
+
+    if (!PyArg_ParseTuple(args, "|si", &op_name, &dtype)) {
+        return NULL;
+    }
+    if (op_name == NULL) {
+        char spec[ARRAY_BACKEND_SPEC_LEN];
+        array_backend_get(spec);
+        return PyUnicode_FromString(spec);
+    }
+    for (op = 0; op < NUM_KERNEL_OPS; op++) {
+        if (!strcmp(op_name, KERNEL_OP_NAMES[op])) break;
+    }
+    if (op == NUM_KERNEL_OPS) {
+        PyErr_Format(PyExc_ValueError, "Unknown kernel %s", op_name);
+        return NULL;
+    }
+    if (py_check_dtype(dtype)) {
+        return NULL;
+    }
+    return PyUnicode_FromString(array_backend_serving(op, dtype));
+}
+
+static PyObject *
+py_list_backends(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    const char *names[ARRAY_MAX_BACKENDS];
+    int n = array_backend_list(names);
+    PyObject *ret = PyList_New(n);
+    if (ret == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < n; i++) {
+        PyObject *name = PyUnicode_FromString(names[i]);
+        if (name == NULL) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+        PyList_SET_ITEM(ret, i, name);
+    }
+    return ret;
+}
+
+static int
+py_parse_gemm_shape(const char *name, GEMM_SHAPE *shape)
+{
+    for (int s = 0; s < NUM_GEMM_SHAPES; s++) {
+        if (!strcmp(name, GEMM_SHAPE_NAMES[s])) {
+            *shape = s;
+            return 0;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "Unknown gemm shape class %s", name);
+    return 1;
+}
+
+static PyObject *
+py_blocking_dict(const gemmBlocking *blk)
+{
+    return Py_BuildValue("{s:i,s:i,s:i,s:i}", "mc", blk->mc, "kc", blk->kc,
+                         "nc", blk->nc, "panel", blk->panel);
+}
+
+static PyObject *
+py_tune(PyObject *self, PyObject *args)
+{
+    int dtype;
+    const char *shape_name;
+    GEMM_SHAPE shape;
+    gemmBlocking best;
+    int failed;
+
+    if (!PyArg_ParseTuple(args, "is", &dtype, &shape_name)) {
+        return NULL;
+    }
+    if (py_check_dtype(dtype) || py_parse_gemm_shape(shape_name, &shape)) {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    failed = gemm_tune(dtype, shape, &best);
+    Py_END_ALLOW_THREADS
+    if (failed) {
+        return PyErr_NoMemory();
+    }
+    return py_blocking_dict(&best);
+}
+
+static PyObject *
+py_tune_save(PyObject *self, PyObject *args)
+{
+    const char *path = NULL;
+    if (!PyArg_ParseTuple(args, "|z", &path)) {
+        return NULL;
+    }
+    if (gemm_tune_save(path)) {
+        PyErr_Format(PyExc_OSError, "Cannot write gemm tuning cache %s",
+                     path ? path : "");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+py_get_gemm_blocking(PyObject *self, PyObject *args)
+{
+    int dtype;
+    const char *shape_name;
+    GEMM_SHAPE shape;
+    gemmBlocking blk;
+
+    if (!PyArg_ParseTuple(args, "is", &dtype, &shape_name)) {
+        return NULL;
+    }
+    if (py_check_dtype(dtype) || py_parse_gemm_shape(shape_name, &shape)) {
+        return NULL;
+    }
+    gemm_get_shape_blocking(dtype, shape, &blk);
+    return py_blocking_dict(&blk);
+}
+
+static PyObject *
+py_set_autotune(PyObject *self, PyObject *arg)
+{
+    int enabled = PyObject_IsTrue(arg);
+    if (enabled < 0) {
+        return NULL;
+    }
+    gemm_set_autotune(enabled);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+py_get_autotune(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return PyBool_FromLong(gemm_get_autotune());
+}
+
+static PyMethodDef minarray_methods[] = {
+    {"empty", (PyCFunction)py_empty, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"zeros", (PyCFunction)py_zeros, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"full", (PyCFunction)py_full, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"arange", (PyCFunction)py_arange, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"linspace", (PyCFunction)py_linspace, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"eye", (PyCFunction)py_eye, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"memory_stats", (PyCFunction)py_memory_stats, METH_NOARGS, NULL},
+    {"reset_peak_memory", (PyCFunction)py_reset_peak_memory, METH_NOARGS, NULL},
+    {"set_memory_policy", (PyCFunction)py_set_memory_policy,
+     METH_VARARGS | METH_KEYWORDS, NULL},
+    {"get_memory_policy", (PyCFunction)py_get_memory_policy, METH_NOARGS, NULL},
+    {"set_backend", (PyCFunction)py_set_backend, METH_VARARGS, NULL},
+    {"get_backend", (PyCFunction)py_get_backend, METH_VARARGS, NULL},
+    {"list_backends", (PyCFunction)py_list_backends, METH_NOARGS, NULL},
+    {"tune", (PyCFunction)py_tune, METH_VARARGS, NULL},
+    {"tune_save", (PyCFunction)py_tune_save, METH_VARARGS, NULL},
+    {"get_gemm_blocking", (PyCFunction)py_get_gemm_blocking, METH_VARARGS, NULL},
+    {"set_autotune", (PyCFunction)py_set_autotune, METH_O, NULL},
+    {"get_autotune", (PyCFunction)py_get_autotune, METH_NOARGS, NULL},
+    {"set_async_executor", (PyCFunction)py_set_async_executor, METH_O, NULL},
+    {"set_num_threads", (PyCFunction)py_set_num_threads, METH_VARARGS, NULL},
+    {"capture_begin", (PyCFunction)py_capture_begin, METH_NOARGS, NULL},
+    {"capture_end", (PyCFunction)py_capture_end, METH_O, NULL},
+    {"get_num_threads", (PyCFunction)py_get_num_threads, METH_NOARGS, NULL},
+    {"trace_start", (PyCFunction)py_trace_start, METH_VARARGS, NULL},
+    {"trace_stop", (PyCFunction)py_trace_stop, METH_NOARGS, NULL},
+    {"stats", (PyCFunction)py_stats, METH_NOARGS, NULL},
+    {"reset_stats", (PyCFunction)py_reset_stats, METH_NOARGS, NULL},
+    {"enable_stats", (PyCFunction)py_enable_stats, METH_O, NULL},
+    {"set_printoptions", (PyCFunction)py_set_print_options,
+     METH_VARARGS | METH_KEYWORDS, NULL},
+    {"get_printoptions", (PyCFunction)py_get_print_options, METH_NOARGS, NULL},
+    {NULL, NULL, 0, NULL},
+};
+
+static struct PyModuleDef minarraydef = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "minarray",
+    .m_doc = "",
+    .m_size = -1,
+    .m_methods = minarray_methods,
+};
+
+PyMODINIT_FUNC
+PyInit_minarray(void)
+{
+    PyObject *ret;
+    if (PyType_Ready(&ArrayType) < 0 || PyType_Ready(&GraphType) < 0 ||
+        PyType_Ready(&CsrType) < 0) {
+        return NULL;
+    }
+
+    ret = PyModule_Create(&minarraydef);
+    if (ret == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(&ArrayType);
+    if (PyModule_AddObject(ret, "array", (PyObject *)&ArrayType) < 0) {
+        Py_DECREF(&ArrayType);
+        Py_DECREF(ret);
+        return NULL;
+    }
+
+    Py_INCREF(&CsrType);
+    if (PyModule_AddObject(ret, "csr_matrix", (PyObject *)&CsrType) < 0) {
+        Py_DECREF(&CsrType);
+        Py_DECREF(ret);
+        return NULL;
+    }
+
+    Py_INCREF(&GraphType);
+    if (PyModule_AddObject(ret, "Graph", (PyObject *)&GraphType) < 0) {
+        Py_DECREF(&GraphType);
+        Py_DECREF(ret);
+        return NULL;
+    }
+
+    if (PyModule_AddIntConstant(ret, "TRACEMALLOC_DOMAIN",
+                                MINUMPY_TRACEMALLOC_DOMAIN) < 0) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    array_mem_set_hooks(py_mem_track, py_mem_untrack);
+
+    async_dot_worker = PyCFunction_New(&async_dot_def, NULL);
+    async_sum_worker = PyCFunction_New(&async_sum_def, NULL);
+    if (async_dot_worker == NULL || async_sum_worker == NULL) {
         Py_DECREF(ret);
         return NULL;
     }
@@ -9,9 +9,13 @@
 
 #include "array.h"
 
+/* tracemalloc domain that array data buffers are reported under. */
+#define MINUMPY_TRACEMALLOC_DOMAIN 0x6d6e7079
+
 typedef struct pyArrayObject {
     PyObject_HEAD
     arrayObject *arr;
+    int pins;  // in-flight operations reading arr; mutation is refused while > 0
 } pyArrayObject;
 
 #endif
@@ -109,11 +109,11 @@ check_array_object_py_initialiser(PyObject *obj, arrayDims *dims, ARRAY_DTYPE *d
 
     if (subLen) {
         dims->len = ARRAY_NUM_DIMS;
-        dims->ptr = calloc(dims->len, sizeof(int));
+        dims->ptr = calloc(dims->len, sizeof(int64_t));
         dims->ptr[0] = len; dims->ptr[1] = subLen;
     } else {
         dims->len = 1;
-        dims->ptr = calloc(dims->len, sizeof(int));
+        dims->ptr = calloc(dims->len, sizeof(int64_t));
         dims->ptr[0] = len;
     }
     if (*dtype == UNKNOWN) {
@@ -128,9 +128,9 @@ fail:
 }
 
 void
-fill_buf_from_py_list(char *buf, int offset, PyObject *list, int n, ARRAY_DTYPE dtype) {
+fill_buf_from_py_list(char *buf, int64_t offset, PyObject *list, int64_t n, ARRAY_DTYPE dtype) {
     PyObject *pyVal = NULL;
-    for (int i = 0; i < n; i++) {
+    for (int64_t i = 0; i < n; i++) {
         pyVal = PySequence_GetItem(list, i);
         if (PyLong_Check(pyVal)) {
             switch (dtype) {
@@ -142,10 +142,10 @@ fill_buf_from_py_list(char *buf, int offset, PyObject *list, int n, ARRAY_DTYPE
             }
         } else if (PyFloat_Check(pyVal)) {
             switch (dtype) {
-            case INT32: ((int32_t *)buf)[i] = (int32_t)PyFloat_AsDouble(pyVal); break;
-            case INT64: ((int64_t *)buf)[i] = (int64_t)PyFloat_AsDouble(pyVal); break;
-            case FLOAT: ((float *)buf)[i] = (float)PyFloat_AsDouble(pyVal); break;
-            case DOUBLE: ((double *)buf)[i] = (double)PyFloat_AsDouble(pyVal); break;
+            case INT32: ((int32_t *)buf)[offset + i] = (int32_t)PyFloat_AsDouble(pyVal); break;
+            case INT64: ((int64_t *)buf)[offset + i] = (int64_t)PyFloat_AsDouble(pyVal); break;
+            case FLOAT: ((float *)buf)[offset + i] = (float)PyFloat_AsDouble(pyVal); break;
+            case DOUBLE: ((double *)buf)[offset + i] = (double)PyFloat_AsDouble(pyVal); break;
             case UNKNOWN: break;
             }
         }
@@ -154,13 +154,13 @@ fill_buf_from_py_list(char *buf, int offset, PyObject *list, int n, ARRAY_DTYPE
 }
 
 void
-fill_py_list_from_buf(PyObject *list, void *buf, int n, ARRAY_DTYPE dtype) {
-    for (int i = 0; i < n; i++) {
+fill_py_list_from_buf(PyObject *list, void *buf, int64_t n, ARRAY_DTYPE dtype) {
+    for (int64_t i = 0; i < n; i++) {
         switch (dtype) {
             case INT32: PyList_SetItem(list, i, PyLong_FromLong(((int32_t *)buf)[i])); break;
             case INT64: PyList_SetItem(list, i, PyLong_FromLong(((int64_t *)buf)[i])); break;
             case FLOAT: PyList_SetItem(list, i, PyFloat_FromDouble(((float *)buf)[i])); break;
-            case DOUBLE: PyList_SetItem(list, i, PyLong_FromDouble(((double *)buf)[i])); break;
+            case DOUBLE: PyList_SetItem(list, i, PyFloat_FromDouble(((double *)buf)[i])); break;
             case UNKNOWN: break;
         }
     }
@@ -176,7 +176,7 @@ fill_array_object_with_py_init(arrayObject *a, PyObject *obj, arrayDims *dims)
         fill_buf_from_py_list(a->data, 0, obj, a->dims[0], a->dtype);
     } else {
         PyObject *v = NULL;
-        for (int i = 0; i < a->dims[0]; i++) {
+        for (int64_t i = 0; i < a->dims[0]; i++) {
             v = PySequence_GetItem(obj, i);
             fill_buf_from_py_list(a->data, i * a->dims[1], v, a->dims[1], a->dtype);
             Py_DECREF(v);
@@ -195,9 +195,10 @@ py_seq_to_intp(PyObject *obj, arrayDims *out)
         return 1;
     }
 
-    int *dims = calloc(ARRAY_NUM_DIMS, sizeof(int));
+    int64_t *dims = calloc(ARRAY_NUM_DIMS, sizeof(int64_t));
     if (PyNumber_Check(obj)) {
-        int v = PyLong_AsLong(obj);
+        int64_t v = PyLong_AsLongLong(obj);
+        if (v == -1 && PyErr_Occurred()) goto fail;
         if (v <= 0) {
             PyErr_SetString(PyExc_ValueError,
                 "Expected positive value");
@@ -212,7 +213,7 @@ py_seq_to_intp(PyObject *obj, arrayDims *out)
     Py_ssize_t len = PySequence_Size(obj);
     if (validate_nd(len)) {
         PyErr_Format(PyExc_ValueError,
-            "Expected sequence of length [1, 2], got %d", len);
+            "Expected sequence of length [1, 2], got %zd", len);
         goto fail;
     }
 
@@ -228,8 +229,10 @@ py_seq_to_intp(PyObject *obj, arrayDims *out)
                 "Expected sequence of ints");
             goto fail;
         }
-        int v = PyLong_AsLong(valObj);
+        int64_t v = PyLong_AsLongLong(valObj);
         Py_DECREF(valObj);
+        valObj = NULL;
+        if (v == -1 && PyErr_Occurred()) goto fail;
         if (v < 0) {
             PyErr_SetString(PyExc_ValueError,
                 "Expected sequence of positive ints");
@@ -248,8 +251,53 @@ fail:
     return 0;
 }
 
+/* Like py_seq_to_intp for index lists: any length, negative values kept. */
+int
+py_seq_to_int_list(PyObject *obj, arrayDims *out)
+{
+    out->ptr = NULL;
+    out->len = 0;
+
+    if (obj == Py_None) {
+        return 1;
+    }
+
+    PyObject *seq = PySequence_Fast(obj, "Expected sequence of ints");
+    if (seq == NULL) {
+        return 0;
+    }
+    Py_ssize_t len = PySequence_Fast_GET_SIZE(seq);
+    int64_t *vals = malloc((len ? len : 1) * sizeof(int64_t));
+    if (vals == NULL) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return 0;
+    }
+    for (Py_ssize_t i = 0; i < len; i++) {
+        PyObject *valObj = PySequence_Fast_GET_ITEM(seq, i);
+        if (!PyLong_Check(valObj)) {
+            PyErr_SetString(PyExc_ValueError,
+                "Expected sequence of ints");
+            free(vals);
+            Py_DECREF(seq);
+            return 0;
+        }
+        vals[i] = PyLong_AsLongLong(valObj);
+        if (vals[i] == -1 && PyErr_Occurred()) {
+            free(vals);
+            Py_DECREF(seq);
+            return 0;
+        }
+    }
+    Py_DECREF(seq);
+
+    out->len = len;
+    out->ptr = vals;
+    return 1;
+}
+
 PyObject *
-py_tup_from_intp(int *vals, int n)
+py_tup_from_intp(int64_t *vals, int n)
 {
     PyObject *tup = PyTuple_New(n);
     if (tup == NULL) {
@@ -257,7 +305,7 @@ py_tup_from_intp(int *vals, int n)
     }
 
     for (int i = 0; i < n; i++) {
-        PyObject *v = PyLong_FromLong((long)vals[i]);
+        PyObject *v = PyLong_FromLongLong(vals[i]);
         if (v == NULL) {
             Py_DECREF(tup);
             return NULL;
@@ -7,19 +7,21 @@
 #include "array_dtypes.h"
 
 typedef struct arrayDims {
-    int *ptr;
+    int64_t *ptr;
     int len;
 } arrayDims;
 
 int py_seq_to_intp(PyObject *obj, arrayDims *out);
-PyObject *py_tup_from_intp(int *vals, int n);
+int py_seq_to_int_list(PyObject *obj, arrayDims *out);
+PyObject *py_tup_from_intp(int64_t *vals, int n);
 
 int check_py_list_uniform_type(PyObject *obj, PyTypeObject *type);
 int check_array_object_py_initialiser(PyObject *obj, arrayDims *dims, ARRAY_DTYPE *dtype);
 
 void fill_array_object_with_py_init(arrayObject *a, PyObject *obj, arrayDims *dims);
-void fill_buf_from_py_list(char *buf, int offset, PyObject *list, int n, ARRAY_DTYPE dtype);
-void fill_py_list_from_buf(PyObject *list, void *buf, int n, ARRAY_DTYPE dtype);
+void fill_buf_from_py_list(char *buf, int64_t offset, PyObject *list, int64_t n,
+                           ARRAY_DTYPE dtype);
+void fill_py_list_from_buf(PyObject *list, void *buf, int64_t n, ARRAY_DTYPE dtype);
 
 
 #endif
@@ -0,0 +1,689 @@
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "array_dtypes.h"
+#include "array_parallel.h"
+#include "array_sort.h"
+#include "array_stats.h"
+#include "array_trace.h"
+
+#define SORT_RADIX 256
+/* Lanes and selection ranges up to this long are insertion sorted. */
+#define SORT_INSERTION_MAX 32
+#define SORT_PARALLEL_MIN_ELEMS (1 << 16)
+#define SORT_GRAIN_ELEMS (1 << 14)
+
+typedef enum {
+    SORT_VALUES,
+    SORT_INDICES,
+    SORT_PARTITION,
+    SORT_TOPK,
+} SORT_MODE;
+
+/* A lane of an array walked row-major as a rows x cols block. */
+typedef struct {
+    int64_t rows;
+    int64_t cols;
+    int64_t rs;
+    int64_t cs;
+} laneShape;
+
+typedef void (*load_func)(void *, const char *, const laneShape *, int64_t, int64_t,
+                          uint64_t *, uint64_t *);
+typedef void (*store_func)(char *, const laneShape *, const void *, int64_t, int64_t);
+
+static inline uint32_t key_int32(int32_t x) { return (uint32_t)x ^ 0x80000000u; }
+static inline int32_t val_int32(uint32_t k) { return (int32_t)(k ^ 0x80000000u); }
+static inline uint64_t key_int64(int64_t x) { return (uint64_t)x ^ 0x8000000000000000ull; }
+static inline int64_t val_int64(uint64_t k) { return (int64_t)(k ^ 0x8000000000000000ull); }
+
+static inline uint32_t
+key_float(float x)
+{
+    uint32_t u;
+    memcpy(&u, &x, sizeof(u));
+    if ((u & 0x7fffffffu) > 0x7f800000u) u &= 0x7fffffffu;
+    return u >> 31 ? ~u : u | 0x80000000u;
+}
+
+static inline float
+val_float(uint32_t k)
+{
+    uint32_t u = k >> 31 ? k ^ 0x80000000u : ~k;
+    float x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+static inline uint64_t
+key_double(double x)
+{
+    uint64_t u;
+    memcpy(&u, &x, sizeof(u));
+    if ((u & 0x7fffffffffffffffull) > 0x7ff0000000000000ull) u &= 0x7fffffffffffffffull;
+    return u >> 63 ? ~u : u | 0x8000000000000000ull;
+}
+
+static inline double
+val_double(uint64_t k)
+{
+    uint64_t u = k >> 63 ? k ^ 0x8000000000000000ull : ~k;
+    double x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+/*
+ * load reads elements [begin, end) of a lane as keys, also returning the
+ * OR and AND of the keys, whose XOR marks the bits that vary; store writes
+ * keys back as values.
+ */
+#define DEFINE_LANE_KERNELS(T, U, name) \
+    static void load_##name(void *keys, const char *base, const laneShape *l, \
+                            int64_t begin, int64_t end, uint64_t *or_bits, \
+                            uint64_t *and_bits) { \
+        U *k = keys; \
+        U o = 0, a = (U)~(U)0; \
+        int64_t j = begin % l->cols; \
+        const T *row = (const T *)base + (begin / l->cols) * l->rs; \
+        for (int64_t m = begin; m < end; m++) { \
+            U v = key_##name(row[j * l->cs]); \
+            k[m] = v; \
+            o |= v; \
+            a &= v; \
+            if (++j == l->cols) { \
+                j = 0; \
+                row += l->rs; \
+            } \
+        } \
+        *or_bits = o; \
+        *and_bits = a; \
+    } \
+    static void store_##name(char *base, const laneShape *l, const void *keys, \
+                             int64_t begin, int64_t end) { \
+        const U *k = keys; \
+        int64_t j = begin % l->cols; \
+        T *row = (T *)base + (begin / l->cols) * l->rs; \
+        for (int64_t m = begin; m < end; m++) { \
+            row[j * l->cs] = val_##name(k[m]); \
+            if (++j == l->cols) { \
+                j = 0; \
+                row += l->rs; \
+            } \
+        } \
+    }
+
+DEFINE_LANE_KERNELS(int32_t, uint32_t, int32)
+DEFINE_LANE_KERNELS(int64_t, uint64_t, int64)
+DEFINE_LANE_KERNELS(float, uint32_t, float)
+DEFINE_LANE_KERNELS(double, uint64_t, double)
+
+static const load_func load_funcs[] = {load_int32, load_int64, load_float, load_double};
+static const store_func store_funcs[] = {store_int32, store_int64, store_float, store_double};
+
+static void
+store_indices(char *base, const laneShape *l, const void *indices, int64_t begin, int64_t end)
+{
+    const int64_t *idx = indices;
+    int64_t j = begin % l->cols;
+    int64_t *row = (int64_t *)base + (begin / l->cols) * l->rs;
+    for (int64_t m = begin; m < end; m++) {
+        row[j * l->cs] = idx[m];
+        if (++j == l->cols) {
+            j = 0;
+            row += l->rs;
+        }
+    }
+}
+
+typedef struct {
+    SORT_MODE mode;
+    const char *src;        // first lane of the input
+    laneShape lane;
+    int64_t step;           // elements between input lanes
+    char *dst;              // values out, for all but argsort
+    laneShape dst_lane;
+    int64_t dst_step;
+    char *idx_dst;          // INT64 positions out, for argsort and topk
+    laneShape idx_lane;
+    int64_t idx_step;
+    int64_t n;              // lane length
+    int64_t k;              // kth for partition, count for topk
+    int largest;
+    int nchunks;            // > 1 splits each pass of a lane across threads
+    size_t size;
+    load_func load;
+    store_func store;
+    int failed;
+} sortCtx;
+
+typedef struct {
+    const sortCtx *c;
+    const char *src;
+    void *keys;
+    uint64_t or_bits;
+    uint64_t and_bits;
+} loadCtx;
+
+static void
+load_range(void *arg, int64_t begin, int64_t end)
+{
+    loadCtx *x = arg;
+    uint64_t o, a;
+    x->c->load(x->keys, x->src, &x->c->lane, begin, end, &o, &a);
+    __atomic_fetch_or(&x->or_bits, o, __ATOMIC_RELAXED);
+    __atomic_fetch_and(&x->and_bits, a, __ATOMIC_RELAXED);
+}
+
+/* Loads lane l as keys; returns the mask of key bits that vary. */
+static uint64_t
+load_lane(const sortCtx *c, int64_t l, void *keys)
+{
+    loadCtx x = {c, c->src + l * c->step * c->size, keys, 0, ~0ull};
+    if (c->nchunks > 1) {
+        parallel_for(c->n, SORT_GRAIN_ELEMS, load_range, &x);
+    } else {
+        load_range(&x, 0, c->n);
+    }
+    return x.or_bits ^ x.and_bits;
+}
+
+typedef struct {
+    store_func store;
+    char *dst;
+    const laneShape *lane;
+    const void *src;
+} storeCtx;
+
+static void
+store_range(void *arg, int64_t begin, int64_t end)
+{
+    storeCtx *x = arg;
+    x->store(x->dst, x->lane, x->src, begin, end);
+}
+
+static void
+store_lane(const sortCtx *c, store_func store, char *dst, const laneShape *lane,
+           const void *src, int64_t n)
+{
+    storeCtx x = {store, dst, lane, src};
+    if (c->nchunks > 1) {
+        parallel_for(n, SORT_GRAIN_ELEMS, store_range, &x);
+    } else {
+        store_range(&x, 0, n);
+    }
+}
+
+typedef struct {
+    const void *src;
+    void *dst;
+    const int64_t *isrc;
+    int64_t *idst;
+    int64_t n;
+    int64_t chunk;
+    int shift;
+    int64_t (*hist)[SORT_RADIX];
+} radixCtx;
+
+/* Orders by key, then by position when positions are carried. */
+#define KEY_LESS(ka, ia, kb, ib) ((ka) < (kb) || (idx && (ka) == (kb) && (ia) < (ib)))
+#define KEY_LESS_AT(k, idx, x, y) KEY_LESS(k[x], idx ? idx[x] : 0, k[y], idx ? idx[y] : 0)
+#define KEY_SWAP(U, k, idx, x, y) \
+    do { \
+        U t_ = k[x]; \
+        k[x] = k[y]; \
+        k[y] = t_; \
+        if (idx) { \
+            int64_t u_ = idx[x]; \
+            idx[x] = idx[y]; \
+            idx[y] = u_; \
+        } \
+    } while (0)
+
+/*
+ * Sorting and selection over U keys, with positions in idx alongside
+ * unless it is NULL. Radix passes count then scatter each chunk of the
+ * keys; the counts, laid out digit-major across chunks, become the
+ * offsets each chunk scatters from, so the sort stays stable. Selection is
+ * a median-of-three quickselect that falls back to heapsort when it stops
+ * shrinking the range.
+ */
+#define DEFINE_KEY_ALGOS(U, name) \
+    static void insertion_##name(U *k, int64_t *idx, int64_t lo, int64_t hi) { \
+        for (int64_t m = lo + 1; m < hi; m++) { \
+            U v = k[m]; \
+            int64_t vi = idx ? idx[m] : 0; \
+            int64_t p = m; \
+            for (; p > lo && KEY_LESS(v, vi, k[p - 1], idx ? idx[p - 1] : 0); p--) { \
+                k[p] = k[p - 1]; \
+                if (idx) idx[p] = idx[p - 1]; \
+            } \
+            k[p] = v; \
+            if (idx) idx[p] = vi; \
+        } \
+    } \
+    static void heapsort_##name(U *k, int64_t *idx, int64_t lo, int64_t hi) { \
+        int64_t n = hi - lo; \
+        for (int64_t end = n, start = n / 2; end > 1;) { \
+            int64_t r; \
+            if (start > 0) { \
+                r = --start; \
+            } else { \
+                end--; \
+                KEY_SWAP(U, k, idx, lo, lo + end); \
+                r = 0; \
+            } \
+            for (int64_t c; (c = 2 * r + 1) < end; r = c) { \
+                int64_t x = lo + c, y = lo + c + 1, p = lo + r; \
+                if (c + 1 < end && KEY_LESS_AT(k, idx, x, y)) { \
+                    c++; \
+                    x = y; \
+                } \
+                if (!KEY_LESS_AT(k, idx, p, x)) break; \
+                KEY_SWAP(U, k, idx, p, x); \
+            } \
+        } \
+    } \
+    /* Moves the key of rank kth in k[0, n) to k[kth], partitioning around it. */ \
+    static void select_##name(U *k, int64_t *idx, int64_t n, int64_t kth) { \
+        int64_t lo = 0, hi = n - 1; \
+        int budget = 2 * (64 - __builtin_clzll((unsigned long long)n)); \
+        while (hi - lo >= SORT_INSERTION_MAX) { \
+            if (budget-- == 0) { \
+                heapsort_##name(k, idx, lo, hi + 1); \
+                return; \
+            } \
+            int64_t mid = lo + (hi - lo) / 2; \
+            if (KEY_LESS_AT(k, idx, mid, lo)) { \
+                KEY_SWAP(U, k, idx, mid, lo); \
+            } \
+            if (KEY_LESS_AT(k, idx, hi, mid)) { \
+                KEY_SWAP(U, k, idx, hi, mid); \
+                if (KEY_LESS_AT(k, idx, mid, lo)) { \
+                    KEY_SWAP(U, k, idx, mid, lo); \
+                } \
+            } \
+            U pk = k[mid]; \
+            int64_t pi = idx ? idx[mid] : 0; \
+            int64_t i = lo, j = hi; \
+            while (i <= j) { \
+                while (KEY_LESS(k[i], idx ? idx[i] : 0, pk, pi)) i++; \
+                while (KEY_LESS(pk, pi, k[j], idx ? idx[j] : 0)) j--; \
+                if (i <= j) { \
+                    KEY_SWAP(U, k, idx, i, j); \
+                    i++; \
+                    j--; \
+                } \
+            } \
+            if (j < kth && kth < i) return; \
+            if (kth <= j) { \
+                hi = j; \
+            } else { \
+                lo = i; \
+            } \
+        } \
+        insertion_##name(k, idx, lo, hi + 1); \
+    } \
+    static void radix_count_##name(void *arg, int64_t begin, int64_t end) { \
+        radixCtx *c = arg; \
+        const U *src = c->src; \
+        for (int64_t ch = begin; ch < end; ch++) { \
+            int64_t *h = c->hist[ch]; \
+            int64_t lo = ch * c->chunk, hi = lo + c->chunk < c->n ? lo + c->chunk : c->n; \
+            memset(h, 0, SORT_RADIX * sizeof(int64_t)); \
+            for (int64_t m = lo; m < hi; m++) h[(src[m] >> c->shift) & 0xff]++; \
+        } \
+    } \
+    static void radix_scatter_##name(void *arg, int64_t begin, int64_t end) { \
+        radixCtx *c = arg; \
+        const U *src = c->src; \
+        U *dst = c->dst; \
+        for (int64_t ch = begin; ch < end; ch++) { \
+            int64_t *pos = c->hist[ch]; \
+            int64_t lo = ch * c->chunk, hi = lo + c->chunk < c->n ? lo + c->chunk : c->n; \
+            if (c->isrc) { \
+                for (int64_t m = lo; m < hi; m++) { \
+                    int64_t p = pos[(src[m] >> c->shift) & 0xff]++; \
+                    dst[p] = src[m]; \
+                    c->idst[p] = c->isrc[m]; \
+                } \
+            } else { \
+                for (int64_t m = lo; m < hi; m++) { \
+                    dst[pos[(src[m] >> c->shift) & 0xff]++] = src[m]; \
+                } \
+            } \
+        } \
+    } \
+    /* \
+     * Sorts the n keys over the bytes that vary in diff, ping-ponging with tmp \
+     * and itmp. Returns the buffer holding the result, and its positions in \
+     * *idx_out. \
+     */ \
+    static U *radix_sort_##name(U *keys, U *tmp, int64_t *idx, int64_t *itmp, int64_t n, \
+                                uint64_t diff, int64_t (*hist)[SORT_RADIX], int nchunks, \
+                                int64_t **idx_out) { \
+        if (n <= SORT_INSERTION_MAX) { \
+            insertion_##name(keys, idx, 0, n); \
+            *idx_out = idx; \
+            return keys; \
+        } \
+        radixCtx c = {.n = n, .chunk = (n + nchunks - 1) / nchunks, .hist = hist}; \
+        for (int shift = 0; shift < (int)(8 * sizeof(U)); shift += 8) { \
+            if (!((diff >> shift) & 0xff)) continue; \
+            c.src = keys; \
+            c.dst = tmp; \
+            c.isrc = idx; \
+            c.idst = itmp; \
+            c.shift = shift; \
+            if (nchunks > 1) { \
+                parallel_for(nchunks, 1, radix_count_##name, &c); \
+            } else { \
+                radix_count_##name(&c, 0, 1); \
+            } \
+            int64_t sum = 0; \
+            for (int d = 0; d < SORT_RADIX; d++) { \
+                for (int ch = 0; ch < nchunks; ch++) { \
+                    int64_t count = hist[ch][d]; \
+                    hist[ch][d] = sum; \
+                    sum += count; \
+                } \
+            } \
+            if (nchunks > 1) { \
+                parallel_for(nchunks, 1, radix_scatter_##name, &c); \
+            } else { \
+                radix_scatter_##name(&c, 0, 1); \
+            } \
+            U *t = keys; \
+            keys = tmp; \
+            tmp = t; \
+            int64_t *it = idx; \
+            idx = itmp; \
+            itmp = it; \
+        } \
+        *idx_out = idx; \
+        return keys; \
+    } \
+    static void lane_##name(const sortCtx *c, int64_t l, U *keys, U *tmp, int64_t *idx, \
+                            int64_t *itmp, int64_t (*hist)[SORT_RADIX]) { \
+        int64_t n = c->n; \
+        int64_t *ridx; \
+        U *res; \
+        uint64_t diff = load_lane(c, l, keys); \
+        char *dst = c->dst ? c->dst + l * c->dst_step * c->size : NULL; \
+        char *idx_dst = c->idx_dst ? c->idx_dst + l * c->idx_step * sizeof(int64_t) : NULL; \
+        switch (c->mode) { \
+        case SORT_VALUES: \
+            res = radix_sort_##name(keys, tmp, NULL, NULL, n, diff, hist, c->nchunks, &ridx); \
+            store_lane(c, c->store, dst, &c->dst_lane, res, n); \
+            break; \
+        case SORT_INDICES: \
+            for (int64_t m = 0; m < n; m++) idx[m] = m; \
+            radix_sort_##name(keys, tmp, idx, itmp, n, diff, hist, c->nchunks, &ridx); \
+            store_lane(c, store_indices, idx_dst, &c->idx_lane, ridx, n); \
+            break; \
+        case SORT_PARTITION: \
+            select_##name(keys, NULL, n, c->k); \
+            store_lane(c, c->store, dst, &c->dst_lane, keys, n); \
+            break; \
+        case SORT_TOPK: { \
+            /* Select the k-th smallest (key, position), then keep the keys up \
+             * to it in lane order so the stable sort breaks ties by position. */ \
+            int64_t k = c->k, kept = 0; \
+            if (c->largest) { \
+                for (int64_t m = 0; m < n; m++) keys[m] = ~keys[m]; \
+            } \
+            memcpy(tmp, keys, n * sizeof(U)); \
+            for (int64_t m = 0; m < n; m++) itmp[m] = m; \
+            select_##name(tmp, itmp, n, k - 1); \
+            U bk = tmp[k - 1]; \
+            int64_t bi = itmp[k - 1]; \
+            for (int64_t m = 0; m < n; m++) { \
+                if (keys[m] < bk || (keys[m] == bk && m <= bi)) { \
+                    tmp[kept] = keys[m]; \
+                    itmp[kept++] = m; \
+                } \
+            } \
+            res = radix_sort_##name(tmp, keys, itmp, idx, k, diff, hist, 1, &ridx); \
+            if (c->largest) { \
+                for (int64_t m = 0; m < k; m++) res[m] = ~res[m]; \
+            } \
+            store_lane(c, c->store, dst, &c->dst_lane, res, k); \
+            store_lane(c, store_indices, idx_dst, &c->idx_lane, ridx, k); \
+            break; \
+        } \
+        } \
+    }
+
+DEFINE_KEY_ALGOS(uint32_t, u32)
+DEFINE_KEY_ALGOS(uint64_t, u64)
+
+static void
+sort_lanes(void *arg, int64_t begin, int64_t end)
+{
+    sortCtx *c = arg;
+    int with_idx = c->mode == SORT_INDICES || c->mode == SORT_TOPK;
+    char *keys = malloc(c->n * c->size);
+    char *tmp = c->mode != SORT_PARTITION ? malloc(c->n * c->size) : NULL;
+    int64_t *idx = with_idx ? malloc(c->n * sizeof(int64_t)) : NULL;
+    int64_t *itmp = with_idx ? malloc(c->n * sizeof(int64_t)) : NULL;
+    int64_t (*hist)[SORT_RADIX] = malloc(c->nchunks * sizeof(*hist));
+    if (keys == NULL || hist == NULL || (c->mode != SORT_PARTITION && tmp == NULL) ||
+        (with_idx && (idx == NULL || itmp == NULL))) {
+        __atomic_store_n(&c->failed, 1, __ATOMIC_RELAXED);
+        goto done;
+    }
+    for (int64_t l = begin; l < end; l++) {
+        if (c->size == sizeof(uint32_t)) {
+            lane_u32(c, l, (uint32_t *)keys, (uint32_t *)tmp, idx, itmp, hist);
+        } else {
+            lane_u64(c, l, (uint64_t *)keys, (uint64_t *)tmp, idx, itmp, hist);
+        }
+    }
+
+done:
+    free(keys);
+    free(tmp);
+    free(idx);
+    free(itmp);
+    free(hist);
+}
+
+/* The lanes of a along axis, or its flattening as one lane if negative. */
+static int64_t
+lane_shape(const arrayObject *a, int axis, laneShape *lane, int64_t *step)
+{
+    if (axis < 0) {
+        *lane = (laneShape){a->dims[0], a->dims[1], a->strides[0], a->strides[1]};
+        *step = 0;
+        return 1;
+    }
+    if (axis == 1) {
+        *lane = (laneShape){1, a->dims[1], 0, a->strides[1]};
+        *step = a->strides[0];
+        return a->dims[0];
+    }
+    *lane = (laneShape){a->dims[0], 1, a->strides[0], 0};
+    *step = a->strides[1];
+    return a->dims[1];
+}
+
+static int64_t
+lane_length(const arrayObject *a, int axis)
+{
+    return axis < 0 ? NUM_ARRAY_ELEMS(a) : a->dims[axis];
+}
+
+/* Dims of a result holding len elements per lane. */
+static void
+result_dims(const arrayObject *a, int axis, int64_t len, int64_t dims[ARRAY_NUM_DIMS])
+{
+    if (axis < 0) {
+        dims[0] = len;
+        dims[1] = 1;
+    } else {
+        dims[axis] = len;
+        dims[1 - axis] = a->dims[1 - axis];
+    }
+}
+
+static int
+sort_into(const arrayObject *a, int axis, SORT_MODE mode, int64_t k, int largest,
+          arrayObject *out, arrayObject *out_idx)
+{
+    sortCtx c = {.mode = mode, .src = a->data, .k = k, .largest = largest, .nchunks = 1,
+                 .size = array_dtype_size(a->dtype), .load = load_funcs[a->dtype],
+                 .store = store_funcs[a->dtype]};
+    int64_t lanes = lane_shape(a, axis, &c.lane, &c.step);
+    c.n = lane_length(a, axis);
+    // Nothing to do, and the lane loops divide by the lane shape.
+    if (lanes == 0 || c.n == 0) return 0;
+    // Flat results are (n, 1) columns.
+    int out_axis = axis < 0 ? 0 : axis;
+    if (out) {
+        c.dst = out->data;
+        lane_shape(out, out_axis, &c.dst_lane, &c.dst_step);
+    }
+    if (out_idx) {
+        c.idx_dst = out_idx->data;
+        lane_shape(out_idx, out_axis, &c.idx_lane, &c.idx_step);
+    }
+
+    int threads = parallel_num_threads();
+    if ((mode == SORT_VALUES || mode == SORT_INDICES) && threads > 1 &&
+        c.n >= SORT_PARALLEL_MIN_ELEMS && lanes < threads) {
+        int64_t chunks = c.n / SORT_GRAIN_ELEMS;
+        c.nchunks = chunks < threads ? (int)chunks : threads;
+        sort_lanes(&c, 0, lanes);
+    } else if (lanes > 1 && lanes * c.n >= SORT_PARALLEL_MIN_ELEMS) {
+        int64_t grain = c.n < SORT_GRAIN_ELEMS ? SORT_GRAIN_ELEMS / c.n : 1;
+        parallel_for(lanes, grain, sort_lanes, &c);
+    } else {
+        sort_lanes(&c, 0, lanes);
+    }
+    return c.failed;
+}
+
+static int
+check_axis(const arrayObject *a, int axis)
+{
+    if (axis >= a->nd) {
+        printf("Axis %d out of range\n", axis);
+        return 1;
+    }
+    return 0;
+}
+
+static int
+check_out(const arrayObject *a, const arrayObject *out, const int64_t dims[ARRAY_NUM_DIMS])
+{
+    if (out->dtype != a->dtype || out->dims[0] != dims[0] || out->dims[1] != dims[1]) {
+        printf("Output dtype and dims must match the result\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* Sorts or partitions a into out, or a new array. */
+static arrayObject *
+sort_values(const arrayObject *a, int axis, SORT_MODE mode, int64_t kth, arrayObject *out)
+{
+    int64_t dims[ARRAY_NUM_DIMS];
+    result_dims(a, axis, lane_length(a, axis), dims);
+    if (out && check_out(a, out, dims)) return NULL;
+
+    arrayObject *ret = out ? out : array_empty(dims, ARRAY_NUM_DIMS, a->dtype);
+    if (ret && sort_into(a, axis, mode, kth, 0, ret, NULL)) {
+        if (ret != out) array_free(ret);
+        ret = NULL;
+    }
+    return ret;
+}
+
+arrayObject*
+array_sort(const arrayObject *a, int axis, arrayObject *out)
+{
+    if (check_axis(a, axis)) return NULL;
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_sort", a->dtype, a->dims, NULL);
+    arrayObject *ret = sort_values(a, axis, SORT_VALUES, 0, out);
+    ARRAY_TRACE_END("array_sort");
+    ARRAY_STATS_END(t0, STATS_SORT, NUM_ARRAY_ELEMS(a),
+                    ret && !out ? NUM_ARRAY_ELEMS(ret) * array_dtype_size(a->dtype) : 0);
+    return ret;
+}
+
+arrayObject*
+array_argsort(const arrayObject *a, int axis)
+{
+    int64_t dims[ARRAY_NUM_DIMS];
+    if (check_axis(a, axis)) return NULL;
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_argsort", a->dtype, a->dims, NULL);
+    result_dims(a, axis, lane_length(a, axis), dims);
+    arrayObject *ret = array_empty(dims, ARRAY_NUM_DIMS, INT64);
+    if (ret && sort_into(a, axis, SORT_INDICES, 0, 0, NULL, ret)) {
+        array_free(ret);
+        ret = NULL;
+    }
+    ARRAY_TRACE_END("array_argsort");
+    ARRAY_STATS_END(t0, STATS_SORT, NUM_ARRAY_ELEMS(a),
+                    ret ? NUM_ARRAY_ELEMS(ret) * sizeof(int64_t) : 0);
+    return ret;
+}
+
+arrayObject*
+array_partition(const arrayObject *a, int64_t kth, int axis, arrayObject *out)
+{
+    if (check_axis(a, axis)) return NULL;
+    int64_t n = lane_length(a, axis);
+    if (kth < 0) kth += n;
+    if (kth < 0 || kth >= n) {
+        printf("kth %" PRId64 " out of range for length %" PRId64 "\n", kth, n);
+        return NULL;
+    }
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_partition", a->dtype, a->dims, NULL);
+    arrayObject *ret = sort_values(a, axis, SORT_PARTITION, kth, out);
+    ARRAY_TRACE_END("array_partition");
+    ARRAY_STATS_END(t0, STATS_SORT, NUM_ARRAY_ELEMS(a),
+                    ret && !out ? NUM_ARRAY_ELEMS(ret) * array_dtype_size(a->dtype) : 0);
+    return ret;
+}
+
+int
+array_topk(const arrayObject *a, int64_t k, int axis, int largest,
+           arrayObject **values, arrayObject **indices)
+{
+    int64_t dims[ARRAY_NUM_DIMS];
+    if (check_axis(a, axis)) return 1;
+    int64_t n = lane_length(a, axis);
+    if (k < 1 || k > n) {
+        printf("k %" PRId64 " out of range for length %" PRId64 "\n", k, n);
+        return 1;
+    }
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("array_topk", a->dtype, a->dims, NULL);
+    result_dims(a, axis, k, dims);
+    *values = array_empty(dims, ARRAY_NUM_DIMS, a->dtype);
+    *indices = array_empty(dims, ARRAY_NUM_DIMS, INT64);
+    int ret = *values == NULL || *indices == NULL ||
+              sort_into(a, axis, SORT_TOPK, k, largest, *values, *indices);
+    if (ret) {
+        array_free(*values);
+        array_free(*indices);
+        *values = *indices = NULL;
+    }
+    ARRAY_TRACE_END("array_topk");
+    ARRAY_STATS_END(t0, STATS_SORT, NUM_ARRAY_ELEMS(a),
+                    ret ? 0 : NUM_ARRAY_ELEMS((*values)) * (array_dtype_size(a->dtype) +
+                                                          sizeof(int64_t)));
+    return ret;
+}
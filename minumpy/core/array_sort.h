@@ -0,0 +1,42 @@
+#ifndef ARRAY_SORT_H
+#define ARRAY_SORT_H
+
+#include "array.h"
+
+/*
+ * Sorting and selection along axis 0 (within columns) or 1 (within rows),
+ * or over the row-major flattening of a when axis is negative, which gives
+ * (n, 1) results.
+ *
+ * Every dtype is sorted as unsigned integer keys that order like its
+ * values: integers with the sign bit flipped, floats with all bits of
+ * negatives flipped and the sign bit of the rest set. So -0.0 sorts before
+ * 0.0, and NaNs, with their sign dropped, after +inf. Sorts are stable LSD
+ * radix sorts with one pass per key byte that differs between elements;
+ * a long lane splits each pass across the thread pool, and many shorter
+ * lanes are sorted concurrently.
+ */
+
+/*
+ * Sorts a along axis into out, which may be a itself, or into a new array
+ * when out is NULL. Returns NULL if out does not match the result.
+ */
+arrayObject *array_sort(const arrayObject *a, int axis, arrayObject *out);
+/* The INT64 positions along axis (or row-major) that would sort a. */
+arrayObject *array_argsort(const arrayObject *a, int axis);
+/*
+ * Reorders each lane so its kth element (negative counts from the end) is
+ * where a sort would put it, with no larger element before it and no
+ * smaller one after, into out as for array_sort. Returns NULL for kth out
+ * of range.
+ */
+arrayObject *array_partition(const arrayObject *a, int64_t kth, int axis, arrayObject *out);
+/*
+ * The k smallest, or largest, elements of each lane in sorted order
+ * (descending for largest), with their INT64 positions; ties go to the
+ * lower position. Returns 1 for k outside [1, lane length].
+ */
+int array_topk(const arrayObject *a, int64_t k, int axis, int largest,
+               arrayObject **values, arrayObject **indices);
+
+#endif
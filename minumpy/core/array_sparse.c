@@ -0,0 +1,184 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "array_dtypes.h"
+#include "array_mem.h"
+#include "array_sparse.h"
+#include "array_stats.h"
+#include "array_trace.h"
+#include "array_utils.h"
+
+static csrObject*
+csr_alloc(int64_t rows, int64_t cols, int64_t nnz, ARRAY_DTYPE dtype)
+{
+    csrObject *s = malloc(sizeof(csrObject));
+    if (s == NULL) return NULL;
+    s->dtype = dtype;
+    s->dims[0] = rows;
+    s->dims[1] = cols;
+    s->nnz = nnz;
+    s->indptr = calloc(rows + 1, sizeof(int64_t));
+    s->indices = malloc((nnz ? nnz : 1) * sizeof(int64_t));
+    s->data = array_data_alloc(nnz, dtype, 0);
+    if (s->indptr == NULL || s->indices == NULL || s->data == NULL) {
+        csr_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+void
+csr_free(csrObject *s)
+{
+    if (!s) return;
+    free(s->indptr);
+    free(s->indices);
+    array_data_free(s->data);
+    free(s);
+}
+
+csrObject*
+csr_from_dense(const arrayObject *a)
+{
+    ARRAY_TRACE_BEGIN("csr_from_dense", a->dtype, a->dims, NULL);
+    int64_t rows = a->dims[0];
+    int64_t cols = a->dims[1];
+    int64_t *counts = malloc((rows ? rows : 1) * sizeof(int64_t));
+    if (counts == NULL) {
+        ARRAY_TRACE_END("csr_from_dense");
+        return NULL;
+    }
+    int64_t nnz = csr_count_nonzero(counts, a->data, rows, cols, a->strides[0], a->strides[1],
+                                    a->dtype);
+    csrObject *s = csr_alloc(rows, cols, nnz, a->dtype);
+    if (s != NULL) {
+        for (int64_t i = 0; i < rows; i++) {
+            s->indptr[i + 1] = s->indptr[i] + counts[i];
+        }
+        csr_gather_nonzero(s->indices, s->data, a->data, rows, cols, a->strides[0],
+                           a->strides[1], a->dtype);
+    }
+    free(counts);
+    ARRAY_TRACE_END("csr_from_dense");
+    return s;
+}
+
+typedef struct csrEntry {
+    int64_t col;
+    int64_t src;  // index into the triplets
+} csrEntry;
+
+static int
+compare_entries(const void *x, const void *y)
+{
+    const csrEntry *a = x;
+    const csrEntry *b = y;
+    if (a->col != b->col) return a->col < b->col ? -1 : 1;
+    return a->src < b->src ? -1 : a->src > b->src;
+}
+
+csrObject*
+csr_from_triplets(const int64_t *row_idx, const int64_t *col_idx, const void *vals,
+                  int64_t nnz, int64_t rows, int64_t cols, ARRAY_DTYPE dtype)
+{
+    for (int64_t p = 0; p < nnz; p++) {
+        if (row_idx[p] < 0 || row_idx[p] >= rows || col_idx[p] < 0 || col_idx[p] >= cols) {
+            printf("Triplet %" PRId64 " (%" PRId64 ", %" PRId64 ") out of range for "
+                   "(%" PRId64 ", %" PRId64 ")\n", p, row_idx[p], col_idx[p], rows, cols);
+            return NULL;
+        }
+    }
+
+    // Bucket the triplets by row, then sort each row by column and fold
+    // duplicates into the first entry.
+    int64_t *starts = calloc(rows + 1, sizeof(int64_t));
+    csrEntry *entries = malloc((nnz ? nnz : 1) * sizeof(csrEntry));
+    csrObject *s = NULL;
+    if (starts == NULL || entries == NULL) goto done;
+    for (int64_t p = 0; p < nnz; p++) starts[row_idx[p] + 1]++;
+    for (int64_t i = 0; i < rows; i++) starts[i + 1] += starts[i];
+    for (int64_t p = 0; p < nnz; p++) {
+        entries[starts[row_idx[p]]++] = (csrEntry){col_idx[p], p};
+    }
+    // starts[i] now holds the end of row i; shift back to the starts.
+    memmove(starts + 1, starts, rows * sizeof(int64_t));
+    starts[0] = 0;
+
+    int64_t unique = 0;
+    for (int64_t i = 0; i < rows; i++) {
+        int64_t begin = starts[i];
+        int64_t end = starts[i + 1];
+        qsort(entries + begin, end - begin, sizeof(csrEntry), compare_entries);
+        for (int64_t p = begin; p < end; p++) {
+            unique += p == begin || entries[p].col != entries[p - 1].col;
+        }
+    }
+
+    s = csr_alloc(rows, cols, unique, dtype);
+    if (s == NULL) goto done;
+    size_t dtype_size = array_dtype_size(dtype);
+    int64_t q = -1;
+    for (int64_t i = 0; i < rows; i++) {
+        for (int64_t p = starts[i]; p < starts[i + 1]; p++) {
+            const char *v = (const char *)vals + (size_t)entries[p].src * dtype_size;
+            if (p > starts[i] && entries[p].col == entries[p - 1].col) {
+                buf_add_val(s->data + (size_t)q * dtype_size, (void *)v, dtype);
+            } else {
+                q++;
+                s->indices[q] = entries[p].col;
+                memcpy(s->data + (size_t)q * dtype_size, v, dtype_size);
+            }
+        }
+        s->indptr[i + 1] = q + 1;
+    }
+
+done:
+    free(starts);
+    free(entries);
+    return s;
+}
+
+arrayObject*
+csr_to_dense(const csrObject *s)
+{
+    arrayObject *ret = array_alloc((int64_t *)s->dims, ARRAY_NUM_DIMS, s->dtype);
+    if (ret == NULL) return NULL;
+    size_t dtype_size = array_dtype_size(s->dtype);
+    for (int64_t i = 0; i < s->dims[0]; i++) {
+        for (int64_t p = s->indptr[i]; p < s->indptr[i + 1]; p++) {
+            memcpy(ret->data + ((size_t)i * s->dims[1] + s->indices[p]) * dtype_size,
+                   s->data + (size_t)p * dtype_size, dtype_size);
+        }
+    }
+    return ret;
+}
+
+arrayObject*
+csr_dot(const csrObject *s, const arrayObject *b)
+{
+    if (s->dims[1] != b->dims[0]) {
+        printf("Dims mismatch (%" PRId64 " %" PRId64 ")\n", s->dims[1], b->dims[0]);
+        return NULL;
+    }
+    if (s->dtype != b->dtype) {
+        printf("dtype mismatch (%d %d)\n", s->dtype, b->dtype);
+        return NULL;
+    }
+
+    ARRAY_STATS_BEGIN(t0);
+    ARRAY_TRACE_BEGIN("csr_dot", s->dtype, s->dims, b->dims);
+    int64_t ret_dims[] = {s->dims[0], b->dims[1]};
+    arrayObject *ret = array_alloc(ret_dims, ARRAY_NUM_DIMS, s->dtype);
+    if (ret == NULL) {
+        ARRAY_TRACE_END("csr_dot");
+        return NULL;
+    }
+    spmm(ret->data, s->indptr, s->indices, s->data, s->dims[0],
+         b->data, b->strides[0], b->strides[1], b->dims[1], s->dtype);
+    ARRAY_TRACE_END("csr_dot");
+    ARRAY_STATS_END(t0, STATS_DOT, s->nnz + NUM_ARRAY_ELEMS(b), 0);
+    return ret;
+}
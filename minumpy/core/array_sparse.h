@@ -0,0 +1,34 @@
+#ifndef ARRAY_SPARSE_H
+#define ARRAY_SPARSE_H
+
+#include "array.h"
+
+/*
+ * Compressed sparse row matrix. Row i holds nonzeros indptr[i] up to
+ * indptr[i + 1] of indices (column, ascending) and data (value). data is
+ * allocated through array_data_alloc so it shows up in memory stats.
+ */
+typedef struct csrObject {
+    ARRAY_DTYPE dtype;
+    int64_t dims[ARRAY_NUM_DIMS];
+    int64_t nnz;
+    int64_t *indptr;
+    int64_t *indices;
+    char *data;
+} csrObject;
+
+csrObject *csr_from_dense(const arrayObject *a);
+/*
+ * Builds a rows x cols matrix from nnz (row, col, value) triplets, with
+ * vals holding nnz elements of dtype. Duplicates are summed; entries that
+ * come out zero are kept. Returns NULL if an index is out of range.
+ */
+csrObject *csr_from_triplets(const int64_t *row_idx, const int64_t *col_idx, const void *vals,
+                             int64_t nnz, int64_t rows, int64_t cols, ARRAY_DTYPE dtype);
+void csr_free(csrObject *s);
+
+arrayObject *csr_to_dense(const csrObject *s);
+/* s @ b as a new dense array; a single-column b is a matrix-vector product. */
+arrayObject *csr_dot(const csrObject *s, const arrayObject *b);
+
+#endif
@@ -0,0 +1,68 @@
+#include <time.h>
+
+#include "array_stats.h"
+
+const char *ARRAY_STATS_OP_NAMES[NUM_STATS_OPS] = {
+    "alloc", "copy", "fill", "ravel", "transpose", "sum", "reduce", "scan", "dot",
+    "str", "unary", "blas", "index", "sort",
+};
+
+int array_stats_enabled = 0;
+
+static arrayOpStats op_stats[NUM_STATS_OPS];
+
+int
+array_stats_compiled(void)
+{
+#ifdef ARRAY_STATS
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void
+array_stats_enable(int enabled)
+{
+    __atomic_store_n(&array_stats_enabled, enabled ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+void
+array_stats_reset(void)
+{
+    for (int i = 0; i < NUM_STATS_OPS; i++) {
+        __atomic_store_n(&op_stats[i].calls, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&op_stats[i].elems, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&op_stats[i].bytes, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&op_stats[i].ns, 0, __ATOMIC_RELAXED);
+    }
+}
+
+void
+array_stats_get(arrayOpStats out[NUM_STATS_OPS])
+{
+    for (int i = 0; i < NUM_STATS_OPS; i++) {
+        out[i].calls = __atomic_load_n(&op_stats[i].calls, __ATOMIC_RELAXED);
+        out[i].elems = __atomic_load_n(&op_stats[i].elems, __ATOMIC_RELAXED);
+        out[i].bytes = __atomic_load_n(&op_stats[i].bytes, __ATOMIC_RELAXED);
+        out[i].ns = __atomic_load_n(&op_stats[i].ns, __ATOMIC_RELAXED);
+    }
+}
+
+uint64_t
+array_stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    // Never 0, which ARRAY_STATS_END reads as "not recording".
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec + 1;
+}
+
+void
+array_stats_record(ARRAY_STATS_OP op, uint64_t elems, uint64_t bytes, uint64_t ns)
+{
+    __atomic_fetch_add(&op_stats[op].calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&op_stats[op].elems, elems, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&op_stats[op].bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&op_stats[op].ns, ns, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,63 @@
+#ifndef ARRAY_STATS_H
+#define ARRAY_STATS_H
+
+#include <stdint.h>
+
+/*
+ * Per-op counters for the core kernels. Recording is compiled in only when
+ * ARRAY_STATS is defined and, even then, only happens while enabled at
+ * runtime. Timings are inclusive, so array_dot also counts the time of the
+ * array_alloc call it makes, which is itself recorded under alloc. Sum
+ * reductions are recorded under sum and all other reductions under reduce.
+ */
+
+typedef enum {
+    STATS_ALLOC,
+    STATS_COPY,
+    STATS_FILL,
+    STATS_RAVEL,
+    STATS_TRANSPOSE,
+    STATS_SUM,
+    STATS_REDUCE,
+    STATS_SCAN,
+    STATS_DOT,
+    STATS_STR,
+    STATS_UNARY,
+    STATS_BLAS,
+    STATS_INDEX,
+    STATS_SORT,
+    NUM_STATS_OPS,
+} ARRAY_STATS_OP;
+
+extern const char *ARRAY_STATS_OP_NAMES[NUM_STATS_OPS];
+
+typedef struct arrayOpStats {
+    uint64_t calls;
+    uint64_t elems;  // elements read or written by the op
+    uint64_t bytes;  // bytes allocated or copied by the op
+    uint64_t ns;
+} arrayOpStats;
+
+extern int array_stats_enabled;
+
+int array_stats_compiled(void);
+void array_stats_enable(int enabled);
+void array_stats_reset(void);
+void array_stats_get(arrayOpStats out[NUM_STATS_OPS]);
+
+uint64_t array_stats_now(void);
+void array_stats_record(ARRAY_STATS_OP op, uint64_t elems, uint64_t bytes, uint64_t ns);
+
+#ifdef ARRAY_STATS
+#define ARRAY_STATS_BEGIN(t0) \
+    uint64_t t0 = array_stats_enabled ? array_stats_now() : 0
+#define ARRAY_STATS_END(t0, op, elems, bytes) \
+    do { \
+        if (t0) array_stats_record(op, elems, bytes, array_stats_now() - t0); \
+    } while (0)
+#else
+#define ARRAY_STATS_BEGIN(t0)
+#define ARRAY_STATS_END(t0, op, elems, bytes) ((void)0)
+#endif
+
+#endif
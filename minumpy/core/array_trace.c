@@ -0,0 +1,221 @@
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "array_dtypes.h"
+#include "array_trace.h"
+
+#define TRACE_CHUNK_EVENTS 1024
+
+typedef struct traceEvent {
+    const char *name;
+    char phase;
+    ARRAY_DTYPE dtype;
+    int64_t dims[4];
+    int num_dims;
+    uint64_t ts_ns;
+} traceEvent;
+
+typedef struct traceChunk {
+    struct traceChunk *next;
+    int len;
+    traceEvent events[TRACE_CHUNK_EVENTS];
+} traceChunk;
+
+/*
+ * A thread's buffer is only ever written, and its chunks only ever freed,
+ * by the owning thread. The reader in array_trace_stop walks the chunks up
+ * to each published length, so neither side needs a lock.
+ */
+typedef struct traceBuffer {
+    struct traceBuffer *next;
+    long tid;
+    int generation;
+    traceChunk *head;
+    traceChunk *tail;
+} traceBuffer;
+
+int array_trace_on = 0;
+
+static traceBuffer *buffers = NULL;
+static __thread traceBuffer *local_buffer = NULL;
+static int generation = 0;
+static FILE *trace_file = NULL;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int
+array_trace_compiled(void)
+{
+#ifdef ARRAY_TRACE
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+static uint64_t
+trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static traceChunk *
+chunk_alloc(void)
+{
+    traceChunk *c = malloc(sizeof(traceChunk));
+    if (c) {
+        c->next = NULL;
+        c->len = 0;
+    }
+    return c;
+}
+
+static void
+chunks_free(traceChunk *c)
+{
+    while (c) {
+        traceChunk *next = c->next;
+        free(c);
+        c = next;
+    }
+}
+
+static traceBuffer *
+thread_buffer(int gen)
+{
+    traceBuffer *b = local_buffer;
+    if (b == NULL) {
+        b = calloc(1, sizeof(traceBuffer));
+        if (b == NULL) return NULL;
+        b->tid = syscall(SYS_gettid);
+        b->generation = -1;
+        b->next = __atomic_load_n(&buffers, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&buffers, &b->next, b, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        local_buffer = b;
+    }
+    if (b->generation != gen) {
+        // Events from an earlier trace have been written out already.
+        __atomic_store_n(&b->generation, -1, __ATOMIC_RELEASE);
+        chunks_free(b->head);
+        b->head = b->tail = chunk_alloc();
+        if (b->head == NULL) return NULL;
+        __atomic_store_n(&b->generation, gen, __ATOMIC_RELEASE);
+    }
+    return b;
+}
+
+void
+array_trace_event(const char *name, char phase, ARRAY_DTYPE dtype,
+                  const int64_t *dims_a, const int64_t *dims_b)
+{
+    int gen = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+    traceBuffer *b = thread_buffer(gen);
+    if (b == NULL) return;
+
+    traceChunk *c = b->tail;
+    if (c->len == TRACE_CHUNK_EVENTS) {
+        traceChunk *next = chunk_alloc();
+        if (next == NULL) return;
+        __atomic_store_n(&c->next, next, __ATOMIC_RELEASE);
+        b->tail = c = next;
+    }
+
+    traceEvent *e = &c->events[c->len];
+    e->name = name;
+    e->phase = phase;
+    e->dtype = dtype;
+    e->num_dims = 0;
+    if (dims_a) {
+        e->dims[e->num_dims++] = dims_a[0];
+        e->dims[e->num_dims++] = dims_a[1];
+    }
+    if (dims_b) {
+        e->dims[e->num_dims++] = dims_b[0];
+        e->dims[e->num_dims++] = dims_b[1];
+    }
+    e->ts_ns = trace_now();
+    __atomic_store_n(&c->len, c->len + 1, __ATOMIC_RELEASE);
+}
+
+int
+array_trace_start(const char *path)
+{
+    pthread_mutex_lock(&trace_lock);
+    if (trace_file) {
+        pthread_mutex_unlock(&trace_lock);
+        return 1;
+    }
+    trace_file = fopen(path, "w");
+    if (trace_file == NULL) {
+        pthread_mutex_unlock(&trace_lock);
+        return 1;
+    }
+    __atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&array_trace_on, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&trace_lock);
+    return 0;
+}
+
+static void
+write_event(FILE *f, const traceEvent *e, long pid, long tid, int first)
+{
+    fprintf(f, "%s\n{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, "
+               "\"pid\": %ld, \"tid\": %ld",
+            first ? "" : ",", e->name, e->phase, e->ts_ns / 1000.0, pid, tid);
+    if (e->phase == 'B' && (e->dtype != UNKNOWN || e->num_dims)) {
+        fprintf(f, ", \"args\": {");
+        if (e->dtype != UNKNOWN) {
+            fprintf(f, "\"dtype\": \"%s\"%s", ARRAY_DTYPE_NAMES[e->dtype],
+                    e->num_dims ? ", " : "");
+        }
+        for (int i = 0; i < e->num_dims; i += 2) {
+            fprintf(f, "\"%s\": [%" PRId64 ", %" PRId64 "]%s", i ? "b" : "a",
+                    e->dims[i], e->dims[i + 1],
+                    i + 2 < e->num_dims ? ", " : "");
+        }
+        fprintf(f, "}");
+    }
+    fprintf(f, "}");
+}
+
+int
+array_trace_stop(void)
+{
+    pthread_mutex_lock(&trace_lock);
+    if (trace_file == NULL) {
+        pthread_mutex_unlock(&trace_lock);
+        return 1;
+    }
+    __atomic_store_n(&array_trace_on, 0, __ATOMIC_RELEASE);
+
+    int gen = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+    long pid = getpid();
+    int first = 1;
+    fprintf(trace_file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    for (traceBuffer *b = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE); b; b = b->next) {
+        if (__atomic_load_n(&b->generation, __ATOMIC_ACQUIRE) != gen) continue;
+        traceChunk *c = b->head;
+        while (c) {
+            int len = __atomic_load_n(&c->len, __ATOMIC_ACQUIRE);
+            for (int i = 0; i < len; i++) {
+                write_event(trace_file, &c->events[i], pid, b->tid, first);
+                first = 0;
+            }
+            c = __atomic_load_n(&c->next, __ATOMIC_ACQUIRE);
+        }
+    }
+    fprintf(trace_file, "\n]}\n");
+
+    int ret = fclose(trace_file) ? 1 : 0;
+    trace_file = NULL;
+    pthread_mutex_unlock(&trace_lock);
+    return ret;
+}
@@ -0,0 +1,38 @@
+#ifndef ARRAY_TRACE_H
+#define ARRAY_TRACE_H
+
+#include <stdint.h>
+
+#include "array_dtypes.h"
+
+/*
+ * Begin/end event tracing written out as Chrome trace JSON, viewable in
+ * chrome://tracing or Perfetto. Each thread appends to its own buffer
+ * without taking locks; buffers are only read back by array_trace_stop.
+ * Recording is compiled in only when ARRAY_TRACE is defined.
+ */
+
+extern int array_trace_on;
+
+int array_trace_compiled(void);
+int array_trace_start(const char *path);
+int array_trace_stop(void);
+
+void array_trace_event(const char *name, char phase, ARRAY_DTYPE dtype,
+                       const int64_t *dims_a, const int64_t *dims_b);
+
+#ifdef ARRAY_TRACE
+#define ARRAY_TRACE_BEGIN(name, dtype, dims_a, dims_b) \
+    do { \
+        if (array_trace_on) array_trace_event(name, 'B', dtype, dims_a, dims_b); \
+    } while (0)
+#define ARRAY_TRACE_END(name) \
+    do { \
+        if (array_trace_on) array_trace_event(name, 'E', UNKNOWN, NULL, NULL); \
+    } while (0)
+#else
+#define ARRAY_TRACE_BEGIN(name, dtype, dims_a, dims_b) ((void)0)
+#define ARRAY_TRACE_END(name) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,475 @@
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "array_backend.h"
+#include "array_parallel.h"
+#include "array_tune.h"
+
+const char *GEMM_SHAPE_NAMES[NUM_GEMM_SHAPES] = {"small", "skinny", "large"};
+
+#define TUNE_CACHE_HEADER "# minumpy gemm tuning cache: machine, dtype, shape, mc kc nc panel"
+#define TUNE_LINE_LEN 512
+#define TUNE_KEY_LEN 256
+// Each timing repeats the product until it takes at least this long.
+#define TUNE_MIN_BATCH_NS 2000000
+#define TUNE_REPEATS 3
+
+/* Where a class's blocking came from; only tuned ones are written out. */
+typedef enum {BLOCKING_DEFAULT, BLOCKING_SET, BLOCKING_TUNED} BLOCKING_SOURCE;
+
+static gemmBlocking gemm_blocking[NUM_ARRAY_DTYPES][NUM_GEMM_SHAPES];
+// Per-class sequence counts, odd while a write is in progress, so that
+// gemm() can read its blocking without taking tune_lock.
+static unsigned blocking_seq[NUM_ARRAY_DTYPES][NUM_GEMM_SHAPES];
+static BLOCKING_SOURCE blocking_source[NUM_ARRAY_DTYPES][NUM_GEMM_SHAPES];
+// Classes autotuning has already run for, or skipped, since it was enabled.
+static int autotune_done[NUM_ARRAY_DTYPES][NUM_GEMM_SHAPES];
+static int autotune = 0;
+
+static pthread_mutex_t tune_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t tune_once = PTHREAD_ONCE_INIT;
+
+static const gemmBlocking DEFAULT_BLOCKING = {128, 256, 2048, 0};
+
+/* Representative m, n, k timed for each class. */
+static const int64_t TUNE_DIMS[NUM_GEMM_SHAPES][3] = {
+    {64, 64, 64},
+    {16, 1024, 512},
+    {384, 384, 384},
+};
+
+static const int MC_CANDIDATES[] = {32, 64, 128, 256};
+static const int KC_CANDIDATES[] = {64, 128, 256, 512};
+static const int NC_CANDIDATES[] = {256, 1024, 2048, 4096};
+// Rows per threaded panel; 0 uses mc.
+static const int PANEL_CANDIDATES[] = {0, 16, 32, 64};
+
+#define NUM_CANDIDATES(c) (int)(sizeof(c) / sizeof(c[0]))
+
+GEMM_SHAPE
+gemm_shape(int64_t m, int64_t n, int64_t k)
+{
+    if ((double)m * n * k <= GEMM_SMALL_MAX_FLOPS) return GEMM_SHAPE_SMALL;
+    if (m <= GEMM_SKINNY_MAX_DIM || n <= GEMM_SKINNY_MAX_DIM) return GEMM_SHAPE_SKINNY;
+    return GEMM_SHAPE_LARGE;
+}
+
+/* Called with tune_lock held, or from tune_init before any reader. */
+static void
+store_blocking_locked(ARRAY_DTYPE dtype, GEMM_SHAPE shape, const gemmBlocking *blk)
+{
+    gemmBlocking *b = &gemm_blocking[dtype][shape];
+    unsigned *seq = &blocking_seq[dtype][shape];
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&b->mc, blk->mc, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->kc, blk->kc, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->nc, blk->nc, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->panel, blk->panel, __ATOMIC_RELAXED);
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Copies a class's blocking, retrying if a writer overlapped the copy. */
+static void
+load_blocking(ARRAY_DTYPE dtype, GEMM_SHAPE shape, gemmBlocking *blk)
+{
+    const gemmBlocking *b = &gemm_blocking[dtype][shape];
+    const unsigned *seq = &blocking_seq[dtype][shape];
+    unsigned before;
+    do {
+        before = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        blk->mc = __atomic_load_n(&b->mc, __ATOMIC_RELAXED);
+        blk->kc = __atomic_load_n(&b->kc, __ATOMIC_RELAXED);
+        blk->nc = __atomic_load_n(&b->nc, __ATOMIC_RELAXED);
+        blk->panel = __atomic_load_n(&b->panel, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((before & 1) || __atomic_load_n(seq, __ATOMIC_RELAXED) != before);
+}
+
+static const char *
+default_cache_path(void)
+{
+    static char path[4096];
+    const char *env = getenv("MINUMPY_TUNE_CACHE");
+    if (env) return env[0] ? env : NULL;
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int len;
+    if (xdg && xdg[0]) {
+        len = snprintf(path, sizeof(path), "%s/minumpy/gemm_tune", xdg);
+    } else if (home && home[0]) {
+        len = snprintf(path, sizeof(path), "%s/.cache/minumpy/gemm_tune", home);
+    } else {
+        return NULL;
+    }
+    return len < (int)sizeof(path) ? path : NULL;
+}
+
+void
+gemm_tune_machine(char *out, size_t size)
+{
+    char model[TUNE_KEY_LEN] = "unknown";
+    char line[TUNE_LINE_LEN];
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    while (f && fgets(line, sizeof(line), f)) {
+        char *colon = strchr(line, ':');
+        if (strncmp(line, "model name", 10) || !colon) continue;
+        const char *v = colon + 1 + strspn(colon + 1, " \t");
+        snprintf(model, sizeof(model), "%.*s", (int)strcspn(v, "\n"), v);
+        break;
+    }
+    if (f) fclose(f);
+    // Tabs separate the cache fields.
+    for (char *p = model; *p; p++) {
+        if (*p == '\t') *p = ' ';
+    }
+    snprintf(out, size, "%s;threads=%d", model, parallel_num_threads());
+}
+
+/*
+ * Parses a cache line into its machine key, dtype, shape and blocking.
+ * Returns 1 for comments and malformed lines.
+ */
+static int
+parse_line(char *line, char **key, ARRAY_DTYPE *dtype, GEMM_SHAPE *shape, gemmBlocking *blk)
+{
+    char *fields[4];
+    char *save = NULL;
+    if (line[0] == '#') return 1;
+    line[strcspn(line, "\n")] = '\0';
+    for (int i = 0; i < 4; i++) {
+        fields[i] = strtok_r(i ? NULL : line, "\t", &save);
+        if (fields[i] == NULL) return 1;
+    }
+    int d, s;
+    for (d = 0; d < NUM_ARRAY_DTYPES && strcmp(fields[1], ARRAY_DTYPE_NAMES[d]); d++);
+    for (s = 0; s < NUM_GEMM_SHAPES && strcmp(fields[2], GEMM_SHAPE_NAMES[s]); s++);
+    if (d == NUM_ARRAY_DTYPES || s == NUM_GEMM_SHAPES) return 1;
+    if (sscanf(fields[3], "%d %d %d %d", &blk->mc, &blk->kc, &blk->nc, &blk->panel) != 4 ||
+        blk->mc <= 0 || blk->kc <= 0 || blk->nc <= 0 || blk->panel < 0) {
+        return 1;
+    }
+    *key = fields[0];
+    *dtype = ARRAY_DTYPES[d];
+    *shape = s;
+    return 0;
+}
+
+/* Called with tune_lock held. */
+static int
+load_locked(const char *path)
+{
+    char key[TUNE_KEY_LEN];
+    char line[TUNE_LINE_LEN];
+    int loaded = 0;
+
+    if (path == NULL) path = default_cache_path();
+    FILE *f = path ? fopen(path, "r") : NULL;
+    if (f == NULL) return 0;
+    gemm_tune_machine(key, sizeof(key));
+    while (fgets(line, sizeof(line), f)) {
+        char *line_key;
+        ARRAY_DTYPE dtype;
+        GEMM_SHAPE shape;
+        gemmBlocking blk;
+        if (parse_line(line, &line_key, &dtype, &shape, &blk) || strcmp(line_key, key)) continue;
+        store_blocking_locked(dtype, shape, &blk);
+        blocking_source[dtype][shape] = BLOCKING_TUNED;
+        loaded++;
+    }
+    fclose(f);
+    return loaded;
+}
+
+static void
+tune_init(void)
+{
+    for (int d = 0; d < NUM_ARRAY_DTYPES; d++) {
+        for (int s = 0; s < NUM_GEMM_SHAPES; s++) {
+            store_blocking_locked(d, s, &DEFAULT_BLOCKING);
+        }
+    }
+    const char *env = getenv("MINUMPY_AUTOTUNE");
+    autotune = env && atoi(env) > 0;
+    load_locked(NULL);
+}
+
+int
+gemm_tune_load(const char *path)
+{
+    pthread_once(&tune_once, tune_init);
+    pthread_mutex_lock(&tune_lock);
+    int loaded = load_locked(path);
+    pthread_mutex_unlock(&tune_lock);
+    return loaded;
+}
+
+/* Creates the directories leading up to path. */
+static void
+make_parents(const char *path)
+{
+    char dir[4096];
+    if (snprintf(dir, sizeof(dir), "%s", path) >= (int)sizeof(dir)) return;
+    for (char *p = dir + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(dir, 0755);
+        *p = '/';
+    }
+}
+
+/* Called with tune_lock held. */
+static int
+save_locked(const char *path)
+{
+    char key[TUNE_KEY_LEN];
+    char line[TUNE_LINE_LEN];
+    char copy[TUNE_LINE_LEN];
+    char tmp[4096 + 32];
+
+    if (path == NULL) {
+        path = default_cache_path();
+        if (path == NULL) return 0;
+    }
+    if (snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(tmp)) {
+        return 1;
+    }
+    gemm_tune_machine(key, sizeof(key));
+    make_parents(path);
+    FILE *out = fopen(tmp, "w");
+    if (out == NULL) {
+        printf("Cannot write gemm tuning cache %s: %s\n", tmp, strerror(errno));
+        return 1;
+    }
+    fprintf(out, "%s\n", TUNE_CACHE_HEADER);
+
+    // Keep other machines' entries, and ours for classes not tuned here.
+    FILE *in = fopen(path, "r");
+    while (in && fgets(line, sizeof(line), in)) {
+        char *line_key;
+        ARRAY_DTYPE dtype;
+        GEMM_SHAPE shape;
+        gemmBlocking blk;
+        strcpy(copy, line);
+        if (parse_line(copy, &line_key, &dtype, &shape, &blk)) continue;
+        if (!strcmp(line_key, key) && blocking_source[dtype][shape] == BLOCKING_TUNED) continue;
+        fputs(line, out);
+    }
+    if (in) fclose(in);
+
+    for (int d = 0; d < NUM_ARRAY_DTYPES; d++) {
+        for (int s = 0; s < NUM_GEMM_SHAPES; s++) {
+            const gemmBlocking *blk = &gemm_blocking[d][s];
+            if (blocking_source[d][s] != BLOCKING_TUNED) continue;
+            fprintf(out, "%s\t%s\t%s\t%d %d %d %d\n", key, ARRAY_DTYPE_NAMES[d],
+                    GEMM_SHAPE_NAMES[s], blk->mc, blk->kc, blk->nc, blk->panel);
+        }
+    }
+    if (fclose(out) || rename(tmp, path)) {
+        printf("Cannot write gemm tuning cache %s: %s\n", path, strerror(errno));
+        unlink(tmp);
+        return 1;
+    }
+    return 0;
+}
+
+int
+gemm_tune_save(const char *path)
+{
+    pthread_once(&tune_once, tune_init);
+    pthread_mutex_lock(&tune_lock);
+    int ret = save_locked(path);
+    pthread_mutex_unlock(&tune_lock);
+    return ret;
+}
+
+static uint64_t
+tune_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+typedef struct tuneProblem {
+    gemm_func kernel;
+    char *a, *b, *c;
+    int64_t m, n, k;
+} tuneProblem;
+
+/*
+ * Best per-product time in ns over TUNE_REPEATS batches, or HUGE_VAL if
+ * the blocking's buffers cannot be allocated, so that it is never chosen.
+ */
+static double
+time_blocking(const tuneProblem *p, const gemmBlocking *blk)
+{
+    uint64_t start = tune_now();
+    if (p->kernel(p->c, p->a, p->k, 1, p->b, p->n, 1, p->m, p->n, p->k, blk)) return HUGE_VAL;
+    uint64_t once = tune_now() - start;
+    int64_t iters = once ? TUNE_MIN_BATCH_NS / once + 1 : 1;
+    double best = 0;
+    for (int r = 0; r < TUNE_REPEATS; r++) {
+        start = tune_now();
+        for (int64_t i = 0; i < iters; i++) {
+            p->kernel(p->c, p->a, p->k, 1, p->b, p->n, 1, p->m, p->n, p->k, blk);
+        }
+        double t = (double)(tune_now() - start) / iters;
+        if (r == 0 || t < best) best = t;
+    }
+    return best;
+}
+
+/*
+ * Tries each candidate for one field of best in turn, keeping the fastest.
+ * Once a candidate covers the dimension the field tiles, larger ones block
+ * the same way and are skipped.
+ */
+static void
+tune_field(const tuneProblem *p, gemmBlocking *best, double *best_ns, int *field,
+           const int *candidates, int n, int64_t dim)
+{
+    int chosen = *field;
+    for (int i = 0; i < n; i++) {
+        if (i > 0 && candidates[i - 1] >= dim) break;
+        if (candidates[i] == chosen) continue;
+        *field = candidates[i];
+        double t = time_blocking(p, best);
+        if (t < *best_ns) {
+            *best_ns = t;
+            chosen = candidates[i];
+        }
+    }
+    *field = chosen;
+}
+
+int
+gemm_tune(ARRAY_DTYPE dtype, GEMM_SHAPE shape, gemmBlocking *best)
+{
+    pthread_once(&tune_once, tune_init);
+    size_t size = array_dtype_size(dtype);
+    tuneProblem p = {
+        (gemm_func)array_backend_threaded.kernels[KERNEL_GEMM][dtype], NULL, NULL, NULL,
+        TUNE_DIMS[shape][0], TUNE_DIMS[shape][1], TUNE_DIMS[shape][2],
+    };
+    p.a = malloc(p.m * p.k * size);
+    p.b = malloc(p.k * p.n * size);
+    p.c = calloc(p.m * p.n, size);
+    if (!p.a || !p.b || !p.c) {
+        free(p.a);
+        free(p.b);
+        free(p.c);
+        return 1;
+    }
+    // A zero B keeps C from growing over the repeated products.
+    buf_fill_val(p.a, 1, p.m * p.k, dtype);
+    buf_fill_val(p.b, 0, p.k * p.n, dtype);
+
+    // kc sizes the packed panels against L1/L2, so it goes first.
+    *best = DEFAULT_BLOCKING;
+    double best_ns = time_blocking(&p, best);
+    tune_field(&p, best, &best_ns, &best->kc, KC_CANDIDATES, NUM_CANDIDATES(KC_CANDIDATES), p.k);
+    tune_field(&p, best, &best_ns, &best->mc, MC_CANDIDATES, NUM_CANDIDATES(MC_CANDIDATES), p.m);
+    tune_field(&p, best, &best_ns, &best->nc, NC_CANDIDATES, NUM_CANDIDATES(NC_CANDIDATES), p.n);
+    if (parallel_num_threads() > 1 && shape == GEMM_SHAPE_LARGE) {
+        tune_field(&p, best, &best_ns, &best->panel, PANEL_CANDIDATES,
+                   NUM_CANDIDATES(PANEL_CANDIDATES), p.m);
+    }
+    free(p.a);
+    free(p.b);
+    free(p.c);
+    if (best_ns == HUGE_VAL) return 1;
+
+    pthread_mutex_lock(&tune_lock);
+    store_blocking_locked(dtype, shape, best);
+    blocking_source[dtype][shape] = BLOCKING_TUNED;
+    pthread_mutex_unlock(&tune_lock);
+    return 0;
+}
+
+void
+gemm_blocking_for(ARRAY_DTYPE dtype, GEMM_SHAPE shape, gemmBlocking *blk)
+{
+    pthread_once(&tune_once, tune_init);
+    if (__atomic_load_n(&autotune, __ATOMIC_RELAXED) &&
+        !__atomic_load_n(&autotune_done[dtype][shape], __ATOMIC_ACQUIRE)) {
+        // Serialised so that concurrent first products tune once.
+        static pthread_mutex_t autotune_lock = PTHREAD_MUTEX_INITIALIZER;
+        pthread_mutex_lock(&autotune_lock);
+        if (!autotune_done[dtype][shape]) {
+            gemmBlocking tuned;
+            if (blocking_source[dtype][shape] == BLOCKING_DEFAULT &&
+                !gemm_tune(dtype, shape, &tuned)) {
+                gemm_tune_save(NULL);
+            }
+            __atomic_store_n(&autotune_done[dtype][shape], 1, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&autotune_lock);
+    }
+    load_blocking(dtype, shape, blk);
+}
+
+void
+gemm_get_shape_blocking(ARRAY_DTYPE dtype, GEMM_SHAPE shape, gemmBlocking *blk)
+{
+    pthread_once(&tune_once, tune_init);
+    load_blocking(dtype, shape, blk);
+}
+
+int
+gemm_set_shape_blocking(ARRAY_DTYPE dtype, GEMM_SHAPE shape, const gemmBlocking *blk)
+{
+    if (blk->mc <= 0 || blk->kc <= 0 || blk->nc <= 0 || blk->panel < 0) return 1;
+    pthread_once(&tune_once, tune_init);
+    pthread_mutex_lock(&tune_lock);
+    store_blocking_locked(dtype, shape, blk);
+    blocking_source[dtype][shape] = BLOCKING_SET;
+    pthread_mutex_unlock(&tune_lock);
+    return 0;
+}
+
+void
+gemm_get_blocking(ARRAY_DTYPE dtype, gemmBlocking *blk)
+{
+    gemm_get_shape_blocking(dtype, GEMM_SHAPE_LARGE, blk);
+}
+
+int
+gemm_set_blocking(ARRAY_DTYPE dtype, const gemmBlocking *blk)
+{
+    for (int s = 0; s < NUM_GEMM_SHAPES; s++) {
+        if (gemm_set_shape_blocking(dtype, s, blk)) return 1;
+    }
+    return 0;
+}
+
+int
+gemm_get_autotune(void)
+{
+    pthread_once(&tune_once, tune_init);
+    return __atomic_load_n(&autotune, __ATOMIC_RELAXED);
+}
+
+void
+gemm_set_autotune(int enabled)
+{
+    pthread_once(&tune_once, tune_init);
+    pthread_mutex_lock(&tune_lock);
+    // Re-enabling gives classes left at their defaults another chance.
+    if (enabled && !autotune) {
+        for (int d = 0; d < NUM_ARRAY_DTYPES; d++) {
+            for (int s = 0; s < NUM_GEMM_SHAPES; s++) {
+                __atomic_store_n(&autotune_done[d][s], 0, __ATOMIC_RELEASE);
+            }
+        }
+    }
+    __atomic_store_n(&autotune, enabled != 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&tune_lock);
+}
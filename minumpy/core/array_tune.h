@@ -0,0 +1,73 @@
+#ifndef ARRAY_TUNE_H
+#define ARRAY_TUNE_H
+
+#include <stdint.h>
+
+#include "array_dtypes.h"
+#include "array_utils.h"
+
+/*
+ * GEMM blocking per dtype and shape class, and the autotuner that picks
+ * it. gemm looks up the blocking for the class of each product. Classes
+ * start out with the built-in defaults, overridden by entries for this
+ * machine in the tuning cache; with autotuning on, a class with neither is
+ * tuned on its first product and the result added to the cache.
+ *
+ * The cache is a text file at MINUMPY_TUNE_CACHE, else
+ * $XDG_CACHE_HOME/minumpy/gemm_tune or ~/.cache/minumpy/gemm_tune, with an
+ * empty MINUMPY_TUNE_CACHE disabling it. Its entries are keyed by CPU model
+ * and thread count, so one file can serve several kinds of host. Autotuning
+ * starts out from MINUMPY_AUTOTUNE (default off).
+ */
+
+typedef enum {
+    GEMM_SHAPE_SMALL,   // m * n * k up to GEMM_SMALL_MAX_FLOPS
+    GEMM_SHAPE_SKINNY,  // m or n up to GEMM_SKINNY_MAX_DIM
+    GEMM_SHAPE_LARGE,
+    NUM_GEMM_SHAPES,
+} GEMM_SHAPE;
+
+extern const char *GEMM_SHAPE_NAMES[NUM_GEMM_SHAPES];
+
+#define GEMM_SMALL_MAX_FLOPS (1 << 20)
+#define GEMM_SKINNY_MAX_DIM 32
+
+GEMM_SHAPE gemm_shape(int64_t m, int64_t n, int64_t k);
+/*
+ * The blocking gemm uses for a product of the given class, tuning it first
+ * when autotuning is on and neither the cache nor a setter has given one.
+ */
+void gemm_blocking_for(ARRAY_DTYPE dtype, GEMM_SHAPE shape, gemmBlocking *blk);
+
+void gemm_get_shape_blocking(ARRAY_DTYPE dtype, GEMM_SHAPE shape, gemmBlocking *blk);
+/* Fixes the blocking of one class. Returns 1 for non-positive sizes. */
+int gemm_set_shape_blocking(ARRAY_DTYPE dtype, GEMM_SHAPE shape, const gemmBlocking *blk);
+/* gemm_get_blocking reads the large class; gemm_set_blocking sets all. */
+void gemm_get_blocking(ARRAY_DTYPE dtype, gemmBlocking *blk);
+int gemm_set_blocking(ARRAY_DTYPE dtype, const gemmBlocking *blk);
+
+int gemm_get_autotune(void);
+void gemm_set_autotune(int enabled);
+
+/*
+ * Times the threaded gemm kernel on a representative product of the class
+ * over candidate block sizes and panel heights, one parameter at a time,
+ * and installs the fastest into best and the table. Returns 1 if the
+ * operands or packing buffers cannot be allocated.
+ */
+int gemm_tune(ARRAY_DTYPE dtype, GEMM_SHAPE shape, gemmBlocking *best);
+/*
+ * Merges the tuned classes into the cache at path, or the default cache
+ * when path is NULL, keeping entries for other machines. Returns 1 if the
+ * file cannot be written; a disabled default cache is not an error.
+ */
+int gemm_tune_save(const char *path);
+/*
+ * Installs the cache entries at path (NULL for the default) that match
+ * this machine. Returns the number of classes set.
+ */
+int gemm_tune_load(const char *path);
+/* Key that cache entries for this machine carry: CPU model and threads. */
+void gemm_tune_machine(char *out, size_t size);
+
+#endif
@@ -1,23 +1,49 @@
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "array_backend.h"
+#include "array_tune.h"
 #include "array_dtypes.h"
+#include "array_parallel.h"
+#include "array_stats.h"
 #include "array_utils.h"
 
-int
-prod(int *vals, int n)
+int64_t
+prod(int64_t *vals, int n)
 {
-    int num_elems = 1;
+    int64_t num_elems = 1;
     for (int i = 0; i < n; i++) {
         num_elems *= vals[i];
     }
     return num_elems;
 }
 
-int *
-cumprod_reverse(int *vals, int n)
+int
+prod_checked(const int64_t *vals, int n, int64_t *out)
+{
+    int64_t num_elems = 1;
+    for (int i = 0; i < n; i++) {
+        if (vals[i] < 0 || __builtin_mul_overflow(num_elems, vals[i], &num_elems)) {
+            return 1;
+        }
+    }
+    *out = num_elems;
+    return 0;
+}
+
+int64_t *
+cumprod_reverse(int64_t *vals, int n)
 {
-    int *strides = malloc(n * sizeof(int));
+    int64_t *strides = malloc(n * sizeof(int64_t));
     strides[n - 1] = 1;
     for (int i = n - 2; i >= 0; i--) {
         strides[i] = strides[i + 1] * vals[i + 1];
@@ -31,11 +57,11 @@ validate_nd(int nd)
     return (nd <= 0 || nd > ARRAY_NUM_DIMS) ? 1 : 0;
 }
 
-int *
-promote_dims(int *dims, int nd, int target_nd)
+int64_t *
+promote_dims(int64_t *dims, int nd, int target_nd)
 {
-    int *ret = malloc(target_nd * sizeof(int));
-    memcpy(ret, dims, nd * sizeof(int));
+    int64_t *ret = malloc(target_nd * sizeof(int64_t));
+    memcpy(ret, dims, nd * sizeof(int64_t));
     for (int i = nd; i < target_nd; i++) {
         ret[i] = 1;
     }
@@ -43,9 +69,9 @@ promote_dims(int *dims, int nd, int target_nd)
 }
 
 void
-swap_idx(int *vals, int i, int j)
+swap_idx(int64_t *vals, int i, int j)
 {
-    int tmp = vals[i];
+    int64_t tmp = vals[i];
     vals[i] = vals[j];
     vals[j] = tmp;
 }
@@ -60,11 +86,11 @@ range(int n)
     return ret;
 }
 
-int *
-filter_idx(int *vals, int n, int idx)
+int64_t *
+filter_idx(int64_t *vals, int n, int idx)
 {
     int ret_n = n > 1 ? n - 1 : 1;
-    int *ret = malloc(ret_n * sizeof(int));
+    int64_t *ret = malloc(ret_n * sizeof(int64_t));
     ret[0] = 1;
     int j = 0;
     for (int i = 0; i < n; i++) {
@@ -74,214 +100,1492 @@ filter_idx(int *vals, int n, int idx)
     return ret;
 }
 
+/*
+ * In-register transposes of one tile, dst[i * ld_dst + j] = src[j * ld_src + i].
+ * Only the element width matters, so the integer dtypes share the float paths.
+ */
+static inline void
+transpose_4x4_32(void *dst, int64_t ld_dst, const void *src, int64_t ld_src)
+{
+#ifdef __SSE2__
+    const float *s = src;
+    float *d = dst;
+    __m128 r0 = _mm_loadu_ps(s);
+    __m128 r1 = _mm_loadu_ps(s + ld_src);
+    __m128 r2 = _mm_loadu_ps(s + 2 * ld_src);
+    __m128 r3 = _mm_loadu_ps(s + 3 * ld_src);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(d, r0);
+    _mm_storeu_ps(d + ld_dst, r1);
+    _mm_storeu_ps(d + 2 * ld_dst, r2);
+    _mm_storeu_ps(d + 3 * ld_dst, r3);
+#else
+    const uint32_t *s = src;
+    uint32_t *d = dst;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            d[i * ld_dst + j] = s[j * ld_src + i];
+        }
+    }
+#endif
+}
+
+static inline void
+transpose_2x2_64(void *dst, int64_t ld_dst, const void *src, int64_t ld_src)
+{
+#ifdef __SSE2__
+    const double *s = src;
+    double *d = dst;
+    __m128d r0 = _mm_loadu_pd(s);
+    __m128d r1 = _mm_loadu_pd(s + ld_src);
+    _mm_storeu_pd(d, _mm_unpacklo_pd(r0, r1));
+    _mm_storeu_pd(d + ld_dst, _mm_unpackhi_pd(r0, r1));
+#else
+    const uint64_t *s = src;
+    uint64_t *d = dst;
+    d[0] = s[0];
+    d[1] = s[ld_src];
+    d[ld_dst] = s[1];
+    d[ld_dst + 1] = s[ld_src + 1];
+#endif
+}
+
+/* Edge length below which the cache-oblivious transpose stops recursing. */
+#define TRANSPOSE_TILE 32
+
 typedef void (*buf_set_val_func)(char *, void *);
 typedef void (*buf_add_val_func)(char *, void *);
 typedef void (*buf_set_zero_func)(char *);
-typedef void (*buf_fill_val_func)(char *, double, int);
-typedef void (*buf_fill_vals_func)(char *, const void *, int);
-typedef void (*buf_fill_uniform_int_func)(char *, int, int, int);
-typedef void (*reduce_mul_add_func)(char *, const void *, const void *, int);
-typedef void (*reduce_sum_func)(char *, const void *, int);
-typedef int  (*print_val_func)(char *, size_t, char *);
-
-void buf_set_val_func_int32(char *buf, void *val) {*(int32_t *)buf = *(int32_t *)val;}
-void buf_set_val_func_int64(char *buf, void *val) {*(int64_t *)buf = *(int64_t *)val;}
-void buf_set_val_func_float(char *buf, void *val) {*(float *)buf = *(float *)val;}
-void buf_set_val_func_double(char *buf, void *val) {*(double *)buf = *(double *)val;}
-
-void buf_add_val_func_int32(char *buf, void *val) {*(int32_t *)buf += *(int32_t *)val;}
-void buf_add_val_func_int64(char *buf, void *val) {*(int64_t *)buf += *(int64_t *)val;}
-void buf_add_val_func_float(char *buf, void *val) {*(float *)buf += *(float *)val;}
-void buf_add_val_func_double(char *buf, void *val) {*(double *)buf += *(double *)val;}
-
-void buf_set_zero_func_int32(char *buf) {*(int32_t *)buf = (int32_t)0;}
-void buf_set_zero_func_int64(char *buf) {*(int64_t *)buf = (int64_t)0;}
-void buf_set_zero_func_float(char *buf) {*(float *)buf = (float)0;}
-void buf_set_zero_func_double(char *buf) {*(double *)buf = (double)0;}
-
-void buf_fill_val_func_int32(char *buf, double val, int n) {
-    for (int i = 0; i < n; i++) {
-        ((int32_t *)buf)[i] = (int32_t)val;
+typedef void (*buf_fill_val_func)(char *, double, int64_t);
+typedef void (*buf_fill_vals_func)(char *, const void *, int64_t);
+typedef void (*buf_fill_uniform_int_func)(char *, int, int, int64_t);
+typedef void (*buf_fill_linear_func)(char *, double, double, int64_t, int64_t);
+typedef void (*buf_fill_int_func)(char *, int64_t, int64_t);
+typedef void (*buf_fill_linear_int_func)(char *, int64_t, int64_t, int64_t, int64_t);
+typedef void (*buf_fill_val_strided_func)(char *, double, int64_t, int64_t);
+typedef void (*buf_copy_strided_func)(char *, const char *, int64_t, int64_t,
+                                      int64_t, int64_t);
+typedef int (*reduce_func)(char *, const char *, int64_t, int64_t, int64_t, int, REDUCE_OP);
+typedef void (*scan_func)(char *, const char *, int64_t, int64_t, int64_t, int, SCAN_OP);
+typedef int64_t (*csr_count_nonzero_func)(int64_t *, const char *, int64_t, int64_t,
+                                          int64_t, int64_t);
+typedef void (*csr_gather_nonzero_func)(int64_t *, char *, const char *, int64_t, int64_t,
+                                        int64_t, int64_t);
+typedef void (*spmm_func)(char *, const int64_t *, const int64_t *, const char *, int64_t,
+                          int64_t, const char *, int64_t, int64_t, int64_t);
+typedef void (*gather_func)(char *, const char *, const int64_t *, int64_t, int64_t, int64_t);
+typedef void (*scatter_func)(char *, const int64_t *, int64_t, int64_t, int64_t, const char *,
+                             int64_t);
+typedef int64_t (*nonzero_offsets_func)(int64_t *, const char *, int64_t, int64_t, int64_t,
+                                        int64_t, int64_t, int64_t);
+typedef int  (*print_val_func)(char *, char *, int);
+
+/*
+ * Accumulates F(x[i * inc] * hi * lo) for i < n into the double result,
+ * spread over BLAS1_LANES independent sums so that the contiguous case
+ * vectorises. Multiplying by a literal 1.0 folds away.
+ */
+#define BLAS1_LANES 8
+
+#define BLAS1_SUM_RUN(x, n, inc, F, hi, lo, result) do { \
+    double lanes_[BLAS1_LANES] = {0}; \
+    int64_t i_ = 0; \
+    for (; i_ + BLAS1_LANES <= (n); i_ += BLAS1_LANES) { \
+        for (int l_ = 0; l_ < BLAS1_LANES; l_++) { \
+            lanes_[l_] += F((double)(x)[(i_ + l_) * (inc)] * (hi) * (lo)); \
+        } \
+    } \
+    for (; i_ < (n); i_++) { \
+        lanes_[0] += F((double)(x)[i_ * (inc)] * (hi) * (lo)); \
+    } \
+    for (int l_ = 0; l_ < BLAS1_LANES; l_++) { \
+        (result) += lanes_[l_]; \
+    } \
+} while (0)
+
+#define BLAS1_SQUARE(v) ((v) * (v))
+#define BLAS1_NEG_ABS(v) ((v) > 0 ? -(v) : (v))
+
+/*
+ * Sums of squares at least this large per element are free of underflow
+ * loss: every square below DBL_MIN contributes under an ulp of the total.
+ */
+#define NRM2_SAFE_MIN (DBL_MIN / DBL_EPSILON)
+
+/*
+ * Typed kernels, generated once per dtype. Each public entry point below
+ * dispatches through its table once per call, so the per-element loops are
+ * plain typed C that the compiler can inline and vectorise.
+ */
+#define DEFINE_DTYPE_KERNELS(T, name) \
+    static void buf_set_val_func_##name(char *buf, void *val) { \
+        *(T *)buf = *(T *)val; \
+    } \
+    static void buf_add_val_func_##name(char *buf, void *val) { \
+        *(T *)buf += *(T *)val; \
+    } \
+    static void buf_set_zero_func_##name(char *buf) { \
+        *(T *)buf = (T)0; \
+    } \
+    static void buf_fill_val_func_##name(char *buf, double val, int64_t n) { \
+        T v = (T)val; \
+        T *out = (T *)buf; \
+        for (int64_t i = 0; i < n; i++) { \
+            out[i] = v; \
+        } \
+    } \
+    static void buf_fill_vals_func_##name(char *buf, const void *vals, int64_t n) { \
+        memcpy(buf, vals, n * sizeof(T)); \
+    } \
+    /* out[i] = start + (first + i) * step, rather than a running sum that drifts. */ \
+    static void buf_fill_linear_func_##name(char *buf, double start, double step, \
+                                            int64_t first, int64_t n) { \
+        T *out = (T *)buf; \
+        for (int64_t i = 0; i < n; i++) { \
+            out[i] = (T)(start + (double)(first + i) * step); \
+        } \
+    } \
+    static void buf_fill_int_func_##name(char *buf, int64_t val, int64_t n) { \
+        T v = (T)val; \
+        T *out = (T *)buf; \
+        for (int64_t i = 0; i < n; i++) { \
+            out[i] = v; \
+        } \
+    } \
+    /* Unsigned, so intermediate products wrap instead of overflowing. */ \
+    static void buf_fill_linear_int_func_##name(char *buf, int64_t start, int64_t step, \
+                                                int64_t first, int64_t n) { \
+        T *out = (T *)buf; \
+        for (int64_t i = 0; i < n; i++) { \
+            out[i] = (T)(int64_t)((uint64_t)start + (uint64_t)(first + i) * (uint64_t)step); \
+        } \
+    } \
+    static void buf_fill_val_strided_func_##name(char *buf, double val, int64_t n, \
+                                                 int64_t stride) { \
+        T v = (T)val; \
+        T *out = (T *)buf; \
+        for (int64_t i = 0; i < n; i++) { \
+            out[i * stride] = v; \
+        } \
+    } \
+    static void buf_fill_uniform_int_func_##name(char *buf, int low, int high, int64_t n) { \
+        T *out = (T *)buf; \
+        for (int64_t i = 0; i < n; i++) { \
+            int v = low + rand() / (RAND_MAX / (high - low + 1) + 1); \
+            out[i] = (T)v; \
+        } \
+    } \
+    static void transpose_rec_##name(T *dst, int64_t ld_dst, const T *src, int64_t ld_src, \
+                                     int64_t rows, int64_t cols) { \
+        if (rows > TRANSPOSE_TILE || cols > TRANSPOSE_TILE) { \
+            if (rows >= cols) { \
+                int64_t h = (rows / 2) & ~3; \
+                transpose_rec_##name(dst, ld_dst, src, ld_src, h, cols); \
+                transpose_rec_##name(dst + h * ld_dst, ld_dst, src + h, ld_src, \
+                                     rows - h, cols); \
+            } else { \
+                int64_t h = (cols / 2) & ~3; \
+                transpose_rec_##name(dst, ld_dst, src, ld_src, rows, h); \
+                transpose_rec_##name(dst + h, ld_dst, src + h * ld_src, ld_src, \
+                                     rows, cols - h); \
+            } \
+            return; \
+        } \
+        int v = sizeof(T) == 4 ? 4 : 2; \
+        int64_t i = 0; \
+        for (; i + v <= rows; i += v) { \
+            int64_t j = 0; \
+            for (; j + v <= cols; j += v) { \
+                if (sizeof(T) == 4) { \
+                    transpose_4x4_32(dst + i * ld_dst + j, ld_dst, \
+                                     src + j * ld_src + i, ld_src); \
+                } else { \
+                    transpose_2x2_64(dst + i * ld_dst + j, ld_dst, \
+                                     src + j * ld_src + i, ld_src); \
+                } \
+            } \
+            for (; j < cols; j++) { \
+                for (int64_t r = i; r < i + v; r++) { \
+                    dst[r * ld_dst + j] = src[j * ld_src + r]; \
+                } \
+            } \
+        } \
+        for (; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j++) { \
+                dst[i * ld_dst + j] = src[j * ld_src + i]; \
+            } \
+        } \
+    } \
+    static void buf_copy_strided_func_##name(char *buf, const char *vals, \
+                                             int64_t rows, int64_t cols, \
+                                             int64_t row_stride, int64_t col_stride) { \
+        T *out = (T *)buf; \
+        const T *in = (const T *)vals; \
+        if (col_stride == 1) { \
+            for (int64_t i = 0; i < rows; i++) { \
+                memcpy(out + i * cols, in + i * row_stride, cols * sizeof(T)); \
+            } \
+            return; \
+        } \
+        if (row_stride == 1) { \
+            transpose_rec_##name(out, cols, in, col_stride, rows, cols); \
+            return; \
+        } \
+        for (int64_t i = 0; i < rows; i++) { \
+            const T *row = in + i * row_stride; \
+            for (int64_t j = 0; j < cols; j++) { \
+                out[i * cols + j] = row[j * col_stride]; \
+            } \
+        } \
+    } \
+    static void reduce_mul_add_func_##name(char *buf, const void *a, const void *b, \
+                                           int64_t n) { \
+        const T *x = (const T *)a; \
+        const T *y = (const T *)b; \
+        T acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0; \
+        int64_t i = 0; \
+        for (; i + 4 <= n; i += 4) { \
+            acc0 += x[i] * y[i]; \
+            acc1 += x[i + 1] * y[i + 1]; \
+            acc2 += x[i + 2] * y[i + 2]; \
+            acc3 += x[i + 3] * y[i + 3]; \
+        } \
+        for (; i < n; i++) { \
+            acc0 += x[i] * y[i]; \
+        } \
+        *(T *)buf += (acc0 + acc1) + (acc2 + acc3); \
+    } \
+    /* \
+     * Level-1 BLAS over a rows x cols block given by its row and column \
+     * strides; a vector is a single row. Unit column strides take loops \
+     * the compiler vectorises. \
+     */ \
+    static void axpy_func_##name(char *ybuf, int64_t y_rs, int64_t y_cs, double alpha, \
+                                 const char *xbuf, int64_t x_rs, int64_t x_cs, \
+                                 int64_t rows, int64_t cols) { \
+        T a = (T)alpha; \
+        for (int64_t i = 0; i < rows; i++) { \
+            T *y = (T *)ybuf + i * y_rs; \
+            const T *x = (const T *)xbuf + i * x_rs; \
+            if (x_cs == 1 && y_cs == 1) { \
+                for (int64_t j = 0; j < cols; j++) { \
+                    y[j] += a * x[j]; \
+                } \
+            } else { \
+                for (int64_t j = 0; j < cols; j++) { \
+                    y[j * y_cs] += a * x[j * x_cs]; \
+                } \
+            } \
+        } \
+    } \
+    static void scal_func_##name(char *buf, double alpha, int64_t rows, int64_t cols, \
+                                 int64_t rs, int64_t cs) { \
+        T a = (T)alpha; \
+        for (int64_t i = 0; i < rows; i++) { \
+            T *x = (T *)buf + i * rs; \
+            if (cs == 1) { \
+                for (int64_t j = 0; j < cols; j++) { \
+                    x[j] *= a; \
+                } \
+            } else { \
+                for (int64_t j = 0; j < cols; j++) { \
+                    x[j * cs] *= a; \
+                } \
+            } \
+        } \
+    } \
+    static double asum_func_##name(const char *buf, int64_t rows, int64_t cols, \
+                                   int64_t rs, int64_t cs) { \
+        double acc = 0; \
+        for (int64_t i = 0; i < rows; i++) { \
+            const T *x = (const T *)buf + i * rs; \
+            if (cs == 1) { \
+                BLAS1_SUM_RUN(x, cols, 1, fabs, 1.0, 1.0, acc); \
+            } else { \
+                BLAS1_SUM_RUN(x, cols, cs, fabs, 1.0, 1.0, acc); \
+            } \
+        } \
+        return acc; \
+    } \
+    /* Sum of (x * hi * lo)^2; the scale is split so each half is finite. */ \
+    static double sumsq_##name(const char *buf, int64_t rows, int64_t cols, int64_t rs, \
+                               int64_t cs, double hi, double lo) { \
+        double acc = 0; \
+        for (int64_t i = 0; i < rows; i++) { \
+            const T *x = (const T *)buf + i * rs; \
+            if (hi == 1.0 && lo == 1.0) { \
+                if (cs == 1) { \
+                    BLAS1_SUM_RUN(x, cols, 1, BLAS1_SQUARE, 1.0, 1.0, acc); \
+                } else { \
+                    BLAS1_SUM_RUN(x, cols, cs, BLAS1_SQUARE, 1.0, 1.0, acc); \
+                } \
+            } else { \
+                BLAS1_SUM_RUN(x, cols, cs, BLAS1_SQUARE, hi, lo, acc); \
+            } \
+        } \
+        return acc; \
+    } \
+    /* \
+     * Row-major index of the first element of largest magnitude, or -1 when \
+     * empty. Magnitudes are compared as -|v|, which unlike |v| cannot \
+     * overflow for the most negative integer; NaNs never compare smaller, \
+     * so they are skipped as in the reference BLAS. \
+     */ \
+    static int64_t iamax_func_##name(const char *buf, int64_t rows, int64_t cols, \
+                                     int64_t rs, int64_t cs) { \
+        if (rows == 0 || cols == 0) return -1; \
+        T best = 0; \
+        int64_t best_idx = 0; \
+        for (int64_t i = 0; i < rows; i++) { \
+            const T *x = (const T *)buf + i * rs; \
+            T m = 0; \
+            if (cs == 1) { \
+                m = negabs_min_run_##name(x, cols); \
+            } else { \
+                for (int64_t j = 0; j < cols; j++) { \
+                    T v = BLAS1_NEG_ABS(x[j * cs]); \
+                    m = v < m ? v : m; \
+                } \
+            } \
+            if (m < best) { \
+                int64_t j = 0; \
+                while (BLAS1_NEG_ABS(x[j * cs]) != m) j++; \
+                best = m; \
+                best_idx = i * cols + j; \
+            } \
+        } \
+        return best_idx; \
+    } \
+    /* \
+     * One pass of plain squares, falling back to a second pass scaled by a \
+     * power of two near 1 / max|x| only when that sum overflowed or is \
+     * small enough that squares may have underflowed. \
+     */ \
+    static double nrm2_func_##name(const char *buf, int64_t rows, int64_t cols, \
+                                   int64_t rs, int64_t cs) { \
+        double ssq = sumsq_##name(buf, rows, cols, rs, cs, 1.0, 1.0); \
+        if (ssq != ssq) return ssq; \
+        if (ssq <= DBL_MAX && ssq >= (double)rows * cols * NRM2_SAFE_MIN) return sqrt(ssq); \
+        int64_t idx = iamax_func_##name(buf, rows, cols, rs, cs); \
+        if (idx < 0) return 0; \
+        const T *x = (const T *)buf + (idx / cols) * rs + (idx % cols) * cs; \
+        double amax = fabs((double)*x); \
+        if (amax == 0 || amax > DBL_MAX) return amax; \
+        int e; \
+        frexp(amax, &e); \
+        double hi = ldexp(1.0, -e / 2); \
+        double lo = ldexp(1.0, -e + e / 2); \
+        ssq = sumsq_##name(buf, rows, cols, rs, cs, hi, lo); \
+        return ldexp(sqrt(ssq), e); \
     }
-}
-void buf_fill_val_func_int64(char *buf, double val, int n) {
-    for (int i = 0; i < n; i++) {
-        ((int64_t *)buf)[i] = (int64_t)val;
+
+/*
+ * Reduction steps, each folding value v into accumulator a. Plain max/min
+ * let a NaN stick once seen; the nan* variants skip NaNs instead. Every
+ * step doubles as the combine for partial accumulators.
+ */
+#define REDUCE_STEP_ADD(a, v) ((a) += (v))
+#define REDUCE_STEP_NANADD(a, v) ((a) += (v) == (v) ? (v) : 0)
+#define REDUCE_STEP_MUL(a, v) ((a) *= (v))
+#define REDUCE_STEP_MAX(a, v) ((a) = (((v) > (a)) | ((v) != (v))) ? (v) : (a))
+#define REDUCE_STEP_MIN(a, v) ((a) = (((v) < (a)) | ((v) != (v))) ? (v) : (a))
+#define REDUCE_STEP_NANMAX(a, v) ((a) = (v) > (a) ? (v) : (a))
+#define REDUCE_STEP_NANMIN(a, v) ((a) = (v) < (a) ? (v) : (a))
+
+/*
+ * Contiguous run folded into REDUCE_LANES independent accumulators. The
+ * fixed-width inner loop is the same shape as the row accumulation below,
+ * which the compiler vectorises even for max/min, where it would not
+ * reassociate a single scalar accumulator.
+ */
+#define REDUCE_LANES 16
+
+#define REDUCE_RUN(TA, x, n, init, STEP, result) do { \
+    TA lanes_[REDUCE_LANES]; \
+    for (int l_ = 0; l_ < REDUCE_LANES; l_++) { \
+        lanes_[l_] = (init); \
+    } \
+    int64_t i_ = 0; \
+    for (; i_ + REDUCE_LANES <= (n); i_ += REDUCE_LANES) { \
+        for (int l_ = 0; l_ < REDUCE_LANES; l_++) { \
+            STEP(lanes_[l_], (x)[i_ + l_]); \
+        } \
+    } \
+    for (int l_ = 0; i_ < (n); i_++, l_++) { \
+        STEP(lanes_[l_], (x)[i_]); \
+    } \
+    for (int w_ = REDUCE_LANES / 2; w_ > 0; w_ /= 2) { \
+        for (int l_ = 0; l_ < w_; l_++) { \
+            STEP(lanes_[l_], lanes_[l_ + w_]); \
+        } \
+    } \
+    (result) = lanes_[0]; \
+} while (0)
+
+/* Columns per block of the axis-0 row accumulation, sized to stay in L1. */
+#define REDUCE_COL_BLOCK 1024
+
+/*
+ * Axis-0 reduction as a row accumulation: each row is folded element-wise
+ * into acc, so both are walked contiguously. Columns are blocked so that
+ * acc stays cached however many rows there are.
+ */
+#define REDUCE_COLS(T, acc, x, rows, cols, rs, init, STEP) do { \
+    for (int64_t j0_ = 0; j0_ < (cols); j0_ += REDUCE_COL_BLOCK) { \
+        int64_t jn_ = j0_ + REDUCE_COL_BLOCK < (cols) ? j0_ + REDUCE_COL_BLOCK : (cols); \
+        for (int64_t j_ = j0_; j_ < jn_; j_++) { \
+            (acc)[j_] = (init); \
+        } \
+        for (int64_t r_ = 0; r_ < (rows); r_++) { \
+            const T *restrict row_ = (x) + (size_t)r_ * (rs); \
+            __typeof__(*(acc)) *restrict acc_ = (acc); \
+            for (int64_t j_ = j0_; j_ < jn_; j_++) { \
+                STEP(acc_[j_], row_[j_]); \
+            } \
+        } \
+    } \
+} while (0)
+
+/*
+ * Min/max over a contiguous run, returning the extreme of the non-NaN
+ * values (or the seed if there are none) and flagging whether any NaN was
+ * seen, so one kernel serves both the propagating and NaN-skipping ops.
+ */
+#define DEFINE_SCALAR_MINMAX(T, name, LOWEST, HIGHEST) \
+    static T minmax_run_##name(const T *x, int64_t n, int is_max, int *saw_nan) { \
+        T best = is_max ? LOWEST : HIGHEST; \
+        int any_nan = 0; \
+        if (is_max) { \
+            for (int64_t i = 0; i < n; i++) { \
+                best = x[i] > best ? x[i] : best; \
+                any_nan |= x[i] != x[i]; \
+            } \
+        } else { \
+            for (int64_t i = 0; i < n; i++) { \
+                best = x[i] < best ? x[i] : best; \
+                any_nan |= x[i] != x[i]; \
+            } \
+        } \
+        *saw_nan = any_nan; \
+        return best; \
     }
-}
-void buf_fill_val_func_float(char *buf, double val, int n) {
-    for (int i = 0; i < n; i++) {
-        ((float *)buf)[i] = (float)val;
+
+#ifdef __SSE2__
+/*
+ * SSE2 min/max, two vectors per step. maxps/maxpd return their second
+ * operand when either is NaN, so NaN inputs never reach the accumulators
+ * and are tracked separately with an unordered compare.
+ */
+#define DEFINE_SSE_MINMAX(T, name, V, W, SFX) \
+    static T minmax_run_##name(const T *x, int64_t n, int is_max, int *saw_nan) { \
+        V acc0 = _mm_set1_##SFX(is_max ? -INFINITY : INFINITY); \
+        V acc1 = acc0; \
+        V nan = _mm_setzero_##SFX(); \
+        int64_t i = 0; \
+        if (is_max) { \
+            for (; i + 2 * W <= n; i += 2 * W) { \
+                V v0 = _mm_loadu_##SFX(x + i); \
+                V v1 = _mm_loadu_##SFX(x + i + W); \
+                acc0 = _mm_max_##SFX(v0, acc0); \
+                acc1 = _mm_max_##SFX(v1, acc1); \
+                nan = _mm_or_##SFX(nan, _mm_cmpunord_##SFX(v0, v1)); \
+            } \
+            acc0 = _mm_max_##SFX(acc0, acc1); \
+        } else { \
+            for (; i + 2 * W <= n; i += 2 * W) { \
+                V v0 = _mm_loadu_##SFX(x + i); \
+                V v1 = _mm_loadu_##SFX(x + i + W); \
+                acc0 = _mm_min_##SFX(v0, acc0); \
+                acc1 = _mm_min_##SFX(v1, acc1); \
+                nan = _mm_or_##SFX(nan, _mm_cmpunord_##SFX(v0, v1)); \
+            } \
+            acc0 = _mm_min_##SFX(acc0, acc1); \
+        } \
+        T lanes[W]; \
+        _mm_storeu_##SFX(lanes, acc0); \
+        T best = lanes[0]; \
+        for (int l = 1; l < W; l++) { \
+            best = (is_max ? lanes[l] > best : lanes[l] < best) ? lanes[l] : best; \
+        } \
+        int any_nan = _mm_movemask_##SFX(nan) != 0; \
+        for (; i < n; i++) { \
+            best = (is_max ? x[i] > best : x[i] < best) ? x[i] : best; \
+            any_nan |= x[i] != x[i]; \
+        } \
+        *saw_nan = any_nan; \
+        return best; \
     }
-}
-void buf_fill_val_func_double(char *buf, double val, int n) {
-    for (int i = 0; i < n; i++) {
-        ((double *)buf)[i] = (double)val;
+
+DEFINE_SSE_MINMAX(float, float, __m128, 4, ps)
+DEFINE_SSE_MINMAX(double, double, __m128d, 2, pd)
+#else
+DEFINE_SCALAR_MINMAX(float, float, -INFINITY, INFINITY)
+DEFINE_SCALAR_MINMAX(double, double, -INFINITY, INFINITY)
+#endif
+DEFINE_SCALAR_MINMAX(int32_t, int32, INT32_MIN, INT32_MAX)
+DEFINE_SCALAR_MINMAX(int64_t, int64, INT64_MIN, INT64_MAX)
+
+/*
+ * The smallest -|x[i]| of a contiguous run, or 0 if there is none, with
+ * NaNs skipped. iamax takes the largest magnitude as this and then scans
+ * for its first occurrence.
+ */
+#define DEFINE_SCALAR_NEGABS_MIN(T, name) \
+    static T negabs_min_run_##name(const T *x, int64_t n) { \
+        T lanes[BLAS1_LANES] = {0}; \
+        int64_t i = 0; \
+        for (; i + BLAS1_LANES <= n; i += BLAS1_LANES) { \
+            for (int l = 0; l < BLAS1_LANES; l++) { \
+                T v = BLAS1_NEG_ABS(x[i + l]); \
+                lanes[l] = v < lanes[l] ? v : lanes[l]; \
+            } \
+        } \
+        T best = 0; \
+        for (; i < n; i++) { \
+            T v = BLAS1_NEG_ABS(x[i]); \
+            best = v < best ? v : best; \
+        } \
+        for (int l = 0; l < BLAS1_LANES; l++) { \
+            best = lanes[l] < best ? lanes[l] : best; \
+        } \
+        return best; \
     }
-}
 
-void buf_fill_vals_func_int32(char *buf, const void *vals, int n) {
-    for (int i = 0; i < n; i++) {
-        ((int32_t *)buf)[i] = ((int32_t *)vals)[i];
+#ifdef __SSE2__
+/*
+ * -|v| is v with the sign bit set. As in the min/max kernels, minps/minpd
+ * keep the accumulator when the loaded value is NaN.
+ */
+#define DEFINE_SSE_NEGABS_MIN(T, name, V, W, SFX) \
+    static T negabs_min_run_##name(const T *x, int64_t n) { \
+        V sign = _mm_set1_##SFX(-0.0); \
+        V acc0 = _mm_setzero_##SFX(); \
+        V acc1 = acc0; \
+        int64_t i = 0; \
+        for (; i + 2 * W <= n; i += 2 * W) { \
+            acc0 = _mm_min_##SFX(_mm_or_##SFX(_mm_loadu_##SFX(x + i), sign), acc0); \
+            acc1 = _mm_min_##SFX(_mm_or_##SFX(_mm_loadu_##SFX(x + i + W), sign), acc1); \
+        } \
+        T lanes[W]; \
+        _mm_storeu_##SFX(lanes, _mm_min_##SFX(acc0, acc1)); \
+        T best = 0; \
+        for (int l = 0; l < W; l++) { \
+            best = lanes[l] < best ? lanes[l] : best; \
+        } \
+        for (; i < n; i++) { \
+            T v = BLAS1_NEG_ABS(x[i]); \
+            best = v < best ? v : best; \
+        } \
+        return best; \
     }
-}
-void buf_fill_vals_func_int64(char *buf, const void *vals, int n) {
-    for (int i = 0; i < n; i++) {
-        ((int64_t *)buf)[i] = ((int64_t *)vals)[i];
+
+DEFINE_SSE_NEGABS_MIN(float, float, __m128, 4, ps)
+DEFINE_SSE_NEGABS_MIN(double, double, __m128d, 2, pd)
+#else
+DEFINE_SCALAR_NEGABS_MIN(float, float)
+DEFINE_SCALAR_NEGABS_MIN(double, double)
+#endif
+DEFINE_SCALAR_NEGABS_MIN(int32_t, int32)
+DEFINE_SCALAR_NEGABS_MIN(int64_t, int64)
+
+/*
+ * Typed reduction kernels over a rows x cols block with unit column stride.
+ * M is the accumulator and output type of mean; LOWEST and HIGHEST seed
+ * max and min, and QNAN is what nanmax/nanmin return for all-NaN input.
+ */
+#define DEFINE_REDUCE_KERNELS(T, name, M, LOWEST, HIGHEST, QNAN) \
+    static int all_nan_##name(const T *x, int64_t n, int64_t stride) { \
+        for (int64_t i = 0; i < n; i++) { \
+            if (x[(size_t)i * stride] == x[(size_t)i * stride]) return 0; \
+        } \
+        return 1; \
+    } \
+    static void reduce_row_##name(char *out, int64_t idx, const T *x, int64_t n, \
+                                  REDUCE_OP op) { \
+        T *o = (T *)out + idx; \
+        switch (op) { \
+        case REDUCE_SUM: REDUCE_RUN(T, x, n, 0, REDUCE_STEP_ADD, *o); break; \
+        case REDUCE_NANSUM: REDUCE_RUN(T, x, n, 0, REDUCE_STEP_NANADD, *o); break; \
+        case REDUCE_PROD: REDUCE_RUN(T, x, n, 1, REDUCE_STEP_MUL, *o); break; \
+        case REDUCE_MAX: \
+        case REDUCE_MIN: \
+        case REDUCE_NANMAX: \
+        case REDUCE_NANMIN: { \
+            int is_max = op == REDUCE_MAX || op == REDUCE_NANMAX; \
+            int saw_nan; \
+            *o = minmax_run_##name(x, n, is_max, &saw_nan); \
+            if (saw_nan && (op == REDUCE_MAX || op == REDUCE_MIN)) { \
+                *o = QNAN; \
+            } else if (saw_nan && *o == (is_max ? LOWEST : HIGHEST) && \
+                       all_nan_##name(x, n, 1)) { \
+                *o = QNAN; \
+            } \
+            break; \
+        } \
+        case REDUCE_MEAN: { \
+            M acc; \
+            REDUCE_RUN(M, x, n, 0, REDUCE_STEP_ADD, acc); \
+            ((M *)out)[idx] = acc / n; \
+            break; \
+        } \
+        case REDUCE_NANMEAN: { \
+            M acc = 0; \
+            int64_t count = 0; \
+            for (int64_t i = 0; i < n; i++) { \
+                if (x[i] == x[i]) { \
+                    acc += x[i]; \
+                    count++; \
+                } \
+            } \
+            ((M *)out)[idx] = count ? acc / count : NAN; \
+            break; \
+        } \
+        case REDUCE_ARGMAX: \
+        case REDUCE_ARGMIN: { \
+            /* First occurrence wins, and the first NaN beats everything. */ \
+            int is_max = op == REDUCE_ARGMAX; \
+            T best = x[0]; \
+            int64_t best_idx = 0; \
+            for (int64_t i = 1; i < n && best == best; i++) { \
+                T v = x[i]; \
+                if ((is_max ? v > best : v < best) || v != v) { \
+                    best = v; \
+                    best_idx = i; \
+                } \
+            } \
+            ((int64_t *)out)[idx] = best_idx; \
+            break; \
+        } \
+        default: break; \
+        } \
+    } \
+    static int reduce_cols_##name(char *out, const T *x, int64_t rows, int64_t cols, \
+                                  int64_t rs, REDUCE_OP op) { \
+        T *acc = (T *)out; \
+        switch (op) { \
+        case REDUCE_SUM: REDUCE_COLS(T, acc, x, rows, cols, rs, 0, REDUCE_STEP_ADD); break; \
+        case REDUCE_NANSUM: \
+            REDUCE_COLS(T, acc, x, rows, cols, rs, 0, REDUCE_STEP_NANADD); \
+            break; \
+        case REDUCE_PROD: REDUCE_COLS(T, acc, x, rows, cols, rs, 1, REDUCE_STEP_MUL); break; \
+        case REDUCE_MAX: \
+            REDUCE_COLS(T, acc, x, rows, cols, rs, LOWEST, REDUCE_STEP_MAX); \
+            break; \
+        case REDUCE_MIN: \
+            REDUCE_COLS(T, acc, x, rows, cols, rs, HIGHEST, REDUCE_STEP_MIN); \
+            break; \
+        case REDUCE_NANMAX: \
+        case REDUCE_NANMIN: { \
+            T seed = op == REDUCE_NANMAX ? LOWEST : HIGHEST; \
+            if (op == REDUCE_NANMAX) { \
+                REDUCE_COLS(T, acc, x, rows, cols, rs, LOWEST, REDUCE_STEP_NANMAX); \
+            } else { \
+                REDUCE_COLS(T, acc, x, rows, cols, rs, HIGHEST, REDUCE_STEP_NANMIN); \
+            } \
+            for (int64_t j = 0; j < cols; j++) { \
+                if (acc[j] == seed && all_nan_##name(x + j, rows, rs)) acc[j] = QNAN; \
+            } \
+            break; \
+        } \
+        case REDUCE_MEAN: { \
+            M *mean = (M *)out; \
+            REDUCE_COLS(T, mean, x, rows, cols, rs, 0, REDUCE_STEP_ADD); \
+            for (int64_t j = 0; j < cols; j++) { \
+                mean[j] /= rows; \
+            } \
+            break; \
+        } \
+        case REDUCE_NANMEAN: { \
+            M *mean = (M *)out; \
+            int64_t *counts = calloc(cols, sizeof(int64_t)); \
+            if (!counts) return 1; \
+            memset(mean, 0, cols * sizeof(M)); \
+            for (int64_t r = 0; r < rows; r++) { \
+                const T *row = x + (size_t)r * rs; \
+                for (int64_t j = 0; j < cols; j++) { \
+                    int valid = row[j] == row[j]; \
+                    mean[j] += valid ? row[j] : 0; \
+                    counts[j] += valid; \
+                } \
+            } \
+            for (int64_t j = 0; j < cols; j++) { \
+                mean[j] = counts[j] ? mean[j] / counts[j] : NAN; \
+            } \
+            free(counts); \
+            break; \
+        } \
+        case REDUCE_ARGMAX: \
+        case REDUCE_ARGMIN: { \
+            int is_max = op == REDUCE_ARGMAX; \
+            int64_t *best_idx = (int64_t *)out; \
+            T *best = malloc(cols * sizeof(T)); \
+            if (!best) return 1; \
+            memcpy(best, x, cols * sizeof(T)); \
+            memset(best_idx, 0, cols * sizeof(int64_t)); \
+            for (int64_t r = 1; r < rows; r++) { \
+                const T *row = x + (size_t)r * rs; \
+                for (int64_t j = 0; j < cols; j++) { \
+                    T v = row[j]; \
+                    if (best[j] == best[j] && \
+                        ((is_max ? v > best[j] : v < best[j]) || v != v)) { \
+                        best[j] = v; \
+                        best_idx[j] = r; \
+                    } \
+                } \
+            } \
+            free(best); \
+            break; \
+        } \
+        default: break; \
+        } \
+        return 0; \
+    } \
+    static int reduce_func_##name(char *out, const char *vals, int64_t rows, int64_t cols, \
+                                  int64_t rs, int axis, REDUCE_OP op) { \
+        const T *x = (const T *)vals; \
+        if (axis == 0) { \
+            return reduce_cols_##name(out, x, rows, cols, rs, op); \
+        } \
+        for (int64_t r = 0; r < rows; r++) { \
+            reduce_row_##name(out, r, x + (size_t)r * rs, cols, op); \
+        } \
+        return 0; \
     }
-}
-void buf_fill_vals_func_float(char *buf, const void *vals, int n) {
-    for (int i = 0; i < n; i++) {
-        ((float *)buf)[i] = ((float *)vals)[i];
+
+/* Flattened scans at least this long use the two-pass parallel scan. */
+#define SCAN_PARALLEL_MIN_ELEMS (1 << 16)
+
+typedef struct scanCtx {
+    char *out;
+    const char *vals;
+    int64_t n;
+    int64_t block;
+    SCAN_OP op;
+    char *carries;
+} scanCtx;
+
+/*
+ * Typed scans over a rows x cols block with unit column stride, written to
+ * a contiguous rows x cols out. Axis 0 adds (or multiplies) each row into
+ * the previous output row element-wise, so it vectorises across columns.
+ * A long single row is scanned in two passes over one block per thread:
+ * the first folds each block to its total, a short serial scan turns the
+ * totals into carries, and the second scans each block from its carry.
+ */
+#define DEFINE_SCAN_KERNELS(T, name) \
+    static void scan_run_##name(T *out, const T *x, int64_t n, T carry, SCAN_OP op) { \
+        if (op == SCAN_CUMSUM) { \
+            for (int64_t i = 0; i < n; i++) { \
+                carry += x[i]; \
+                out[i] = carry; \
+            } \
+        } else { \
+            for (int64_t i = 0; i < n; i++) { \
+                carry *= x[i]; \
+                out[i] = carry; \
+            } \
+        } \
+    } \
+    static void scan_fold_blocks_##name(void *arg, int64_t begin, int64_t end) { \
+        scanCtx *ctx = arg; \
+        const T *x = (const T *)ctx->vals; \
+        T *totals = (T *)ctx->carries; \
+        for (int64_t b = begin; b < end; b++) { \
+            int64_t start = b * ctx->block; \
+            int64_t len = start + ctx->block < ctx->n ? ctx->block : ctx->n - start; \
+            if (ctx->op == SCAN_CUMSUM) { \
+                REDUCE_RUN(T, x + start, len, 0, REDUCE_STEP_ADD, totals[b]); \
+            } else { \
+                REDUCE_RUN(T, x + start, len, 1, REDUCE_STEP_MUL, totals[b]); \
+            } \
+        } \
+    } \
+    static void scan_blocks_##name(void *arg, int64_t begin, int64_t end) { \
+        scanCtx *ctx = arg; \
+        const T *x = (const T *)ctx->vals; \
+        T *out = (T *)ctx->out; \
+        const T *carries = (const T *)ctx->carries; \
+        for (int64_t b = begin; b < end; b++) { \
+            int64_t start = b * ctx->block; \
+            int64_t len = start + ctx->block < ctx->n ? ctx->block : ctx->n - start; \
+            scan_run_##name(out + start, x + start, len, carries[b], ctx->op); \
+        } \
+    } \
+    static void scan_parallel_##name(T *out, const T *x, int64_t n, int64_t nblocks, \
+                                     SCAN_OP op) { \
+        T *carries = malloc(nblocks * sizeof(T)); \
+        if (!carries) { \
+            scan_run_##name(out, x, n, op == SCAN_CUMSUM ? 0 : 1, op); \
+            return; \
+        } \
+        scanCtx ctx = {(char *)out, (const char *)x, n, (n + nblocks - 1) / nblocks, \
+                       op, (char *)carries}; \
+        parallel_for(nblocks, 1, scan_fold_blocks_##name, &ctx); \
+        T carry = op == SCAN_CUMSUM ? 0 : 1; \
+        for (int64_t b = 0; b < nblocks; b++) { \
+            T total = carries[b]; \
+            carries[b] = carry; \
+            carry = op == SCAN_CUMSUM ? carry + total : carry * total; \
+        } \
+        parallel_for(nblocks, 1, scan_blocks_##name, &ctx); \
+        free(carries); \
+    } \
+    static void scan_func_##name(char *buf, const char *vals, int64_t rows, int64_t cols, \
+                                 int64_t rs, int axis, SCAN_OP op) { \
+        T *out = (T *)buf; \
+        const T *x = (const T *)vals; \
+        T identity = op == SCAN_CUMSUM ? 0 : 1; \
+        if (axis == 1) { \
+            int nthreads = parallel_num_threads(); \
+            if (rows == 1 && cols >= SCAN_PARALLEL_MIN_ELEMS && nthreads > 1) { \
+                scan_parallel_##name(out, x, cols, nthreads, op); \
+                return; \
+            } \
+            for (int64_t r = 0; r < rows; r++) { \
+                scan_run_##name(out + (size_t)r * cols, x + (size_t)r * rs, cols, \
+                                identity, op); \
+            } \
+            return; \
+        } \
+        if (rows > 0) memcpy(out, x, cols * sizeof(T)); \
+        for (int64_t r = 1; r < rows; r++) { \
+            const T *restrict prev = out + (size_t)(r - 1) * cols; \
+            const T *restrict row = x + (size_t)r * rs; \
+            T *restrict cur = out + (size_t)r * cols; \
+            if (op == SCAN_CUMSUM) { \
+                for (int64_t j = 0; j < cols; j++) cur[j] = prev[j] + row[j]; \
+            } else { \
+                for (int64_t j = 0; j < cols; j++) cur[j] = prev[j] * row[j]; \
+            } \
+        } \
     }
+
+/*
+ * Blocked GEMM computing C += A B for a row-major m x n C. A and B are read
+ * through arbitrary element strides, so transposed operands are consumed
+ * in place: the operand layout only decides how each block is packed into
+ * the contiguous MR-row and NR-column panels that the micro-kernel reads.
+ */
+#define GEMM_MR 4
+#define GEMM_NR 8
+
+typedef enum {GEMM_LAYOUT_N, GEMM_LAYOUT_T, GEMM_LAYOUT_STRIDED} GEMM_LAYOUT;
+
+static GEMM_LAYOUT
+gemm_layout(int64_t row_stride, int64_t col_stride)
+{
+    if (col_stride == 1) return GEMM_LAYOUT_N;
+    if (row_stride == 1) return GEMM_LAYOUT_T;
+    return GEMM_LAYOUT_STRIDED;
 }
-void buf_fill_vals_func_double(char *buf, const void *vals, int n) {
-    for (int i = 0; i < n; i++) {
-        ((double *)buf)[i] = ((double *)vals)[i];
-    }
+
+// Packing buffers larger than this are freed after each product.
+#define GEMM_SCRATCH_KEEP_BYTES ((size_t)8 << 20)
+
+typedef struct gemmScratch {
+    void *bufs[2];
+    size_t sizes[2];
+} gemmScratch;
+
+static pthread_key_t gemm_scratch_key;
+static pthread_once_t gemm_scratch_once = PTHREAD_ONCE_INIT;
+
+static void
+gemm_scratch_free(void *arg)
+{
+    gemmScratch *s = arg;
+    free(s->bufs[0]);
+    free(s->bufs[1]);
+    free(s);
 }
 
-void buf_fill_uniform_int_func_int32(char *buf, int low, int high, int n) {
-    for (int i = 0; i < n; i++) {
-        int v = low + rand() / (RAND_MAX / (high - low + 1) + 1);
-        ((int32_t *)buf)[i] = (int32_t)v;
-    }
+static void
+gemm_scratch_init(void)
+{
+    pthread_key_create(&gemm_scratch_key, gemm_scratch_free);
 }
-void buf_fill_uniform_int_func_int64(char *buf, int low, int high, int n) {
-    for (int i = 0; i < n; i++) {
-        int v = low + rand() / (RAND_MAX / (high - low + 1) + 1);
-        ((int64_t *)buf)[i] = (int64_t)v;
+
+/*
+ * Per-thread packing buffers, grown on demand and reused across calls;
+ * they are freed when their thread exits. Returns NULL if out of memory.
+ */
+static void *
+gemm_scratch(int which, size_t size)
+{
+    pthread_once(&gemm_scratch_once, gemm_scratch_init);
+    gemmScratch *s = pthread_getspecific(gemm_scratch_key);
+    if (s == NULL) {
+        s = calloc(1, sizeof(gemmScratch));
+        if (s == NULL) return NULL;
+        if (pthread_setspecific(gemm_scratch_key, s)) {
+            free(s);
+            return NULL;
+        }
     }
-}
-void buf_fill_uniform_int_func_float(char *buf, int low, int high, int n) {
-    for (int i = 0; i < n; i++) {
-        int v = low + rand() / (RAND_MAX / (high - low + 1) + 1);
-        ((float *)buf)[i] = (float)v;
+    if (size > s->sizes[which]) {
+        free(s->bufs[which]);
+        void *buf = NULL;
+        if (posix_memalign(&buf, 64, size)) buf = NULL;
+        s->bufs[which] = buf;
+        s->sizes[which] = buf ? size : 0;
     }
+    return s->bufs[which];
 }
-void buf_fill_uniform_int_func_double(char *buf, int low, int high, int n) {
-    for (int i = 0; i < n; i++) {
-        int v = low + rand() / (RAND_MAX / (high - low + 1) + 1);
-        ((double *)buf)[i] = (double)v;
+
+/* Frees this thread's buffers past GEMM_SCRATCH_KEEP_BYTES. */
+static void
+gemm_scratch_trim(void)
+{
+    gemmScratch *s = pthread_getspecific(gemm_scratch_key);
+    for (int which = 0; s && which < 2; which++) {
+        if (s->sizes[which] > GEMM_SCRATCH_KEEP_BYTES) {
+            free(s->bufs[which]);
+            s->bufs[which] = NULL;
+            s->sizes[which] = 0;
+        }
     }
 }
 
-void reduce_mul_add_func_int32(char *buf, const void *a, const void *b, int n) {
-    for (int i = 0; i < n; i++) {
-        *(int32_t *)buf += ((int32_t *)a)[i] *((int32_t *)b)[i];
+#define GEMM_MIN(x, y) ((x) < (y) ? (x) : (y))
+
+#define DEFINE_GEMM_KERNELS(T, name) \
+    static void gemm_pack_a_##name(T *out, const T *a, int64_t rs, int64_t cs, \
+                                   int64_t mc, int64_t kc) { \
+        GEMM_LAYOUT layout = gemm_layout(rs, cs); \
+        for (int64_t ir = 0; ir < mc; ir += GEMM_MR, out += GEMM_MR * kc) { \
+            int mr = (int)GEMM_MIN(GEMM_MR, mc - ir); \
+            const T *panel = a + ir * rs; \
+            if (layout == GEMM_LAYOUT_T) { \
+                for (int64_t p = 0; p < kc; p++) { \
+                    const T *col = panel + p * cs; \
+                    for (int r = 0; r < GEMM_MR; r++) { \
+                        out[p * GEMM_MR + r] = r < mr ? col[r] : 0; \
+                    } \
+                } \
+                continue; \
+            } \
+            for (int r = 0; r < GEMM_MR; r++) { \
+                const T *row = panel + r * rs; \
+                for (int64_t p = 0; p < kc; p++) { \
+                    out[p * GEMM_MR + r] = r < mr ? row[p * cs] : 0; \
+                } \
+            } \
+        } \
+    } \
+    static void gemm_pack_b_##name(T *out, const T *b, int64_t rs, int64_t cs, \
+                                   int64_t kc, int64_t nc) { \
+        GEMM_LAYOUT layout = gemm_layout(rs, cs); \
+        for (int64_t jr = 0; jr < nc; jr += GEMM_NR, out += GEMM_NR * kc) { \
+            int nr = (int)GEMM_MIN(GEMM_NR, nc - jr); \
+            const T *panel = b + jr * cs; \
+            if (layout == GEMM_LAYOUT_N) { \
+                for (int64_t p = 0; p < kc; p++) { \
+                    const T *row = panel + p * rs; \
+                    for (int c = 0; c < GEMM_NR; c++) { \
+                        out[p * GEMM_NR + c] = c < nr ? row[c] : 0; \
+                    } \
+                } \
+                continue; \
+            } \
+            for (int c = 0; c < GEMM_NR; c++) { \
+                const T *col = panel + c * cs; \
+                for (int64_t p = 0; p < kc; p++) { \
+                    out[p * GEMM_NR + c] = c < nr ? col[p * rs] : 0; \
+                } \
+            } \
+        } \
+    } \
+    static void gemm_micro_##name(int64_t kc, const T *pa, const T *pb, \
+                                  T *c, int64_t ldc, int mr, int nr) { \
+        T acc[GEMM_MR][GEMM_NR] = {{0}}; \
+        for (int64_t p = 0; p < kc; p++) { \
+            for (int i = 0; i < GEMM_MR; i++) { \
+                T av = pa[p * GEMM_MR + i]; \
+                for (int j = 0; j < GEMM_NR; j++) { \
+                    acc[i][j] += av * pb[p * GEMM_NR + j]; \
+                } \
+            } \
+        } \
+        for (int i = 0; i < mr; i++) { \
+            for (int j = 0; j < nr; j++) { \
+                c[i * ldc + j] += acc[i][j]; \
+            } \
+        } \
+    } \
+    static int gemm_func_##name(char *cbuf, const char *abuf, int64_t a_rs, int64_t a_cs, \
+                                const char *bbuf, int64_t b_rs, int64_t b_cs, \
+                                int64_t m, int64_t n, int64_t k, const gemmBlocking *blk) { \
+        T *c = (T *)cbuf; \
+        const T *a = (const T *)abuf; \
+        const T *b = (const T *)bbuf; \
+        int64_t mc_max = GEMM_MIN(blk->mc, m) + GEMM_MR; \
+        int64_t kc_max = GEMM_MIN(blk->kc, k); \
+        int64_t nc_max = GEMM_MIN(blk->nc, n) + GEMM_NR; \
+        T *pa = gemm_scratch(0, (size_t)mc_max * kc_max * sizeof(T)); \
+        T *pb = gemm_scratch(1, (size_t)kc_max * nc_max * sizeof(T)); \
+        if (kc_max && (!pa || !pb)) return 1; \
+        for (int64_t jc = 0; jc < n; jc += blk->nc) { \
+            int64_t nc = GEMM_MIN(blk->nc, n - jc); \
+            for (int64_t pc = 0; pc < k; pc += blk->kc) { \
+                int64_t kc = GEMM_MIN(blk->kc, k - pc); \
+                gemm_pack_b_##name(pb, b + pc * b_rs + jc * b_cs, b_rs, b_cs, kc, nc); \
+                for (int64_t ic = 0; ic < m; ic += blk->mc) { \
+                    int64_t mc = GEMM_MIN(blk->mc, m - ic); \
+                    gemm_pack_a_##name(pa, a + ic * a_rs + pc * a_cs, a_rs, a_cs, mc, kc); \
+                    for (int64_t jr = 0; jr < nc; jr += GEMM_NR) { \
+                        for (int64_t ir = 0; ir < mc; ir += GEMM_MR) { \
+                            gemm_micro_##name( \
+                                kc, pa + ir * kc, pb + jr * kc, \
+                                c + (ic + ir) * n + jc + jr, n, \
+                                GEMM_MIN(GEMM_MR, mc - ir), \
+                                GEMM_MIN(GEMM_NR, nc - jr)); \
+                        } \
+                    } \
+                } \
+            } \
+        } \
+        gemm_scratch_trim(); \
+        return 0; \
     }
-}
-void reduce_mul_add_func_int64(char *buf, const void *a, const void *b, int n) {
-    for (int i = 0; i < n; i++) {
-        *(int64_t *)buf += ((int64_t *)a)[i] *((int64_t *)b)[i];
+
+/*
+ * CSR kernels. The nonzero scans walk the dense input in row-major order,
+ * so indices come out sorted within each row. spmm computes rows
+ * [begin, end) of out = A @ B for CSR A and a strided dense B of n
+ * columns, overwriting out; a single column (SpMV) accumulates in a
+ * register.
+ */
+#define DEFINE_SPARSE_KERNELS(T, name) \
+    static int64_t csr_count_nonzero_func_##name(int64_t *row_counts, const char *buf, \
+                                                 int64_t rows, int64_t cols, \
+                                                 int64_t rs, int64_t cs) { \
+        const T *x = (const T *)buf; \
+        int64_t total = 0; \
+        for (int64_t i = 0; i < rows; i++) { \
+            int64_t count = 0; \
+            for (int64_t j = 0; j < cols; j++) { \
+                count += x[(size_t)i * rs + (size_t)j * cs] != 0; \
+            } \
+            row_counts[i] = count; \
+            total += count; \
+        } \
+        return total; \
+    } \
+    static void csr_gather_nonzero_func_##name(int64_t *indices, char *data, const char *buf, \
+                                               int64_t rows, int64_t cols, \
+                                               int64_t rs, int64_t cs) { \
+        const T *x = (const T *)buf; \
+        T *d = (T *)data; \
+        int64_t p = 0; \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j++) { \
+                T v = x[(size_t)i * rs + (size_t)j * cs]; \
+                if (v != 0) { \
+                    indices[p] = j; \
+                    d[p++] = v; \
+                } \
+            } \
+        } \
+    } \
+    static void spmm_func_##name(char *out, const int64_t *indptr, const int64_t *indices, \
+                                 const char *data, int64_t begin, int64_t end, \
+                                 const char *buf, int64_t b_rs, int64_t b_cs, int64_t n) { \
+        const T *restrict vals = (const T *)data; \
+        const T *b = (const T *)buf; \
+        T *restrict o = (T *)out + (size_t)begin * n; \
+        for (int64_t i = begin; i < end; i++, o += n) { \
+            if (n == 1) { \
+                T acc = 0; \
+                for (int64_t p = indptr[i]; p < indptr[i + 1]; p++) { \
+                    acc += vals[p] * b[(size_t)indices[p] * b_rs]; \
+                } \
+                o[0] = acc; \
+                continue; \
+            } \
+            for (int64_t j = 0; j < n; j++) o[j] = 0; \
+            for (int64_t p = indptr[i]; p < indptr[i + 1]; p++) { \
+                T v = vals[p]; \
+                const T *restrict row = b + (size_t)indices[p] * b_rs; \
+                if (b_cs == 1) { \
+                    for (int64_t j = 0; j < n; j++) o[j] += v * row[j]; \
+                } else { \
+                    for (int64_t j = 0; j < n; j++) o[j] += v * row[(size_t)j * b_cs]; \
+                } \
+            } \
+        } \
     }
-}
-void reduce_mul_add_func_float(char *buf, const void *a, const void *b, int n) {
-    for (int i = 0; i < n; i++) {
-        *(float *)buf += ((float *)a)[i] *((float *)b)[i];
+
+/*
+ * Indexed copies for take, put and masks. Row i of the n rows moved starts
+ * at element offsets[i] of the strided side and holds cols elements cs
+ * apart; the other side is contiguous, with vals_step 0 in scatter reusing
+ * one row for all. Offsets are bounds checked by the caller. Single
+ * elements (cols 1) are the embedding-lookup pattern of scattered loads,
+ * so the loads GATHER_PREFETCH_DIST indices ahead are prefetched.
+ */
+#define GATHER_PREFETCH_DIST 16
+
+#define DEFINE_INDEX_KERNELS(T, name) \
+    static void gather_func_##name(char *out, const char *buf, const int64_t *offsets, \
+                                   int64_t n, int64_t cols, int64_t cs) { \
+        T *restrict o = (T *)out; \
+        const T *x = (const T *)buf; \
+        if (cols == 1) { \
+            int64_t i = 0; \
+            for (; i + GATHER_PREFETCH_DIST < n; i++) { \
+                __builtin_prefetch(x + offsets[i + GATHER_PREFETCH_DIST]); \
+                o[i] = x[offsets[i]]; \
+            } \
+            for (; i < n; i++) o[i] = x[offsets[i]]; \
+            return; \
+        } \
+        for (int64_t i = 0; i < n; i++, o += cols) { \
+            const T *row = x + offsets[i]; \
+            if (i + 1 < n) __builtin_prefetch(x + offsets[i + 1]); \
+            if (cs == 1) { \
+                memcpy(o, row, cols * sizeof(T)); \
+            } else { \
+                for (int64_t j = 0; j < cols; j++) o[j] = row[j * cs]; \
+            } \
+        } \
+    } \
+    static void scatter_func_##name(char *buf, const int64_t *offsets, int64_t n, \
+                                    int64_t cols, int64_t cs, const char *vals, \
+                                    int64_t vals_step) { \
+        T *x = (T *)buf; \
+        const T *restrict v = (const T *)vals; \
+        if (cols == 1) { \
+            int64_t i = 0; \
+            for (; i + GATHER_PREFETCH_DIST < n; i++) { \
+                __builtin_prefetch(x + offsets[i + GATHER_PREFETCH_DIST], 1); \
+                x[offsets[i]] = v[i * vals_step]; \
+            } \
+            for (; i < n; i++) x[offsets[i]] = v[i * vals_step]; \
+            return; \
+        } \
+        for (int64_t i = 0; i < n; i++, v += vals_step) { \
+            T *row = x + offsets[i]; \
+            for (int64_t j = 0; j < cols; j++) row[j * cs] = v[j]; \
+        } \
+    } \
+    static int64_t nonzero_offsets_func_##name(int64_t *out, const char *buf, \
+                                               int64_t rows, int64_t cols, \
+                                               int64_t rs, int64_t cs, \
+                                               int64_t out_rs, int64_t out_cs) { \
+        const T *m = (const T *)buf; \
+        int64_t count = 0; \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j++) { \
+                if (m[i * rs + j * cs] == 0) continue; \
+                if (out) out[count] = i * out_rs + j * out_cs; \
+                count++; \
+            } \
+        } \
+        return count; \
     }
+
+static int
+print_int(char *out, int64_t v)
+{
+    char digits[20];
+    uint64_t u = v < 0 ? -(uint64_t)v : (uint64_t)v;
+    int n = 0;
+    do {
+        digits[n++] = '0' + u % 10;
+        u /= 10;
+    } while (u);
+
+    int len = 0;
+    if (v < 0) out[len++] = '-';
+    while (n) out[len++] = digits[--n];
+    out[len] = '\0';
+    return len;
 }
-void reduce_mul_add_func_double(char *buf, const void *a, const void *b, int n) {
-    for (int i = 0; i < n; i++) {
-        *(double *)buf += ((double *)a)[i] *((double *)b)[i];
-    }
+
+static int
+print_float(char *out, double v, int precision)
+{
+    return snprintf(out, PRINT_VAL_MAX_LEN, "%.*e", precision, v);
 }
 
-void reduce_sum_func_int32(char *buf, const void *vals, int n) {
-    for (int i = 0; i < n; i++) {
-        *(int32_t *)buf += ((int32_t *)vals)[i];
+/*
+ * The threaded backend's gemm: C is split into panels of blk->panel rows
+ * (blk->mc when 0) that pool threads multiply with the simd kernel. Each
+ * panel packs its own B blocks, so smaller products run inline.
+ */
+#define GEMM_PARALLEL_MIN_FLOPS (1 << 21)
+
+typedef struct gemmRowsCtx {
+    gemm_func kernel;
+    char *c;
+    const char *a;
+    int64_t a_rs, a_cs;
+    const char *b;
+    int64_t b_rs, b_cs;
+    int64_t n, k;
+    const gemmBlocking *blk;
+    int64_t dtype_size;
+    int failed;
+} gemmRowsCtx;
+
+static void
+gemm_rows(void *arg, int64_t begin, int64_t end)
+{
+    gemmRowsCtx *ctx = arg;
+    if (ctx->kernel(ctx->c + begin * ctx->n * ctx->dtype_size,
+                    ctx->a + begin * ctx->a_rs * ctx->dtype_size, ctx->a_rs, ctx->a_cs,
+                    ctx->b, ctx->b_rs, ctx->b_cs, end - begin, ctx->n, ctx->k, ctx->blk)) {
+        __atomic_store_n(&ctx->failed, 1, __ATOMIC_RELAXED);
     }
 }
-void reduce_sum_func_int64(char *buf, const void *vals, int n) {
-    for (int i = 0; i < n; i++) {
-        *(int64_t *)buf += ((int64_t *)vals)[i];
+
+#define DEFINE_THREADED_GEMM(T, name) \
+    static int gemm_threaded_func_##name(char *c, const char *a, int64_t a_rs, int64_t a_cs, \
+                                         const char *b, int64_t b_rs, int64_t b_cs, \
+                                         int64_t m, int64_t n, int64_t k, \
+                                         const gemmBlocking *blk) { \
+        int64_t panel = blk->panel ? blk->panel : blk->mc; \
+        if (m < 2 * panel || (double)m * n * k < GEMM_PARALLEL_MIN_FLOPS) { \
+            return gemm_func_##name(c, a, a_rs, a_cs, b, b_rs, b_cs, m, n, k, blk); \
+        } \
+        gemmRowsCtx ctx = {gemm_func_##name, c, a, a_rs, a_cs, b, b_rs, b_cs, n, k, blk, \
+                           sizeof(T), 0}; \
+        parallel_for(m, panel, gemm_rows, &ctx); \
+        return ctx.failed; \
     }
-}
-void reduce_sum_func_float(char *buf, const void *vals, int n) {
-    for (int i = 0; i < n; i++) {
-        *(float *)buf += ((float *)vals)[i];
+
+/*
+ * The reference backend: the plainest loops for each op, kept as a known
+ * good fallback and a baseline to check the other backends against. nrm2
+ * is the classic scale and sum-of-squares update, dividing per element.
+ */
+#define DEFINE_REFERENCE_KERNELS(T, name) \
+    static int gemm_ref_func_##name(char *cbuf, const char *abuf, int64_t a_rs, int64_t a_cs, \
+                                    const char *bbuf, int64_t b_rs, int64_t b_cs, \
+                                    int64_t m, int64_t n, int64_t k, \
+                                    const gemmBlocking *blk) { \
+        (void)blk; \
+        T *c = (T *)cbuf; \
+        const T *a = (const T *)abuf; \
+        const T *b = (const T *)bbuf; \
+        for (int64_t i = 0; i < m; i++) { \
+            for (int64_t j = 0; j < n; j++) { \
+                T acc = 0; \
+                for (int64_t p = 0; p < k; p++) { \
+                    acc += a[i * a_rs + p * a_cs] * b[p * b_rs + j * b_cs]; \
+                } \
+                c[i * n + j] += acc; \
+            } \
+        } \
+        return 0; \
+    } \
+    static void dot_ref_func_##name(char *buf, const void *a, const void *b, int64_t n) { \
+        T acc = 0; \
+        for (int64_t i = 0; i < n; i++) { \
+            acc += ((const T *)a)[i] * ((const T *)b)[i]; \
+        } \
+        *(T *)buf += acc; \
+    } \
+    static void axpy_ref_func_##name(char *ybuf, int64_t y_rs, int64_t y_cs, double alpha, \
+                                     const char *xbuf, int64_t x_rs, int64_t x_cs, \
+                                     int64_t rows, int64_t cols) { \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j++) { \
+                ((T *)ybuf)[i * y_rs + j * y_cs] += \
+                    (T)alpha * ((const T *)xbuf)[i * x_rs + j * x_cs]; \
+            } \
+        } \
+    } \
+    static void scal_ref_func_##name(char *buf, double alpha, int64_t rows, int64_t cols, \
+                                     int64_t rs, int64_t cs) { \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j++) { \
+                ((T *)buf)[i * rs + j * cs] *= (T)alpha; \
+            } \
+        } \
+    } \
+    static double asum_ref_func_##name(const char *buf, int64_t rows, int64_t cols, \
+                                       int64_t rs, int64_t cs) { \
+        double acc = 0; \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j++) { \
+                acc += fabs((double)((const T *)buf)[i * rs + j * cs]); \
+            } \
+        } \
+        return acc; \
+    } \
+    static double nrm2_ref_func_##name(const char *buf, int64_t rows, int64_t cols, \
+                                       int64_t rs, int64_t cs) { \
+        double scale = 0, ssq = 1; \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j++) { \
+                double v = fabs((double)((const T *)buf)[i * rs + j * cs]); \
+                if (v == 0) continue; \
+                if (scale < v) { \
+                    ssq = 1 + ssq * (scale / v) * (scale / v); \
+                    scale = v; \
+                } else { \
+                    ssq += (v / scale) * (v / scale); \
+                } \
+            } \
+        } \
+        return scale * sqrt(ssq); \
+    } \
+    static int64_t iamax_ref_func_##name(const char *buf, int64_t rows, int64_t cols, \
+                                         int64_t rs, int64_t cs) { \
+        if (rows == 0 || cols == 0) return -1; \
+        T best = 0; \
+        int64_t best_idx = 0; \
+        for (int64_t i = 0; i < rows; i++) { \
+            for (int64_t j = 0; j < cols; j++) { \
+                T v = BLAS1_NEG_ABS(((const T *)buf)[i * rs + j * cs]); \
+                if (v < best) { \
+                    best = v; \
+                    best_idx = i * cols + j; \
+                } \
+            } \
+        } \
+        return best_idx; \
     }
-}
-void reduce_sum_func_double(char *buf, const void *vals, int n) {
-    for (int i = 0; i < n; i++) {
-        *(double *)buf += ((double *)vals)[i];
+
+#define DEFINE_PRINT_KERNEL(name, printer) \
+    static int print_val_func_##name(char *out, char *buf, int precision) { \
+        (void)precision; \
+        return printer; \
     }
-}
 
-int print_val_func_int32(char *out, size_t n, char *buf) {
-    return snprintf(out, n, "%1.2e", (double)*(int32_t *)buf);
-}
-int print_val_func_int64(char *out, size_t n, char *buf) {
-    return snprintf(out, n, "%1.2e", (double)*(int64_t *)buf);
-}
-int print_val_func_float(char *out, size_t n, char *buf) {
-    return snprintf(out, n, "%1.2e", (double)*(float *)buf);
-}
-int print_val_func_double(char *out, size_t n, char *buf) {
-    return snprintf(out, n, "%1.2e", (double)*(double *)buf);
-}
+DEFINE_DTYPE_KERNELS(int32_t, int32)
+DEFINE_DTYPE_KERNELS(int64_t, int64)
+DEFINE_DTYPE_KERNELS(float, float)
+DEFINE_DTYPE_KERNELS(double, double)
 
-static buf_set_val_func buf_set_val_funcs[NUM_ARRAY_DTYPES] = {
-    buf_set_val_func_int32,
-    buf_set_val_func_int64,
-    buf_set_val_func_float,
-    buf_set_val_func_double,
-};
+DEFINE_REDUCE_KERNELS(int32_t, int32, double, INT32_MIN, INT32_MAX, 0)
+DEFINE_REDUCE_KERNELS(int64_t, int64, double, INT64_MIN, INT64_MAX, 0)
+DEFINE_REDUCE_KERNELS(float, float, float, -INFINITY, INFINITY, NAN)
+DEFINE_REDUCE_KERNELS(double, double, double, -INFINITY, INFINITY, NAN)
 
-static buf_add_val_func buf_add_val_funcs[NUM_ARRAY_DTYPES] = {
-    buf_add_val_func_int32,
-    buf_add_val_func_int64,
-    buf_add_val_func_float,
-    buf_add_val_func_double,
-};
+DEFINE_SCAN_KERNELS(int32_t, int32)
+DEFINE_SCAN_KERNELS(int64_t, int64)
+DEFINE_SCAN_KERNELS(float, float)
+DEFINE_SCAN_KERNELS(double, double)
 
-static buf_set_zero_func buf_set_zero_funcs[NUM_ARRAY_DTYPES] = {
-    buf_set_zero_func_int32,
-    buf_set_zero_func_int64,
-    buf_set_zero_func_float,
-    buf_set_zero_func_double,
-};
+DEFINE_GEMM_KERNELS(int32_t, int32)
+DEFINE_GEMM_KERNELS(int64_t, int64)
+DEFINE_GEMM_KERNELS(float, float)
+DEFINE_GEMM_KERNELS(double, double)
 
-static buf_fill_val_func buf_fill_val_funcs[NUM_ARRAY_DTYPES] = {
-    buf_fill_val_func_int32,
-    buf_fill_val_func_int64,
-    buf_fill_val_func_float,
-    buf_fill_val_func_double,
-};
+DEFINE_SPARSE_KERNELS(int32_t, int32)
+DEFINE_SPARSE_KERNELS(int64_t, int64)
+DEFINE_SPARSE_KERNELS(float, float)
+DEFINE_SPARSE_KERNELS(double, double)
 
-static buf_fill_vals_func buf_fill_vals_funcs[NUM_ARRAY_DTYPES] = {
-    buf_fill_vals_func_int32,
-    buf_fill_vals_func_int64,
-    buf_fill_vals_func_float,
-    buf_fill_vals_func_double,
-};
+DEFINE_INDEX_KERNELS(int32_t, int32)
+DEFINE_INDEX_KERNELS(int64_t, int64)
+DEFINE_INDEX_KERNELS(float, float)
+DEFINE_INDEX_KERNELS(double, double)
 
-static buf_fill_uniform_int_func buf_fill_uniform_int_funcs[NUM_ARRAY_DTYPES] = {
-    buf_fill_uniform_int_func_int32,
-    buf_fill_uniform_int_func_int64,
-    buf_fill_uniform_int_func_float,
-    buf_fill_uniform_int_func_double,
-};
+DEFINE_THREADED_GEMM(int32_t, int32)
+DEFINE_THREADED_GEMM(int64_t, int64)
+DEFINE_THREADED_GEMM(float, float)
+DEFINE_THREADED_GEMM(double, double)
 
-static reduce_mul_add_func reduce_mul_add_funcs[NUM_ARRAY_DTYPES] = {
-    reduce_mul_add_func_int32,
-    reduce_mul_add_func_int64,
-    reduce_mul_add_func_float,
-    reduce_mul_add_func_double,
+DEFINE_REFERENCE_KERNELS(int32_t, int32)
+DEFINE_REFERENCE_KERNELS(int64_t, int64)
+DEFINE_REFERENCE_KERNELS(float, float)
+DEFINE_REFERENCE_KERNELS(double, double)
+
+DEFINE_PRINT_KERNEL(int32, print_int(out, *(int32_t *)buf))
+DEFINE_PRINT_KERNEL(int64, print_int(out, *(int64_t *)buf))
+DEFINE_PRINT_KERNEL(float, print_float(out, *(float *)buf, precision))
+DEFINE_PRINT_KERNEL(double, print_float(out, *(double *)buf, precision))
+
+#define DTYPE_KERNEL_TABLE(prefix) { \
+    prefix##_int32, \
+    prefix##_int64, \
+    prefix##_float, \
+    prefix##_double, \
+}
+
+static buf_set_val_func buf_set_val_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(buf_set_val_func);
+static buf_add_val_func buf_add_val_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(buf_add_val_func);
+static buf_set_zero_func buf_set_zero_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(buf_set_zero_func);
+static buf_fill_val_func buf_fill_val_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(buf_fill_val_func);
+static buf_fill_vals_func buf_fill_vals_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(buf_fill_vals_func);
+static buf_fill_uniform_int_func buf_fill_uniform_int_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(buf_fill_uniform_int_func);
+static buf_fill_linear_func buf_fill_linear_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(buf_fill_linear_func);
+static buf_fill_int_func buf_fill_int_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(buf_fill_int_func);
+static buf_fill_linear_int_func buf_fill_linear_int_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(buf_fill_linear_int_func);
+static buf_fill_val_strided_func buf_fill_val_strided_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(buf_fill_val_strided_func);
+static buf_copy_strided_func buf_copy_strided_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(buf_copy_strided_func);
+static reduce_func reduce_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(reduce_func);
+static scan_func scan_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(scan_func);
+static csr_count_nonzero_func csr_count_nonzero_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(csr_count_nonzero_func);
+static csr_gather_nonzero_func csr_gather_nonzero_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(csr_gather_nonzero_func);
+static spmm_func spmm_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(spmm_func);
+static gather_func gather_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(gather_func);
+static scatter_func scatter_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(scatter_func);
+static nonzero_offsets_func nonzero_offsets_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(nonzero_offsets_func);
+static print_val_func print_val_funcs[NUM_ARRAY_DTYPES] =
+    DTYPE_KERNEL_TABLE(print_val_func);
+
+/* The pluggable kernels, as backends registered in array_backend.c. */
+#define BACKEND_SLOTS(prefix) { \
+    (kernelFunc)prefix##_int32, \
+    (kernelFunc)prefix##_int64, \
+    (kernelFunc)prefix##_float, \
+    (kernelFunc)prefix##_double, \
+}
+
+const arrayBackend array_backend_simd = {
+    "simd",
+    {
+        [KERNEL_GEMM] = BACKEND_SLOTS(gemm_func),
+        [KERNEL_DOT] = BACKEND_SLOTS(reduce_mul_add_func),
+        [KERNEL_AXPY] = BACKEND_SLOTS(axpy_func),
+        [KERNEL_SCAL] = BACKEND_SLOTS(scal_func),
+        [KERNEL_ASUM] = BACKEND_SLOTS(asum_func),
+        [KERNEL_NRM2] = BACKEND_SLOTS(nrm2_func),
+        [KERNEL_IAMAX] = BACKEND_SLOTS(iamax_func),
+    },
 };
 
-static reduce_sum_func reduce_sum_funcs[NUM_ARRAY_DTYPES] = {
-    reduce_sum_func_int32,
-    reduce_sum_func_int64,
-    reduce_sum_func_float,
-    reduce_sum_func_double,
+const arrayBackend array_backend_threaded = {
+    "threaded",
+    {
+        [KERNEL_GEMM] = BACKEND_SLOTS(gemm_threaded_func),
+    },
 };
 
-static print_val_func print_val_funcs[NUM_ARRAY_DTYPES] = {
-    print_val_func_int32,
-    print_val_func_int64,
-    print_val_func_float,
-    print_val_func_double,
+const arrayBackend array_backend_reference = {
+    "reference",
+    {
+        [KERNEL_GEMM] = BACKEND_SLOTS(gemm_ref_func),
+        [KERNEL_DOT] = BACKEND_SLOTS(dot_ref_func),
+        [KERNEL_AXPY] = BACKEND_SLOTS(axpy_ref_func),
+        [KERNEL_SCAL] = BACKEND_SLOTS(scal_ref_func),
+        [KERNEL_ASUM] = BACKEND_SLOTS(asum_ref_func),
+        [KERNEL_NRM2] = BACKEND_SLOTS(nrm2_ref_func),
+        [KERNEL_IAMAX] = BACKEND_SLOTS(iamax_ref_func),
+    },
 };
 
 void
@@ -302,38 +1606,445 @@ buf_set_zero(char *buf, ARRAY_DTYPE dtype)
     buf_set_zero_funcs[dtype](buf);
 }
 
+/*
+ * Fills of at least this many elements are split across threads, so that
+ * a fresh buffer's pages are first touched by the threads that later
+ * split loops over it.
+ */
+#define FILL_PARALLEL_MIN_ELEMS (1 << 20)
+#define FILL_GRAIN_ELEMS (1 << 16)
+
+typedef struct fillCtx {
+    char *buf;
+    const char *vals;
+    double val;
+    double step;
+    int64_t ival;
+    int64_t istep;
+    ARRAY_DTYPE dtype;
+} fillCtx;
+
+static void
+fill_val_range(void *arg, int64_t begin, int64_t end)
+{
+    fillCtx *ctx = arg;
+    size_t dtype_size = array_dtype_size(ctx->dtype);
+    buf_fill_val_funcs[ctx->dtype](ctx->buf + begin * dtype_size, ctx->val, end - begin);
+}
+
+static void
+fill_vals_range(void *arg, int64_t begin, int64_t end)
+{
+    fillCtx *ctx = arg;
+    size_t dtype_size = array_dtype_size(ctx->dtype);
+    buf_fill_vals_funcs[ctx->dtype](ctx->buf + begin * dtype_size,
+                                    ctx->vals + begin * dtype_size, end - begin);
+}
+
 void
-buf_fill_val(char *buf, double val, int n, ARRAY_DTYPE dtype)
+buf_fill_val(char *buf, double val, int64_t n, ARRAY_DTYPE dtype)
 {
-    buf_fill_val_funcs[dtype](buf, val, n);
+    ARRAY_STATS_BEGIN(t0);
+    if (n < FILL_PARALLEL_MIN_ELEMS) {
+        buf_fill_val_funcs[dtype](buf, val, n);
+    } else {
+        fillCtx ctx = {buf, NULL, val, 0, 0, 0, dtype};
+        parallel_for(n, FILL_GRAIN_ELEMS, fill_val_range, &ctx);
+    }
+    ARRAY_STATS_END(t0, STATS_FILL, n, n * array_dtype_size(dtype));
+}
+
+void
+buf_fill_vals(char *buf, const void *vals, int64_t n, ARRAY_DTYPE dtype)
+{
+    ARRAY_STATS_BEGIN(t0);
+    if (n < FILL_PARALLEL_MIN_ELEMS) {
+        buf_fill_vals_funcs[dtype](buf, vals, n);
+    } else {
+        fillCtx ctx = {buf, vals, 0, 0, 0, 0, dtype};
+        parallel_for(n, FILL_GRAIN_ELEMS, fill_vals_range, &ctx);
+    }
+    ARRAY_STATS_END(t0, STATS_FILL, n, n * array_dtype_size(dtype));
+}
+
+static void
+fill_linear_range(void *arg, int64_t begin, int64_t end)
+{
+    fillCtx *ctx = arg;
+    buf_fill_linear_funcs[ctx->dtype](ctx->buf + begin * array_dtype_size(ctx->dtype),
+                                      ctx->val, ctx->step, begin, end - begin);
+}
+
+void
+buf_fill_linear(char *buf, double start, double step, int64_t n, ARRAY_DTYPE dtype)
+{
+    ARRAY_STATS_BEGIN(t0);
+    if (n < FILL_PARALLEL_MIN_ELEMS) {
+        buf_fill_linear_funcs[dtype](buf, start, step, 0, n);
+    } else {
+        fillCtx ctx = {buf, NULL, start, step, 0, 0, dtype};
+        parallel_for(n, FILL_GRAIN_ELEMS, fill_linear_range, &ctx);
+    }
+    ARRAY_STATS_END(t0, STATS_FILL, n, n * array_dtype_size(dtype));
+}
+
+static void
+fill_int_range(void *arg, int64_t begin, int64_t end)
+{
+    fillCtx *ctx = arg;
+    buf_fill_int_funcs[ctx->dtype](ctx->buf + begin * array_dtype_size(ctx->dtype), ctx->ival,
+                                   end - begin);
+}
+
+void
+buf_fill_int(char *buf, int64_t val, int64_t n, ARRAY_DTYPE dtype)
+{
+    ARRAY_STATS_BEGIN(t0);
+    if (n < FILL_PARALLEL_MIN_ELEMS) {
+        buf_fill_int_funcs[dtype](buf, val, n);
+    } else {
+        fillCtx ctx = {buf, NULL, 0, 0, val, 0, dtype};
+        parallel_for(n, FILL_GRAIN_ELEMS, fill_int_range, &ctx);
+    }
+    ARRAY_STATS_END(t0, STATS_FILL, n, n * array_dtype_size(dtype));
+}
+
+static void
+fill_linear_int_range(void *arg, int64_t begin, int64_t end)
+{
+    fillCtx *ctx = arg;
+    buf_fill_linear_int_funcs[ctx->dtype](ctx->buf + begin * array_dtype_size(ctx->dtype),
+                                          ctx->ival, ctx->istep, begin, end - begin);
+}
+
+void
+buf_fill_linear_int(char *buf, int64_t start, int64_t step, int64_t n, ARRAY_DTYPE dtype)
+{
+    ARRAY_STATS_BEGIN(t0);
+    if (n < FILL_PARALLEL_MIN_ELEMS) {
+        buf_fill_linear_int_funcs[dtype](buf, start, step, 0, n);
+    } else {
+        fillCtx ctx = {buf, NULL, 0, 0, start, step, dtype};
+        parallel_for(n, FILL_GRAIN_ELEMS, fill_linear_int_range, &ctx);
+    }
+    ARRAY_STATS_END(t0, STATS_FILL, n, n * array_dtype_size(dtype));
 }
 
 void
-buf_fill_vals(char *buf, const void *vals, int n, ARRAY_DTYPE dtype)
+buf_fill_val_strided(char *buf, double val, int64_t n, int64_t stride, ARRAY_DTYPE dtype)
 {
-    buf_fill_vals_funcs[dtype](buf, vals, n);
+    buf_fill_val_strided_funcs[dtype](buf, val, n, stride);
 }
 
 void
-buf_fill_uniform_int(char *buf, int low, int high, int n, ARRAY_DTYPE dtype)
+buf_fill_uniform_int(char *buf, int low, int high, int64_t n, ARRAY_DTYPE dtype)
 {
+    ARRAY_STATS_BEGIN(t0);
     buf_fill_uniform_int_funcs[dtype](buf, low, high, n);
+    ARRAY_STATS_END(t0, STATS_FILL, n, n * array_dtype_size(dtype));
+}
+
+/* Copies of at least this many elements are split by rows across threads. */
+#define COPY_PARALLEL_MIN_ELEMS (1 << 20)
+
+typedef struct copyStridedCtx {
+    char *buf;
+    const char *vals;
+    int64_t cols;
+    int64_t row_stride;
+    int64_t col_stride;
+    ARRAY_DTYPE dtype;
+} copyStridedCtx;
+
+static void
+copy_strided_rows(void *arg, int64_t begin, int64_t end)
+{
+    copyStridedCtx *ctx = arg;
+    size_t dtype_size = array_dtype_size(ctx->dtype);
+    buf_copy_strided_funcs[ctx->dtype](
+        ctx->buf + (size_t)begin * ctx->cols * dtype_size,
+        ctx->vals + (size_t)begin * ctx->row_stride * dtype_size,
+        end - begin,
+        ctx->cols,
+        ctx->row_stride,
+        ctx->col_stride
+    );
+}
+
+void
+buf_copy_strided(char *buf, const char *vals, int64_t rows, int64_t cols,
+                 int64_t row_stride, int64_t col_stride, ARRAY_DTYPE dtype)
+{
+    if ((size_t)rows * cols < COPY_PARALLEL_MIN_ELEMS) {
+        buf_copy_strided_funcs[dtype](buf, vals, rows, cols, row_stride, col_stride);
+        return;
+    }
+    copyStridedCtx ctx = {buf, vals, cols, row_stride, col_stride, dtype};
+    parallel_for(rows, TRANSPOSE_TILE, copy_strided_rows, &ctx);
+}
+
+void
+reduce_mul_add(char *buf, const void *a, const void *b, int64_t n, ARRAY_DTYPE dtype)
+{
+    ((reduce_mul_add_func)array_backend_kernel(KERNEL_DOT, dtype))(buf, a, b, n);
+}
+
+/*
+ * axpy and scal write every element once, so past the fill threshold they
+ * are split across threads like the fills: by rows, or along the single
+ * row of a vector.
+ */
+typedef struct blas1Ctx {
+    kernelFunc kernel;
+    char *y;
+    const char *x;
+    double alpha;
+    int64_t y_rs, y_cs;
+    int64_t x_rs, x_cs;
+    int64_t rows, cols;
+    ARRAY_DTYPE dtype;
+} blas1Ctx;
+
+static void
+blas1_split(const blas1Ctx *ctx, int64_t begin, int64_t end, blas1Ctx *part)
+{
+    size_t dtype_size = array_dtype_size(ctx->dtype);
+    *part = *ctx;
+    if (ctx->rows == 1) {
+        part->y += begin * ctx->y_cs * dtype_size;
+        part->x += begin * ctx->x_cs * dtype_size;
+        part->cols = end - begin;
+    } else {
+        part->y += begin * ctx->y_rs * dtype_size;
+        part->x += begin * ctx->x_rs * dtype_size;
+        part->rows = end - begin;
+    }
+}
+
+static void
+axpy_range(void *arg, int64_t begin, int64_t end)
+{
+    blas1Ctx p;
+    blas1_split(arg, begin, end, &p);
+    ((axpy_func)p.kernel)(p.y, p.y_rs, p.y_cs, p.alpha, p.x, p.x_rs, p.x_cs, p.rows, p.cols);
+}
+
+static void
+scal_range(void *arg, int64_t begin, int64_t end)
+{
+    blas1Ctx p;
+    blas1_split(arg, begin, end, &p);
+    ((scal_func)p.kernel)(p.y, p.alpha, p.rows, p.cols, p.y_rs, p.y_cs);
+}
+
+static void
+blas1_parallel(blas1Ctx *ctx, void (*body)(void *, int64_t, int64_t))
+{
+    if (ctx->rows == 1) {
+        parallel_for(ctx->cols, FILL_GRAIN_ELEMS, body, ctx);
+    } else {
+        int64_t grain = ctx->cols < FILL_GRAIN_ELEMS ? FILL_GRAIN_ELEMS / ctx->cols : 1;
+        parallel_for(ctx->rows, grain, body, ctx);
+    }
+}
+
+void
+axpy(char *y, int64_t y_rs, int64_t y_cs, double alpha, const char *x, int64_t x_rs,
+     int64_t x_cs, int64_t rows, int64_t cols, ARRAY_DTYPE dtype)
+{
+    kernelFunc kernel = array_backend_kernel(KERNEL_AXPY, dtype);
+    if (rows * cols < FILL_PARALLEL_MIN_ELEMS) {
+        ((axpy_func)kernel)(y, y_rs, y_cs, alpha, x, x_rs, x_cs, rows, cols);
+        return;
+    }
+    blas1Ctx ctx = {kernel, y, x, alpha, y_rs, y_cs, x_rs, x_cs, rows, cols, dtype};
+    blas1_parallel(&ctx, axpy_range);
 }
 
 void
-reduce_mul_add(char *buf, const void *a, const void *b, int n, ARRAY_DTYPE dtype)
+scal(char *x, double alpha, int64_t rows, int64_t cols, int64_t rs, int64_t cs,
+     ARRAY_DTYPE dtype)
+{
+    kernelFunc kernel = array_backend_kernel(KERNEL_SCAL, dtype);
+    if (rows * cols < FILL_PARALLEL_MIN_ELEMS) {
+        ((scal_func)kernel)(x, alpha, rows, cols, rs, cs);
+        return;
+    }
+    blas1Ctx ctx = {kernel, x, x, alpha, rs, cs, rs, cs, rows, cols, dtype};
+    blas1_parallel(&ctx, scal_range);
+}
+
+double
+asum(const char *x, int64_t rows, int64_t cols, int64_t rs, int64_t cs, ARRAY_DTYPE dtype)
+{
+    return ((asum_func)array_backend_kernel(KERNEL_ASUM, dtype))(x, rows, cols, rs, cs);
+}
+
+double
+nrm2(const char *x, int64_t rows, int64_t cols, int64_t rs, int64_t cs, ARRAY_DTYPE dtype)
+{
+    return ((nrm2_func)array_backend_kernel(KERNEL_NRM2, dtype))(x, rows, cols, rs, cs);
+}
+
+int64_t
+iamax(const char *x, int64_t rows, int64_t cols, int64_t rs, int64_t cs, ARRAY_DTYPE dtype)
+{
+    return ((iamax_func)array_backend_kernel(KERNEL_IAMAX, dtype))(x, rows, cols, rs, cs);
+}
+
+const char *REDUCE_OP_NAMES[NUM_REDUCE_OPS] = {
+    "sum", "prod", "max", "min", "mean", "argmax", "argmin",
+    "nansum", "nanmax", "nanmin", "nanmean",
+};
+
+int
+reduce_is_arg(REDUCE_OP op)
+{
+    return op == REDUCE_ARGMAX || op == REDUCE_ARGMIN;
+}
+
+ARRAY_DTYPE
+reduce_out_dtype(REDUCE_OP op, ARRAY_DTYPE dtype)
+{
+    if (reduce_is_arg(op)) return INT64;
+    if ((op == REDUCE_MEAN || op == REDUCE_NANMEAN) && dtype != FLOAT) return DOUBLE;
+    return dtype;
+}
+
+int
+reduce(char *out, const char *vals, int64_t rows, int64_t cols, int64_t row_stride, int axis,
+       REDUCE_OP op, ARRAY_DTYPE dtype)
 {
-    reduce_mul_add_funcs[dtype](buf, a, b, n);
+    // Integers have no NaN, so the NaN-skipping variants are the plain ops.
+    if (dtype == INT32 || dtype == INT64) {
+        if (op == REDUCE_NANSUM) op = REDUCE_SUM;
+        if (op == REDUCE_NANMAX) op = REDUCE_MAX;
+        if (op == REDUCE_NANMIN) op = REDUCE_MIN;
+        if (op == REDUCE_NANMEAN) op = REDUCE_MEAN;
+    }
+    return reduce_funcs[dtype](out, vals, rows, cols, row_stride, axis, op);
 }
 
+const char *SCAN_OP_NAMES[NUM_SCAN_OPS] = {"cumsum", "cumprod"};
+
 void
-reduce_sum(char *buf, const void *vals, int n, ARRAY_DTYPE dtype)
+scan(char *out, const char *vals, int64_t rows, int64_t cols, int64_t row_stride, int axis,
+     SCAN_OP op, ARRAY_DTYPE dtype)
+{
+    scan_funcs[dtype](out, vals, rows, cols, row_stride, axis, op);
+}
+
+int
+gemm(char *c, const char *a, int64_t a_rs, int64_t a_cs,
+     const char *b, int64_t b_rs, int64_t b_cs,
+     int64_t m, int64_t n, int64_t k, ARRAY_DTYPE dtype)
+{
+    gemmBlocking blk;
+    gemm_blocking_for(dtype, gemm_shape(m, n, k), &blk);
+    gemm_func kernel = (gemm_func)array_backend_kernel(KERNEL_GEMM, dtype);
+    return kernel(c, a, a_rs, a_cs, b, b_rs, b_cs, m, n, k, &blk);
+}
+
+int64_t
+csr_count_nonzero(int64_t *row_counts, const char *vals, int64_t rows, int64_t cols,
+                  int64_t row_stride, int64_t col_stride, ARRAY_DTYPE dtype)
+{
+    return csr_count_nonzero_funcs[dtype](row_counts, vals, rows, cols, row_stride, col_stride);
+}
+
+void
+csr_gather_nonzero(int64_t *indices, char *data, const char *vals, int64_t rows,
+                   int64_t cols, int64_t row_stride, int64_t col_stride, ARRAY_DTYPE dtype)
+{
+    csr_gather_nonzero_funcs[dtype](indices, data, vals, rows, cols, row_stride, col_stride);
+}
+
+/* Products with less work than this (nonzeros times columns) stay serial. */
+#define SPMM_PARALLEL_MIN_WORK (1 << 16)
+/* Target work per parallel_for grain. */
+#define SPMM_GRAIN_WORK (1 << 12)
+
+typedef struct spmmCtx {
+    char *out;
+    const int64_t *indptr;
+    const int64_t *indices;
+    const char *data;
+    const char *b;
+    int64_t b_rs;
+    int64_t b_cs;
+    int64_t n;
+    ARRAY_DTYPE dtype;
+} spmmCtx;
+
+static void
+spmm_rows(void *arg, int64_t begin, int64_t end)
+{
+    spmmCtx *ctx = arg;
+    spmm_funcs[ctx->dtype](ctx->out, ctx->indptr, ctx->indices, ctx->data, begin, end,
+                           ctx->b, ctx->b_rs, ctx->b_cs, ctx->n);
+}
+
+void
+spmm(char *out, const int64_t *indptr, const int64_t *indices, const char *data,
+     int64_t rows, const char *b, int64_t b_rs, int64_t b_cs, int64_t n, ARRAY_DTYPE dtype)
+{
+    size_t work = (size_t)indptr[rows] * n + (size_t)rows * n;
+    if (work < SPMM_PARALLEL_MIN_WORK) {
+        spmm_funcs[dtype](out, indptr, indices, data, 0, rows, b, b_rs, b_cs, n);
+        return;
+    }
+    // Rows are uneven, so hand out small grains and let idle workers steal.
+    size_t row_work = work / (rows ? rows : 1) + 1;
+    int64_t grain = row_work >= SPMM_GRAIN_WORK ? 1 : (int64_t)(SPMM_GRAIN_WORK / row_work);
+    spmmCtx ctx = {out, indptr, indices, data, b, b_rs, b_cs, n, dtype};
+    parallel_for(rows, grain, spmm_rows, &ctx);
+}
+
+typedef struct gatherCtx {
+    char *out;
+    const char *x;
+    const int64_t *offsets;
+    int64_t cols, cs;
+    ARRAY_DTYPE dtype;
+} gatherCtx;
+
+static void
+gather_range(void *arg, int64_t begin, int64_t end)
+{
+    gatherCtx *ctx = arg;
+    gather_funcs[ctx->dtype](ctx->out + begin * ctx->cols * array_dtype_size(ctx->dtype),
+                             ctx->x, ctx->offsets + begin, end - begin, ctx->cols, ctx->cs);
+}
+
+void
+gather(char *out, const char *x, const int64_t *offsets, int64_t n, int64_t cols, int64_t cs,
+       ARRAY_DTYPE dtype)
+{
+    if (n * cols < FILL_PARALLEL_MIN_ELEMS) {
+        gather_funcs[dtype](out, x, offsets, n, cols, cs);
+        return;
+    }
+    gatherCtx ctx = {out, x, offsets, cols, cs, dtype};
+    int64_t grain = cols < FILL_GRAIN_ELEMS ? FILL_GRAIN_ELEMS / cols : 1;
+    parallel_for(n, grain, gather_range, &ctx);
+}
+
+void
+scatter(char *x, const int64_t *offsets, int64_t n, int64_t cols, int64_t cs,
+        const char *vals, int64_t vals_step, ARRAY_DTYPE dtype)
+{
+    scatter_funcs[dtype](x, offsets, n, cols, cs, vals, vals_step);
+}
+
+int64_t
+nonzero_offsets(int64_t *out, const char *mask, int64_t rows, int64_t cols, int64_t rs,
+                int64_t cs, int64_t out_rs, int64_t out_cs, ARRAY_DTYPE dtype)
 {
-    reduce_sum_funcs[dtype](buf, vals, n);
+    return nonzero_offsets_funcs[dtype](out, mask, rows, cols, rs, cs, out_rs, out_cs);
 }
 
 int
-print_val(char *out, size_t n, char *buf, ARRAY_DTYPE dtype)
+print_val(char *out, char *buf, int precision, ARRAY_DTYPE dtype)
 {
-    return print_val_funcs[dtype](out, n, buf);
+    return print_val_funcs[dtype](out, buf, precision);
 }
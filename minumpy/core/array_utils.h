@@ -1,29 +1,156 @@
 #ifndef ARRAY_UTILS_H
 #define ARRAY_UTILS_H
 
+#include <stdint.h>
+
 #include "array_dtypes.h"
 
 #define ARRAY_NUM_DIMS 2
 
-int prod(int *vals, int n);
-int *cumprod_reverse(int *vals, int n);
-void swap_idx(int *vals, int i, int j);
+int64_t prod(int64_t *vals, int n);
+/*
+ * Stores the product of vals in *out, returning 1 instead if a value is
+ * negative or the product does not fit in an int64_t.
+ */
+int prod_checked(const int64_t *vals, int n, int64_t *out);
+int64_t *cumprod_reverse(int64_t *vals, int n);
+void swap_idx(int64_t *vals, int i, int j);
 int *range(int n);
-int *filter_idx(int *vals, int n, int idx);
+int64_t *filter_idx(int64_t *vals, int n, int idx);
 
 int validate_nd(int nd);
-int *promote_dims(int *dims, int nd, int target_nd);
+int64_t *promote_dims(int64_t *dims, int nd, int target_nd);
 
 void buf_set_val(char *buf, void *val, ARRAY_DTYPE dtype);
 void buf_add_val(char *buf, void *val, ARRAY_DTYPE dtype);
 void buf_set_zero(char *buf, ARRAY_DTYPE dtype);
-void buf_fill_val(char *buf, double val, int n, ARRAY_DTYPE dtype);
-void buf_fill_vals(char *buf, const void *vals, int n, ARRAY_DTYPE dtype);
-void buf_fill_uniform_int(char *buf, int low, int high, int n, ARRAY_DTYPE dtype);
+void buf_fill_val(char *buf, double val, int64_t n, ARRAY_DTYPE dtype);
+void buf_fill_vals(char *buf, const void *vals, int64_t n, ARRAY_DTYPE dtype);
+/* buf[i] = start + i * step, converted to dtype. */
+void buf_fill_linear(char *buf, double start, double step, int64_t n, ARRAY_DTYPE dtype);
+/* As buf_fill_val and buf_fill_linear, exact for int64 values past 2^53. */
+void buf_fill_int(char *buf, int64_t val, int64_t n, ARRAY_DTYPE dtype);
+void buf_fill_linear_int(char *buf, int64_t start, int64_t step, int64_t n, ARRAY_DTYPE dtype);
+void buf_fill_val_strided(char *buf, double val, int64_t n, int64_t stride, ARRAY_DTYPE dtype);
+void buf_fill_uniform_int(char *buf, int low, int high, int64_t n, ARRAY_DTYPE dtype);
+void buf_copy_strided(char *buf, const char *vals, int64_t rows, int64_t cols,
+                      int64_t row_stride, int64_t col_stride, ARRAY_DTYPE dtype);
+
+void reduce_mul_add(char *buf, const void *a, const void *b, int64_t n, ARRAY_DTYPE dtype);
+
+/*
+ * Level-1 BLAS over a rows x cols block of elements given by row and
+ * column strides; a strided vector is the single row (1, n, 0, inc).
+ * alpha is converted to dtype first, so it truncates for integer dtypes.
+ * asum and nrm2 accumulate in double; nrm2 rescales when the plain sum of
+ * squares would overflow or underflow. iamax returns the row-major index
+ * of the first element of largest magnitude, ignoring NaNs, or -1 when
+ * the block is empty.
+ */
+void axpy(char *y, int64_t y_rs, int64_t y_cs, double alpha, const char *x, int64_t x_rs,
+          int64_t x_cs, int64_t rows, int64_t cols, ARRAY_DTYPE dtype);
+void scal(char *x, double alpha, int64_t rows, int64_t cols, int64_t rs, int64_t cs,
+          ARRAY_DTYPE dtype);
+double asum(const char *x, int64_t rows, int64_t cols, int64_t rs, int64_t cs, ARRAY_DTYPE dtype);
+double nrm2(const char *x, int64_t rows, int64_t cols, int64_t rs, int64_t cs, ARRAY_DTYPE dtype);
+int64_t iamax(const char *x, int64_t rows, int64_t cols, int64_t rs, int64_t cs,
+              ARRAY_DTYPE dtype);
+
+typedef enum {
+    REDUCE_SUM,
+    REDUCE_PROD,
+    REDUCE_MAX,
+    REDUCE_MIN,
+    REDUCE_MEAN,
+    REDUCE_ARGMAX,
+    REDUCE_ARGMIN,
+    REDUCE_NANSUM,
+    REDUCE_NANMAX,
+    REDUCE_NANMIN,
+    REDUCE_NANMEAN,
+    NUM_REDUCE_OPS,
+} REDUCE_OP;
+
+extern const char *REDUCE_OP_NAMES[NUM_REDUCE_OPS];
+
+int reduce_is_arg(REDUCE_OP op);
+ARRAY_DTYPE reduce_out_dtype(REDUCE_OP op, ARRAY_DTYPE dtype);
+/*
+ * Reduces a rows x cols block with unit column stride over axis 0 (out has
+ * cols elements) or axis 1 (out has rows elements), writing elements of
+ * reduce_out_dtype(op, dtype). Arg reductions write int64 indices.
+ * Returns nonzero if a per-column accumulator could not be allocated.
+ */
+int reduce(char *out, const char *vals, int64_t rows, int64_t cols, int64_t row_stride,
+           int axis, REDUCE_OP op, ARRAY_DTYPE dtype);
+
+typedef enum {
+    SCAN_CUMSUM,
+    SCAN_CUMPROD,
+    NUM_SCAN_OPS,
+} SCAN_OP;
+
+extern const char *SCAN_OP_NAMES[NUM_SCAN_OPS];
+
+/*
+ * Inclusive scan of a rows x cols block with unit column stride along axis
+ * 0 or 1, written to a contiguous rows x cols out of the same dtype.
+ */
+void scan(char *out, const char *vals, int64_t rows, int64_t cols, int64_t row_stride,
+          int axis, SCAN_OP op, ARRAY_DTYPE dtype);
+
+typedef struct gemmBlocking {
+    int mc;     // rows of A packed per block
+    int kc;     // depth of each packed A/B block
+    int nc;     // columns of B packed per block
+    int panel;  // rows per thread in the threaded backend; 0 for mc
+} gemmBlocking;
+
+/*
+ * C += A B with the blocking array_tune.h picks for the shape. Returns 1,
+ * with C partly updated, if the packing buffers cannot be allocated.
+ */
+int gemm(char *c, const char *a, int64_t a_rs, int64_t a_cs,
+         const char *b, int64_t b_rs, int64_t b_cs,
+         int64_t m, int64_t n, int64_t k, ARRAY_DTYPE dtype);
+
+/* Fills row_counts with the nonzeros of each row and returns their total. */
+int64_t csr_count_nonzero(int64_t *row_counts, const char *vals, int64_t rows, int64_t cols,
+                          int64_t row_stride, int64_t col_stride, ARRAY_DTYPE dtype);
+/* Writes the column index and value of each nonzero in row-major order. */
+void csr_gather_nonzero(int64_t *indices, char *data, const char *vals, int64_t rows,
+                        int64_t cols, int64_t row_stride, int64_t col_stride,
+                        ARRAY_DTYPE dtype);
+/*
+ * out (rows x n, row-major) = A @ B, where A is the CSR matrix given by
+ * indptr/indices/data and B is dense with the given strides.
+ */
+void spmm(char *out, const int64_t *indptr, const int64_t *indices, const char *data,
+          int64_t rows, const char *b, int64_t b_rs, int64_t b_cs, int64_t n,
+          ARRAY_DTYPE dtype);
+
+/*
+ * Indexed copies of n rows of cols elements, cs apart, starting at the
+ * element offsets given (checked by the caller). gather packs them into a
+ * contiguous out, splitting large gathers across threads; scatter writes
+ * the contiguous vals back, advancing vals_step elements per row (0 to
+ * repeat one row), in order so that the last duplicate offset wins.
+ */
+void gather(char *out, const char *x, const int64_t *offsets, int64_t n, int64_t cols,
+            int64_t cs, ARRAY_DTYPE dtype);
+void scatter(char *x, const int64_t *offsets, int64_t n, int64_t cols, int64_t cs,
+             const char *vals, int64_t vals_step, ARRAY_DTYPE dtype);
+/*
+ * Counts the nonzeros of a strided rows x cols mask in row-major order and,
+ * unless out is NULL, writes i * out_rs + j * out_cs for each to out.
+ */
+int64_t nonzero_offsets(int64_t *out, const char *mask, int64_t rows, int64_t cols,
+                        int64_t rs, int64_t cs, int64_t out_rs, int64_t out_cs,
+                        ARRAY_DTYPE dtype);
 
-void reduce_mul_add(char *buf, const void *a, const void *b, int n, ARRAY_DTYPE dtype);
-void reduce_sum(char *buf, const void *vals, int n, ARRAY_DTYPE dtype);
+#define PRINT_VAL_MAX_PRECISION 16
+#define PRINT_VAL_MAX_LEN 32
 
-int print_val(char *out, size_t n, char *buf, ARRAY_DTYPE dtype);
+int print_val(char *out, char *buf, int precision, ARRAY_DTYPE dtype);
 
 #endif
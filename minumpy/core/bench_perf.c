@@ -0,0 +1,98 @@
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "bench_perf.h"
+
+const char *PERF_COUNTER_NAMES[NUM_PERF_COUNTERS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses",
+};
+
+#define CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} perf_configs[NUM_PERF_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB)},
+};
+
+static int
+perf_event_open(struct perf_event_attr *attr)
+{
+    return syscall(SYS_perf_event_open, attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+int
+perf_counters_open(perfCounters *pc)
+{
+    pc->num_available = 0;
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_configs[i].type;
+        attr.config = perf_configs[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        pc->fds[i] = perf_event_open(&attr);
+        if (pc->fds[i] >= 0) pc->num_available++;
+    }
+    return pc->num_available;
+}
+
+void
+perf_counters_close(perfCounters *pc)
+{
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        if (pc->fds[i] >= 0) close(pc->fds[i]);
+        pc->fds[i] = -1;
+    }
+    pc->num_available = 0;
+}
+
+int
+perf_counter_available(const perfCounters *pc, PERF_COUNTER c)
+{
+    return pc->fds[c] >= 0;
+}
+
+void
+perf_counters_start(perfCounters *pc)
+{
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        if (pc->fds[i] < 0) continue;
+        ioctl(pc->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(pc->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void
+perf_counters_stop(perfCounters *pc, uint64_t out[NUM_PERF_COUNTERS])
+{
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        out[i] = 0;
+        if (pc->fds[i] < 0) continue;
+        ioctl(pc->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+        uint64_t vals[3];  // value, time enabled, time running
+        if (read(pc->fds[i], vals, sizeof(vals)) != sizeof(vals)) continue;
+        // Scale up counts that were multiplexed off the PMU part of the time.
+        if (vals[2] && vals[2] < vals[1]) {
+            vals[0] = (uint64_t)((double)vals[0] * vals[1] / vals[2]);
+        }
+        out[i] = vals[0];
+    }
+}
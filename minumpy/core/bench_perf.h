@@ -0,0 +1,35 @@
+#ifndef BENCH_PERF_H
+#define BENCH_PERF_H
+
+#include <stdint.h>
+
+/*
+ * Hardware counters read through Linux perf_event_open for the benchmark
+ * harness. Every counter is opened on its own so that a partial set still
+ * works; counters the kernel or container refuses are marked unavailable.
+ */
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    NUM_PERF_COUNTERS,
+} PERF_COUNTER;
+
+extern const char *PERF_COUNTER_NAMES[NUM_PERF_COUNTERS];
+
+typedef struct perfCounters {
+    int fds[NUM_PERF_COUNTERS];
+    int num_available;
+} perfCounters;
+
+int perf_counters_open(perfCounters *pc);
+void perf_counters_close(perfCounters *pc);
+int perf_counter_available(const perfCounters *pc, PERF_COUNTER c);
+
+void perf_counters_start(perfCounters *pc);
+void perf_counters_stop(perfCounters *pc, uint64_t out[NUM_PERF_COUNTERS]);
+
+#endif
@@ -1,50 +1,525 @@
-#include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "array.h"
 #include "array_dtypes.h"
+#include "array_parallel.h"
+#include "bench_perf.h"
 
-int main() {
-    for (int i = 0; i < NUM_ARRAY_DTYPES; i++) {
-        ARRAY_DTYPE dtype = ARRAY_DTYPES[i];
-        const char *dtype_name = ARRAY_DTYPE_NAMES[i];
-
-        int N = 512;
-        int ds_a[] = {N, N};
-        int ds_b[] = {N, N};
-        arrayObject *a = array_alloc(ds_a, 2, dtype);
-        arrayObject *b = array_alloc(ds_b, 2, dtype);
-
-        array_fill_uniform_int(a, 0, 1, dtype);
-        array_fill_uniform_int(b, 0, 1, dtype);
-
-        clock_t start_time = clock();
-        arrayObject *d = array_dot(a, b);
-        double elapsed_time = (double)(clock() - start_time) / CLOCKS_PER_SEC;
-        printf("Dot %s %f seconds\n", dtype_name, elapsed_time);
-
-        assert(d != NULL);
-        assert(d->dims[0] == N && d->dims[1] == N);
-
-        start_time = clock();
-        arrayObject *d1 = array_sum(d, 1);
-        elapsed_time = (double)(clock() - start_time) / CLOCKS_PER_SEC;
-        printf("Sum 1 %s %f seconds\n", dtype_name, elapsed_time);
-
-        start_time = clock();
-        arrayObject *d2 = array_sum(d1, 0);
-        elapsed_time = (double)(clock() - start_time) / CLOCKS_PER_SEC;
-        printf("Sum 0 %s %f seconds\n", dtype_name, elapsed_time);
-
-        printf("%s\n", array_str(d2));
-
-        array_free(a);
-        array_free(b);
-        array_free(d);
-        array_free(d1);
-        array_free(d2);
+/*
+ * Benchmark harness for the core array ops. Every (op, dtype, shape) case is
+ * warmed up, then timed repeatedly with a monotonic wall clock until either
+ * the repetition count or the per-case time budget is exhausted. Results are
+ * printed as a table, or as a JSON array with --json for regression tracking.
+ * With --perf, hardware counters are read around every timed call as well.
+ */
+
+typedef struct benchConfig {
+    int full;
+    int json;
+    int warmup;
+    int reps;
+    double max_seconds;
+    const char *op_filter;
+    perfCounters *perf;
+} benchConfig;
+
+typedef struct benchState {
+    ARRAY_DTYPE dtype;
+    int dims[2];
+    arrayObject *a;
+    arrayObject *b;
+    void *vals;
+} benchState;
+
+typedef struct benchOp {
+    const char *name;
+    int needs_vals;
+    void (*run)(benchState *s);
+    double (*flops)(const benchState *s);
+    double (*bytes)(const benchState *s);
+} benchOp;
+
+typedef struct benchResult {
+    int reps;
+    double min_ns;
+    double median_ns;
+    double p99_ns;
+    uint64_t counters[NUM_PERF_COUNTERS];  // summed over all reps
+} benchResult;
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static double
+num_elems(const benchState *s)
+{
+    return (double)s->dims[0] * s->dims[1];
+}
+
+static double
+elem_bytes(const benchState *s)
+{
+    return num_elems(s) * array_dtype_size(s->dtype);
+}
+
+static double no_flops(const benchState *s) { (void)s; return 0; }
+static double no_bytes(const benchState *s) { (void)s; return 0; }
+static double read_flops(const benchState *s) { return num_elems(s); }
+static double read_bytes(const benchState *s) { return elem_bytes(s); }
+static double copy_bytes(const benchState *s) { return 2 * elem_bytes(s); }
+static double axpy_flops(const benchState *s) { return 2 * num_elems(s); }
+static double axpy_bytes(const benchState *s) { return 3 * elem_bytes(s); }
+
+static double
+dot_flops(const benchState *s)
+{
+    return 2.0 * s->dims[0] * s->dims[1] * s->dims[1];
+}
+
+static double
+dot_bytes(const benchState *s)
+{
+    double size = array_dtype_size(s->dtype);
+    return (num_elems(s) + (double)s->dims[1] * s->dims[1] + num_elems(s)) * size;
+}
+
+static void
+run_dot(benchState *s)
+{
+    array_free(array_dot(s->a, s->b));
+}
+
+static void
+run_dot_nt(benchState *s)
+{
+    int perm[] = {1, 0};
+    array_transpose(s->b, perm);
+    array_free(array_dot(s->a, s->b));
+    array_transpose(s->b, perm);
+}
+
+static void
+run_sum0(benchState *s)
+{
+    array_free(array_sum(s->a, 0));
+}
+
+static void
+run_sum1(benchState *s)
+{
+    array_free(array_sum(s->a, 1));
+}
+
+static void
+run_max0(benchState *s)
+{
+    array_free(array_reduce(s->a, REDUCE_MAX, 1, 0));
+}
+
+static void
+run_argmax1(benchState *s)
+{
+    array_free(array_reduce(s->a, REDUCE_ARGMAX, 2, 0));
+}
+
+static void
+run_cumsum(benchState *s)
+{
+    array_free(array_scan(s->a, SCAN_CUMSUM, -1));
+}
+
+/* The same flattened scan pinned to one thread, as the serial baseline. */
+static void
+run_cumsum_serial(benchState *s)
+{
+    int threads = parallel_num_threads();
+    parallel_set_num_threads(1);
+    array_free(array_scan(s->a, SCAN_CUMSUM, -1));
+    parallel_set_num_threads(threads);
+}
+
+static void
+run_cumsum0(benchState *s)
+{
+    array_free(array_scan(s->a, SCAN_CUMSUM, 0));
+}
+
+static void
+run_axpy(benchState *s)
+{
+    array_axpy(s->a, 1, s->b);
+}
+
+static void
+run_scal(benchState *s)
+{
+    array_scal(s->a, 1);
+}
+
+static void
+run_asum(benchState *s)
+{
+    array_asum(s->a);
+}
+
+static void
+run_nrm2(benchState *s)
+{
+    array_nrm2(s->a);
+}
+
+static void
+run_iamax(benchState *s)
+{
+    array_iamax(s->a);
+}
+
+static void
+run_ravel(benchState *s)
+{
+    array_data_free(array_ravel(s->a));
+}
+
+static void
+run_ravel_transposed(benchState *s)
+{
+    int perm[] = {1, 0};
+    array_transpose(s->a, perm);
+    array_data_free(array_ravel(s->a));
+    array_transpose(s->a, perm);
+}
+
+static void
+run_transpose(benchState *s)
+{
+    int perm[] = {1, 0};
+    array_transpose(s->a, perm);
+    array_transpose(s->a, perm);
+}
+
+static void
+run_copy(benchState *s)
+{
+    array_free(array_copy(s->a));
+}
+
+static void
+run_fill_val(benchState *s)
+{
+    array_fill_val(s->a, 1, s->dtype);
+}
+
+static void
+run_fill_vals(benchState *s)
+{
+    array_fill_vals(s->a, s->vals, s->dtype);
+}
+
+static void
+run_fill_uniform_int(benchState *s)
+{
+    array_fill_uniform_int(s->a, 0, 9, s->dtype);
+}
+
+static void
+run_str(benchState *s)
+{
+    free(array_str(s->a));
+}
+
+static benchOp bench_ops[] = {
+    {"dot", 0, run_dot, dot_flops, dot_bytes},
+    {"dot_nt", 0, run_dot_nt, dot_flops, dot_bytes},
+    {"sum0", 0, run_sum0, read_flops, read_bytes},
+    {"sum1", 0, run_sum1, read_flops, read_bytes},
+    {"max0", 0, run_max0, read_flops, read_bytes},
+    {"argmax1", 0, run_argmax1, read_flops, read_bytes},
+    {"cumsum", 0, run_cumsum, read_flops, copy_bytes},
+    {"cumsum_serial", 0, run_cumsum_serial, read_flops, copy_bytes},
+    {"cumsum0", 0, run_cumsum0, read_flops, copy_bytes},
+    {"axpy", 0, run_axpy, axpy_flops, axpy_bytes},
+    {"scal", 0, run_scal, read_flops, copy_bytes},
+    {"asum", 0, run_asum, read_flops, read_bytes},
+    {"nrm2", 0, run_nrm2, axpy_flops, read_bytes},
+    {"iamax", 0, run_iamax, read_flops, read_bytes},
+    {"ravel", 0, run_ravel, no_flops, copy_bytes},
+    {"ravel_transposed", 0, run_ravel_transposed, no_flops, copy_bytes},
+    {"transpose", 0, run_transpose, no_flops, no_bytes},
+    {"copy", 0, run_copy, no_flops, copy_bytes},
+    {"fill_val", 0, run_fill_val, no_flops, read_bytes},
+    {"fill_vals", 1, run_fill_vals, no_flops, copy_bytes},
+    {"fill_uniform_int", 0, run_fill_uniform_int, no_flops, read_bytes},
+    {"str", 0, run_str, no_flops, no_bytes},
+};
+
+#define NUM_BENCH_OPS (int)(sizeof(bench_ops) / sizeof(bench_ops[0]))
+
+static int quick_shapes[][2] = {{64, 64}, {256, 256}};
+
+static int full_shapes[][2] = {
+    {16, 16}, {64, 64}, {256, 256}, {512, 512}, {1024, 1024},
+    {4096, 64}, {64, 4096}, {1 << 20, 1},
+};
+
+/* dot is cubic in the shape, so the sweep caps it to keep runs bounded. */
+#define DOT_MAX_FLOPS 4e9
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static benchResult
+measure(benchOp *op, benchState *s, const benchConfig *cfg)
+{
+    benchResult r = {0};
+    double *samples = malloc(cfg->reps * sizeof(double));
+
+    for (int i = 0; i < cfg->warmup; i++) {
+        op->run(s);
+    }
+
+    uint64_t budget_ns = (uint64_t)(cfg->max_seconds * 1e9);
+    uint64_t start = now_ns();
+    while (r.reps < cfg->reps) {
+        uint64_t counters[NUM_PERF_COUNTERS];
+        if (cfg->perf) perf_counters_start(cfg->perf);
+        uint64_t t0 = now_ns();
+        op->run(s);
+        uint64_t t1 = now_ns();
+        if (cfg->perf) {
+            perf_counters_stop(cfg->perf, counters);
+            for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+                r.counters[i] += counters[i];
+            }
+        }
+        samples[r.reps++] = (double)(t1 - t0);
+        if (r.reps >= 5 && t1 - start > budget_ns) break;
+    }
+
+    qsort(samples, r.reps, sizeof(double), compare_doubles);
+    r.min_ns = samples[0];
+    r.median_ns = r.reps % 2
+        ? samples[r.reps / 2]
+        : 0.5 * (samples[r.reps / 2 - 1] + samples[r.reps / 2]);
+    int p99_idx = (int)(0.99 * r.reps + 0.999999) - 1;
+    r.p99_ns = samples[p99_idx < 0 ? 0 : p99_idx];
+
+    free(samples);
+    return r;
+}
+
+static void
+bench_state_init(benchState *s, benchOp *op, ARRAY_DTYPE dtype, int *dims)
+{
+    memset(s, 0, sizeof(*s));
+    s->dtype = dtype;
+    s->dims[0] = dims[0];
+    s->dims[1] = dims[1];
+    int64_t a_dims[] = {dims[0], dims[1]};
+    s->a = array_alloc(a_dims, 2, dtype);
+    array_fill_uniform_int(s->a, 0, 9, dtype);
+    if (op->run == run_dot || op->run == run_dot_nt) {
+        int64_t b_dims[] = {dims[1], dims[1]};
+        s->b = array_alloc(b_dims, 2, dtype);
+        array_fill_uniform_int(s->b, 0, 9, dtype);
+    } else if (op->run == run_axpy) {
+        s->b = array_alloc(a_dims, 2, dtype);
+        array_fill_uniform_int(s->b, 0, 9, dtype);
+    }
+    if (op->needs_vals) {
+        s->vals = array_ravel(s->a);
+    }
+}
+
+static void
+bench_state_free(benchState *s)
+{
+    array_free(s->a);
+    array_free(s->b);
+    array_data_free(s->vals);
+}
+
+/*
+ * Derived counter metrics: IPC, then misses per element for each of the
+ * miss counters. Negative values mark metrics whose counters are missing.
+ */
+#define NUM_PERF_METRICS 4
+
+static const char *PERF_METRIC_NAMES[NUM_PERF_METRICS] = {
+    "ipc", "l1d_misses_per_elem", "llc_misses_per_elem", "dtlb_misses_per_elem",
+};
+
+static void
+perf_metrics(const benchConfig *cfg, const benchState *s, const benchResult *r,
+             double metrics[NUM_PERF_METRICS])
+{
+    static const PERF_COUNTER misses[] = {
+        PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_DTLB_MISSES,
+    };
+    double elems = num_elems(s) * r->reps;
+    metrics[0] = -1;
+    if (perf_counter_available(cfg->perf, PERF_CYCLES) &&
+        perf_counter_available(cfg->perf, PERF_INSTRUCTIONS) &&
+        r->counters[PERF_CYCLES]) {
+        metrics[0] = (double)r->counters[PERF_INSTRUCTIONS] / r->counters[PERF_CYCLES];
+    }
+    for (int i = 0; i < 3; i++) {
+        metrics[i + 1] = perf_counter_available(cfg->perf, misses[i])
+            ? r->counters[misses[i]] / elems
+            : -1;
+    }
+}
+
+static void
+report(benchOp *op, benchState *s, benchResult *r, const benchConfig *cfg, int first)
+{
+    double secs = r->median_ns * 1e-9;
+    double gflops = op->flops(s) / secs * 1e-9;
+    double gbps = op->bytes(s) / secs * 1e-9;
+    const char *dtype_name = ARRAY_DTYPE_NAMES[s->dtype];
+    double metrics[NUM_PERF_METRICS];
+    if (cfg->perf) perf_metrics(cfg, s, r, metrics);
+
+    if (cfg->json) {
+        printf("%s\n  {\"op\": \"%s\", \"dtype\": \"%s\", \"dims\": [%d, %d], "
+               "\"reps\": %d, \"min_ns\": %.0f, \"median_ns\": %.0f, "
+               "\"p99_ns\": %.0f, \"gflops\": %.4f, \"gbps\": %.4f",
+               first ? "" : ",", op->name, dtype_name, s->dims[0], s->dims[1],
+               r->reps, r->min_ns, r->median_ns, r->p99_ns, gflops, gbps);
+        if (cfg->perf) {
+            for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+                if (perf_counter_available(cfg->perf, i)) {
+                    printf(", \"%s_per_call\": %.1f", PERF_COUNTER_NAMES[i],
+                           (double)r->counters[i] / r->reps);
+                } else {
+                    printf(", \"%s_per_call\": null", PERF_COUNTER_NAMES[i]);
+                }
+            }
+            for (int i = 0; i < NUM_PERF_METRICS; i++) {
+                if (metrics[i] < 0) {
+                    printf(", \"%s\": null", PERF_METRIC_NAMES[i]);
+                } else {
+                    printf(", \"%s\": %.4f", PERF_METRIC_NAMES[i], metrics[i]);
+                }
+            }
+        }
+        printf("}");
+    } else {
+        printf("%-18s %-7s %8d x %-8d %6d %14.0f %14.0f %10.3f %10.3f",
+               op->name, dtype_name, s->dims[0], s->dims[1], r->reps,
+               r->median_ns, r->p99_ns, gflops, gbps);
+        if (cfg->perf) {
+            for (int i = 0; i < NUM_PERF_METRICS; i++) {
+                if (metrics[i] < 0) {
+                    printf(" %10s", "n/a");
+                } else {
+                    printf(" %10.3f", metrics[i]);
+                }
+            }
+        }
+        printf("\n");
+    }
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+        "usage: %s [--full] [--json] [--reps N] [--warmup N] "
+        "[--max-time SECONDS] [--op NAME] [--perf]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    benchConfig cfg = {0, 0, 2, 50, 1.0, NULL, NULL};
+    perfCounters perf;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--full")) {
+            cfg.full = 1;
+        } else if (!strcmp(argv[i], "--json")) {
+            cfg.json = 1;
+        } else if (!strcmp(argv[i], "--reps") && i + 1 < argc) {
+            cfg.reps = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--warmup") && i + 1 < argc) {
+            cfg.warmup = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--max-time") && i + 1 < argc) {
+            cfg.max_seconds = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--op") && i + 1 < argc) {
+            cfg.op_filter = argv[++i];
+        } else if (!strcmp(argv[i], "--perf")) {
+            cfg.perf = &perf;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (cfg.reps < 1) cfg.reps = 1;
+    if (cfg.perf) {
+        int n = perf_counters_open(&perf);
+        if (n < NUM_PERF_COUNTERS) {
+            fprintf(stderr, "perf: %d of %d hardware counters available "
+                    "(check perf_event_paranoid or container seccomp)\n",
+                    n, NUM_PERF_COUNTERS);
+        }
+    }
+
+    int (*shapes)[2] = cfg.full ? full_shapes : quick_shapes;
+    int num_shapes = cfg.full
+        ? sizeof(full_shapes) / sizeof(full_shapes[0])
+        : sizeof(quick_shapes) / sizeof(quick_shapes[0]);
+
+    if (cfg.json) {
+        printf("[");
+    } else {
+        printf("%-18s %-7s %19s %6s %14s %14s %10s %10s",
+               "op", "dtype", "shape", "reps", "median_ns", "p99_ns",
+               "GFLOP/s", "GB/s");
+        if (cfg.perf) {
+            printf(" %10s %10s %10s %10s", "IPC", "L1D/elem", "LLC/elem",
+                   "dTLB/elem");
+        }
+        printf("\n");
+    }
+
+    int first = 1;
+    for (int o = 0; o < NUM_BENCH_OPS; o++) {
+        benchOp *op = &bench_ops[o];
+        if (cfg.op_filter && strcmp(cfg.op_filter, op->name)) continue;
+
+        for (int i = 0; i < NUM_ARRAY_DTYPES; i++) {
+            for (int j = 0; j < num_shapes; j++) {
+                benchState s;
+                s.dtype = ARRAY_DTYPES[i];
+                s.dims[0] = shapes[j][0];
+                s.dims[1] = shapes[j][1];
+                if ((op->run == run_dot || op->run == run_dot_nt) &&
+                    dot_flops(&s) > DOT_MAX_FLOPS) continue;
+
+                bench_state_init(&s, op, ARRAY_DTYPES[i], shapes[j]);
+                benchResult r = measure(op, &s, &cfg);
+                report(op, &s, &r, &cfg, first);
+                bench_state_free(&s);
+                first = 0;
+            }
+        }
+    }
+
+    if (cfg.json) {
+        printf("\n]\n");
+    }
+    if (cfg.perf) {
+        perf_counters_close(&perf);
     }
 
     return 0;
@@ -1,11 +1,26 @@
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "array.h"
+#include "array_backend.h"
 #include "array_dtypes.h"
+#include "array_graph.h"
+#include "array_index.h"
+#include "array_math.h"
+#include "array_parallel.h"
+#include "array_sort.h"
+#include "array_sparse.h"
+#include "array_stats.h"
+#include "array_trace.h"
+#include "array_tune.h"
 #include "array_utils.h"
 
 #define EPSILON 1e-8
@@ -55,7 +70,7 @@ char_arrays_equal(char *a, char *b, int n)
 }
 
 static int
-check_array_metadata(arrayObject *a, ARRAY_DTYPE et, int *ed, int *es)
+check_array_metadata(arrayObject *a, ARRAY_DTYPE et, int64_t *ed, int64_t *es)
 {
     if (a->dtype != et) return 1;
     for (int i = 0; i < a->nd; i++) {
@@ -100,17 +115,42 @@ cast_test_values(int *vals, int n, ARRAY_DTYPE dtype) {
     }
 }
 
+static double
+elem_as_double(const arrayObject *a, int i, int j)
+{
+    const char *p = a->data +
+        (i * a->strides[0] + j * a->strides[1]) * array_dtype_size(a->dtype);
+    switch (a->dtype) {
+        case INT32: return *(const int32_t *)p;
+        case INT64: return *(const int64_t *)p;
+        case FLOAT: return *(const float *)p;
+        case DOUBLE: return *(const double *)p;
+        default: return 0;
+    }
+}
+
+static int
+all_equal(const arrayObject *a, double val)
+{
+    for (int i = 0; i < a->dims[0]; i++) {
+        for (int j = 0; j < a->dims[1]; j++) {
+            if (elem_as_double(a, i, j) != val) return 0;
+        }
+    }
+    return 1;
+}
+
 int
 test_instantiation(ARRAY_DTYPE dtype)
 {
     arrayObject *a1 = NULL;
     arrayObject *a2 = NULL;
-    int ds1[] = {3};
-    int ed1[] = {3, 1};
-    int es1[] = {1, 1};
-    int ds2[] = {4, 2};
-    int ed2[] = {4, 2};
-    int es2[] = {2, 1};
+    int64_t ds1[] = {3};
+    int64_t ed1[] = {3, 1};
+    int64_t es1[] = {1, 1};
+    int64_t ds2[] = {4, 2};
+    int64_t ed2[] = {4, 2};
+    int64_t es2[] = {2, 1};
 
     a1 = array_alloc(ds1, 1, dtype);
     if (!a1) goto fail;
@@ -140,9 +180,9 @@ test_fill(ARRAY_DTYPE dtype)
     void *r2 = NULL;
     void *cvs1 = NULL;
     void *cvs2 = NULL;
-    int ds1[] = {5};
+    int64_t ds1[] = {5};
     int vs1[] = {4, 11, 3, 8, 0};
-    int ds2[] = {4, 2};
+    int64_t ds2[] = {4, 2};
     int vs2[] = {8, 3, 9, 1, 4, 2, 0, 6};
 
     a1 = array_alloc(ds1, 1, dtype);
@@ -164,20 +204,100 @@ test_fill(ARRAY_DTYPE dtype)
 fail:
     array_free(a1);
     array_free(a2);
-    free(r1);
-    free(r2);
+    array_data_free(r1);
+    array_data_free(r2);
     free(cvs1);
     free(cvs2);
     return 1;
 }
 
+int
+test_constructors(ARRAY_DTYPE dtype)
+{
+    arrayObject *a = NULL;
+    int ret = 1;
+    int64_t ds[] = {3, 4};
+    int64_t big[] = {1 << 21};
+
+    a = array_full(ds, 2, 7, dtype);
+    if (!a || check_array_metadata(a, dtype, ds, (int64_t[]){4, 1})) goto fail;
+    if (elem_as_double(a, 0, 0) != 7 || elem_as_double(a, 2, 3) != 7) goto fail;
+    array_free(a);
+
+    // Long enough to split the fill across threads.
+    a = array_arange(-4, (1 << 21) - 4, 1, dtype);
+    if (!a || a->dims[0] != big[0] || a->dims[1] != 1) goto fail;
+    if (elem_as_double(a, 0, 0) != -4 || elem_as_double(a, 1000003, 0) != 999999) goto fail;
+    array_free(a);
+    a = array_arange(10, 0, -3, dtype);
+    if (!a || a->dims[0] != 4 || elem_as_double(a, 3, 0) != 1) goto fail;
+    array_free(a);
+    a = array_arange(0, 1, 0, dtype);
+    if (a) goto fail;
+
+    // Integer paths, exact past 2^53 for INT64, and serial and parallel.
+    a = array_arange_int(-3, (1 << 21) - 3, 1, dtype);
+    if (!a || a->dims[0] != big[0] || elem_as_double(a, 1000003, 0) != 1000000) goto fail;
+    array_free(a);
+    a = array_arange_int(7, -2, -4, dtype);
+    if (!a || a->dims[0] != 3 || elem_as_double(a, 2, 0) != -1) goto fail;
+    array_free(a);
+    if (array_arange_int(0, 1, 0, dtype)) goto fail;
+    if (dtype == INT64) {
+        int64_t top = INT64_MAX - 2;
+        a = array_arange_int((1LL << 53) - 1, top, 1LL << 61, dtype);
+        if (!a || a->dims[0] != 4) goto fail;
+        if (((int64_t *)a->data)[0] != (1LL << 53) - 1 ||
+            ((int64_t *)a->data)[3] != (1LL << 53) - 1 + 3 * (1LL << 61)) goto fail;
+        array_free(a);
+        a = array_arange_int(INT64_MIN, INT64_MAX, INT64_MAX, dtype);
+        if (!a || a->dims[0] != 3 || ((int64_t *)a->data)[2] != INT64_MAX - 1) goto fail;
+        array_free(a);
+        a = array_full_int(big, 1, (1LL << 53) + 1, dtype);
+        if (!a || ((int64_t *)a->data)[big[0] - 1] != (1LL << 53) + 1) goto fail;
+        array_free(a);
+    }
+    a = NULL;
+
+    a = array_linspace(0, 8, 5, 1, dtype);
+    if (!a || a->dims[0] != 5) goto fail;
+    for (int i = 0; i < 5; i++) {
+        if (elem_as_double(a, i, 0) != 2 * i) goto fail;
+    }
+    array_free(a);
+    a = array_linspace(0, 8, 4, 0, dtype);
+    if (!a || elem_as_double(a, 3, 0) != 6) goto fail;
+    array_free(a);
+
+    a = array_eye(3, 4, 1, dtype);
+    if (!a || a->dims[0] != 3 || a->dims[1] != 4) goto fail;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            if (elem_as_double(a, i, j) != (j == i + 1)) goto fail;
+        }
+    }
+    array_free(a);
+    a = array_eye(3, 3, -5, dtype);
+    if (!a || !all_equal(a, 0)) goto fail;
+    array_free(a);
+
+    a = array_empty(big, 1, dtype);
+    if (!a || a->dims[0] != big[0]) goto fail;
+
+    ret = 0;
+
+fail:
+    array_free(a);
+    return ret;
+}
+
 int
 test_copy(ARRAY_DTYPE dtype)
 {
     arrayObject *a = NULL;
     arrayObject *b = NULL;
     void *cvs = NULL;
-    int ds[] = {3, 5};
+    int64_t ds[] = {3, 5};
     int vs[] = {3, 1, 5, 2, 0,
                 4, 4, 1, 0, 3,
                 0, 2, 7, 1, 9};
@@ -191,8 +311,8 @@ test_copy(ARRAY_DTYPE dtype)
     if (!b) goto fail;
     if (a->nd != b->nd) goto fail;
     if (char_arrays_equal(a->data, b->data, prod(ds, 2) * array_dtype_size(dtype))) goto fail;
-    if (arrays_equal(a->dims, b->dims, 2, INT32)) goto fail;
-    if (arrays_equal(a->strides, b->strides, 2, INT32)) goto fail;
+    if (arrays_equal(a->dims, b->dims, 2, INT64)) goto fail;
+    if (arrays_equal(a->strides, b->strides, 2, INT64)) goto fail;
 
     return 0;
 
@@ -210,9 +330,9 @@ test_transpose(ARRAY_DTYPE dtype)
     void *cvs = NULL;
     void *r = NULL;
     void *cts = NULL;
-    int ds[] = {4, 2};
-    int ed[] = {2, 4};
-    int es[] = {1, 2};
+    int64_t ds[] = {4, 2};
+    int64_t ed[] = {2, 4};
+    int64_t es[] = {1, 2};
     int vs[] = {8, 3, 9, 1, 4, 2, 0, 6};
     int ts[] = {8, 9, 4, 0, 3, 1, 2, 6};
     int perm[] = {1, 0};
@@ -234,7 +354,7 @@ test_transpose(ARRAY_DTYPE dtype)
 fail:
     array_free(a);
     free(cvs);
-    free(r);
+    array_data_free(r);
     free(cts);
     return 1;
 }
@@ -262,9 +382,9 @@ int test_sum(ARRAY_DTYPE dtype)
     void *ce21 = NULL;
     void *ce30 = NULL;
     void *ce31 = NULL;
-    int ds1[] = {4};
-    int ds2[] = {3, 5};
-    int ds3[] = {3, 5};
+    int64_t ds1[] = {4};
+    int64_t ds2[] = {3, 5};
+    int64_t ds3[] = {3, 5};
     int v1[] = {3, 1, 5, 4};
     int v2[] = {3, 1, 5, 2, 0,
                 4, 4, 1, 0, 3,
@@ -331,11 +451,11 @@ fail:
     array_free(s21);
     array_free(s30);
     array_free(s31);
-    free(r1);
-    free(r20);
-    free(r21);
-    free(r30);
-    free(r31);
+    array_data_free(r1);
+    array_data_free(r20);
+    array_data_free(r21);
+    array_data_free(r30);
+    array_data_free(r31);
     free(cv1);
     free(cv2);
     free(cv3);
@@ -370,12 +490,12 @@ int test_dot(ARRAY_DTYPE dtype)
     void *ce1 = NULL;
     void *ce2 = NULL;
     void *ce3 = NULL;
-    int ds11[] = {1, 4};
-    int ds12[] = {4};
-    int ds21[] = {3, 5};
-    int ds22[] = {5};
-    int ds31[] = {2, 3};
-    int ds32[] = {3, 4};
+    int64_t ds11[] = {1, 4};
+    int64_t ds12[] = {4};
+    int64_t ds21[] = {3, 5};
+    int64_t ds22[] = {5};
+    int64_t ds31[] = {2, 3};
+    int64_t ds32[] = {3, 4};
     int v11[] = {3, 1, 5, 4};
     int v12[] = {0, 2, 6, 3};
     int v21[] = {3, 1, 5, 2, 0,
@@ -447,9 +567,9 @@ fail:
     free(cv22);
     free(cv31);
     free(cv32);
-    free(rd1);
-    free(rd2);
-    free(rd3);
+    array_data_free(rd1);
+    array_data_free(rd2);
+    array_data_free(rd3);
     free(ce1);
     free(ce2);
     free(ce3);
@@ -457,6 +577,1454 @@ fail:
     return 1;
 }
 
+/*
+ * Checks a @ b for every combination of transposed operands against a naive
+ * reference, using a small blocking so that partial blocks and panels are hit.
+ */
+int test_dot_transposed(ARRAY_DTYPE dtype)
+{
+    int m = 13, n = 11, k = 17;
+    int perm[] = {1, 0};
+    gemmBlocking saved;
+    gemmBlocking small = {5, 6, 7, 0};
+    int ret = 0;
+
+    gemm_get_blocking(dtype, &saved);
+    gemm_set_blocking(dtype, &small);
+
+    for (int layout = 0; layout < 4 && !ret; layout++) {
+        int trans_a = layout & 1;
+        int trans_b = layout & 2;
+        int64_t ds_a[] = {trans_a ? k : m, trans_a ? m : k};
+        int64_t ds_b[] = {trans_b ? n : k, trans_b ? k : n};
+        arrayObject *a = array_alloc(ds_a, 2, dtype);
+        arrayObject *b = array_alloc(ds_b, 2, dtype);
+        array_fill_uniform_int(a, -4, 5, dtype);
+        array_fill_uniform_int(b, -4, 5, dtype);
+        if (trans_a) array_transpose(a, perm);
+        if (trans_b) array_transpose(b, perm);
+
+        arrayObject *d = array_dot(a, b);
+        if (!d || d->dims[0] != m || d->dims[1] != n) {
+            ret = 1;
+        }
+        for (int i = 0; i < m && !ret; i++) {
+            for (int j = 0; j < n && !ret; j++) {
+                double expected = 0;
+                for (int p = 0; p < k; p++) {
+                    expected += elem_as_double(a, i, p) * elem_as_double(b, p, j);
+                }
+                if (elem_as_double(d, i, j) != expected) ret = 1;
+            }
+        }
+        array_free(a);
+        array_free(b);
+        array_free(d);
+    }
+
+    gemm_set_blocking(dtype, &saved);
+    return ret;
+}
+
+/* C and F copies of a transposed array, large enough to cross several tiles. */
+int test_copy_order(ARRAY_DTYPE dtype)
+{
+    int64_t ds[] = {45, 67};
+    int perm[] = {1, 0};
+    int ret = 0;
+    arrayObject *a = array_alloc(ds, 2, dtype);
+    array_fill_uniform_int(a, -100, 100, dtype);
+    array_transpose(a, perm);
+
+    arrayObject *c = array_copy_order(a, 'C');
+    arrayObject *f = array_copy_order(a, 'F');
+    arrayObject *k = array_copy_order(a, 'K');
+    if (!c || !f || !k || array_copy_order(a, 'X')) ret = 1;
+    if (!ret && (!array_is_contiguous(c, 'C') || array_is_contiguous(c, 'F'))) ret = 1;
+    if (!ret && (!array_is_contiguous(f, 'F') || array_is_contiguous(f, 'C'))) ret = 1;
+    if (!ret && !array_is_contiguous(k, 'F')) ret = 1;
+    if (!ret && (array_is_contiguous(a, 'C') || !array_is_contiguous(a, 'F'))) ret = 1;
+    for (int i = 0; i < a->dims[0] && !ret; i++) {
+        for (int j = 0; j < a->dims[1] && !ret; j++) {
+            double v = elem_as_double(a, i, j);
+            if (elem_as_double(c, i, j) != v || elem_as_double(f, i, j) != v) ret = 1;
+        }
+    }
+
+    array_free(a);
+    array_free(c);
+    array_free(f);
+    array_free(k);
+    return ret;
+}
+
+/*
+ * max/argmin/mean over each axis and over both, checked against a naive
+ * scan. The array is wide enough to span several column blocks, and is
+ * reduced both as is and through a transposed view.
+ */
+int test_reduce(ARRAY_DTYPE dtype)
+{
+    int64_t ds[] = {37, 1500};
+    int perm[] = {1, 0};
+    int ret = 0;
+    arrayObject *a = array_alloc(ds, 2, dtype);
+    array_fill_uniform_int(a, -1000, 1000, dtype);
+
+    for (int pass = 0; pass < 2 && !ret; pass++) {
+        if (pass) array_transpose(a, perm);
+        int rows = a->dims[0];
+        int cols = a->dims[1];
+
+        arrayObject *mx = array_reduce(a, REDUCE_MAX, 1, 1);
+        arrayObject *am = array_reduce(a, REDUCE_ARGMIN, 2, 0);
+        arrayObject *mean = array_reduce(a, REDUCE_MEAN, 3, 0);
+        if (!mx || !am || !mean) ret = 1;
+        if (!ret && (mx->dims[0] != 1 || mx->dims[1] != cols)) ret = 1;
+        if (!ret && (am->dtype != INT64 || am->dims[0] != rows)) ret = 1;
+        if (!ret && mean->dtype != (dtype == FLOAT ? FLOAT : DOUBLE)) ret = 1;
+
+        double total = 0;
+        for (int j = 0; j < cols && !ret; j++) {
+            double best = elem_as_double(a, 0, j);
+            for (int i = 1; i < rows; i++) {
+                double v = elem_as_double(a, i, j);
+                if (v > best) best = v;
+            }
+            if (elem_as_double(mx, 0, j) != best) ret = 1;
+        }
+        for (int i = 0; i < rows && !ret; i++) {
+            int best = 0;
+            for (int j = 0; j < cols; j++) {
+                double v = elem_as_double(a, i, j);
+                if (v < elem_as_double(a, i, best)) best = j;
+                total += v;
+            }
+            if (((int64_t *)am->data)[i] != best) ret = 1;
+        }
+        if (!ret && fabs(elem_as_double(mean, 0, 0) - total / (rows * cols)) > 1e-3) {
+            ret = 1;
+        }
+
+        array_free(mx);
+        array_free(am);
+        array_free(mean);
+    }
+    if (!ret && (array_reduce(a, REDUCE_MAX, 0, 0) || array_reduce(a, REDUCE_MAX, 4, 0))) {
+        ret = 1;
+    }
+
+    array_free(a);
+    return ret;
+}
+
+/*
+ * cumsum along both axes of a transposed view, and a flattened cumsum long
+ * enough to take the two-pass parallel scan, against a serial running sum.
+ */
+int test_scan(ARRAY_DTYPE dtype)
+{
+    int64_t ds[] = {5, 7};
+    int64_t ds_long[] = {100003};
+    int perm[] = {1, 0};
+    int ret = 0;
+    arrayObject *a = array_alloc(ds, 2, dtype);
+    arrayObject *l = array_alloc(ds_long, 1, dtype);
+    array_fill_uniform_int(a, -3, 4, dtype);
+    array_fill_uniform_int(l, 0, 4, dtype);
+    array_transpose(a, perm);
+
+    arrayObject *s0 = array_scan(a, SCAN_CUMSUM, 0);
+    arrayObject *s1 = array_scan(a, SCAN_CUMPROD, 1);
+    if (!s0 || !s1 || s0->dims[0] != 7 || s0->dims[1] != 5) ret = 1;
+    for (int j = 0; j < a->dims[1] && !ret; j++) {
+        double acc = 0;
+        for (int i = 0; i < a->dims[0]; i++) {
+            acc += elem_as_double(a, i, j);
+            if (elem_as_double(s0, i, j) != acc) ret = 1;
+        }
+    }
+    for (int i = 0; i < a->dims[0] && !ret; i++) {
+        double acc = 1;
+        for (int j = 0; j < a->dims[1]; j++) {
+            acc *= elem_as_double(a, i, j);
+            if (elem_as_double(s1, i, j) != acc) ret = 1;
+        }
+    }
+
+    int threads = parallel_num_threads();
+    parallel_set_num_threads(4);
+    arrayObject *sl = array_scan(l, SCAN_CUMSUM, -1);
+    parallel_set_num_threads(threads);
+    double acc = 0;
+    for (int i = 0; i < ds_long[0] && !ret; i++) {
+        acc += elem_as_double(l, i, 0);
+        if (elem_as_double(sl, i, 0) != acc) ret = 1;
+    }
+    if (array_scan(a, SCAN_CUMSUM, 2)) ret = 1;
+
+    array_free(a);
+    array_free(l);
+    array_free(s0);
+    array_free(s1);
+    array_free(sl);
+    return ret;
+}
+
+/* Records dot then two sums, one over a transposed input, and replays them. */
+int test_graph(ARRAY_DTYPE dtype)
+{
+    int64_t ds_a[] = {9, 6};
+    int64_t ds_b[] = {9, 5};
+    int perm[] = {1, 0};
+    int ret = 0;
+    arrayObject *a[2], *b[2];
+    for (int i = 0; i < 2; i++) {
+        a[i] = array_alloc(ds_a, 2, dtype);
+        b[i] = array_alloc(ds_b, 2, dtype);
+        array_fill_uniform_int(a[i], -4, 5, dtype);
+        array_fill_uniform_int(b[i], -4, 5, dtype);
+        array_transpose(a[i], perm);
+    }
+
+    arrayGraph *g = array_graph_alloc();
+    arrayObject *c = array_dot(a[0], b[0]);
+    arrayObject *s0 = array_sum(c, 1);
+    arrayObject *s1 = array_sum(a[0], 0);
+    if (array_graph_record_dot(g, a[0], b[0], c) ||
+        array_graph_record_sum(g, c, 1, s0) ||
+        array_graph_record_sum(g, a[0], 0, s1)) {
+        ret = 1;
+    }
+    if (array_graph_num_inputs(g) != 2 || array_graph_num_ops(g) != 3 ||
+        array_graph_find_input(g, b[0]) != 1 || array_graph_find_input(g, c) != -1) {
+        ret = 1;
+    }
+
+    arrayObject *bound[] = {a[1], b[1]};
+    if (array_graph_check_inputs(g, bound)) ret = 1;
+    array_graph_replay(g, bound);
+    arrayObject *ec = array_dot(a[1], b[1]);
+    arrayObject *es0 = array_sum(ec, 1);
+    arrayObject *es1 = array_sum(a[1], 0);
+    if (arrays_equal(c->data, ec->data, NUM_ARRAY_ELEMS(c), dtype) ||
+        arrays_equal(s0->data, es0->data, NUM_ARRAY_ELEMS(s0), dtype) ||
+        arrays_equal(s1->data, es1->data, NUM_ARRAY_ELEMS(s1), dtype)) {
+        ret = 1;
+    }
+
+    // Layout changes and outputs fed back as inputs are rejected.
+    arrayObject *swapped[] = {b[1], a[1]};
+    array_transpose(a[1], perm);
+    arrayObject *relaid[] = {a[1], b[1]};
+    if (!array_graph_check_inputs(g, swapped) || !array_graph_check_inputs(g, relaid)) {
+        ret = 1;
+    }
+    array_graph_free(g);
+
+    int64_t ds_sq[] = {4, 4};
+    arrayObject *x = array_alloc(ds_sq, 2, dtype);
+    arrayObject *y = array_dot(x, x);
+    g = array_graph_alloc();
+    array_graph_record_dot(g, x, x, y);
+    arrayObject *aliased[] = {y};
+    if (array_graph_num_inputs(g) != 1 || !array_graph_check_inputs(g, aliased)) ret = 1;
+    array_graph_free(g);
+
+    arrayObject *all[] = {a[0], a[1], b[0], b[1], c, s0, s1, ec, es0, es1, x, y};
+    for (int i = 0; i < 12; i++) array_free(all[i]);
+    return ret;
+}
+
+static arrayObject *
+sparse_test_array(int rows, int cols, int every, ARRAY_DTYPE dtype)
+{
+    int64_t ds[] = {rows, cols};
+    int *vals = malloc(rows * cols * sizeof(int));
+    for (int i = 0; i < rows * cols; i++) {
+        vals[i] = (i * 7919) % every == 0 ? i % 9 - 4 : 0;
+    }
+    arrayObject *a = array_alloc(ds, 2, dtype);
+    void *cv = cast_test_values(vals, rows * cols, dtype);
+    array_fill_vals(a, cv, dtype);
+    free(cv);
+    free(vals);
+    return a;
+}
+
+int test_sparse(ARRAY_DTYPE dtype)
+{
+    int ret = 0;
+    int perm[] = {1, 0};
+    arrayObject *a = sparse_test_array(37, 23, 11, dtype);
+    csrObject *s = csr_from_dense(a);
+    int nnz = 0;
+    for (int i = 0; i < 37; i++) {
+        for (int j = 0; j < 23; j++) nnz += elem_as_double(a, i, j) != 0;
+    }
+    arrayObject *d = csr_to_dense(s);
+    if (s->nnz != nnz || arrays_equal(d->data, a->data, 37 * 23, dtype)) ret = 1;
+
+    // Matrix, transposed-matrix and vector right-hand sides.
+    int64_t ds_b[] = {23, 5};
+    int64_t ds_bt[] = {5, 23};
+    int64_t ds_v[] = {23};
+    arrayObject *rhs[] = {
+        array_alloc(ds_b, 2, dtype), array_alloc(ds_bt, 2, dtype), array_alloc(ds_v, 1, dtype)
+    };
+    array_transpose(rhs[1], perm);
+    for (int r = 0; r < 3 && !ret; r++) {
+        array_fill_uniform_int(rhs[r], -4, 5, dtype);
+        arrayObject *sp = csr_dot(s, rhs[r]);
+        arrayObject *de = array_dot(a, rhs[r]);
+        if (!sp || arrays_equal(sp->data, de->data, NUM_ARRAY_ELEMS(de), dtype)) ret = 1;
+        array_free(sp);
+        array_free(de);
+    }
+    if (csr_dot(s, a)) ret = 1;
+
+    // Large enough to split rows across threads.
+    int threads = parallel_num_threads();
+    parallel_set_num_threads(4);
+    arrayObject *big = sparse_test_array(400, 300, 19, dtype);
+    int64_t ds_w[] = {300, 32};
+    arrayObject *w = array_alloc(ds_w, 2, dtype);
+    array_fill_uniform_int(w, -4, 5, dtype);
+    csrObject *sb = csr_from_dense(big);
+    arrayObject *sp = csr_dot(sb, w);
+    arrayObject *de = array_dot(big, w);
+    if (arrays_equal(sp->data, de->data, NUM_ARRAY_ELEMS(de), dtype)) ret = 1;
+    parallel_set_num_threads(threads);
+
+    // Triplets: (0, 1) appears twice and is summed.
+    int64_t ri[] = {0, 2, 0, 1, 0};
+    int64_t ci[] = {1, 0, 1, 2, 3};
+    int tv[] = {1, 2, 3, 4, 5};
+    int expected[] = {0, 4, 0, 5, 0, 0, 4, 0, 2, 0, 0, 0};
+    void *ctv = cast_test_values(tv, 5, dtype);
+    void *cexp = cast_test_values(expected, 12, dtype);
+    csrObject *st = csr_from_triplets(ri, ci, ctv, 5, 3, 4, dtype);
+    arrayObject *dt = csr_to_dense(st);
+    if (st->nnz != 4 || st->indptr[3] != 4 || arrays_equal(dt->data, cexp, 12, dtype)) ret = 1;
+    if (csr_from_triplets(ri, ci, ctv, 5, 2, 4, dtype)) ret = 1;
+
+    arrayObject *frees[] = {a, d, rhs[0], rhs[1], rhs[2], big, w, sp, de, dt};
+    for (int i = 0; i < 10; i++) array_free(frees[i]);
+    csr_free(s);
+    csr_free(sb);
+    csr_free(st);
+    free(ctv);
+    free(cexp);
+    return ret;
+}
+
+typedef struct parallelTestCtx {
+    int *counts;
+    int n;
+    int grain;
+    int bad_ranges;
+    long nested_total;
+} parallelTestCtx;
+
+static void
+count_range(void *arg, int64_t begin, int64_t end)
+{
+    parallelTestCtx *ctx = arg;
+    if (begin % ctx->grain || ((end - begin) % ctx->grain && end != ctx->n)) {
+        __atomic_add_fetch(&ctx->bad_ranges, 1, __ATOMIC_RELAXED);
+    }
+    for (int i = begin; i < end; i++) {
+        __atomic_add_fetch(&ctx->counts[i], 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void
+add_range(void *arg, int64_t begin, int64_t end)
+{
+    __atomic_add_fetch(&((parallelTestCtx *)arg)->nested_total, end - begin, __ATOMIC_RELAXED);
+}
+
+static void
+nested_range(void *arg, int64_t begin, int64_t end)
+{
+    for (int i = begin; i < end; i++) {
+        parallel_for(1000, 3, add_range, arg);
+    }
+}
+
+static void *
+count_from_thread(void *arg)
+{
+    parallelTestCtx *ctx = arg;
+    parallel_for(ctx->n, ctx->grain, count_range, ctx);
+    return NULL;
+}
+
+static int
+check_counts(parallelTestCtx *ctx, int expected)
+{
+    for (int i = 0; i < ctx->n; i++) {
+        if (ctx->counts[i] != expected) return 1;
+    }
+    return ctx->bad_ranges != 0;
+}
+
+int test_parallel(ARRAY_DTYPE dtype)
+{
+    int ret = 0;
+    int threads = parallel_num_threads();
+    parallel_set_num_threads(4);
+
+    int counts[4][10007] = {{0}};
+    parallelTestCtx ctx = {counts[0], 10007, 7, 0, 0};
+    parallel_for(ctx.n, ctx.grain, count_range, &ctx);
+    parallel_for(ctx.n, ctx.grain, count_range, &ctx);
+    if (check_counts(&ctx, 2)) ret = 1;
+
+    ctx.nested_total = 0;
+    parallel_for(16, 1, nested_range, &ctx);
+    if (ctx.nested_total != 16 * 1000) ret = 1;
+
+    // Independent callers share the pool.
+    pthread_t callers[3];
+    parallelTestCtx cctx[3];
+    for (int t = 0; t < 3; t++) {
+        cctx[t] = (parallelTestCtx){counts[t + 1], 10007 - t, 5 + t, 0, 0};
+        pthread_create(&callers[t], NULL, count_from_thread, &cctx[t]);
+    }
+    for (int t = 0; t < 3; t++) {
+        pthread_join(callers[t], NULL);
+        if (check_counts(&cctx[t], 1)) ret = 1;
+    }
+
+    parallel_set_affinity(1);
+    parallel_set_num_threads(2);
+    memset(counts[0], 0, sizeof(counts[0]));
+    ctx.bad_ranges = 0;
+    parallel_for(ctx.n, ctx.grain, count_range, &ctx);
+    if (check_counts(&ctx, 1) || !parallel_get_affinity()) ret = 1;
+    parallel_set_affinity(0);
+
+    parallel_set_num_threads(threads);
+    return ret;
+}
+
+int test_str(ARRAY_DTYPE dtype)
+{
+    arrayObject *a1 = NULL;
+    arrayObject *a2 = NULL;
+    void *cv1 = NULL;
+    void *cv2 = NULL;
+    char *s1 = NULL;
+    char *s2 = NULL;
+    int ret = 1;
+    int64_t ds1[] = {3};
+    int64_t ds2[] = {5, 5};
+    int v1[] = {3, -1, 5};
+    int v2[25];
+    for (int i = 0; i < 25; i++) v2[i] = i;
+    int is_int = dtype == INT32 || dtype == INT64;
+    char *e1 = is_int ? "[3 -1 5]\n" : "[3.00e+00 -1.00e+00 5.00e+00]\n";
+    char *e2 = is_int ? "[0 ... 4]\n...\n[20 ... 24]\n"
+                      : "[0e+00 ... 4e+00]\n...\n[2e+01 ... 2e+01]\n";
+    arrayPrintOptions defaults;
+    arrayPrintOptions summarise = {20, 1, 0};
+    arrayPrintOptions invalid = {20, 0, 0};
+    array_get_print_options(&defaults);
+
+    a1 = array_alloc(ds1, 1, dtype);
+    cv1 = cast_test_values(v1, 3, dtype);
+    array_fill_vals(a1, cv1, dtype);
+    s1 = array_str(a1);
+    if (strcmp(s1, e1)) goto fail;
+
+    a2 = array_alloc(ds2, 2, dtype);
+    cv2 = cast_test_values(v2, 25, dtype);
+    array_fill_vals(a2, cv2, dtype);
+    if (!array_set_print_options(&invalid)) goto fail;
+    if (array_set_print_options(&summarise)) goto fail;
+    s2 = array_str(a2);
+    if (strcmp(s2, e2)) goto fail;
+
+    ret = 0;
+
+fail:
+    array_set_print_options(&defaults);
+    array_free(a1);
+    array_free(a2);
+    free(cv1);
+    free(cv2);
+    free(s1);
+    free(s2);
+    return ret;
+}
+
+int test_stats(ARRAY_DTYPE dtype)
+{
+    arrayObject *a = NULL;
+    arrayObject *b = NULL;
+    arrayObject *d = NULL;
+    arrayOpStats stats[NUM_STATS_OPS];
+    int ret = 1;
+    int64_t ds[] = {3, 4};
+    size_t nbytes = 12 * array_dtype_size(dtype);
+
+    array_stats_reset();
+    array_stats_enable(1);
+    a = array_alloc(ds, 2, dtype);
+    array_fill_val(a, 2, dtype);
+    b = array_copy(a);
+    array_stats_enable(0);
+    d = array_sum(a, 0);
+
+    array_stats_get(stats);
+    if (stats[STATS_ALLOC].calls != 2) goto fail;
+    if (stats[STATS_ALLOC].bytes != 2 * nbytes) goto fail;
+    if (stats[STATS_FILL].calls != 1 || stats[STATS_FILL].elems != 12) goto fail;
+    if (stats[STATS_COPY].calls != 1 || stats[STATS_COPY].bytes != nbytes) goto fail;
+    if (stats[STATS_COPY].ns == 0) goto fail;
+    if (stats[STATS_SUM].calls != 0) goto fail;
+
+    array_stats_reset();
+    array_stats_get(stats);
+    if (stats[STATS_ALLOC].calls != 0 || stats[STATS_COPY].ns != 0) goto fail;
+
+    ret = 0;
+
+fail:
+    array_stats_enable(0);
+    array_free(a);
+    array_free(b);
+    array_free(d);
+    return ret;
+}
+
+int test_trace(ARRAY_DTYPE dtype)
+{
+    arrayObject *a = NULL;
+    arrayObject *b = NULL;
+    arrayObject *d = NULL;
+    FILE *f = NULL;
+    char contents[4096];
+    int ret = 1;
+    int64_t ds_a[] = {2, 3};
+    int64_t ds_b[] = {3, 4};
+    const char *path = "/tmp/minumpy_test_trace.json";
+    char expected[128];
+    snprintf(expected, sizeof(expected),
+             "\"args\": {\"dtype\": \"%s\", \"a\": [2, 3], \"b\": [3, 4]}",
+             ARRAY_DTYPE_NAMES[dtype]);
+
+    a = array_alloc(ds_a, 2, dtype);
+    b = array_alloc(ds_b, 2, dtype);
+    if (array_trace_start(path)) goto fail;
+    if (!array_trace_start(path)) goto fail;
+    d = array_dot(a, b);
+    if (array_trace_stop()) goto fail;
+    if (!array_trace_stop()) goto fail;
+
+    f = fopen(path, "r");
+    if (!f) goto fail;
+    size_t len = fread(contents, 1, sizeof(contents) - 1, f);
+    contents[len] = '\0';
+    if (!strstr(contents, "\"traceEvents\"")) goto fail;
+    if (!strstr(contents, "{\"name\": \"array_dot\", \"ph\": \"B\"")) goto fail;
+    if (!strstr(contents, "{\"name\": \"array_dot\", \"ph\": \"E\"")) goto fail;
+    if (!strstr(contents, "{\"name\": \"array_alloc\", \"ph\": \"B\"")) goto fail;
+    if (!strstr(contents, expected)) goto fail;
+
+    ret = 0;
+
+fail:
+    if (f) fclose(f);
+    remove(path);
+    array_free(a);
+    array_free(b);
+    array_free(d);
+    return ret;
+}
+
+static void *tracked_ptr = NULL;
+static size_t tracked_size = 0;
+
+static void
+track(void *ptr, size_t size)
+{
+    tracked_ptr = ptr;
+    tracked_size = size;
+}
+
+static void
+untrack(void *ptr)
+{
+    if (ptr == tracked_ptr) tracked_ptr = NULL;
+}
+
+int test_memory(ARRAY_DTYPE dtype)
+{
+    arrayObject *a = NULL;
+    void *r = NULL;
+    arrayMemStats before[NUM_ARRAY_DTYPES];
+    arrayMemStats after[NUM_ARRAY_DTYPES];
+    arrayMemStats total;
+    int ret = 1;
+    int64_t ds[] = {4, 5};
+    size_t nbytes = 20 * array_dtype_size(dtype);
+
+    array_mem_stats(before, &total);
+    array_mem_reset_peak();
+    array_mem_set_hooks(track, untrack);
+
+    a = array_alloc(ds, 2, dtype);
+    if (tracked_ptr != a->data || tracked_size != nbytes) goto fail;
+    r = array_ravel(a);
+    if (tracked_ptr != r) goto fail;
+
+    array_mem_stats(after, &total);
+    if (after[dtype].live_bytes - before[dtype].live_bytes != 2 * nbytes) goto fail;
+    if (after[dtype].allocs - before[dtype].allocs != 2) goto fail;
+
+    array_data_free(r);
+    r = NULL;
+    if (tracked_ptr != NULL) goto fail;
+    array_free(a);
+    a = NULL;
+
+    array_mem_stats(after, &total);
+    if (after[dtype].live_bytes != before[dtype].live_bytes) goto fail;
+    if (after[dtype].peak_bytes != before[dtype].live_bytes + 2 * nbytes) goto fail;
+    if (total.peak_bytes < 2 * nbytes) goto fail;
+
+    ret = 0;
+
+fail:
+    array_mem_set_hooks(NULL, NULL);
+    array_free(a);
+    array_data_free(r);
+    return ret;
+}
+
+static double
+unary_ref(UNARY_OP op, double x)
+{
+    switch (op) {
+        case UNARY_EXP: return exp(x);
+        case UNARY_LOG: return log(x);
+        case UNARY_SQRT: return sqrt(x);
+        case UNARY_TANH: return tanh(x);
+        default: return 1 / (1 + exp(-x));
+    }
+}
+
+int
+test_unary(ARRAY_DTYPE dtype)
+{
+    arrayObject *a = NULL;
+    arrayObject *b = NULL;
+    arrayObject *c = NULL;
+    arrayObject *r = NULL;
+    int ret = 1;
+    int64_t ds[] = {37, 45};
+    // Relative bound a little over the documented ULP errors.
+    double tol = dtype == FLOAT ? 4 * 6e-8 : 4 * 1.2e-16;
+
+    a = array_alloc(ds, 2, dtype);
+    if (dtype != FLOAT && dtype != DOUBLE) {
+        r = array_unary(a, UNARY_EXP, NULL);
+        ret = r != NULL;
+        goto fail;
+    }
+    for (int op = 0; op < NUM_UNARY_OPS; op++) {
+        for (int i = 0; i < 37; i++) {
+            for (int j = 0; j < 45; j++) {
+                double x = (i * 45 + j) * 0.0137 + (op == UNARY_LOG || op == UNARY_SQRT ? 1e-3 : -11);
+                buf_fill_val(a->data + (i * 45 + j) * array_dtype_size(dtype), x, 1, dtype);
+            }
+        }
+        // Transposed input: column-major, so the fresh result keeps its
+        // layout and maps flat.
+        int perm[] = {1, 0};
+        array_transpose(a, perm);
+        r = array_unary(a, op, NULL);
+        if (!r || r->dims[0] != 45 || r->dims[1] != 37) goto fail;
+        for (int i = 0; i < 45; i++) {
+            for (int j = 0; j < 37; j++) {
+                double want = unary_ref(op, elem_as_double(a, i, j));
+                if (fabs(elem_as_double(r, i, j) - want) > tol * fabs(want)) goto fail;
+            }
+        }
+        // Into a row-major out: the layouts differ, so rows are gathered.
+        int64_t ts[] = {45, 37};
+        b = array_empty(ts, 2, dtype);
+        if (array_unary(a, op, b) != b) goto fail;
+        for (int i = 0; i < 45; i++) {
+            for (int j = 0; j < 37; j++) {
+                if (elem_as_double(b, i, j) != elem_as_double(r, i, j)) goto fail;
+            }
+        }
+        array_free(b);
+        b = NULL;
+        // In place on the column-major array takes the flat path.
+        if (array_unary(a, op, a) != a) goto fail;
+        for (int i = 0; i < 45; i++) {
+            for (int j = 0; j < 37; j++) {
+                if (elem_as_double(a, i, j) != elem_as_double(r, i, j)) goto fail;
+            }
+        }
+        array_transpose(a, perm);
+        array_free(r);
+        r = NULL;
+    }
+
+    // The same gather past UNARY_PARALLEL_MIN_ELEMS, split over rows.
+    int64_t big[] = {300, 200};
+    int64_t big_t[] = {200, 300};
+    c = array_alloc(big, 2, dtype);
+    for (int64_t i = 0; i < 300 * 200; i++) {
+        buf_fill_val(c->data + i * array_dtype_size(dtype), i * 1e-4 - 3, 1, dtype);
+    }
+    int perm[] = {1, 0};
+    array_transpose(c, perm);
+    b = array_empty(big_t, 2, dtype);
+    if (array_unary(c, UNARY_TANH, b) != b) goto fail;
+    for (int i = 0; i < 200; i++) {
+        for (int j = 0; j < 300; j++) {
+            double want = tanh(elem_as_double(c, i, j));
+            if (fabs(elem_as_double(b, i, j) - want) > tol * fabs(want)) goto fail;
+        }
+    }
+
+    int64_t bad[] = {37, 44};
+    r = array_alloc(bad, 2, dtype);
+    if (array_unary(a, UNARY_SQRT, r)) goto fail;
+
+    ret = 0;
+
+fail:
+    array_free(a);
+    array_free(b);
+    array_free(c);
+    array_free(r);
+    return ret;
+}
+
+int
+test_blas1(ARRAY_DTYPE dtype)
+{
+    arrayObject *x = NULL;
+    arrayObject *y = NULL;
+    arrayObject *z = NULL;
+    int ret = 1;
+    int perm[] = {1, 0};
+    int64_t ds[] = {5, 7};
+    int64_t ts[] = {7, 5};
+
+    x = array_alloc(ds, 2, dtype);
+    y = array_full(ts, 2, 1, dtype);
+    double abs_sum = 0, sq_sum = 0;
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 7; j++) {
+            double v = i * 7 + j - 17;
+            buf_fill_val(x->data + (i * 7 + j) * array_dtype_size(dtype), v, 1, dtype);
+            abs_sum += fabs(v);
+            sq_sum += v * v;
+        }
+    }
+
+    // y is a transposed view, so axpy walks it by its strides.
+    array_transpose(y, perm);
+    if (array_axpy(y, 2, x)) goto fail;
+    array_scal(y, 3);
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 7; j++) {
+            if (elem_as_double(y, i, j) != 3 * (1 + 2 * elem_as_double(x, i, j))) goto fail;
+        }
+    }
+    if (array_asum(x) != abs_sum) goto fail;
+    if (fabs(array_nrm2(x) - sqrt(sq_sum)) > 1e-6 * sqrt(sq_sum)) goto fail;
+    // -17 at 0 and 17 at 34 tie; the first wins, in row-major order even
+    // when the array is transposed.
+    if (array_iamax(x) != 0) goto fail;
+    array_transpose(x, perm);
+    if (array_iamax(x) != 0) goto fail;
+    buf_fill_val(x->data + 20 * array_dtype_size(dtype), -30, 1, dtype);
+    if (array_iamax(x) != 6 * 5 + 2) goto fail;
+
+    z = array_alloc(ds, 2, dtype);
+    if (!array_axpy(z, 1, x)) goto fail;
+    if (array_nrm2(z) != 0 || array_asum(z) != 0) goto fail;
+
+    if (dtype == DOUBLE) {
+        // Squares that overflow or underflow take the rescaled path.
+        double vals[] = {1e200, 1e-200, 1e-310};
+        for (int k = 0; k < 3; k++) {
+            array_fill_val(z, vals[k], dtype);
+            double want = vals[k] * sqrt(35.0);
+            if (fabs(array_nrm2(z) - want) > 1e-14 * want) goto fail;
+        }
+    }
+
+    ret = 0;
+
+fail:
+    array_free(x);
+    array_free(y);
+    array_free(z);
+    return ret;
+}
+
+/* An (n, 1) INT64 index array. */
+static arrayObject *
+index_array(const int64_t *vals, int64_t n)
+{
+    int64_t dims[] = {n, 1};
+    arrayObject *idx = array_empty(dims, 2, INT64);
+    if (idx) memcpy(idx->data, vals, n * sizeof(int64_t));
+    return idx;
+}
+
+int
+test_index(ARRAY_DTYPE dtype)
+{
+    arrayObject *a = NULL;
+    arrayObject *idx = NULL;
+    arrayObject *bad = NULL;
+    arrayObject *out = NULL;
+    arrayObject *vals = NULL;
+    arrayObject *mask = NULL;
+    arrayObject *big = NULL;
+    int ret = 1;
+    int perm[] = {1, 0};
+    int64_t ds[] = {4, 5};
+    int64_t one[] = {1, 1};
+    int64_t off;
+
+    a = array_alloc(ds, 2, dtype);
+    buf_fill_linear(a->data, 0, 1, 20, dtype);
+
+    if (array_index(a, 1, 2, &off) || off != 7) goto fail;
+    if (array_index(a, -1, -2, &off) || off != 18) goto fail;
+    if (!array_index(a, 4, 0, &off) || !array_index(a, 0, -6, &off)) goto fail;
+
+    // Flat, row and column gathers, then flat again through a transpose.
+    idx = index_array((int64_t[]){3, -1, 0, 3}, 4);
+    out = array_take(a, idx, -1);
+    if (!out || out->dims[0] != 4 || out->dims[1] != 1) goto fail;
+    if (elem_as_double(out, 0, 0) != 3 || elem_as_double(out, 1, 0) != 19 ||
+        elem_as_double(out, 3, 0) != 3) goto fail;
+    array_free(out);
+    out = array_take(a, idx, 0);
+    if (!out || out->dims[0] != 4 || out->dims[1] != 5) goto fail;
+    if (elem_as_double(out, 1, 4) != 19 || elem_as_double(out, 2, 1) != 1) goto fail;
+    array_free(out);
+    out = array_take(a, idx, 1);
+    if (!out || out->dims[0] != 4 || out->dims[1] != 4) goto fail;
+    if (elem_as_double(out, 2, 0) != 13 || elem_as_double(out, 2, 1) != 14) goto fail;
+    array_free(out);
+    array_transpose(a, perm);
+    out = array_take(a, idx, -1);
+    // Element v of the transpose's flattening is a[v % 4][v / 4].
+    if (!out || elem_as_double(out, 0, 0) != 15 || elem_as_double(out, 1, 0) != 19) goto fail;
+    array_free(out);
+    array_transpose(a, perm);
+    out = NULL;
+
+    // Bad indices leave a untouched.
+    array_free(idx);
+    idx = index_array((int64_t[]){0, 20}, 2);
+    if (array_take(a, idx, -1) != NULL) goto fail;
+    if (!array_check_indices(a, idx, -1) || array_check_indices(a, idx, 0) != 1) goto fail;
+    vals = array_full(one, 2, -1, dtype);
+    if (array_put(a, idx, vals, -1) != 1) goto fail;
+    if (elem_as_double(a, 0, 0) != 0) goto fail;
+    bad = array_full(one, 2, 0, FLOAT);
+    if (dtype != FLOAT && array_take(a, bad, -1) != NULL) goto fail;
+
+    // Scatter a single value over rows, then explicit values over columns.
+    array_free(idx);
+    idx = index_array((int64_t[]){1, 1, -1}, 3);
+    if (array_put(a, idx, vals, 0)) goto fail;
+    for (int j = 0; j < 5; j++) {
+        if (elem_as_double(a, 1, j) != -1 || elem_as_double(a, 3, j) != -1) goto fail;
+    }
+    array_free(vals);
+    vals = array_take(a, idx, 1);
+    if (!vals) goto fail;
+    buf_fill_linear(vals->data, 100, 1, 12, dtype);
+    // Duplicate index 1 takes the later column of vals.
+    if (array_put(a, idx, vals, 1)) goto fail;
+    if (elem_as_double(a, 0, 1) != 101 || elem_as_double(a, 2, 4) != 108) goto fail;
+    if (elem_as_double(a, 0, 0) != 0 || elem_as_double(a, 2, 0) != 10) goto fail;
+
+    // Swapping rows through a put from a itself reads a before writing it.
+    array_free(idx);
+    idx = index_array((int64_t[]){3, 2, 1, 0}, 4);
+    buf_fill_linear(a->data, 0, 1, 20, dtype);
+    if (array_put(a, idx, a, 0)) goto fail;
+    if (elem_as_double(a, 0, 0) != 15 || elem_as_double(a, 1, 4) != 14 ||
+        elem_as_double(a, 3, 2) != 2) goto fail;
+
+    // Masks select the even elements.
+    buf_fill_linear(a->data, 0, 1, 20, dtype);
+    mask = array_alloc(ds, 2, dtype);
+    for (int k = 0; k < 20; k += 2) buf_fill_val(mask->data + k * array_dtype_size(dtype), 1, 1, dtype);
+    out = array_extract(a, mask);
+    if (!out || out->dims[0] != 10 || elem_as_double(out, 9, 0) != 18) goto fail;
+    array_free(vals);
+    vals = array_full(ds, 2, 7, dtype);
+    if (array_putmask(a, mask, vals)) goto fail;
+    if (elem_as_double(a, 0, 0) != 7 || elem_as_double(a, 0, 1) != 1) goto fail;
+    array_transpose(mask, perm);
+    if (array_extract(a, mask) != NULL) goto fail;
+
+    // Enough lookups to split the gather across threads.
+    array_free(idx);
+    int64_t n = 1 << 21;
+    int64_t big_dims[] = {n, 1};
+    idx = array_empty(big_dims, 2, INT64);
+    for (int64_t k = 0; k < n; k++) ((int64_t *)idx->data)[k] = (k * 7919) % 20;
+    big = array_take(a, idx, -1);
+    if (!big) goto fail;
+    buf_fill_linear(a->data, 0, 1, 20, dtype);
+    array_free(big);
+    big = array_take(a, idx, -1);
+    for (int64_t k = 0; k < n; k += 4099) {
+        if (elem_as_double(big, k, 0) != (k * 7919) % 20) goto fail;
+    }
+
+    ret = 0;
+
+fail:
+    array_free(a);
+    array_free(idx);
+    array_free(bad);
+    array_free(out);
+    array_free(vals);
+    array_free(mask);
+    array_free(big);
+    return ret;
+}
+
+static int
+cmp_double(const void *x, const void *y)
+{
+    double a = *(const double *)x, b = *(const double *)y;
+    return a < b ? -1 : a > b;
+}
+
+/* Lane l of a along axis, sorted with qsort into buf. */
+static void
+ref_sorted_lane(const arrayObject *a, int axis, int64_t l, double *buf)
+{
+    int64_t n = a->dims[axis];
+    for (int64_t m = 0; m < n; m++) {
+        buf[m] = axis == 1 ? elem_as_double(a, l, m) : elem_as_double(a, m, l);
+    }
+    qsort(buf, n, sizeof(double), cmp_double);
+}
+
+static double
+lane_elem(const arrayObject *a, int axis, int64_t l, int64_t m)
+{
+    return axis == 1 ? elem_as_double(a, l, m) : elem_as_double(a, m, l);
+}
+
+int
+test_sort(ARRAY_DTYPE dtype)
+{
+    arrayObject *a = NULL;
+    arrayObject *s = NULL;
+    arrayObject *idx = NULL;
+    arrayObject *vals = NULL;
+    arrayObject *big = NULL;
+    arrayObject *e = NULL;
+    int ret = 1;
+    int threads = parallel_num_threads();
+    int perm[] = {1, 0};
+    int64_t ds[] = {6, 9};
+    double ref[64];
+
+    a = array_alloc(ds, 2, dtype);
+    for (int k = 0; k < 54; k++) {
+        buf_fill_val(a->data + k * array_dtype_size(dtype), (k * 37 + 11) % 23 - 11, 1, dtype);
+    }
+
+    // Rows, then columns of the transpose, against qsort.
+    for (int t = 0; t < 2; t++) {
+        for (int axis = 0; axis < 2; axis++) {
+            s = array_sort(a, axis, NULL);
+            if (!s || s->dims[0] != a->dims[0] || s->dims[1] != a->dims[1]) goto fail;
+            for (int64_t l = 0; l < a->dims[1 - axis]; l++) {
+                ref_sorted_lane(a, axis, l, ref);
+                for (int64_t m = 0; m < a->dims[axis]; m++) {
+                    if (lane_elem(s, axis, l, m) != ref[m]) goto fail;
+                }
+            }
+            array_free(s);
+            s = NULL;
+
+            // Positions are stable: ties keep their order.
+            idx = array_argsort(a, axis);
+            if (!idx || idx->dtype != INT64) goto fail;
+            for (int64_t l = 0; l < a->dims[1 - axis]; l++) {
+                for (int64_t m = 1; m < a->dims[axis]; m++) {
+                    int64_t p = lane_elem(idx, axis, l, m - 1), q = lane_elem(idx, axis, l, m);
+                    double x = lane_elem(a, axis, l, p), y = lane_elem(a, axis, l, q);
+                    if (x > y || (x == y && p > q)) goto fail;
+                }
+            }
+            array_free(idx);
+            idx = NULL;
+        }
+        array_transpose(a, perm);
+    }
+
+    // Flattened, and in place along rows.
+    s = array_sort(a, -1, NULL);
+    if (!s || s->dims[0] != 54 || s->dims[1] != 1) goto fail;
+    if (elem_as_double(s, 0, 0) != -11 || elem_as_double(s, 53, 0) != 11) goto fail;
+    if (array_sort(a, 1, s) != NULL) goto fail;
+    if (array_sort(a, 1, a) != a) goto fail;
+    for (int64_t i = 0; i < 6; i++) {
+        for (int64_t j = 1; j < 9; j++) {
+            if (elem_as_double(a, i, j - 1) > elem_as_double(a, i, j)) goto fail;
+        }
+    }
+
+    // Partition and top-k along columns.
+    for (int k = 0; k < 54; k++) {
+        buf_fill_val(a->data + k * array_dtype_size(dtype), (k * 37 + 11) % 23 - 11, 1, dtype);
+    }
+    array_free(s);
+    s = array_partition(a, -2, 0, NULL);
+    if (!s) goto fail;
+    for (int64_t l = 0; l < 9; l++) {
+        ref_sorted_lane(a, 0, l, ref);
+        if (elem_as_double(s, 4, l) != ref[4]) goto fail;
+        for (int64_t m = 0; m < 6; m++) {
+            double x = elem_as_double(s, m, l);
+            if ((m < 4 && x > ref[4]) || (m > 4 && x < ref[4])) goto fail;
+        }
+    }
+    if (array_partition(a, 6, 0, NULL) != NULL) goto fail;
+
+    for (int largest = 0; largest < 2; largest++) {
+        if (array_topk(a, 4, 1, largest, &vals, &idx)) goto fail;
+        if (vals->dims[0] != 6 || vals->dims[1] != 4) goto fail;
+        for (int64_t l = 0; l < 6; l++) {
+            ref_sorted_lane(a, 1, l, ref);
+            for (int64_t m = 0; m < 4; m++) {
+                double want = largest ? ref[8 - m] : ref[m];
+                int64_t p = elem_as_double(idx, l, m);
+                if (elem_as_double(vals, l, m) != want || elem_as_double(a, l, p) != want) goto fail;
+                if (m && elem_as_double(vals, l, m - 1) == want &&
+                    elem_as_double(idx, l, m - 1) > p) goto fail;
+            }
+        }
+        array_free(vals);
+        array_free(idx);
+        vals = idx = NULL;
+    }
+    if (!array_topk(a, 10, 1, 1, &vals, &idx)) goto fail;
+
+    if (dtype == FLOAT || dtype == DOUBLE) {
+        // NaNs of either sign go last, and -0.0 before 0.0.
+        double specials[] = {NAN, -0.0, -INFINITY, 0.0, -NAN, INFINITY, -1};
+        int64_t sd[] = {1, 7};
+        array_free(s);
+        s = array_alloc(sd, 2, dtype);
+        for (int k = 0; k < 7; k++) {
+            buf_fill_val(s->data + k * array_dtype_size(dtype), specials[k], 1, dtype);
+        }
+        array_sort(s, 1, s);
+        if (elem_as_double(s, 0, 0) != -INFINITY || elem_as_double(s, 0, 1) != -1 ||
+            !signbit(elem_as_double(s, 0, 2)) || signbit(elem_as_double(s, 0, 3)) ||
+            elem_as_double(s, 0, 4) != INFINITY || !isnan(elem_as_double(s, 0, 5)) ||
+            !isnan(elem_as_double(s, 0, 6))) goto fail;
+    }
+
+    // Empty lanes, and no lanes at all, give empty results.
+    int64_t ed[] = {5, 0};
+    e = array_alloc(ed, 2, dtype);
+    array_free(s);
+    s = array_sort(e, 1, NULL);
+    if (!s || s->dims[0] != 5 || s->dims[1] != 0) goto fail;
+    if (array_sort(e, 1, e) != e) goto fail;
+    array_free(s);
+    s = array_sort(e, -1, NULL);
+    if (!s || s->dims[0] != 0 || s->dims[1] != 1) goto fail;
+    array_free(s);
+    s = array_partition(e, 2, 0, NULL);
+    if (!s || s->dims[0] != 5 || s->dims[1] != 0) goto fail;
+    if (array_partition(e, 0, 1, NULL) != NULL) goto fail;
+    array_free(idx);
+    idx = array_argsort(e, 1);
+    if (!idx || idx->dims[0] != 5 || idx->dims[1] != 0) goto fail;
+    array_free(idx);
+    if (array_topk(e, 2, 0, 1, &vals, &idx)) goto fail;
+    if (vals->dims[0] != 2 || vals->dims[1] != 0 || idx->dims[1] != 0) goto fail;
+    array_free(vals);
+    vals = NULL;
+    array_free(e);
+    ed[0] = 0;
+    e = array_alloc(ed, 2, dtype);
+    array_free(idx);
+    idx = array_argsort(e, -1);
+    if (!idx || idx->dims[0] != 0 || idx->dims[1] != 1) goto fail;
+
+    // Long enough to split each radix pass across threads.
+    parallel_set_num_threads(4);
+    int64_t n = 1 << 18;
+    int64_t big_dims[] = {n, 1};
+    big = array_alloc(big_dims, 2, dtype);
+    uint64_t x = 12345;
+    for (int64_t k = 0; k < n; k++) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        buf_fill_val(big->data + k * array_dtype_size(dtype), (int64_t)(x >> 44) - (1 << 19),
+                     1, dtype);
+    }
+    array_free(s);
+    array_free(idx);
+    idx = NULL;
+    s = array_sort(big, 0, NULL);
+    idx = array_argsort(big, -1);
+    if (!s || !idx) goto fail;
+    for (int64_t k = 1; k < n; k++) {
+        int64_t p = elem_as_double(idx, k - 1, 0), q = elem_as_double(idx, k, 0);
+        double v = elem_as_double(big, p, 0), w = elem_as_double(big, q, 0);
+        if (elem_as_double(s, k - 1, 0) > elem_as_double(s, k, 0)) goto fail;
+        if (v != elem_as_double(s, k - 1, 0) || v > w || (v == w && p > q)) goto fail;
+    }
+
+    ret = 0;
+
+fail:
+    parallel_set_num_threads(threads);
+    array_free(a);
+    array_free(s);
+    array_free(idx);
+    array_free(vals);
+    array_free(big);
+    array_free(e);
+    return ret;
+}
+
+static double
+nrm2_fixed(const char *x, int64_t rows, int64_t cols, int64_t rs, int64_t cs)
+{
+    (void)x;
+    (void)rows;
+    (void)cols;
+    (void)rs;
+    (void)cs;
+    return 42;
+}
+
+static arrayBackend test_backend_fixed = {"fixed", {
+    [KERNEL_NRM2] = {(kernelFunc)nrm2_fixed, (kernelFunc)nrm2_fixed,
+                     (kernelFunc)nrm2_fixed, (kernelFunc)nrm2_fixed},
+}};
+
+/* a . b under the given selection, compared elementwise against want. */
+static int
+dot_matches(const char *spec, arrayObject *a, arrayObject *b, const arrayObject *want)
+{
+    if (array_backend_set(spec)) return 0;
+    arrayObject *d = array_dot(a, b);
+    int ok = d != NULL;
+    for (int64_t i = 0; ok && i < want->dims[0]; i++) {
+        for (int64_t j = 0; ok && j < want->dims[1]; j++) {
+            ok = elem_as_double(d, i, j) == elem_as_double(want, i, j);
+        }
+    }
+    array_free(d);
+    return ok;
+}
+
+int
+test_backend(ARRAY_DTYPE dtype)
+{
+    arrayObject *a = NULL;
+    arrayObject *b = NULL;
+    arrayObject *want = NULL;
+    char saved[ARRAY_BACKEND_SPEC_LEN];
+    char spec[ARRAY_BACKEND_SPEC_LEN];
+    const char *names[ARRAY_MAX_BACKENDS];
+    int ret = 1;
+    int perm[] = {1, 0};
+    int64_t ds_a[] = {70, 40};
+    int64_t ds_b[] = {50, 40};
+
+    array_backend_get(saved);
+    // Registered by the first dtype's run; later runs see the name taken.
+    if (array_backend_register(&test_backend_fixed) == (dtype == ARRAY_DTYPES[0])) goto fail;
+
+    a = array_alloc(ds_a, 2, dtype);
+    b = array_alloc(ds_b, 2, dtype);
+    for (int64_t i = 0; i < 70 * 40; i++) {
+        buf_fill_val(a->data + i * array_dtype_size(dtype), i % 13 - 6, 1, dtype);
+    }
+    for (int64_t i = 0; i < 50 * 40; i++) {
+        buf_fill_val(b->data + i * array_dtype_size(dtype), i % 7 - 3, 1, dtype);
+    }
+    // b is used transposed, so gemm sees a column-major operand.
+    array_transpose(b, perm);
+
+    // Small integers keep every product exact, so all backends agree.
+    if (array_backend_set("reference")) goto fail;
+    if (strcmp(array_backend_serving(KERNEL_GEMM, dtype), "reference")) goto fail;
+    want = array_dot(a, b);
+    if (want == NULL) goto fail;
+    if (!dot_matches("simd", a, b, want)) goto fail;
+    if (!dot_matches("threaded", a, b, want)) goto fail;
+    if (!dot_matches("gemm=reference,threaded", a, b, want)) goto fail;
+
+    // Slots the listed backends leave empty fall back to simd.
+    if (array_backend_set("threaded")) goto fail;
+    if (strcmp(array_backend_serving(KERNEL_GEMM, dtype), "threaded")) goto fail;
+    if (strcmp(array_backend_serving(KERNEL_NRM2, dtype), "simd")) goto fail;
+    double norm = array_nrm2(a);
+    if (array_backend_set("fixed,reference")) goto fail;
+    if (array_nrm2(a) != 42) goto fail;
+    if (strcmp(array_backend_serving(KERNEL_ASUM, dtype), "reference")) goto fail;
+    if (array_backend_set("nrm2=reference,fixed")) goto fail;
+    if (strcmp(array_backend_serving(KERNEL_NRM2, dtype), "reference")) goto fail;
+    if (fabs(array_nrm2(a) - norm) > 1e-6 * norm) goto fail;
+
+    // Invalid selections leave the current one alone.
+    if (!array_backend_set("nope") || !array_backend_set("simd,nrm3=reference") ||
+        !array_backend_set("nrm2=nope")) goto fail;
+    array_backend_get(spec);
+    if (strcmp(spec, "nrm2=reference,fixed")) goto fail;
+
+    int n = array_backend_list(names);
+    for (int i = 0; i < n; i++) {
+        if (strcmp(names[i], "blas")) continue;
+        if (!array_backend_set("blas")) {
+            // Only float and double are served; the rest stays simd.
+            int real = dtype == FLOAT || dtype == DOUBLE;
+            const char *serving = array_backend_serving(KERNEL_GEMM, dtype);
+            if (strcmp(serving, real ? "blas" : "simd")) goto fail;
+            if (!dot_matches("blas", a, b, want)) goto fail;
+        }
+    }
+    ret = 0;
+
+fail:
+    array_backend_set(saved);
+    array_free(a);
+    array_free(b);
+    array_free(want);
+    return ret;
+}
+
+static int
+blocking_equal(const gemmBlocking *a, const gemmBlocking *b)
+{
+    return a->mc == b->mc && a->kc == b->kc && a->nc == b->nc && a->panel == b->panel;
+}
+
+typedef struct blockingFlipCtx {
+    ARRAY_DTYPE dtype;
+    gemmBlocking blk[2];
+    int stop;
+} blockingFlipCtx;
+
+static void *
+flip_blocking(void *arg)
+{
+    blockingFlipCtx *ctx = arg;
+    for (int i = 0; !__atomic_load_n(&ctx->stop, __ATOMIC_RELAXED); i ^= 1) {
+        gemm_set_shape_blocking(ctx->dtype, GEMM_SHAPE_SMALL, &ctx->blk[i]);
+    }
+    return NULL;
+}
+
+int
+test_tune(ARRAY_DTYPE dtype)
+{
+    char dir[64];
+    char path[96];
+    char key[256];
+    char line[512];
+    gemmBlocking saved[NUM_GEMM_SHAPES];
+    gemmBlocking best, got;
+    gemmBlocking bad = {64, 0, 64, 0};
+    gemmBlocking odd = {40, 48, 56, 8};
+    FILE *f = NULL;
+    int ret = 1;
+    int foreign = 0, ours = 0;
+
+    if (gemm_shape(8, 8, 8) != GEMM_SHAPE_SMALL) return 1;
+    if (gemm_shape(4, 4096, 4096) != GEMM_SHAPE_SKINNY) return 1;
+    if (gemm_shape(4096, 4, 4096) != GEMM_SHAPE_SKINNY) return 1;
+    if (gemm_shape(512, 512, 512) != GEMM_SHAPE_LARGE) return 1;
+
+    for (int s = 0; s < NUM_GEMM_SHAPES; s++) {
+        gemm_get_shape_blocking(dtype, s, &saved[s]);
+    }
+    snprintf(dir, sizeof(dir), "/tmp/minumpy_tune_%ld_%d", (long)getpid(), dtype);
+    snprintf(path, sizeof(path), "%s/cache", dir);
+
+    if (!gemm_set_shape_blocking(dtype, GEMM_SHAPE_SMALL, &bad)) goto fail;
+    if (gemm_tune(dtype, GEMM_SHAPE_SMALL, &best)) goto fail;
+    gemm_get_shape_blocking(dtype, GEMM_SHAPE_SMALL, &got);
+    if (!blocking_equal(&best, &got) || best.mc <= 0 || best.kc <= 0 || best.nc <= 0) goto fail;
+
+    // Saving keeps another machine's entry; the parent directory is created.
+    gemm_tune_machine(key, sizeof(key));
+    mkdir(dir, 0755);
+    f = fopen(path, "w");
+    if (f == NULL) goto fail;
+    fprintf(f, "other cpu;threads=1\t%s\tlarge\t8 8 8 0\n", ARRAY_DTYPE_NAMES[dtype]);
+    fclose(f);
+    if (gemm_tune_save(path)) goto fail;
+    f = fopen(path, "r");
+    if (f == NULL) goto fail;
+    while (fgets(line, sizeof(line), f)) {
+        foreign += !strncmp(line, "other cpu;", 10);
+        ours += !strncmp(line, key, strlen(key)) && line[strlen(key)] == '\t';
+    }
+    fclose(f);
+    if (foreign != 1 || ours < 1) goto fail;
+
+    // Loading installs only this machine's entries.
+    if (gemm_set_shape_blocking(dtype, GEMM_SHAPE_SMALL, &odd)) goto fail;
+    if (gemm_tune_load(path) < 1) goto fail;
+    gemm_get_shape_blocking(dtype, GEMM_SHAPE_SMALL, &got);
+    if (!blocking_equal(&best, &got)) goto fail;
+    gemm_get_shape_blocking(dtype, GEMM_SHAPE_LARGE, &got);
+    if (!blocking_equal(&saved[GEMM_SHAPE_LARGE], &got)) goto fail;
+
+    // Lock-free reads racing a setter see one whole blocking or the other.
+    blockingFlipCtx flip = {dtype, {best, odd}, 0};
+    pthread_t writer;
+    int torn = 0;
+    if (pthread_create(&writer, NULL, flip_blocking, &flip)) goto fail;
+    for (int i = 0; i < 100000; i++) {
+        gemm_blocking_for(dtype, GEMM_SHAPE_SMALL, &got);
+        torn += !blocking_equal(&got, &best) && !blocking_equal(&got, &odd);
+    }
+    __atomic_store_n(&flip.stop, 1, __ATOMIC_RELAXED);
+    pthread_join(writer, NULL);
+    if (torn) goto fail;
+
+    ret = 0;
+
+fail:
+    for (int s = 0; s < NUM_GEMM_SHAPES; s++) {
+        gemm_set_shape_blocking(dtype, s, &saved[s]);
+    }
+    unlink(path);
+    rmdir(dir);
+    return ret;
+}
+
+int
+test_memory_policy(ARRAY_DTYPE dtype)
+{
+    arrayObject *a = NULL;
+    arrayObject *b = NULL;
+    arrayMemPolicy saved;
+    arrayMemPolicy p;
+    int ret = 1;
+    int64_t big[] = {1100, 1000};
+    int64_t small[] = {4, 5};
+
+    array_mem_get_policy(&saved);
+    p = saved;
+    p.mmap_threshold = 1 << 16;
+    p.hugepages = 1;
+    p.numa = MEM_NUMA_LOCAL;
+    if (array_mem_set_policy(&p)) goto fail;
+
+    // Mapped, zeroed, and filled in parallel past FILL_PARALLEL_MIN_ELEMS.
+    a = array_alloc(big, 2, dtype);
+    if (!array_data_is_mapped(a->data) || !all_equal(a, 0)) goto fail;
+    if ((uintptr_t)a->data % 64) goto fail;
+    array_fill_val(a, 3, dtype);
+    if (!all_equal(a, 3)) goto fail;
+    b = array_alloc(small, 2, dtype);
+    if (array_data_is_mapped(b->data)) goto fail;
+    array_free(b);
+
+    // zeros skips first touch: the last page is not resident until read.
+    b = array_zeros(big, 2, dtype);
+    if (!array_data_is_mapped(b->data)) goto fail;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t last = ((uintptr_t)b->data + NUM_ARRAY_ELEMS(b) * array_dtype_size(dtype) - 1)
+        & ~(uintptr_t)(page - 1);
+    unsigned char resident = 1;
+    if (mincore((void *)last, page, &resident) || (resident & 1)) goto fail;
+    if (!all_equal(b, 0)) goto fail;
+    array_free(b);
+
+    // Per-array policy overrides the global one.
+    arrayMemPolicy heap = p;
+    heap.mmap_threshold = SIZE_MAX;
+    b = array_alloc_policy(big, 2, dtype, &heap);
+    if (array_data_is_mapped(b->data) || !all_equal(b, 0)) goto fail;
+    array_free(b);
+
+    p.numa = MEM_NUMA_INTERLEAVE;
+    p.hugepages = 0;
+    p.first_touch = 0;
+    b = array_alloc_policy(big, 2, dtype, &p);
+    if (!array_data_is_mapped(b->data) || !all_equal(b, 0)) goto fail;
+    array_free(b);
+    b = NULL;
+
+    p.numa = MEM_NUMA_BIND;
+    p.node = -1;
+    if (!array_mem_set_policy(&p)) goto fail;
+    p.node = 1 << 20;
+    if (!array_mem_set_policy(&p)) goto fail;
+    p.numa = NUM_MEM_NUMA_MODES;
+    if (!array_mem_set_policy(&p)) goto fail;
+
+    ret = 0;
+
+fail:
+    array_mem_set_policy(&saved);
+    array_free(a);
+    array_free(b);
+    return ret;
+}
+
+int
+test_large(ARRAY_DTYPE dtype)
+{
+    int ret = 0;
+    int64_t n;
+
+    // Shapes whose element or byte count overflows are refused up front.
+    int64_t ds_huge[] = {(int64_t)1 << 40, (int64_t)1 << 40};
+    int64_t ds_neg[] = {-1, 3};
+    int64_t ds_ok[] = {(int64_t)1 << 31, 4};
+    if (array_alloc(ds_huge, 2, dtype) || array_alloc(ds_neg, 2, dtype)) ret = 1;
+    if (!prod_checked(ds_huge, 2, &n) || !prod_checked(ds_neg, 2, &n)) ret = 1;
+    if (prod_checked(ds_ok, 2, &n) || n != (int64_t)1 << 33) ret = 1;
+    if (array_data_alloc(SIZE_MAX / 2, dtype, 0)) ret = 1;
+
+    // More than 2^31 elements: the flat argmax index and, where the dtype
+    // holds it exactly, the sum. Skipped when the buffer cannot be backed.
+    int64_t ds_big[] = {((int64_t)1 << 31) + 16};
+    arrayObject *a = array_alloc(ds_big, 1, dtype);
+    if (a == NULL) return ret;
+    n = ds_big[0];
+    array_fill_val(a, 1, dtype);
+    buf_fill_val(a->data + (n - 1) * array_dtype_size(dtype), 2, 1, dtype);
+    arrayObject *sum = array_sum(a, 0);
+    arrayObject *arg = array_reduce(a, REDUCE_ARGMAX, 3, 0);
+    if (a->dims[0] != n || *(int64_t *)arg->data != n - 1) ret = 1;
+    if (dtype == INT64 && *(int64_t *)sum->data != n + 1) ret = 1;
+    if (dtype == DOUBLE && *(double *)sum->data != (double)(n + 1)) ret = 1;
+    array_free(sum);
+    array_free(arg);
+    array_free(a);
+    return ret;
+}
+
 static void
 run_test(int (*test)(ARRAY_DTYPE), char *test_name)
 {
@@ -492,10 +2060,30 @@ run_test(int (*test)(ARRAY_DTYPE), char *test_name)
 int main() {
     run_test(test_instantiation, "instantiation");
     run_test(test_fill, "fill");
+    run_test(test_constructors, "constructors");
     run_test(test_copy, "copy");
+    run_test(test_copy_order, "copy_order");
     run_test(test_transpose, "transpose");
     run_test(test_sum, "sum");
+    run_test(test_reduce, "reduce");
+    run_test(test_scan, "scan");
+    run_test(test_unary, "unary");
+    run_test(test_blas1, "blas1");
+    run_test(test_index, "index");
+    run_test(test_sort, "sort");
+    run_test(test_backend, "backend");
+    run_test(test_parallel, "parallel");
     run_test(test_dot, "dot");
+    run_test(test_dot_transposed, "dot_transposed");
+    run_test(test_tune, "tune");
+    run_test(test_graph, "graph");
+    run_test(test_sparse, "sparse");
+    run_test(test_str, "str");
+    run_test(test_stats, "stats");
+    run_test(test_trace, "trace");
+    run_test(test_memory, "memory");
+    run_test(test_memory_policy, "memory_policy");
+    run_test(test_large, "large");
 
     return 0;
 }
@@ -1,19 +1,211 @@
-import time
+"""Python-level benchmarks for minumpy, optionally side by side with NumPy.
+
+Each op is timed through three layers so that binding overhead can be told
+apart from kernel time:
+
+* ``wrapper``: the public ``minumpy`` function from ``__init__.py``.
+* ``method``: the ``minarray`` C method called directly, i.e. argument
+  parsing plus the C kernel.
+* ``call``: the same method on a 1x1 array, which approximates the fixed
+  Python-to-C crossing cost.
+
+``wrapper - method`` is the cost of the ``__init__.py`` layer and
+``method - call`` estimates the time spent in the C kernel itself. Small
+sizes therefore measure per-call overhead and large sizes throughput.
+"""
+import argparse
+import json
+import statistics
+import timeit
 
 import minumpy as np
+from minarray import array as _array
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+SMALL_SIZES = [1, 8, 32]
+LARGE_SIZES = [128, 512]
+DOT_MAX_SIZE = 256
+
+
+def _time_per_call(fn, min_time=0.02, repeat=5):
+    timer = timeit.Timer(fn)
+    number = 1
+    while True:
+        t = timer.timeit(number)
+        if t >= min_time:
+            break
+        number *= 10 if t < min_time / 10 else 2
+    runs = timer.repeat(repeat=repeat, number=number)
+    return statistics.median(runs) / number
+
+
+def _numpy_dtype(dtype):
+    return {np.int32: "int32", np.int64: "int64",
+            np.float: "float32", np.double: "float64"}[dtype]
+
+
+def _lists(n, m):
+    return [[(i * m + j) % 7 for j in range(m)] for i in range(n)]
+
+
+class Case(object):
+    """Builds the callables for one op at one size and dtype."""
+
+    def __init__(self, name, n, dtype):
+        self.name = name
+        self.n = n
+        self.dtype = dtype
+
+    def callables(self, n):
+        """Returns (wrapper, method, numpy_or_None, elements) for size n."""
+        dtype = self.dtype
+        vals = _lists(n, n)
+        a = np.array(vals, dtype=dtype)
+        b = np.array(vals, dtype=dtype)
+        x = y = None
+        if numpy is not None:
+            x = numpy.array(vals, dtype=_numpy_dtype(dtype))
+            y = numpy.array(vals, dtype=_numpy_dtype(dtype))
+        template = _array(None, shape=(n, n), dtype=dtype)
+        perm = (1, 0)
+
+        ops = {
+            "array": (
+                lambda: np.array(vals, dtype=dtype),
+                lambda: _array(vals, dtype=dtype),
+                x is not None and (lambda: numpy.array(vals, dtype=x.dtype))),
+            "ravel": (
+                lambda: np.ravel(a),
+                lambda: a.ravel(),
+                x is not None and (lambda: x.ravel().tolist())),
+            "transpose": (
+                lambda: np.transpose(a, perm),
+                lambda: a.transpose(perm),
+                x is not None and (lambda: x.transpose(perm))),
+            "sum0": (
+                lambda: np.sum(a, 0),
+                lambda: a.sum(0),
+                x is not None and (lambda: x.sum(0))),
+            "sum1": (
+                lambda: np.sum(a, 1),
+                lambda: a.sum(1),
+                x is not None and (lambda: x.sum(1))),
+            "dot": (
+                lambda: np.dot(a, b),
+                lambda: a.dot(b),
+                x is not None and (lambda: x.dot(y))),
+            "axpy": (
+                lambda: np.axpy(1, b, a),
+                lambda: a.axpy(1, b),
+                x is not None and (lambda: numpy.add(x, y, out=x))),
+            "scal": (
+                lambda: np.scal(1, a),
+                lambda: a.scal(1),
+                x is not None and (lambda: numpy.multiply(x, 1, out=x))),
+            "asum": (
+                lambda: np.asum(a),
+                lambda: a.asum(),
+                x is not None and (lambda: numpy.abs(x).sum())),
+            "nrm2": (
+                lambda: np.nrm2(a),
+                lambda: a.nrm2(),
+                x is not None and (lambda: numpy.linalg.norm(x))),
+            "iamax": (
+                lambda: np.iamax(a),
+                lambda: a.iamax(),
+                x is not None and (lambda: numpy.abs(x).argmax())),
+            "ones": (
+                lambda: np.ones(shape=(n, n), dtype=dtype),
+                lambda: template.ones(),
+                x is not None and (lambda: numpy.ones((n, n), dtype=x.dtype))),
+            "randint": (
+                lambda: np.randint(0, 9, shape=(n, n), dtype=dtype),
+                lambda: template.randint(0, 9),
+                x is not None and (lambda: numpy.random.randint(
+                    0, 10, size=(n, n)).astype(x.dtype))),
+        }
+        wrapper, method, ref = ops[self.name]
+        return wrapper, method, ref or None, n * n
+
+    def run(self):
+        wrapper, method, ref, elems = self.callables(self.n)
+        _, call, _, _ = self.callables(1)
+        t_wrapper = _time_per_call(wrapper)
+        t_method = _time_per_call(method)
+        t_call = _time_per_call(call)
+        t_numpy = _time_per_call(ref) if ref else None
+        return {
+            "op": self.name,
+            "dtype": _numpy_dtype(self.dtype),
+            "shape": [self.n, self.n],
+            "wrapper_us": t_wrapper * 1e6,
+            "method_us": t_method * 1e6,
+            "wrapper_overhead_us": (t_wrapper - t_method) * 1e6,
+            "call_overhead_us": t_call * 1e6,
+            "kernel_us": max(t_method - t_call, 0) * 1e6,
+            "melems_per_s": elems / t_method * 1e-6,
+            "numpy_us": t_numpy * 1e6 if t_numpy else None,
+            "vs_numpy": t_wrapper / t_numpy if t_numpy else None,
+        }
+
+
+OPS = ["array", "ravel", "transpose", "sum0", "sum1", "dot", "axpy", "scal",
+       "asum", "nrm2", "iamax", "ones", "randint"]
+COLUMNS = [("wrapper_us", "wrapper us"), ("method_us", "method us"),
+           ("wrapper_overhead_us", "init.py us"),
+           ("call_overhead_us", "call us"), ("kernel_us", "kernel us"),
+           ("melems_per_s", "Melem/s"), ("numpy_us", "numpy us"),
+           ("vs_numpy", "vs numpy")]
+
+
+def _format_row(r):
+    cells = ["{:<10}".format(r["op"]), "{:<8}".format(r["dtype"]),
+             "{:>10}".format("{}x{}".format(*r["shape"]))]
+    for c, _ in COLUMNS:
+        v = r[c]
+        cells.append("{:>12}".format("-" if v is None else "{:.3f}".format(v)))
+    return " ".join(cells)
+
 
+def benchmark(ops=None, sizes=None, dtypes=None, as_json=False):
+    ops = ops or OPS
+    sizes = sizes or SMALL_SIZES + LARGE_SIZES
+    dtypes = dtypes or [np.int64, np.double]
 
-def benchmark():
-    N = 512
-    a = np.randint(shape=(N, N))
-    b = np.randint(shape=(N, N))
+    results = []
+    if not as_json:
+        print(" ".join(["{:<10}".format("op"), "{:<8}".format("dtype"),
+                        "{:>10}".format("shape")] +
+                       ["{:>12}".format(h) for _, h in COLUMNS]))
+    for op in ops:
+        for dtype in dtypes:
+            for n in sizes:
+                if op == "dot" and n > DOT_MAX_SIZE:
+                    continue
+                r = Case(op, n, dtype).run()
+                results.append(r)
+                if not as_json:
+                    print(_format_row(r))
+    if as_json:
+        print(json.dumps(results, indent=2))
+    return results
 
-    start = time.time()
-    c = np.dot(a, b)
-    end = time.time()
 
-    print("elapsed time", end - start, np.sum(np.sum(c, 1), 0))
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--ops", nargs="+", choices=OPS)
+    parser.add_argument("--sizes", nargs="+", type=int)
+    parser.add_argument("--dtypes", nargs="+",
+                        choices=["int32", "int64", "float", "double"])
+    parser.add_argument("--json", action="store_true")
+    args = parser.parse_args()
+    dtypes = [getattr(np, d) for d in args.dtypes] if args.dtypes else None
+    benchmark(args.ops, args.sizes, dtypes, args.json)
 
 
 if __name__ == "__main__":
-    benchmark()
+    main()
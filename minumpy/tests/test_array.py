@@ -1,3 +1,15 @@
+import asyncio
+import builtins
+import concurrent.futures
+import json
+import math
+import os
+import struct
+import subprocess
+import sys
+import threading
+import tracemalloc
+
 import pytest
 from pytest import raises as assert_raises
 
@@ -110,6 +122,91 @@ def test_sum(dtype):
     assert_raises(ValueError, np.array([1, 1]).sum, 2)
 
 
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_reductions(dtype):
+    a = np.array([[3, 1, 5, 2],
+                  [4, 9, 1, 0],
+                  [0, 2, 7, 1]], dtype=dtype)
+    assert np.max(a) == 9 and np.min(a) == 0
+    assert np.argmax(a) == 5 and np.argmin(a) == 7
+    assert np.prod(np.array([[1, 2], [3, 4]], dtype=dtype)) == 24
+    assert abs(np.mean(a) - 35 / 12) < 1e-6
+    assert_sequences_equal(np.max(a, axis=0).ravel(), [4, 9, 7, 2])
+    assert_sequences_equal(np.min(a, axis=-1).ravel(), [1, 0, 0])
+    assert_sequences_equal(np.argmax(a, axis=0).ravel(), [1, 1, 2, 0])
+    assert_sequences_equal(np.argmin(a, axis=1).ravel(), [1, 3, 0])
+    assert_sequences_equal(np.mean(a, axis=1).ravel(), [2.75, 3.5, 2.5])
+
+    m = np.max(a, axis=0, keepdims=True)
+    assert m.dims == (1, 4)
+    assert np.sum(a, axis=(0, 1), keepdims=True).dims == (1, 1)
+    assert np.sum(a, axis=(0, 1)).ravel() == [35]
+
+    np.transpose(a, (1, 0))
+    assert_sequences_equal(np.max(a, axis=1).ravel(), [4, 9, 7, 2])
+    assert_sequences_equal(np.argmax(a, axis=0).ravel(), [2, 1, 2])
+    assert np.argmax(a) == 4
+
+    with pytest.raises(ValueError):
+        np.max(a, axis=(0, 0))
+    with pytest.raises(ValueError):
+        np.max(a, axis=2)
+
+
+@pytest.mark.parametrize('dtype', [np.float, np.double])
+def test_nan_reductions(dtype):
+    nan = builtins.float("nan")
+    a = np.array([[1.0, nan, 3.0],
+                  [4.0, 5.0, nan]], dtype=dtype)
+    assert math.isnan(np.max(a)) and math.isnan(np.sum(a, axis=None))
+    assert np.argmax(a) == 1
+    assert np.nanmax(a) == 5 and np.nanmin(a) == 1
+    assert np.nansum(a) == 13 and np.nanmean(a) == 13 / 4
+    assert_sequences_equal(np.nanmax(a, axis=0).ravel(), [4, 5, 3])
+    assert_sequences_equal(np.nanmean(a, axis=1).ravel(), [2, 4.5])
+    assert math.isnan(np.nanmax(np.array([nan, nan], dtype=dtype)))
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_scans(dtype):
+    a = np.array([[1, 2, 3],
+                  [4, 5, 6]], dtype=dtype)
+    assert_sequences_equal(np.cumsum(a).ravel(), [1, 3, 6, 10, 15, 21])
+    assert np.cumsum(a).dims == (6, 1)
+    assert_sequences_equal(np.cumsum(a, axis=0).ravel(), [1, 2, 3, 5, 7, 9])
+    assert_sequences_equal(np.cumprod(a, axis=-1).ravel(), [1, 2, 6, 4, 20, 120])
+
+    np.transpose(a, (1, 0))
+    c = np.cumsum(a, axis=1)
+    assert c.dims == (3, 2)
+    assert_sequences_equal(np.ascontiguousarray(c).ravel(), [1, 5, 2, 7, 3, 9])
+
+    n = 70000
+    s = np.cumsum(np.ones(shape=(n,), dtype=dtype))
+    assert s.ravel()[-1] == n
+    with pytest.raises(ValueError):
+        np.cumsum(a, axis=2)
+
+
+def test_num_threads():
+    default = np.get_num_threads()
+    a = np.randint(0, 10, shape=(100000,), dtype=np.int64)
+    try:
+        np.set_num_threads(1)
+        assert np.get_num_threads() == 1
+        serial = np.cumsum(a).ravel()
+
+        np.set_num_threads(4, pin=True)
+        assert np.get_num_threads() == 4
+        # Several callers share the pool at once.
+        futures = [np.sum_async(np.cumsum(a), 0) for _ in range(4)]
+        assert np.cumsum(a).ravel() == serial
+        assert all(f.result().ravel() == [builtins.sum(serial)] for f in futures)
+    finally:
+        np.set_num_threads(pin=False)
+    assert np.get_num_threads() == default
+
+
 @pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
 def test_dot(dtype):
     assert_sequences_equal(
@@ -122,6 +219,188 @@ def test_dot(dtype):
     )
 
 
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_dot_transposed(dtype):
+    a = np.array([[3, 1, 5],
+                  [2, 0, 4]], dtype=dtype)
+    b = np.array([[4, 1],
+                  [0, 2],
+                  [3, 3]], dtype=dtype)
+    expected = [[27, 20], [20, 14]]
+    at = np.array([[3, 2], [1, 0], [5, 4]], dtype=dtype)
+    bt = np.array([[4, 0, 3], [1, 2, 3]], dtype=dtype)
+    np.transpose(at, (1, 0))
+    np.transpose(bt, (1, 0))
+    for x, y in [(a, b), (at, b), (a, bt), (at, bt)]:
+        assert_sequences_equal(np.dot(x, y).ravel(), sum(expected, []))
+    assert_sequences_equal(bt.ravel(), [4, 1, 0, 2, 3, 3])
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_async(dtype):
+    a = np.array([[3, 1, 5],
+                  [2, 0, 4]], dtype=dtype)
+    b = np.array([[4, 1],
+                  [0, 2],
+                  [3, 3]], dtype=dtype)
+    f = np.dot_async(a, b)
+    assert isinstance(f, concurrent.futures.Future)
+    assert_sequences_equal(f.result().ravel(), [27, 20, 20, 14])
+    assert_sequences_equal(a.sum_async(1).result().ravel(), [9, 6])
+
+    async def overlapped():
+        return await asyncio.gather(asyncio.wrap_future(a.dot_async(b)),
+                                    asyncio.wrap_future(np.sum_async(a, 0)))
+    d, s = asyncio.run(overlapped())
+    assert_sequences_equal(d.ravel(), [27, 20, 20, 14])
+    assert_sequences_equal(s.ravel(), [5, 1, 9])
+
+    with assert_raises(TypeError):
+        a.dot_async([1, 2])
+    with assert_raises(ValueError):
+        a.sum_async(2)
+    # Errors inside the kernel surface through the future.
+    with assert_raises(ValueError):
+        a.dot_async(a).result()
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_csr_matrix(dtype):
+    dense = np.array([[0, 2, 0, 0],
+                      [0, 0, 0, 0],
+                      [1, 0, 0, 3]], dtype=dtype)
+    m = np.csr_matrix(dense)
+    assert m.nnz == 3 and m.dims == (3, 4) and m.dtype == dtype
+    assert_sequences_equal(m.todense().ravel(), dense.ravel())
+
+    b = np.array([[1, 2], [3, 4], [5, 6], [7, 8]], dtype=dtype)
+    assert_sequences_equal(np.dot(m, b).ravel(), np.dot(dense, b).ravel())
+    v = np.array([1, 2, 3, 4], dtype=dtype)
+    assert m.dot(v).dims == (3, 1)
+    assert_sequences_equal(m.dot(v).ravel(), [4, 0, 13])
+    np.transpose(b, (1, 0))
+    with assert_raises(ValueError):
+        m.dot(b)
+
+    t = np.csr_matrix(([1, 2, 3], ([0, 2, 0], [1, 0, 1])), shape=(3, 2),
+                      dtype=dtype)
+    assert t.nnz == 2
+    assert_sequences_equal(t.todense().ravel(), [0, 4, 0, 0, 2, 0])
+    with assert_raises(ValueError):
+        np.csr_matrix(([1], ([3], [0])), shape=(3, 2), dtype=dtype)
+    with assert_raises(ValueError):
+        np.csr_matrix(([1, 2], ([0], [0])), shape=(3, 2), dtype=dtype)
+    with assert_raises(ValueError):
+        np.csr_matrix(([1], ([0], [0])), dtype=dtype)
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_capture(dtype):
+    a = np.randint(-4, 5, shape=(6, 9), dtype=dtype)
+    b = np.randint(-4, 5, shape=(9, 5), dtype=dtype)
+    with np.capture() as g:
+        c = np.dot(a, b)
+        s = np.sum(c, 1)
+        t = a.sum(0)
+        with assert_raises(RuntimeError):
+            np.transpose(a, (1, 0))
+        with assert_raises(RuntimeError):
+            with np.capture():
+                pass
+    assert len(g.inputs) == 2 and g.inputs[0] is a and g.inputs[1] is b
+    assert len(g.outputs) == 3 and g.outputs[0] is c and g.outputs[2] is t
+
+    a2 = np.randint(-4, 5, shape=(6, 9), dtype=dtype)
+    b2 = np.randint(-4, 5, shape=(9, 5), dtype=dtype)
+    allocs = np.memory_stats()["total"]["allocs"]
+    assert g.replay([a2, b2]) is t
+    assert np.memory_stats()["total"]["allocs"] == allocs
+    c2 = np.dot(a2, b2)
+    assert_sequences_equal(c.ravel(), c2.ravel())
+    assert_sequences_equal(s.ravel(), np.sum(c2, 1).ravel())
+    assert_sequences_equal(t.ravel(), a2.sum(0).ravel())
+
+    with assert_raises(ValueError):
+        g.replay([b2, a2])
+    with assert_raises(ValueError):
+        g.replay([a2])
+    with assert_raises(TypeError):
+        g.replay([a2, [1, 2]])
+    with assert_raises(RuntimeError):
+        np.transpose(c, (1, 0))
+    del g
+    np.transpose(c, (1, 0))
+    np.transpose(a, (1, 0))
+
+
+class _DeferredExecutor:
+    """Holds submitted work until run() so in-flight state can be observed."""
+
+    def __init__(self):
+        self.pending = []
+
+    def submit(self, fn, *args):
+        f = concurrent.futures.Future()
+        self.pending.append((f, fn, args))
+        return f
+
+    def run(self):
+        for f, fn, args in self.pending:
+            if f.set_running_or_notify_cancel():
+                f.set_result(fn(*args))
+        self.pending = []
+
+
+def test_async_pins_operands():
+    a = np.array([[1.0, 2.0], [3.0, 4.0]])
+    b = np.array([[1.0, 0.0], [0.0, 1.0]])
+    executor = _DeferredExecutor()
+    np.set_async_executor(executor)
+    try:
+        f = np.dot_async(a, b)
+        g = a.sum_async(0)
+        for x in (a, b):
+            with assert_raises(RuntimeError):
+                np.transpose(x, (1, 0))
+        # Reads are still allowed while pinned.
+        assert_sequences_equal(np.dot(a, b).ravel(), [1, 2, 3, 4])
+
+        executor.run()
+        assert_sequences_equal(f.result().ravel(), [1, 2, 3, 4])
+        assert_sequences_equal(g.result().ravel(), [4, 6])
+        np.transpose(b, (1, 0))
+        np.transpose(a, (1, 0))
+
+        # Cancelling before the work starts releases the operands too.
+        h = a.dot_async(b)
+        assert h.cancel()
+        executor.run()
+        np.transpose(a, (1, 0))
+    finally:
+        np.set_async_executor(None)
+    with assert_raises(TypeError):
+        np.set_async_executor(object())
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_copy(dtype):
+    a = np.array([[1, 2, 3], [4, 5, 6]], dtype=dtype)
+    assert np.ascontiguousarray(a) is a
+    f = np.copy(a, order="F")
+    assert f.strides == (1, 2) and f.f_contiguous and not f.c_contiguous
+    assert_sequences_equal(f.ravel(), [1, 2, 3, 4, 5, 6])
+
+    np.transpose(a, (1, 0))
+    assert not a.c_contiguous
+    c = np.ascontiguousarray(a)
+    assert c is not a and c.c_contiguous and c.strides == (2, 1)
+    assert_sequences_equal(c.ravel(), [1, 4, 2, 5, 3, 6])
+    assert np.copy(a, order="K").f_contiguous
+
+    with pytest.raises(ValueError):
+        np.copy(a, order="X")
+
+
 @pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
 def test_ones(dtype):
     a = np.ones(shape=(3,), dtype=dtype)
@@ -135,6 +414,368 @@ def test_ones(dtype):
     assert np.sum(np.sum(b, 1), 0).ravel() == [7 * 4]
 
 
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_constructors(dtype):
+    a = np.empty((4, 3), dtype=dtype)
+    assert_array_metadata(a, dtype, 2, (4, 3), (3, 1))
+
+    z = np.zeros((5, 2), dtype=dtype)
+    assert_array_metadata(z, dtype, 2, (5, 2), (2, 1))
+    assert z.ravel() == [0] * 10
+
+    f = np.full(3, 7, dtype=dtype)
+    assert_array_metadata(f, dtype, 2, (3, 1), (1, 1))
+    assert f.ravel() == [7] * 3
+
+    r = np.arange(2, 11, 3, dtype=dtype)
+    assert_array_metadata(r, dtype, 2, (3, 1), (1, 1))
+    assert r.ravel() == [2, 5, 8]
+    assert np.arange(4, dtype=dtype).ravel() == [0, 1, 2, 3]
+    assert np.arange(3, 0, -1, dtype=dtype).ravel() == [3, 2, 1]
+    assert np.arange(1, 1, dtype=dtype).dims == (0, 1)
+    assert_raises(ValueError, np.arange, 0, 1, 0, dtype)
+
+    assert np.linspace(0, 8, 5, dtype=dtype).ravel() == [0, 2, 4, 6, 8]
+    assert np.linspace(0, 8, 4, endpoint=False, dtype=dtype).ravel() == [0, 2, 4, 6]
+    assert_raises(ValueError, np.linspace, 0, 1, -1, dtype=dtype)
+
+    e = np.eye(3, dtype=dtype)
+    assert e.ravel() == [1, 0, 0, 0, 1, 0, 0, 0, 1]
+    assert np.eye(2, 3, k=1, dtype=dtype).ravel() == [0, 1, 0, 0, 0, 1]
+    assert np.eye(3, 2, k=-1, dtype=dtype).ravel() == [0, 0, 1, 0, 0, 1]
+    assert_raises(ValueError, np.eye, -1)
+
+    # Big enough for the parallel fill path.
+    n = (1 << 20) + 5
+    big = np.arange(n, dtype=dtype)
+    assert np.max(big, axis=None) == n - 1
+    assert np.sum(np.full(n, 2, dtype=dtype), axis=None) == 2 * n
+
+
+def test_int_constructors_are_exact():
+    big = 2 ** 53
+    assert np.full(2, big + 1, dtype=np.int64).ravel() == [big + 1] * 2
+    assert np.arange(big, big + 4, dtype=np.int64).ravel() == [big, big + 1, big + 2, big + 3]
+    assert np.arange(2 ** 63 - 3, 2 ** 63 - 1).ravel() == [2 ** 63 - 3, 2 ** 63 - 2]
+    assert np.arange(-2 ** 63, -2 ** 63 + 7, 3).ravel() == [-2 ** 63, -2 ** 63 + 3,
+                                                           -2 ** 63 + 6]
+    assert np.full(1, 2 ** 31 - 1, dtype=np.int32).ravel() == [2 ** 31 - 1]
+    assert np.full(2, 2.5, dtype=np.int32).ravel() == [2, 2]
+
+    # Values an integer dtype cannot hold raise rather than wrap.
+    assert_raises(OverflowError, np.full, 1, 2 ** 31, dtype=np.int32)
+    assert_raises(OverflowError, np.full, 1, 2 ** 64, dtype=np.int64)
+    assert_raises(OverflowError, np.full, 1, 1e19, dtype=np.int64)
+    assert_raises(OverflowError, np.full, 1, math.nan, dtype=np.int32)
+    assert_raises(OverflowError, np.arange, 2 ** 31 - 1, 2 ** 31 + 1, dtype=np.int32)
+    assert_raises(OverflowError, np.arange, 0.0, 5e9, 2.5e9, dtype=np.int32)
+
+
+def test_constructor_defaults():
+    assert np.arange(3).dtype == np.int64
+    assert np.arange(0.5, 2).dtype == np.double
+    assert np.arange(0.5, 2).ravel() == [0.5, 1.5]
+    assert np.zeros(2).dtype == np.double
+    assert np.linspace(0, 1, 3).ravel() == [0, 0.5, 1]
+    assert_raises(ValueError, np.empty, (2, 2), dtype=9)
+
+
+def _ulps(got, want, dtype):
+    if dtype == np.float:
+        want = struct.unpack("f", struct.pack("f", want))[0]
+        m, e = math.frexp(want)
+        ulp = math.ldexp(1.0, max(e, -125) - 24)
+    else:
+        ulp = math.ulp(want)
+    return abs(got - want) / ulp
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_unary(dtype):
+    funcs = [(np.exp, math.exp, 1, -20, 20), (np.log, math.log, 1, 1e-3, 1e3),
+             (np.sqrt, math.sqrt, 0.5, 0, 1e6),
+             (np.tanh, math.tanh, 1.5, -10, 10),
+             (np.sigmoid, lambda x: 1 / (1 + math.exp(-x)), 2.5, -30, 30)]
+    n = 1001
+    if dtype in (np.int32, np.int64):
+        a = np.arange(1, n, dtype=dtype)
+        for f, _, _, _, _ in funcs:
+            assert_raises(TypeError, f, a)
+        return
+
+    for f, ref, bound, lo, hi in funcs:
+        a = np.linspace(lo, hi, n, dtype=dtype)
+        xs = a.ravel()
+        got = f(a).ravel()
+        # The reference is itself rounded, so allow one more ULP.
+        assert builtins.max(_ulps(g, ref(x), dtype)
+                            for g, x in zip(got, xs)) <= bound + 1
+
+        out = np.empty(n, dtype=dtype)
+        assert f(a, out=out) is out
+        assert out.ravel() == got
+        assert f(a, out=a) is a
+        assert a.ravel() == got
+
+    assert math.isnan(np.log(np.full(1, -1, dtype=dtype)).ravel()[0])
+    assert np.exp(np.full(1, 1000, dtype=dtype)).ravel() == [math.inf]
+    assert np.sigmoid(np.full(1, -1000, dtype=dtype)).ravel() == [0]
+    assert_raises(ValueError, np.exp, a, out=np.empty(3, dtype=dtype))
+    assert_raises(ValueError, a.unary, "cos")
+
+    # Transposed input: column-major, so the result keeps its layout and
+    # maps flat. Big enough to run in parallel.
+    t = np.linspace(-5, 5, 300 * 200, dtype=dtype).ravel()
+    b = np.array([t[i * 200:(i + 1) * 200] for i in range(300)], dtype=dtype)
+    np.transpose(b, (1, 0))
+    e = np.tanh(b)
+    assert e.dims == (200, 300)
+    want = b.copy().ravel()
+    assert builtins.max(_ulps(g, math.tanh(x), dtype)
+                        for g, x in zip(e.ravel(), want)) <= 2.5
+
+    # Into a row-major out the layouts differ, so rows are gathered.
+    out = np.empty((200, 300), dtype=dtype)
+    assert np.tanh(b, out=out) is out
+    assert out.ravel() == e.copy().ravel()
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_blas1(dtype):
+    vals = [[3, -8, 1], [-2, 8, 4]]
+    x = np.array(vals, dtype=dtype)
+    flat = [v for row in vals for v in row]
+    y = np.array([[1, 1], [2, 2], [3, 3]], dtype=dtype)
+    np.transpose(y, (1, 0))
+
+    assert np.axpy(2, x, y) is y
+    assert y.ravel() == [1 + 6, 2 - 16, 3 + 2, 1 - 4, 2 + 16, 3 + 8]
+    assert np.scal(-1, y) is y
+    assert y.ravel() == [-7, 14, -5, 3, -18, -11]
+    assert np.asum(x) == 26
+    assert math.isclose(np.nrm2(x), math.sqrt(builtins.sum(v * v for v in flat)),
+                        rel_tol=1e-6)
+    # -8 and 8 tie; the first in row-major order wins.
+    assert np.iamax(x) == 1
+    np.transpose(x, (1, 0))
+    assert np.iamax(x) == 2
+
+    assert_raises(ValueError, np.axpy, 1, x, np.zeros(6, dtype=dtype))
+
+    # Large enough to split axpy and scal across threads.
+    n = 1 << 21
+    a = np.full(n, 2, dtype=dtype)
+    b = np.ones(n, dtype=dtype)
+    np.scal(3, np.axpy(2, b, a))
+    assert np.asum(a) == 12 * n
+    assert math.isclose(np.nrm2(a), 12 * math.sqrt(n), rel_tol=1e-6)
+
+    if dtype == np.double:
+        for v in (1e300, 1e-300):
+            assert math.isclose(np.nrm2(np.full(4, v, dtype=dtype)), 2 * v, rel_tol=1e-15)
+        assert np.nrm2(np.array([1.0, math.inf], dtype=dtype)) == math.inf
+        assert math.isnan(np.nrm2(np.array([math.nan, math.inf], dtype=dtype)))
+    if dtype in (np.float, np.double):
+        # NaNs are skipped, as in the reference BLAS.
+        assert np.iamax(np.array([math.nan, -3.0, 2.0] * 11, dtype=dtype)) == 1
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_index(dtype):
+    a = np.array([[1, 2, 3], [4, 5, 6]], dtype=dtype)
+    assert a[0, 1] == 2 and a[-1, -3] == 4
+    assert isinstance(a[1, 2], int if dtype in (np.int32, np.int64) else builtins.float)
+    a[1, 0] = 9
+    a[-1, -1] = -6
+    assert a.ravel() == [1, 2, 3, 9, 5, -6]
+    for key in ((2, 0), (0, -4)):
+        assert_raises(IndexError, a.__getitem__, key)
+        assert_raises(IndexError, a.__setitem__, key, 0)
+    assert_raises(TypeError, a.__getitem__, 0)
+    assert_raises(TypeError, a.__setitem__, (0, 0), "x")
+
+    rows = np.array([1, 0, -1], dtype=np.int64)
+    assert a[rows].dims == (3, 3)
+    assert a[rows].ravel() == [9, 5, -6, 1, 2, 3, 9, 5, -6]
+    assert np.take(a, np.array([2, 0], dtype=np.int32), axis=1).ravel() == [3, 1, -6, 9]
+    assert np.take(a, np.array([[5, 0]], dtype=np.int32)).ravel() == [-6, 1]
+    np.transpose(a, (1, 0))
+    assert np.take(a, np.array([1], dtype=np.int32), axis=0).ravel() == [2, 5]
+    np.transpose(a, (1, 0))
+    assert_raises(IndexError, np.take, a, np.array([2], dtype=np.int32), 0)
+    assert_raises(IndexError, a.__getitem__, np.array([0], dtype=np.double))
+
+    np.put(a, np.array([0, 0], dtype=np.int32), np.array([[7, 8], [1, 8]], dtype=dtype),
+           axis=1)
+    assert a.ravel() == [8, 2, 3, 8, 5, -6]
+    a[np.array([1], dtype=np.int32)] = 0
+    assert a.ravel() == [8, 2, 3, 0, 0, 0]
+    # A bad index anywhere leaves a untouched.
+    assert_raises(IndexError, np.put, a, np.array([0, 6], dtype=np.int32), 1)
+    assert a.ravel() == [8, 2, 3, 0, 0, 0]
+    assert_raises(IndexError, np.put, a, np.array([0], dtype=np.int32),
+                  np.array([1, 2], dtype=dtype), 0)
+
+    b = np.array([[1, 2, 3], [4, 5, 6]], dtype=dtype)
+    b[np.array([[1, 0]], dtype=np.int32)] = b
+    assert b.ravel() == [4, 5, 6, 1, 2, 3]
+
+    mask = np.array([[1, 0, 1], [0, 1, 0]], dtype=np.int32)
+    assert np.extract(mask, a).ravel() == [8, 3, 0]
+    np.putmask(a, mask, -1)
+    assert a.ravel() == [-1, 2, -1, 0, -1, 0]
+    np.putmask(a, mask, np.array([[4, 4, 4], [5, 5, 5]], dtype=dtype))
+    assert a.ravel() == [4, 2, 4, 0, 5, 0]
+    assert_raises(ValueError, np.extract, np.ones(3, dtype=np.int32), a)
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_sort(dtype):
+    vals = [[3, -1, 2, -1], [0, 7, -5, 7], [4, 4, 4, 1]]
+    a = np.array(vals, dtype=dtype)
+    cols = [list(c) for c in zip(*vals)]
+
+    assert np.sort(a).ravel() == [v for row in vals for v in sorted(row)]
+    assert np.sort(a, axis=0).ravel() == [v for row in zip(*map(sorted, cols)) for v in row]
+    flat = np.sort(a, axis=None)
+    assert flat.dims == (12, 1)
+    assert flat.ravel() == sorted(v for row in vals for v in row)
+    assert a.ravel() == [v for row in vals for v in row]
+    # Ties keep their order.
+    assert np.argsort(a).ravel() == [1, 3, 2, 0, 2, 0, 1, 3, 3, 0, 1, 2]
+    assert np.argsort(a, axis=None).ravel()[:3] == [6, 1, 3]
+    np.transpose(a, (1, 0))
+    assert np.argsort(a, axis=0).ravel() == [1, 2, 3, 3, 0, 0, 2, 1, 1, 0, 3, 2]
+    np.transpose(a, (1, 0))
+
+    b = np.copy(a)
+    assert b.sort(0) is None
+    assert b.ravel() == np.sort(a, 0).ravel()
+    assert_raises(ValueError, b.sort, None)
+
+    p = np.partition(a, 1)
+    for row, got in zip(vals, [p.ravel()[i:i + 4] for i in range(0, 12, 4)]):
+        kth = sorted(row)[1]
+        assert got[1] == kth and got[0] <= kth and min(got[2:]) >= kth
+    p = np.partition(a, 4, axis=None).ravel()
+    assert p[4] == 1 and builtins.max(p[:4]) <= 1 and min(p[5:]) >= 1
+    assert_raises(ValueError, np.partition, a, 12, None)
+    a.partition(-1, axis=0)
+    assert a.ravel()[8:] == [4, 7, 4, 7]
+    assert_raises(ValueError, a.partition, 3, 0)
+
+    a = np.array(vals, dtype=dtype)
+    v, i = np.topk(a, 2)
+    assert v.ravel() == [3, 2, 7, 7, 4, 4] and i.ravel() == [0, 2, 1, 3, 0, 1]
+    assert i.dtype == np.int64
+    v, i = np.topk(a, 3, axis=None, largest=False)
+    assert v.dims == (3, 1) and v.ravel() == [-5, -1, -1] and i.ravel() == [6, 1, 3]
+    assert_raises(ValueError, np.topk, a, 5)
+
+    if dtype in (np.float, np.double):
+        f = np.array([math.nan, 1.5, -math.inf, -0.0, 0.0, -2.5], dtype=dtype)
+        got = np.sort(f, axis=0).ravel()
+        assert got[:5] == [-math.inf, -2.5, -0.0, 0.0, 1.5] and math.isnan(got[5])
+        assert math.copysign(1, got[2]) == -1
+        assert np.argsort(f, axis=None).ravel()[-1] == 0
+
+    # Empty lanes, and no lanes at all.
+    e = np.zeros((5, 0), dtype=dtype)
+    assert e.sort(axis=1) is None and e.dims == (5, 0)
+    assert np.sort(e, axis=None).dims == (0, 1)
+    assert e.sorted(None).dims == (0, 1)
+    assert np.argsort(e, 1).dims == (5, 0)
+    assert np.partition(e, 2, axis=0).dims == (5, 0)
+    assert_raises(ValueError, np.partition, e, 0, 1)
+    v, i = np.topk(e, 2, axis=0)
+    assert v.dims == (2, 0) and i.dims == (2, 0)
+    assert np.argsort(np.zeros((0, 0), dtype=dtype), None).dims == (0, 1)
+
+    # Long enough to sort in parallel.
+    n = 1 << 17
+    keys = [(k * 7919) % 100003 - 50000 for k in range(n)]
+    big = np.array(keys, dtype=dtype)
+    np.set_num_threads(4)
+    try:
+        assert np.sort(big, axis=0).ravel() == sorted(keys)
+        idx = np.argsort(big, axis=0).ravel()
+    finally:
+        np.set_num_threads()
+    assert idx == sorted(range(n), key=lambda k: keys[k])
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_backend(dtype):
+    a = np.array([[(i * 7 + j) % 11 - 5 for j in range(30)] for i in range(40)], dtype=dtype)
+    b = np.array([[(i * 3 + j) % 5 - 2 for j in range(20)] for i in range(30)], dtype=dtype)
+    names = np.list_backends()
+    assert {'simd', 'threaded', 'reference'} <= set(names)
+
+    with np.backend('reference'):
+        assert np.get_backend() == 'reference'
+        assert np.get_backend('gemm', dtype) == 'reference'
+        want = np.dot(a, b).ravel()
+        norm = np.nrm2(a)
+    # Exact small-integer products agree across backends.
+    for spec in [n for n in names if n != 'reference'] + ['gemm=reference,simd']:
+        with np.backend(spec):
+            assert np.dot(a, b).ravel() == want
+            assert math.isclose(np.nrm2(a), norm, rel_tol=1e-6)
+
+    old = np.get_backend()
+    with np.backend('threaded,nrm2=reference'):
+        assert np.get_backend('gemm', dtype) == 'threaded'
+        assert np.get_backend('nrm2', dtype) == 'reference'
+        assert np.get_backend('asum', dtype) == 'simd'
+    assert np.get_backend() == old
+
+    assert_raises(ValueError, np.set_backend, 'nope')
+    assert_raises(ValueError, np.set_backend, 'simd,gemv=simd')
+    assert_raises(ValueError, np.get_backend, 'gemv', dtype)
+    assert np.get_backend() == old
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_tune(dtype, tmp_path):
+    path = str(tmp_path / "cache" / "gemm_tune")
+    got = np.tune(dtypes=[dtype], shapes=["small"], path=path)
+    blk = got[(dtype, "small")]
+    assert np.get_gemm_blocking(dtype, "small") == blk
+    assert all(blk[f] > 0 for f in ("mc", "kc", "nc")) and blk["panel"] >= 0
+    name = ["INT32", "INT64", "FLOAT", "DOUBLE"][dtype]
+    with open(path) as f:
+        lines = [l.split("\t") for l in f if not l.startswith("#")]
+    assert [l[3].split() for l in lines if l[1:3] == [name, "small"]] == \
+        [[str(blk[f]) for f in ("mc", "kc", "nc", "panel")]]
+
+    assert_raises(ValueError, np.tune, dtypes=[dtype], shapes=["huge"], path=path)
+    assert_raises(ValueError, np.get_gemm_blocking, dtype, "huge")
+
+
+def test_autotune_cache(tmp_path):
+    path = str(tmp_path / "gemm_tune")
+    env = dict(os.environ, MINUMPY_TUNE_CACHE=path, MINUMPY_AUTOTUNE="1")
+    # The first small double product tunes its class and writes the cache.
+    script = ("import minumpy as np; a = np.ones((8, 8), dtype=np.double); "
+              "np.dot(a, a); print(np.get_gemm_blocking(np.double, 'small'))")
+    tuned = subprocess.run([sys.executable, "-c", script], env=env, check=True,
+                           capture_output=True, text=True).stdout
+    with open(path) as f:
+        lines = [l.split("\t") for l in f if not l.startswith("#")]
+    assert [(l[1], l[2]) for l in lines] == [("DOUBLE", "small")]
+    mc, kc, nc, panel = map(int, lines[0][3].split())
+    assert eval(tuned) == {"mc": mc, "kc": kc, "nc": nc, "panel": panel}
+
+    # Later imports reload the entry for this machine without tuning.
+    with open(path, "w") as f:
+        f.write("\t".join(lines[0][:3] + ["40 48 56 0\n"]))
+    env["MINUMPY_AUTOTUNE"] = "0"
+    script = "import minumpy as np; print(np.get_gemm_blocking(np.double, 'small'))"
+    out = subprocess.run([sys.executable, "-c", script], env=env, check=True,
+                         capture_output=True, text=True).stdout
+    assert eval(out) == {"mc": 40, "kc": 48, "nc": 56, "panel": 0}
+
+
 @pytest.mark.parametrize('dtype', [np.int32, np.int64])
 def test_randint(dtype):
     a = np.randint(shape=(6, 3), dtype=dtype)
@@ -143,3 +784,159 @@ def test_randint(dtype):
     assert s[0] >= 0 and s[0] <= 18
 
     assert_raises(ValueError, np.randint, low=2, high=1)
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_str(dtype):
+    is_int = dtype in (np.int32, np.int64)
+    a = np.array([[2, -81, 26],
+                  [17, 102, -3]], dtype=dtype)
+    if is_int:
+        assert str(a) == "[2 -81 26]\n[17 102 -3]\n"
+    else:
+        assert str(a) == ("[2.00e+00 -8.10e+01 2.60e+01]\n"
+                          "[1.70e+01 1.02e+02 -3.00e+00]\n")
+
+    defaults = np.get_printoptions()
+    try:
+        np.set_printoptions(threshold=10, edgeitems=1, precision=1)
+        assert np.get_printoptions() == {
+            "threshold": 10, "edgeitems": 1, "precision": 1}
+        b = np.ones(shape=(100, 100), dtype=dtype)
+        if is_int:
+            assert str(b) == "[1 ... 1]\n...\n[1 ... 1]\n"
+        else:
+            assert str(b) == "[1.0e+00 ... 1.0e+00]\n...\n[1.0e+00 ... 1.0e+00]\n"
+
+        assert_raises(ValueError, np.set_printoptions, edgeitems=0)
+        assert_raises(ValueError, np.set_printoptions, precision=17)
+    finally:
+        np.set_printoptions(**defaults)
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_stats(dtype):
+    a = np.ones(shape=(4, 3), dtype=dtype)
+    b = np.ones(shape=(3, 2), dtype=dtype)
+    try:
+        np.reset_stats()
+        np.enable_stats()
+        np.dot(a, b)
+        np.enable_stats(False)
+        np.sum(a, 0)
+
+        s = np.stats()
+        assert s["dot"]["calls"] == 1
+        assert s["dot"]["elems"] == 12 + 6
+        assert s["dot"]["ns"] > 0
+        assert s["ravel"]["calls"] == 0
+        assert s["alloc"]["calls"] >= 1
+        assert s["sum"]["calls"] == 0
+
+        np.reset_stats()
+        assert all(v["calls"] == 0 for v in np.stats().values())
+    finally:
+        np.enable_stats(False)
+
+
+def test_trace(tmp_path):
+    path = str(tmp_path / "trace.json")
+    a = np.ones(shape=(4, 3))
+    b = np.ones(shape=(3, 2))
+
+    np.trace_start(path)
+    assert_raises(RuntimeError, np.trace_start, path)
+    threads = [threading.Thread(target=np.dot, args=(a, b)) for _ in range(2)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    np.sum(a, 0)
+    np.trace_stop()
+    assert_raises(RuntimeError, np.trace_stop)
+
+    with open(path) as f:
+        events = json.load(f)["traceEvents"]
+    dots = [e for e in events if e["name"] == "array_dot" and e["ph"] == "B"]
+    assert len(dots) == 2
+    assert len({e["tid"] for e in dots}) == 2
+    assert dots[0]["args"] == {"dtype": "DOUBLE", "a": [4, 3], "b": [3, 2]}
+    names = {e["name"] for e in events}
+    assert {"py.dot", "py.sum", "array_sum", "array_reduce",
+            "array_alloc"} <= names
+    assert all(e["ph"] in ("B", "E") for e in events)
+
+
+@pytest.mark.parametrize('dtype', [np.int32, np.int64, np.float, np.double])
+def test_memory_stats(dtype):
+    name = {np.int32: "int32", np.int64: "int64",
+            np.float: "float", np.double: "double"}[dtype]
+    itemsize = 4 if dtype in (np.int32, np.float) else 8
+    nbytes = 300 * 200 * itemsize
+    before = np.memory_stats()[name]
+
+    np.reset_peak_memory()
+    a = np.ones(shape=(300, 200), dtype=dtype)
+    during = np.memory_stats()[name]
+    # Allocated once and filled in place, without a template array.
+    assert during["live"] - before["live"] == nbytes
+    assert during["allocs"] - before["allocs"] == 1
+    assert during["peak"] >= before["live"] + nbytes
+
+    del a
+    after = np.memory_stats()
+    assert after[name]["live"] == before["live"]
+    assert after["total"]["peak"] >= nbytes
+
+
+def test_large_shapes():
+    # Element counts past int64 are rejected; ones that fit but cannot be
+    # backed raise MemoryError.
+    assert_raises(ValueError, np.array, shape=(2**40, 2**40))
+    assert_raises(MemoryError, np.array, shape=(2**31, 2**20), dtype=np.int32)
+
+    n = 2**31 + 16
+    try:
+        a = np.array(shape=(n,), dtype=np.int32)
+    except MemoryError:
+        pytest.skip("cannot allocate a {}-element array".format(n))
+    assert a.dims == (n, 1)
+    assert a.strides == (1, 1)
+    assert np.sum(a, axis=None) == 0
+    assert np.argmax(a) == 0
+
+
+@pytest.mark.parametrize("dtype", [np.int32, np.int64, np.float, np.double])
+def test_memory_policy(dtype):
+    before = np.get_memory_policy()
+    with np.memory_policy(mmap_threshold=1 << 16, hugepages=True,
+                          numa="interleave"):
+        policy = np.get_memory_policy()
+        assert policy["mmap_threshold"] == 1 << 16
+        assert policy["hugepages"] is True
+        assert policy["numa"] == "interleave"
+        a = np.ones(shape=(1100, 1000), dtype=dtype)
+        z = np.array(shape=(300, 200), dtype=dtype)
+    assert np.get_memory_policy() == before
+    assert np.sum(a, axis=None) == 1100 * 1000
+    assert np.sum(z, axis=None) == 0
+
+    assert_raises(ValueError, np.set_memory_policy, numa="nearest")
+    assert_raises(ValueError, np.set_memory_policy, numa="bind", node=-1)
+    assert_raises(ValueError, np.set_memory_policy, mmap_threshold=-1)
+    assert np.get_memory_policy() == before
+
+
+def test_tracemalloc():
+    tracemalloc.start()
+    try:
+        a = np.ones(shape=(500, 400), dtype=np.double)
+        snapshot = tracemalloc.take_snapshot().filter_traces(
+            [tracemalloc.DomainFilter(True, np.TRACEMALLOC_DOMAIN)])
+        assert sum(t.size for t in snapshot.traces) == 500 * 400 * 8
+        del a
+        snapshot = tracemalloc.take_snapshot().filter_traces(
+            [tracemalloc.DomainFilter(True, np.TRACEMALLOC_DOMAIN)])
+        assert len(snapshot.traces) == 0
+    finally:
+        tracemalloc.stop()
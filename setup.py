@@ -8,7 +8,21 @@ setup(name='minumpy',
         ['minumpy/core/array_py.c',
          'minumpy/core/array_py_utils.c',
          'minumpy/core/array.c',
+         'minumpy/core/array_backend.c',
+         'minumpy/core/array_blas.c',
          'minumpy/core/array_dtypes.c',
+         'minumpy/core/array_graph.c',
+         'minumpy/core/array_index.c',
+         'minumpy/core/array_math.c',
+         'minumpy/core/array_mem.c',
+         'minumpy/core/array_parallel.c',
+         'minumpy/core/array_sort.c',
+         'minumpy/core/array_sparse.c',
+         'minumpy/core/array_stats.c',
+         'minumpy/core/array_trace.c',
+         'minumpy/core/array_tune.c',
          'minumpy/core/array_utils.c',
-         ])
+         ],
+        define_macros=[('ARRAY_STATS', None), ('ARRAY_TRACE', None)],
+        libraries=['dl'])
       ])